@@ -0,0 +1,696 @@
+      subroutine sixsrun(asol,phi0,avis,phiv,month,jday,uw,uo3,
+     s     iaer,taer55,xps,iwave,wlinfu,wlsupu,nfilt,filt,
+     s     idirec,ro,pws,phi_wind,xsal,pcl,
+     s     tgas,tscat,sphalb,optdep,refl,appref,ierr)
+
+c**********************************************************************c
+c                                                                      c
+c     in-process entry point to 6sV version 1.0B                       c
+c                                                                      c
+c     this is the computation of the main program (main.f) for the     c
+c     subset of the inputs that ledaps needs, with the card reads      c
+c     replaced by arguments and the printed report replaced by output  c
+c     arrays.  the numerical code is the same as the one of main.f.    c
+c                                                                      c
+c     input parameters:                                                c
+c       asol,phi0,avis,phiv : solar zenith, solar azimuth, view        c
+c                             zenith and view azimuth (degrees)        c
+c       month,jday          : month and day of the month               c
+c       uw,uo3              : water vapor (g/cm2) and ozone (cm-atm)   c
+c                             (idatm=8)                                c
+c       iaer                : aerosol model (0 no aerosols,            c
+c                             1 continental, 2 maritime, 3 urban,      c
+c                             5 desert, 6 biomass, 7 stratospheric)    c
+c       taer55              : aerosol optical thickness at 550 nm      c
+c       xps                 : target level (as in main.f)              c
+c       iwave               : 1 user defined filter function, or a     c
+c                             predefined band of main.f (2 to 118)     c
+c       wlinfu,wlsupu       : user filter limits (microns, iwave=1)    c
+c       nfilt,filt          : user filter values, 0.0025 microns step  c
+c                             starting at wlinfu (iwave=1)             c
+c       idirec              : 0 homogeneous lambertian ground of       c
+c                             reflectance ro, 1 ocean brdf defined by  c
+c                             pws,phi_wind,xsal,pcl                    c
+c     the sensor is always at satellite level.                         c
+c                                                                      c
+c     output parameters (spectrally integrated values):                c
+c       tgas(3,8)   : (downward,upward,total) gaseous transmittance    c
+c                     (global,water,ozone,co2,oxyg,no2,ch4,co)         c
+c       tscat(3,3)  : (downward,upward,total) scattering transmittance c
+c                     (rayleigh,aerosols,total)                        c
+c       sphalb(3)   : spherical albedo     (rayleigh,aerosols,total)   c
+c       optdep(3)   : optical depth total  (rayleigh,aerosols,total)   c
+c       refl(3)     : reflectance I        (rayleigh,aerosols,total)   c
+c       appref      : apparent reflectance                             c
+c       ierr        : 0 on success, 1 on error                         c
+c                                                                      c
+c**********************************************************************c
+
+      include "paramdef.inc"
+      dimension anglem(mu2_p),weightm(mu2_p),
+     s   rm(-mu_p:mu_p),gb(-mu_p:mu_p),rp(np_p),gp(np_p)
+      dimension  xlmus(-mu_p:mu_p,np_p),xlmuv(-mu_p:mu_p,np_p)
+      dimension brdfints(-mu_p:mu_p,np_p)
+     s    ,sbrdftmp(-1:1,1),sbrdf(1501),
+     s     srm(-1:1),srp(1),
+     s    brdfintv(-mu_p:mu_p,np_p),robar(1501),
+     s    robarp(1501),robard(1501),xlm1(-mu_p:mu_p,np_p),
+     s    xlm2(-mu_p:mu_p,np_p)
+        real romix_fi(nfi_p),rorayl_fi(nfi_p),
+     s       roatm_fi(3,20,nfi_p),xlphim(nfi_p)
+        real rolut(mu_p,41),roluts(20,mu_p,41)
+        real rolutq(mu_p,41),rolutsq(20,mu_p,41)
+        real rolutu(mu_p,41),rolutsu(20,mu_p,41)
+	real filut(mu_p,41)
+	integer nfilut(mu_p)
+        real anglem,weightm,rm,gb,accu2,accu3
+        real rp,gp,xlmus,xlmuv,brdfints
+        real brdfintv,robar,robarp,robard,xlm1,xlm2
+        real c,wldisc,rocl,roel,zpl,ppl,tpl,whpl
+        real wopl,xacc,s,wlinf,wlsup,delta
+        real sigma,z,p,t,wh,wo,ext,ome,gasym,phase,qhase,roatm,dtdir
+        real dtdif,utdir,utdif,sphal,wldis,trayl,traypl,pi,pi2,step
+        real asol,phi0,avis,phiv,dsol
+        real phi,phirad,xmus,xmuv,xmup,xmud,uw,uo3,taer55
+        real xps,uwus,uo3us,taer55p,puw,puo3,puwus
+        real puo3us,wl,wlmoy,tamoy,tamoyp,pizmoy,pizmoyp,trmoy
+        real trmoyp,fr,rad,spalt,uhase
+        real albbrdf,robar1,xnorm1,rob,xnor
+        real rdown,rdir,robar2,xnorm2,ro,roc,roe
+        real seb,sbor,swl,sb,refet
+        real tgasm,dgasm,ugasm,sdwava,sdozon,sddica,sdoxyg
+        real sdniox,sdmoca,sdmeth,suwava,suozon,sudica,suoxyg
+        real suniox,sumoca,sumeth,stwava,stozon,stdica,stoxyg,stniox
+        real stmoca,stmeth,sodray,sodaer,sodtot,sroray
+        real sroaer,srotot,sdtotr,sdtota,sdtott,sutotr,sutota
+        real sutott,sasr,sasa,sast,dtozon,dtdica,dtoxyg
+        real dtniox,dtmeth,dtmoca,utozon,utdica,utoxyg,utniox
+        real utmeth,utmoca,attwava,ttozon,ttdica,ttoxyg,ttniox
+        real ttmeth,ttmoca,dtwava,utwava,ttwava,coef,romix,rorayl
+        real roaero,phaa,phar,tsca,tray,trayp,taerp,dtott,utott
+	real rqmix,rqrayl,rqaero,qhaa,qhar
+	real rumix,rurayl,ruaero,uhaa,uhar
+        real astot,asray,asaer,utotr,utota,dtotr,dtota,dgtot,tgtot
+        real tgp1,tgp2,rqatm,ruatm
+        real ugtot,edifr,edifa,tdird,tdiru,tdifd,tdifu,fra
+        real fae,avr,romeas2
+        real ratm2,rsurf
+        real pps,palt,ftray
+        integer nt,mu,mu2,np,nfi,k,iwr,mum1,idatm,idatmp,ipol
+        integer j,l,month,jday,iaer,iaerp
+        integer iwave,iinf,isup,i,idirec,nfilt,ierr,iaer_prof
+      real wlinfu,wlsupu,filt(nfilt)
+      real pws,phi_wind,xsal,pcl,paw,rfoam,rwat,rglit
+      real tgas(3,8),tscat(3,3),sphalb(3),optdep(3),refl(3),appref
+      integer nquad
+      common /num_quad/ nquad
+      real rn,ri,x1,x2,x3,cij,rsunph,nrsunph,rmax,rmin
+      integer icp,irsunph
+      character FILE*80,FILE2*80
+      logical ier
+      integer igmax
+      common/sixs_ier/iwr,ier
+      common /mie_in/ rmax,rmin,icp,rn(20,4),ri(20,4),x1(4),x2(4),
+     s x3(4),cij(4),irsunph,rsunph(50),nrsunph(50)
+      common /multorder/ igmax
+      common /sixs_planesim/zpl(34),ppl(34),tpl(34),whpl(34),wopl(34)
+      common /sixs_test/xacc
+      common /sixs_ffu/s(1501),wlinf,wlsup
+      common /sixs_del/ delta,sigma
+      common /sixs_atm/z(34),p(34),t(34),wh(34),wo(34)
+      common /sixs_aer/ext(20),ome(20),gasym(20),phase(20),qhase(20),
+     suhase(20)
+      common /sixs_disc/ roatm(3,20),dtdir(3,20),dtdif(3,20),
+     s utdir(3,20),utdif(3,20),sphal(3,20),wldis(20),trayl(20),
+     s traypl(20),rqatm(3,20),ruatm(3,20)
+      dimension c(4),wldisc(20),rocl(1501),roel(1501)
+      data wldisc /0.350,0.400,0.412,0.443,0.470,0.488,0.515,0.550,
+     s             0.590,0.633,0.670,0.694,0.760,0.860,1.240,1.536,
+     s             1.650,1.950,2.250,3.750/
+
+c***********************************************************************
+c     initialisations (see main.f)
+c***********************************************************************
+      FILE='  '
+      FILE2='  '
+      nt=nt_p
+      mu=mu_p
+      mu2=mu2_p
+      np=np_p
+      nfi=nfi_p
+      iwr=6
+      ier=.FALSE.
+      ierr=1
+      iinf=1
+      isup=1501
+      igmax=20
+      pi=acos(-1.)
+      pi2=2*pi
+      accu2=1.E-03
+      accu3=1.E-07
+      call gauss(-1.,1.,anglem,weightm,mu2)
+      call gauss(0.,pi2,rp,gp,np)
+      mum1=mu-1
+      do 581 j=-mum1,-1
+       k=mu+j
+       rm(-j-mu)=anglem(k)
+       gb(-j-mu)=weightm(k)
+  581 continue
+      do 582 j=1,mum1
+       k=mum1+j
+       rm(mu-j)=anglem(k)
+       gb(mu-j)=weightm(k)
+  582 continue
+      gb(-mu)=0.
+      gb(0)=0.
+      gb(mu)=0.
+      sigma=0.056032
+      delta=0.0279
+      xacc=1.e-06
+      step=0.0025
+      do 1111 l=1,20
+       wldis(l)=wldisc(l)
+ 1111 continue
+
+c***********************************************************************
+c     geometrical conditions (igeom=0)
+c***********************************************************************
+      dsol=1.
+      call varsol(jday,month,dsol)
+
+      phi=abs(phiv-phi0)
+      phirad=(phi0-phiv)*pi/180.
+      if (phirad.lt.0.) phirad=phirad+2.*pi
+      if (phirad.gt.(2.*pi)) phirad=phirad-2.*pi
+      xmus=cos(asol*pi/180.)
+      xmuv=cos(avis*pi/180.)
+      xmup=cos(phirad)
+      xmud=-xmus*xmuv-sqrt(1.-xmus*xmus)*sqrt(1.-xmuv*xmuv)*xmup
+      if (xmud.gt.1.) xmud=1.
+      if (xmud.lt.-1.) xmud=-1.
+
+c***********************************************************************
+c     atmospheric model (idatm=8, user water vapor and ozone)
+c***********************************************************************
+      idatm=8
+      call us62
+
+c***********************************************************************
+c     aerosol model and concentration (v=0, taer55 given)
+c***********************************************************************
+      ipol=1
+      rmin=0.
+      rmax=0.
+      icp=1
+      do i=1,4
+       x1(i)=0.0
+       x2(i)=0.0
+       x3(i)=0.0
+       do l=1,20
+        rn(l,i)=0.0
+        ri(l,i)=0.0
+       enddo
+      enddo
+      do i=1,50
+       rsunph(i)=0.
+       nrsunph(i)=0.
+      enddo
+      cij(1)=1.00
+      iaer_prof=0
+      iaerp=0
+
+      if (iaer.lt.0.or.iaer.eq.4.or.iaer.gt.7) then
+        call print_error('sixsrun: unsupported aerosol model')
+        return
+      endif
+      nquad=nqdef_p
+      goto(49,40,41,42,49,49,49,49),iaer+1
+   40 c(1)=0.70
+      c(2)=0.29
+      c(3)=0.00
+      c(4)=0.01
+      go to 49
+   41 c(1)=0.00
+      c(2)=0.05
+      c(3)=0.95
+      c(4)=0.00
+      go to 49
+   42 c(1)=0.17
+      c(2)=0.61
+      c(3)=0.00
+      c(4)=0.22
+   49 continue
+
+      call aeroso(iaer,c,xmud,wldis,FILE2,ipol)
+      if(ier) return
+
+      if (iaer.eq.0) taer55=0.
+
+c***********************************************************************
+c     target altitude
+c***********************************************************************
+      if (xps.ge.0.) then
+        xps=0.
+        uwus=1.424
+        uo3us=0.344
+      else
+        call pressure(uwus,uo3us,xps)
+      endif
+
+c***********************************************************************
+c     sensor at satellite level (xpp=-1000)
+c***********************************************************************
+      palt=1000.
+      pps=0.
+      taer55p=taer55
+      ftray=1.
+      idatmp=4
+      puw=0.
+      puo3=0.
+      puwus=0.
+      puo3us=0.
+
+c***********************************************************************
+c     spectral conditions
+c***********************************************************************
+      do 38 l=iinf,isup
+       s(l)=1.
+   38 continue
+      if (iwave.lt.1.or.iwave.gt.118) then
+        call print_error('sixsrun: unsupported spectral condition')
+        return
+      endif
+      goto (110,
+     s      111,
+     s      112,112,
+     s      114,114,114,114,114,114,114,114,114,114,114,114,
+     s      118,118,118,118,118,118,118,118,
+     s      121,121,121,121,121,121,
+     s      127,127,127,127,
+     s      128,128,128,128,128,128,128,
+     s      129,129,129,129,129,129,129,129,
+     s      130,130,130,130,
+     s      131,131,131,131,131,131,131,131,
+     s      113,113,113,113,113,113,113,113,
+     s      150,150,150,150,
+     s      151,151,151,151,151,151,151,151,
+     s      151,151,151,151,151,151,151,
+     s      152,152,152,152,152,152,152,152,152,152,
+     s      152,152,152,152,152,152,152,152,152,152,
+     s      152,152,152,152,152,152,152,152,152,152
+     s     ),iwave
+  110 wlinf=wlinfu
+      wlsup=wlsupu
+      iinf=(wlinf-.25)/0.0025+1.5
+      isup=(wlsup-.25)/0.0025+1.5
+      if (nfilt.lt.(isup-iinf+1)) then
+        call print_error('sixsrun: filter function too short')
+        return
+      endif
+      do 1113 i=iinf,isup
+       s(i)=filt(i-iinf+1)
+ 1113 continue
+      goto 20
+  111 call meteo
+      go to 19
+  112 call goes(iwave-2)
+      go to 19
+  114 call avhrr(iwave-4)
+      go to 19
+  118 call hrv(iwave-16)
+      go to 19
+  121 call tm(iwave-24)
+      go to 19
+  127 call mss(iwave-30)
+      goto 19
+  128 call mas(iwave-34)
+      goto 19
+  129 call modis(iwave-41)
+      goto 19
+  130 call avhrr(iwave-37)
+      goto 19
+  131 call polder(iwave-53)
+      goto 19
+  113 call seawifs(iwave-61)
+      goto 19
+  150 call aatsr(iwave-69)
+      goto 19
+  151 call meris(iwave-73)
+      goto 19
+  152 call gli(iwave-88)
+   19 iinf=(wlinf-.25)/0.0025+1.5
+      isup=(wlsup-.25)/0.0025+1.5
+   20 continue
+
+c***********************************************************************
+c     atmospheric parameters at the equivalent wavelength
+c***********************************************************************
+      do i=1,mu
+      nfilut(i)=0
+      do j=1,41
+      rolut(i,j)=0.
+      rolutq(i,j)=0.
+      rolutu(i,j)=0.
+      filut(i,j)=0.
+      enddo
+      enddo
+
+      call equivwl(iinf,isup,step,
+     s             wlmoy)
+      call discom (idatmp,iaer,iaer_prof,xmus,xmuv,phi,taer55,taer55p,
+     a      palt,phirad,nt,mu,np,rm,gb,rp,ftray,ipol,xlm1,xlm2,
+     a      roatm_fi,nfi,
+     a      nfilut,filut,roluts,rolutsq,rolutsu)
+      if(ier) return
+      if(iaer.ne.0) then
+        call specinterp(wlmoy,taer55,taer55p,
+     s     tamoy,tamoyp,pizmoy,pizmoyp,ipol)
+      endif
+      call odrayl(wlmoy,
+     s                   trmoy)
+      trmoyp=trmoy*ftray
+      if (idatmp.eq.4) then
+          trmoyp=trmoy
+          tamoyp=tamoy
+      endif
+
+c***********************************************************************
+c     ground reflectance (homogeneous target)
+c***********************************************************************
+      fr=0.
+      rad=0.
+      do 1116 l=iinf,isup
+        rocl(l)=0.
+        roel(l)=0.
+ 1116 continue
+
+      if (idirec.eq.0) then
+        do 35 l=iinf,isup
+          rocl(l)=ro
+          roel(l)=ro
+   35   continue
+      else if (idirec.eq.1) then
+        rm(-mu)=-xmuv
+        rm(mu)=xmuv
+        rm(0)=-xmus
+        spalt=1000.
+        call os(iaer_prof,tamoy,trmoy,pizmoy,tamoyp,trmoyp,spalt,
+     s               phirad,nt,mu,np,rm,gb,rp,
+     s                     xlmus,xlphim,nfi,rolut)
+        rm(-mu)=-xmus
+        rm(mu)=xmus
+        rm(0)=-xmuv
+        call os(iaer_prof,tamoyp,trmoyp,pizmoy,tamoyp,trmoyp,spalt,
+     s               phirad,nt,mu,np,rm,gb,rp,
+     s                     xlmuv,xlphim,nfi,rolut)
+
+c       brdf from ocean condition (ibrdf=6)
+        if (xsal.lt.0.001)xsal=34.3
+        paw=phi0-phi_wind
+        do l=iinf,isup
+           srm(-1)=phirad
+           srm(1)=xmuv
+           srm(0)=xmus
+           wl=.25+(l-1)*step
+           call oceabrdf(pws,paw,xsal,pcl,wl,rfoam,rwat,rglit,
+     s         1,1,srm,srp,
+     s           sbrdftmp)
+           sbrdf(l)=sbrdftmp(1,1)
+        enddo
+        rm(-mu)=phirad
+        rm(mu)=xmuv
+        rm(0)=xmus
+        call oceabrdf(pws,paw,xsal,pcl,wlmoy,rfoam,rwat,rglit,
+     s  	mu,np,rm,rp,
+     s           brdfints)
+        rm(-mu)=2.*pi-phirad
+        rm(mu)=xmus
+        rm(0)=xmuv
+        call oceabrdf(pws,paw,xsal,pcl,wlmoy,rfoam,rwat,rglit,
+     s   	mu,np,rm,rp,
+     s           brdfintv)
+        call oceaalbe(pws,paw,xsal,pcl,wlmoy,
+     s       albbrdf)
+
+        robar1=0.
+        xnorm1=0.
+        do 83 j=1,np
+          rob=0.
+          xnor=0.
+          do 84 k=1,mu-1
+            rdown=xlmus(-k,j)
+            rdir=brdfintv(k,j)
+            rob=rob+rdown*rdir*rm(k)*gb(k)
+            xnor=xnor+rdown*rm(k)*gb(k)
+   84     continue
+          robar1=robar1+rob*gp(j)
+          xnorm1=xnorm1+xnor*gp(j)
+   83   continue
+        robar2=0.
+        xnorm2=0.
+        do 85 j=1,np
+          rob=0.
+          xnor=0.
+          do 86 k=1,mu-1
+            rdown=xlmuv(-k,j)
+            rdir=brdfints(k,j)
+            rob=rob+rdown*rdir*rm(k)*gb(k)
+            xnor=xnor+rdown*rm(k)*gb(k)
+   86     continue
+          robar2=robar2+rob*gp(j)
+          xnorm2=xnorm2+xnor*gp(j)
+   85   continue
+        do 335 l=iinf,isup
+          rocl(l)=sbrdf(l)
+          roel(l)=sbrdf(l)
+          robar(l)=robar1/xnorm1
+          robarp(l)=robar2/xnorm2
+          robard(l)=albbrdf
+  335   continue
+      else
+        call print_error('sixsrun: unsupported ground condition')
+        return
+      endif
+
+c***********************************************************************
+c     spectral integration (see loop 51 of main.f)
+c***********************************************************************
+      sb=0.
+      seb=0.
+      refet=0.
+      tgasm=0.
+      dgasm=0.
+      ugasm=0.
+      sdwava=0.
+      sdozon=0.
+      sddica=0.
+      sdoxyg=0.
+      sdniox=0.
+      sdmoca=0.
+      sdmeth=0.
+      suwava=0.
+      suozon=0.
+      sudica=0.
+      suoxyg=0.
+      suniox=0.
+      sumoca=0.
+      sumeth=0.
+      stwava=0.
+      stozon=0.
+      stdica=0.
+      stoxyg=0.
+      stniox=0.
+      stmoca=0.
+      stmeth=0.
+      sodray=0.
+      sodaer=0.
+      sodtot=0.
+      sroray=0.
+      sroaer=0.
+      srotot=0.
+      sdtotr=0.
+      sdtota=0.
+      sdtott=0.
+      sutotr=0.
+      sutota=0.
+      sutott=0.
+      sasr=0.
+      sasa=0.
+      sast=0.
+
+        do 51 l=iinf,isup
+        sbor=s(l)
+        if(l.eq.iinf.or.l.eq.isup) sbor=sbor*0.5
+        roc=rocl(l)
+        roe=roel(l)
+        wl=.25+(l-1)*step
+        call abstra(idatm,wl,xmus,xmuv,uw/2.,uo3,uwus,uo3us,
+     a             idatmp,puw/2.,puo3,puwus,puo3us,
+     a      dtwava,dtozon,dtdica,dtoxyg,dtniox,dtmeth,dtmoca,
+     a      utwava,utozon,utdica,utoxyg,utniox,utmeth,utmoca,
+     a      attwava,ttozon,ttdica,ttoxyg,ttniox,ttmeth,ttmoca )
+        call abstra(idatm,wl,xmus,xmuv,uw,uo3,uwus,uo3us,
+     a             idatmp,puw,puo3,puwus,puo3us,
+     a      dtwava,dtozon,dtdica,dtoxyg,dtniox,dtmeth,dtmoca,
+     a      utwava,utozon,utdica,utoxyg,utniox,utmeth,utmoca,
+     a      ttwava,ttozon,ttdica,ttoxyg,ttniox,ttmeth,ttmoca )
+        if (dtwava.lt.accu3) dtwava=0.
+        if (dtozon.lt.accu3) dtozon=0.
+        if (dtdica.lt.accu3) dtdica=0.
+        if (dtniox.lt.accu3) dtniox=0.
+        if (dtmeth.lt.accu3) dtmeth=0.
+        if (dtmoca.lt.accu3) dtmeth=0.
+        if (utwava.lt.accu3) utwava=0.
+        if (utozon.lt.accu3) utozon=0.
+        if (utdica.lt.accu3) utdica=0.
+        if (utniox.lt.accu3) utniox=0.
+        if (utmeth.lt.accu3) utmeth=0.
+        if (utmoca.lt.accu3) utmeth=0.
+        if (ttwava.lt.accu3) ttwava=0.
+        if (ttozon.lt.accu3) ttozon=0.
+        if (ttdica.lt.accu3) ttdica=0.
+        if (ttniox.lt.accu3) ttniox=0.
+        if (ttmeth.lt.accu3) ttmeth=0.
+        if (ttmoca.lt.accu3) ttmeth=0.
+        call solirr(wl,
+     s            swl)
+        swl=swl*dsol
+        coef=sbor*step*swl
+        call interp(iaer,idatmp,wl,taer55,taer55p,xmud,romix,
+     s   rorayl,roaero,phaa,phar,rqmix,rqrayl,rqaero,qhaa,qhar,
+     s   rumix,rurayl,ruaero,uhaa,uhar,
+     s   tsca,tray,trayp,taer,taerp,dtott,utott,astot,asray,asaer,
+     s   utotr,utota,dtotr,dtota,ipol,roatm_fi,romix_fi,rorayl_fi,nfi,
+     s   roluts,rolut,rolutsq,rolutq,rolutsu,rolutu,nfilut)
+
+        dgtot=dtwava*dtozon*dtdica*dtoxyg*dtniox*dtmeth*dtmoca
+        tgtot=ttwava*ttozon*ttdica*ttoxyg*ttniox*ttmeth*ttmoca
+        ugtot=utwava*utozon*utdica*utoxyg*utniox*utmeth*utmoca
+        tgp1=ttozon*ttdica*ttoxyg*ttniox*ttmeth*ttmoca
+        tgp2=attwava*ttozon*ttdica*ttoxyg*ttniox*ttmeth*ttmoca
+
+        sb=sb+sbor*step
+        seb=seb+coef
+
+          edifr=utotr-exp(-trayp/xmuv)
+          edifa=utota-exp(-taerp/xmuv)
+        if (idirec.eq.1) then
+          tdird=exp(-(trayp+taerp)/xmus)
+          tdiru=exp(-(trayp+taerp)/xmuv)
+          tdifd=dtott-tdird
+          tdifu=utott-tdiru
+	  rsurf=roc*tdird*tdiru+
+     s          robar(l)*tdifd*tdiru+robarp(l)*tdifu*tdird+
+     s          robard(l)*tdifd*tdifu+
+     s    (tdifd+tdird)*(tdifu+tdiru)*astot*robard(l)*robard(l)
+     s          /(1.-astot*robard(l))
+        else
+          call enviro(edifr,edifa,rad,palt,xmuv,fra,fae,fr)
+          avr=roc*fr+(1.-fr)*roe
+          rsurf=roc*dtott*exp(-(trayp+taerp)/xmuv)/(1.-avr*astot)
+     s       +avr*dtott*(utott-exp(-(trayp+taerp)/xmuv))/(1.-avr*astot)
+        endif
+        ratm2=(romix-rorayl)*tgp2+rorayl*tgp1
+        romeas2=ratm2+rsurf*tgtot
+        refet=refet+romeas2*coef
+
+        srotot=srotot+(romix)*coef
+        sroray=sroray+rorayl*coef
+        sroaer=sroaer+roaero*coef
+        sasr=sasr+asray*coef
+        sasa=sasa+asaer*coef
+        sast=sast+astot*coef
+        sodray=sodray+tray*coef
+        sodaer=sodaer+taer*coef
+        sodtot=sodtot+(taer+tray)*coef
+        tgasm=tgasm+tgtot*coef
+        dgasm=dgasm+dgtot*coef
+        ugasm=ugasm+ugtot*coef
+        sdwava=sdwava+dtwava*coef
+        sdozon=sdozon+dtozon*coef
+        sddica=sddica+dtdica*coef
+        sdoxyg=sdoxyg+dtoxyg*coef
+        sdniox=sdniox+dtniox*coef
+        sdmeth=sdmeth+dtmeth*coef
+        sdmoca=sdmoca+dtmoca*coef
+        suwava=suwava+utwava*coef
+        suozon=suozon+utozon*coef
+        sudica=sudica+utdica*coef
+        suoxyg=suoxyg+utoxyg*coef
+        suniox=suniox+utniox*coef
+        sumeth=sumeth+utmeth*coef
+        sumoca=sumoca+utmoca*coef
+        stwava=stwava+ttwava*coef
+        stozon=stozon+ttozon*coef
+        stdica=stdica+ttdica*coef
+        stoxyg=stoxyg+ttoxyg*coef
+        stniox=stniox+ttniox*coef
+        stmeth=stmeth+ttmeth*coef
+        stmoca=stmoca+ttmoca*coef
+        sdtotr=sdtotr+dtotr*coef
+        sdtota=sdtota+dtota*coef
+        sdtott=sdtott+dtott*coef
+        sutotr=sutotr+utotr*coef
+        sutota=sutota+utota*coef
+        sutott=sutott+utott*coef
+   51   continue
+
+c***********************************************************************
+c     integrated values
+c***********************************************************************
+      tgas(1,1)=dgasm/seb
+      tgas(2,1)=ugasm/seb
+      tgas(3,1)=tgasm/seb
+      tgas(1,2)=sdwava/seb
+      tgas(2,2)=suwava/seb
+      tgas(3,2)=stwava/seb
+      tgas(1,3)=sdozon/seb
+      tgas(2,3)=suozon/seb
+      tgas(3,3)=stozon/seb
+      tgas(1,4)=sddica/seb
+      tgas(2,4)=sudica/seb
+      tgas(3,4)=stdica/seb
+      tgas(1,5)=sdoxyg/seb
+      tgas(2,5)=suoxyg/seb
+      tgas(3,5)=stoxyg/seb
+      tgas(1,6)=sdniox/seb
+      tgas(2,6)=suniox/seb
+      tgas(3,6)=stniox/seb
+      tgas(1,7)=sdmeth/seb
+      tgas(2,7)=sumeth/seb
+      tgas(3,7)=stmeth/seb
+      tgas(1,8)=sdmoca/seb
+      tgas(2,8)=sumoca/seb
+      tgas(3,8)=stmoca/seb
+
+      sdtotr=sdtotr/seb
+      sdtota=sdtota/seb
+      sdtott=sdtott/seb
+      sutotr=sutotr/seb
+      sutota=sutota/seb
+      sutott=sutott/seb
+      tscat(1,1)=sdtotr
+      tscat(2,1)=sutotr
+      tscat(3,1)=sutotr*sdtotr
+      tscat(1,2)=sdtota
+      tscat(2,2)=sutota
+      tscat(3,2)=sutota*sdtota
+      tscat(1,3)=sdtott
+      tscat(2,3)=sutott
+      tscat(3,3)=sutott*sdtott
+
+      sphalb(1)=sasr/seb
+      sphalb(2)=sasa/seb
+      sphalb(3)=sast/seb
+      optdep(1)=sodray/seb
+      optdep(2)=sodaer/seb
+      optdep(3)=sodtot/seb
+      refl(1)=sroray/seb
+      refl(2)=sroaer/seb
+      refl(3)=srotot/seb
+      appref=refet/seb
+
+      if(ier) return
+      ierr=0
+      return
+      end
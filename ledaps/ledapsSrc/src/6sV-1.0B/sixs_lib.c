@@ -0,0 +1,58 @@
+/*
+!C****************************************************************************
+
+!File: sixs_lib.c
+
+!Description: C interface to the in-process 6S computation (SIXSRUN.f,
+ libsixs.a), in place of running the 6S executable on an input file.
+
+!Revision History:
+ Revision 1.0 2015/11/03
+ Original Version.
+
+!Design Notes:
+   1. 6S keeps its working state in Fortran COMMON blocks, so sixs_run is
+      not re-entrant: run at most one computation at a time per process.
+
+!END****************************************************************************
+*/
+
+#include <stddef.h>
+#include "sixs_lib.h"
+
+#define sixsrun sixsrun_
+
+void sixsrun(float *asol,float *phi0,float *avis,float *phiv,int *month,
+	int *jday,float *uw,float *uo3,int *iaer,float *taer55,float *xps,
+	int *iwave,float *wlinf,float *wlsup,int *nfilt,float *filt,
+	int *idirec,float *ro,float *pws,float *phi_wind,float *xsal,float *pcl,
+	float *tgas,float *tscat,float *sphalb,float *optdep,float *refl,
+	float *appref,int *ierr);
+
+/* Run 6S in-process for the conditions of in.  The Fortran code modifies
+   some of its arguments, so everything is passed through local copies.
+   Returns 0 on success, -1 if 6S reported an error. */
+int sixs_run(sixs_input_t *in, sixs_output_t *out) {
+	float asol=in->sza,phi0=in->saz,avis=in->vza,phiv=in->vaz;
+	int month=in->month,jday=in->day;
+	float uw=in->uwv,uo3=in->uoz;
+	int iaer=(int)in->aer_model;
+	float taer55=in->aot550,xps=in->target_alt;
+	int iwave=in->iwave;
+	float wlinf=in->wlinf,wlsup=in->wlsup;
+	int nfilt=in->nfilter;
+	float dummy_filt=0.;
+	float *filt=(in->filter != NULL) ? in->filter : &dummy_filt;
+	int idirec=(int)in->ground;
+	float ro=in->rho;
+	float pws=in->wind_speed,phi_wind=in->wind_azimuth;
+	float xsal=in->salinity,pcl=in->pigment;
+	int ierr;
+
+	sixsrun(&asol,&phi0,&avis,&phiv,&month,&jday,&uw,&uo3,&iaer,&taer55,
+		&xps,&iwave,&wlinf,&wlsup,&nfilt,filt,&idirec,&ro,&pws,&phi_wind,
+		&xsal,&pcl,&out->T_g[0][0],&out->T_sca[0][0],out->S,out->tau,
+		out->rho,&out->rho_toa,&ierr);
+
+	return (ierr == 0) ? 0 : -1;
+}
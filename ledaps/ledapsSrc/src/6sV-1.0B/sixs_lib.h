@@ -0,0 +1,80 @@
+#ifndef SIXS_LIB_H
+#define SIXS_LIB_H
+
+/* C interface to the in-process 6S computation (SIXSRUN.f, libsixs.a).
+   6S keeps its working state in Fortran COMMON blocks, so sixs_run is
+   not re-entrant: run at most one computation at a time per process. */
+
+#define SIXS_FILTER_USER 1		/* iwave of a user defined filter function */
+#define SIXS_FILTER_STEP 0.0025	/* filter function step (microns) */
+#define SIXS_NB_COMP 3			/* number of components/directions */
+
+typedef enum {
+  SIXS_AER_NONE = 0,
+  SIXS_AER_CONTINENTAL = 1,
+  SIXS_AER_MARITIME = 2,
+  SIXS_AER_URBAN = 3,
+  SIXS_AER_DESERT = 5,
+  SIXS_AER_BIOMASS = 6,
+  SIXS_AER_STRATOSPHERIC = 7
+} Sixs_Aerosol_t;
+
+typedef enum {
+  SIXS_GROUND_LAMBERTIAN = 0,	/* homogeneous lambertian ground */
+  SIXS_GROUND_OCEAN = 1			/* homogeneous ground with ocean BRDF */
+} Sixs_Ground_t;
+
+typedef enum {
+  SIXS_GAS_GLOBAL = 0,
+  SIXS_GAS_WATER,
+  SIXS_GAS_OZONE,
+  SIXS_GAS_CO2,
+  SIXS_GAS_OXYG,
+  SIXS_GAS_NO2,
+  SIXS_GAS_CH4,
+  SIXS_GAS_CO,
+  SIXS_NB_GAS
+} Sixs_Gas_t;
+
+/* index of the first dimension of the transmittances */
+typedef enum {
+  SIXS_DOWNWARD = 0,
+  SIXS_UPWARD,
+  SIXS_TOTAL
+} Sixs_Direction_t;
+
+/* index of the rayleigh/aerosol/total values */
+typedef enum {
+  SIXS_RAYLEIGH = 0,
+  SIXS_AEROSOLS,
+  SIXS_RAY_AER
+} Sixs_Component_t;
+
+typedef struct {
+	float sza,saz,vza,vaz;		/* geometrical conditions (degrees) */
+	int month,day;
+	float uwv,uoz;				/* water vapor (g/cm2) and ozone (cm-atm) */
+	Sixs_Aerosol_t aer_model;
+	float aot550;				/* aerosol optical thickness at 550 nm */
+	float target_alt;			/* target level, as entered in 6S */
+	int iwave;					/* predefined 6S band or SIXS_FILTER_USER */
+	float wlinf,wlsup;			/* user filter function limits (microns) */
+	int nfilter;				/* number of user filter function values */
+	float *filter;				/* user filter values from wlinf by SIXS_FILTER_STEP */
+	Sixs_Ground_t ground;
+	float rho;					/* lambertian ground reflectance */
+	float wind_speed,wind_azimuth,salinity,pigment;	/* ocean BRDF */
+} sixs_input_t;
+
+typedef struct {
+	float T_g[SIXS_NB_GAS][SIXS_NB_COMP];	/* gaseous transmittance [gas][dir] */
+	float T_sca[SIXS_NB_COMP][SIXS_NB_COMP];	/* scattering transmittance [comp][dir] */
+	float S[SIXS_NB_COMP];		/* spherical albedo */
+	float tau[SIXS_NB_COMP];	/* optical depth total */
+	float rho[SIXS_NB_COMP];	/* reflectance I */
+	float rho_toa;				/* apparent reflectance */
+} sixs_output_t;
+
+int sixs_run(sixs_input_t *in, sixs_output_t *out);
+
+#endif
@@ -0,0 +1,51 @@
+/*
+!C****************************************************************************
+
+!File: cal_names.h
+
+!Description: Renames the global symbols of lndcal that lndsr also defines,
+ so that both can be linked into the fused ledaps driver.  Forced into each
+ lndcal source file (-include) by the ledaps Makefile; not used by the
+ lndcal build itself.
+
+!Revision History:
+ Revision 1.0 2015/11/16
+ Original Version.
+
+!END****************************************************************************
+*/
+
+#ifndef CAL_NAMES_H
+#define CAL_NAMES_H
+
+#define main lndcal_main
+
+#define CloseInput CalCloseInput
+#define CloseOutput CalCloseOutput
+#define DateCopy CalDateCopy
+#define DateDiff CalDateDiff
+#define DateInit CalDateInit
+#define DupString CalDupString
+#define Error CalError
+#define FormatDate CalFormatDate
+#define FreeInput CalFreeInput
+#define FreeLut CalFreeLut
+#define FreeOutput CalFreeOutput
+#define FreeParam CalFreeParam
+#define GetInputLine CalGetInputLine
+#define GetLine CalGetLine
+#define GetLut CalGetLut
+#define GetParam CalGetParam
+#define GetXMLInput CalGetXMLInput
+#define InputMetaCopy CalInputMetaCopy
+#define Inst_string CalInst_string
+#define KeyString CalKeyString
+#define OpenInput CalOpenInput
+#define OpenOutput CalOpenOutput
+#define Param_string CalParam_string
+#define PutOutputLine CalPutOutputLine
+#define Sat_string CalSat_string
+#define StringParse CalStringParse
+#define Wrs_string CalWrs_string
+
+#endif
@@ -0,0 +1,252 @@
+/*
+!C****************************************************************************
+
+!File: ledaps.c
+
+!Description: Fused LEDAPS driver.  Runs lndpm, lndcal, lndsr and lndsrbm on
+ a Landsat XML file like do_ledaps.py, but with lndcal and lndsr in this
+ process: the TOA bands written by lndcal are handed to lndsr in memory, so
+ lndsr never reads them back from disk, and writing the TOA reflectance
+ bands is optional.
+
+ Usage: ledaps [-notoa] <xml_file>
+
+   -notoa   do not write the TOA reflectance and QA bands; the TOA brightness
+            temperature bands, needed by lndsrbm, are removed at the end.
+            None of the TOA bands are kept in the XML file.
+
+!Revision History:
+ Revision 1.0 2015/11/16
+ Original Version.
+
+!Design Notes:
+   1. lndcal and lndsr are linked in as lndcal_main and lndsr_main; the
+      lndcal symbols that clash with lndsr are renamed by cal_names.h.
+   2. lndcal hands each output band over through 'output_mem_put' when it
+      closes it, and lndsr takes the bands through 'input_mem_get' when it
+      opens its input; both look the bands up by file name.
+   3. lndpm and lndsrbm (a script) are run as separate processes.
+
+!END****************************************************************************
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "bool.h"
+#include "error.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+
+#define NBAND_MEM_MAX (16)    /* bands handed over in memory */
+
+/* Stage entry points and in-memory hooks (lndcal/output.c, lndsr/input.c) */
+int lndcal_main(int argc, const char **argv);
+int lndsr_main(int argc, const char **argv);
+extern bool (*output_mem_put)(char *file_name, void *buf, size_t size);
+extern bool output_mem_write_refl;
+extern void *(*input_mem_get)(char *file_name, size_t size);
+
+/* Bands handed over in memory, by file name */
+typedef struct {
+  char *file_name;
+  void *buf;
+  size_t size;
+} Band_mem_t;
+
+static Band_mem_t band_mem[NBAND_MEM_MAX];
+static int nband_mem = 0;
+
+/* Keep a band handed over by lndcal; takes the buffer */
+static bool BandMemPut(char *file_name, void *buf, size_t size)
+{
+  if (nband_mem >= NBAND_MEM_MAX) {
+    free(buf);
+    RETURN_ERROR("too many bands in memory", "BandMemPut", false);
+  }
+  band_mem[nband_mem].file_name = strdup(file_name);
+  if (band_mem[nband_mem].file_name == NULL) {
+    free(buf);
+    RETURN_ERROR("allocating band file name", "BandMemPut", false);
+  }
+  band_mem[nband_mem].buf = buf;
+  band_mem[nband_mem].size = size;
+  nband_mem++;
+
+  return true;
+}
+
+/* Band of the given file name and size for lndsr; NULL if not in memory */
+static void *BandMemGet(char *file_name, size_t size)
+{
+  int i;
+
+  for (i = 0; i < nband_mem; i++)
+    if (!strcmp(band_mem[i].file_name, file_name) && band_mem[i].size == size)
+      return band_mem[i].buf;
+
+  return NULL;
+}
+
+static void BandMemFree(void)
+{
+  int i;
+
+  for (i = 0; i < nband_mem; i++) {
+    free(band_mem[i].file_name);
+    free(band_mem[i].buf);
+  }
+  nband_mem = 0;
+}
+
+/* Remove the TOA bands from the XML file and delete their files, if any */
+static bool RemoveToaBands(char *xml_file)
+{
+  Espa_internal_meta_t xml_metadata;
+  Espa_band_meta_t tmp;
+  char hdr_file[STR_SIZE];
+  char *cptr = NULL;
+  int ib, nkeep;
+
+  init_metadata_struct(&xml_metadata);
+  if (parse_metadata(xml_file, &xml_metadata) != SUCCESS)
+    RETURN_ERROR("parsing XML file", "RemoveToaBands", false);
+
+  /* Move the TOA bands to the end, so that the metadata written only has
+     the other bands and all of them are still freed */
+  nkeep = 0;
+  for (ib = 0; ib < xml_metadata.nbands; ib++) {
+    if (!strcmp(xml_metadata.band[ib].product, "toa_refl") ||
+        !strcmp(xml_metadata.band[ib].product, "toa_bt")) {
+      unlink(xml_metadata.band[ib].file_name);
+      strcpy(hdr_file, xml_metadata.band[ib].file_name);
+      cptr = strrchr(hdr_file, '.');
+      if (cptr != NULL) {
+        strcpy(cptr, ".hdr");
+        unlink(hdr_file);
+      }
+      continue;
+    }
+    if (ib != nkeep) {
+      tmp = xml_metadata.band[nkeep];
+      xml_metadata.band[nkeep] = xml_metadata.band[ib];
+      xml_metadata.band[ib] = tmp;
+    }
+    nkeep++;
+  }
+
+  ib = xml_metadata.nbands;
+  xml_metadata.nbands = nkeep;
+  if (write_metadata(&xml_metadata, xml_file) != SUCCESS) {
+    xml_metadata.nbands = ib;
+    free_metadata(&xml_metadata);
+    RETURN_ERROR("writing XML file", "RemoveToaBands", false);
+  }
+  xml_metadata.nbands = ib;
+  free_metadata(&xml_metadata);
+
+  return true;
+}
+
+int main (int argc, const char **argv) {
+  bool write_toa = true;
+  char xml_file[STR_SIZE];   /* XML file name, without directory */
+  char scene[STR_SIZE];      /* XML file name without the .xml extension */
+  char exe_dir[STR_SIZE];    /* directory of the LEDAPS executables */
+  char cal_param[STR_SIZE+16];  /* lndcal parameter file */
+  char sr_param[STR_SIZE+16];   /* lndsr parameter file */
+  char cmd[3*STR_SIZE];
+  const char *stage_argv[3];
+  const char *cptr = NULL;
+  char *dir = NULL;
+  int i;
+
+  printf ("\nRunning ledaps ...\n");
+  for (i = 1; i < argc - 1; i++) {
+    if (!strcmp(argv[i], "-notoa"))
+      write_toa = false;
+    else
+      break;
+  }
+  if (i != argc - 1) {
+    fprintf(stderr, "usage: %s [-notoa] <xml_file>\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  /* The executables run as separate processes are next to this one, or in
+     the PATH */
+  exe_dir[0] = '\0';
+  cptr = strrchr(argv[0], '/');
+  if (cptr != NULL) {
+    if (cptr - argv[0] + 2 > STR_SIZE)
+      EXIT_ERROR("executable path too long", "main");
+    strncpy(exe_dir, argv[0], cptr - argv[0] + 1);
+    exe_dir[cptr - argv[0] + 1] = '\0';
+    if (exe_dir[0] != '/') {
+      /* relative to the current directory, which is changed below */
+      if (getcwd(cmd, sizeof(cmd)) == NULL ||
+          strlen(cmd) + strlen(exe_dir) + 2 > STR_SIZE)
+        EXIT_ERROR("getting the executable directory", "main");
+      strcat(cmd, "/");
+      strcat(cmd, exe_dir);
+      strcpy(exe_dir, cmd);
+    }
+  }
+
+  /* Run in the directory of the XML file, like do_ledaps.py */
+  if (strlen(argv[i]) >= STR_SIZE)
+    EXIT_ERROR("XML file name too long", "main");
+  cptr = strrchr(argv[i], '/');
+  strcpy(xml_file, cptr != NULL ? cptr + 1 : argv[i]);
+  if (cptr != NULL) {
+    dir = strdup(argv[i]);
+    if (dir == NULL)
+      EXIT_ERROR("allocating XML directory name", "main");
+    dir[cptr - argv[i]] = '\0';
+    if (chdir(dir[0] != '\0' ? dir : "/") != 0)
+      EXIT_ERROR("changing to the XML file directory", "main");
+    free(dir);
+  }
+  strcpy(scene, xml_file);
+  if (strlen(scene) > 4 && !strcmp(&scene[strlen(scene) - 4], ".xml"))
+    scene[strlen(scene) - 4] = '\0';
+  sprintf(cal_param, "lndcal.%s.txt", scene);
+  sprintf(sr_param, "lndsr.%s.txt", scene);
+
+  /* Create the parameter files */
+  sprintf(cmd, "%slndpm %s", exe_dir, xml_file);
+  if (system(cmd) != 0)
+    EXIT_ERROR("running lndpm", "main");
+
+  /* Calibrate, keeping the TOA bands in memory */
+  output_mem_put = BandMemPut;
+  output_mem_write_refl = write_toa;
+  stage_argv[0] = "lndcal";
+  stage_argv[1] = cal_param;
+  stage_argv[2] = NULL;
+  if (lndcal_main(2, stage_argv) != EXIT_SUCCESS)
+    EXIT_ERROR("running lndcal", "main");
+  output_mem_put = NULL;
+
+  /* Surface reflectance from the in-memory TOA bands */
+  input_mem_get = BandMemGet;
+  stage_argv[0] = "lndsr";
+  stage_argv[1] = sr_param;
+  if (lndsr_main(2, stage_argv) != EXIT_SUCCESS)
+    EXIT_ERROR("running lndsr", "main");
+  input_mem_get = NULL;
+  BandMemFree();
+
+  /* Update the cloud mask */
+  sprintf(cmd, "%slndsrbm.ksh %s", exe_dir, sr_param);
+  if (system(cmd) != 0)
+    EXIT_ERROR("running lndsrbm", "main");
+
+  if (!write_toa && !RemoveToaBands(xml_file))
+    EXIT_ERROR("removing the TOA bands", "main");
+
+  printf ("ledaps complete.\n");
+  return (EXIT_SUCCESS);
+}
@@ -22,6 +22,10 @@
  * revision 2.0.0 1/30/2014  Gail Schmidt, USGS
  * - modified the brightness temp values to be written in Kelvin vs. degrees
  *   Celsius
+ * revision 2.1.0 11/12/2015
+ * - the output value of each of the 256 input DNs is computed once per band
+ *   (CalDnLut, Cal6DnLut) and Cal/Cal6 only look it up; the statistics are
+ *   computed from a DN histogram at the end (CalStats, Cal6Stats)
  *
  * NOTES:
  * 1. TOA radiance and reflectance equations for Landsat 7 are available in
@@ -32,10 +36,8 @@
  *    still need to account for the solar angle.
  */
 
-bool Cal(Lut_t *lut, int iband, Input_t *input, unsigned char *line_in, 
-         int16 *line_out, unsigned char *line_out_qa, Cal_stats_t *cal_stats,
-         int iy) {
-  int is,val;
+bool CalDnLut(Lut_t *lut, int iband, Input_t *input, Cal_dn_lut_t *dn_lut) {
+  int val;
   float rad_gain, rad_bias;           /* TOA radiance gain/bias */
   float refl_gain = 0.0,
         refl_bias = 0.0;              /* TOA reflectance gain/bias */
@@ -43,8 +45,6 @@ bool Cal(Lut_t *lut, int iband, Input_t *input, unsigned char *line_in,
   float ref_conv = 0.0;               /* TOA reflectance conversion value */
   float ref;                          /* TOA reflectance value */
   float fval;                         /* temporary float value */
-  int nsamp= input->size.s;
-  int ifill= (int)lut->in_fill;
 
   /* Get the TOA radiance gain/bias */
   rad_gain = lut->meta.rad_gain[iband];
@@ -56,40 +56,30 @@ bool Cal(Lut_t *lut, int iband, Input_t *input, unsigned char *line_in,
     refl_gain = lut->meta.refl_gain[iband];
     refl_bias = lut->meta.refl_bias[iband];
 
-    if ( iy==0 ) {
-      printf("*** band=%1d refl gain=%f refl bias=%f cos_sun_zen=%f\n", iband+1,
-             refl_gain, refl_bias, lut->cos_sun_zen);
-      fflush(stdout);
-    }
+    printf("*** band=%1d refl gain=%f refl bias=%f cos_sun_zen=%f\n", iband+1,
+           refl_gain, refl_bias, lut->cos_sun_zen);
+    fflush(stdout);
   }
   else {
     ref_conv = (PI * lut->dsun2) / (lut->esun[iband] * lut->cos_sun_zen);
   
-    if ( iy==0 ) {
-      printf("*** band=%1d rad gain=%f rad bias=%f dsun2=%f\n"
-             "    ref_conv=%f=(PI*%f)/(%f*%f) ***\n", iband+1,
-             rad_gain, rad_bias, lut->dsun2, ref_conv, lut->dsun2,
-             lut->esun[iband], lut->cos_sun_zen);
-      fflush(stdout);
-    }
+    printf("*** band=%1d rad gain=%f rad bias=%f dsun2=%f\n"
+           "    ref_conv=%f=(PI*%f)/(%f*%f) ***\n", iband+1,
+           rad_gain, rad_bias, lut->dsun2, ref_conv, lut->dsun2,
+           lut->esun[iband], lut->cos_sun_zen);
+    fflush(stdout);
   }
 
-  /* Loop through the samples in the line */
-  for (is = 0; is < nsamp; is++) {
-    val= getValue((unsigned char *)line_in, is);
-    if (val == ifill || line_out_qa[is]==lut->qa_fill ) {
-      line_out[is] = lut->out_fill;
-      cal_stats->nfill[iband]++;
-      continue;
-    }
-
+  /* Loop through the DN values */
+  for (val = 0; val < CAL_NDN; val++) {
     /* flag saturated pixels, added by Feng (3/23/09) */
     if (val == SATU_VAL[iband]) {
-      line_out[is] = lut->out_satu;
+      dn_lut->out[val] = lut->out_satu;
+      dn_lut->valid[val] = false;
+      dn_lut->rad[val] = dn_lut->val[val] = 0.0;
       continue;
     }
 
-    cal_stats->nvalid[iband]++;
     fval= (float)val;
 
     /* If the TOA reflectance gain/bias values are available, then use them.
@@ -105,141 +95,198 @@ bool Cal(Lut_t *lut, int iband, Input_t *input, unsigned char *line_in,
 
     /* Apply a scaling of 10000 (tied to the lut->scale_factor). Valid ranges
        are set up in lut.c as well. */
-    line_out[is] = (int16)(ref * 10000.0 + 0.5);
+    dn_lut->out[val] = (int16)(ref * 10000.0 + 0.5);
 
     /* Cap the output using the min/max values.  Then reset the toa reflectance
        value so that it's correctly reported in the stats and the min/max
        range matches that of the image data. */
-    if (line_out[is] < lut->valid_range_ref[0]) {
-      line_out[is] = lut->valid_range_ref[0];
-      ref = line_out[is] * 0.0001;
+    if (dn_lut->out[val] < lut->valid_range_ref[0]) {
+      dn_lut->out[val] = lut->valid_range_ref[0];
+      ref = dn_lut->out[val] * 0.0001;
     }
-    else if (line_out[is] > lut->valid_range_ref[1]) {
-      line_out[is] = lut->valid_range_ref[1];
-      ref = line_out[is] * 0.0001;
+    else if (dn_lut->out[val] > lut->valid_range_ref[1]) {
+      dn_lut->out[val] = lut->valid_range_ref[1];
+      ref = dn_lut->out[val] * 0.0001;
     }
 
-    if (cal_stats->first[iband]) {
-      cal_stats->idn_min[iband] = val;
-      cal_stats->idn_max[iband] = val;
-
-      cal_stats->rad_min[iband] = rad;
-      cal_stats->rad_max[iband] = rad;
-
-      cal_stats->ref_min[iband] = ref;
-      cal_stats->ref_max[iband] = ref;
-
-      cal_stats->iref_min[iband] = line_out[is];
-      cal_stats->iref_max[iband] = line_out[is];
-
-      cal_stats->first[iband] = false;
-    } else {
-      if (val < cal_stats->idn_min[iband]) 
-        cal_stats->idn_min[iband] = val;
-      if (val > cal_stats->idn_max[iband]) 
-        cal_stats->idn_max[iband] = val;
-
-      if (rad < cal_stats->rad_min[iband]) cal_stats->rad_min[iband] = rad;
-      if (rad > cal_stats->rad_max[iband]) cal_stats->rad_max[iband] = rad;
-
-      if (ref < cal_stats->ref_min[iband]) cal_stats->ref_min[iband] = ref;
-      if (ref > cal_stats->ref_max[iband]) cal_stats->ref_max[iband] = ref;
-
-      if (line_out[is] < cal_stats->iref_min[iband]) 
-        cal_stats->iref_min[iband] = line_out[is];
-      if (line_out[is] > cal_stats->iref_max[iband]) 
-        cal_stats->iref_max[iband] = line_out[is];
-    }
-  }  /* end for is */
+    dn_lut->valid[val] = true;
+    dn_lut->rad[val] = rad;
+    dn_lut->val[val] = ref;
+  }  /* end for val */
 
   return true;
 }
 
-bool Cal6(Lut_t *lut, Input_t *input, unsigned char *line_in, int16 *line_out, 
-         unsigned char *line_out_qa, Cal_stats6_t *cal_stats, int iy) {
-  int is, val;
+bool Cal6DnLut(Lut_t *lut, Cal_dn_lut_t *dn_lut) {
+  int val;
   float rad_gain, rad_bias, rad, temp;
-  int nsamp= input->size_th.s;
-  int ifill= (int)lut->in_fill;
 
   rad_gain = lut->meta.rad_gain_th;
   rad_bias = lut->meta.rad_bias_th;
   
-  if ( iy==0 ) {
-    printf("*** band=%1d gain=%f bias=%f ***\n", 6, rad_gain, rad_bias);
-  }
-
-  for (is = 0; is < nsamp; is++) {
-    val= getValue((unsigned char *)line_in, is);
-    if (val == ifill || line_out_qa[is]==lut->qa_fill ) {
-      line_out[is] = lut->out_fill;
-      cal_stats->nfill++;
-      continue;
-    }
+  printf("*** band=%1d gain=%f bias=%f ***\n", 6, rad_gain, rad_bias);
 
+  for (val = 0; val < CAL_NDN; val++) {
     /* for saturated pixels */
     if (val >= SATU_VAL6) {
-      line_out[is] = lut->out_satu;
+      dn_lut->out[val] = lut->out_satu;
+      dn_lut->valid[val] = false;
+      dn_lut->rad[val] = dn_lut->val[val] = 0.0;
       continue;
     }
 
-    cal_stats->nvalid++;
- 
     /* compute the brightness temperature in Kelvin and apply scaling of
        10.0 (tied to lut->scale_factor_th). valid ranges are set up in lut.c
        as well. */
     rad = (rad_gain * (float)val) + rad_bias;
     temp = lut->K2 / log(1.0 + (lut->K1/rad));
-    line_out[is] = (int16)(temp * 10.0 + 0.5);
+    dn_lut->out[val] = (int16)(temp * 10.0 + 0.5);
 
     /* Cap the output using the min/max values.  Then reset the temperature
        value so that it's correctly reported in the stats and the min/max
        range matches that of the image data. */
-    if (line_out[is] < lut->valid_range_th[0]) {
-      line_out[is] = lut->valid_range_th[0];
-      temp = line_out[is] * 0.1;
+    if (dn_lut->out[val] < lut->valid_range_th[0]) {
+      dn_lut->out[val] = lut->valid_range_th[0];
+      temp = dn_lut->out[val] * 0.1;
     }
-    else if (line_out[is] > lut->valid_range_th[1]) {
-      line_out[is] = lut->valid_range_th[1];
-      temp = line_out[is] * 0.1;
+    else if (dn_lut->out[val] > lut->valid_range_th[1]) {
+      dn_lut->out[val] = lut->valid_range_th[1];
+      temp = dn_lut->out[val] * 0.1;
     }
 
-    if (cal_stats->first) {
-      cal_stats->idn_min = val;
-      cal_stats->idn_max = val;
+    dn_lut->valid[val] = true;
+    dn_lut->rad[val] = rad;
+    dn_lut->val[val] = temp;
+  }  /* end for val */
 
-      cal_stats->rad_min = rad;
-      cal_stats->rad_max = rad;
+  return true;
+}
 
-      cal_stats->temp_min = temp;
-      cal_stats->temp_max = temp;
+bool Cal(Lut_t *lut, int iband, Input_t *input, Cal_dn_lut_t *dn_lut,
+         unsigned char *line_in, int16 *line_out, unsigned char *line_out_qa,
+         Cal_stats_t *cal_stats) {
+  int is,val;
+  int nsamp= input->size.s;
+  int ifill= (int)lut->in_fill;
+  long *dn_hist = cal_stats->dn_hist[iband];
 
-      cal_stats->itemp_min = line_out[is];
-      cal_stats->itemp_max = line_out[is];
+  /* Loop through the samples in the line */
+  for (is = 0; is < nsamp; is++) {
+    val= getValue((unsigned char *)line_in, is);
+    if (val == ifill || line_out_qa[is]==lut->qa_fill ) {
+      line_out[is] = lut->out_fill;
+      cal_stats->nfill[iband]++;
+      continue;
+    }
 
-      cal_stats->first = false;
-    } else {
-      if (val < (int)cal_stats->idn_min) 
-        cal_stats->idn_min = val;
-      if (val > cal_stats->idn_max) 
-        cal_stats->idn_max = val;
+    line_out[is] = dn_lut->out[val];
+    dn_hist[val]++;
+  }  /* end for is */
 
-      if (rad < cal_stats->rad_min) cal_stats->rad_min = rad;
-      if (rad > cal_stats->rad_max) cal_stats->rad_max = rad;
+  return true;
+}
 
-      if (temp < cal_stats->temp_min) cal_stats->temp_min = temp;
-      if (temp > cal_stats->temp_max) cal_stats->temp_max = temp;
+bool Cal6(Lut_t *lut, Input_t *input, Cal_dn_lut_t *dn_lut,
+          unsigned char *line_in, int16 *line_out, unsigned char *line_out_qa,
+          Cal_stats6_t *cal_stats) {
+  int is, val;
+  int nsamp= input->size_th.s;
+  int ifill= (int)lut->in_fill;
 
-      if (line_out[is] < cal_stats->itemp_min) 
-        cal_stats->itemp_min = line_out[is];
-      if (line_out[is] > cal_stats->itemp_max) 
-        cal_stats->itemp_max = line_out[is];
+  for (is = 0; is < nsamp; is++) {
+    val= getValue((unsigned char *)line_in, is);
+    if (val == ifill || line_out_qa[is]==lut->qa_fill ) {
+      line_out[is] = lut->out_fill;
+      cal_stats->nfill++;
+      continue;
     }
+
+    line_out[is] = dn_lut->out[val];
+    cal_stats->dn_hist[val]++;
   }  /* end for is */
 
   return true;
 }
 
+/* Compute the number of valid pixels and the min/max statistics of a band
+   from its DN histogram */
+void CalStats(int iband, Cal_dn_lut_t *dn_lut, Cal_stats_t *cal_stats) {
+  int val;
+
+  cal_stats->nvalid[iband] = 0;
+  for (val = 0; val < CAL_NDN; val++) {
+    if (cal_stats->dn_hist[iband][val] == 0 || !dn_lut->valid[val])
+      continue;
+
+    cal_stats->nvalid[iband] += cal_stats->dn_hist[iband][val];
+    if (cal_stats->first[iband]) {
+      cal_stats->idn_min[iband] = val;
+      cal_stats->rad_min[iband] = dn_lut->rad[val];
+      cal_stats->rad_max[iband] = dn_lut->rad[val];
+      cal_stats->ref_min[iband] = dn_lut->val[val];
+      cal_stats->ref_max[iband] = dn_lut->val[val];
+      cal_stats->iref_min[iband] = dn_lut->out[val];
+      cal_stats->iref_max[iband] = dn_lut->out[val];
+      cal_stats->first[iband] = false;
+    } else {
+      if (dn_lut->rad[val] < cal_stats->rad_min[iband])
+        cal_stats->rad_min[iband] = dn_lut->rad[val];
+      if (dn_lut->rad[val] > cal_stats->rad_max[iband])
+        cal_stats->rad_max[iband] = dn_lut->rad[val];
+
+      if (dn_lut->val[val] < cal_stats->ref_min[iband])
+        cal_stats->ref_min[iband] = dn_lut->val[val];
+      if (dn_lut->val[val] > cal_stats->ref_max[iband])
+        cal_stats->ref_max[iband] = dn_lut->val[val];
+
+      if (dn_lut->out[val] < cal_stats->iref_min[iband]) 
+        cal_stats->iref_min[iband] = dn_lut->out[val];
+      if (dn_lut->out[val] > cal_stats->iref_max[iband]) 
+        cal_stats->iref_max[iband] = dn_lut->out[val];
+    }
+    cal_stats->idn_max[iband] = val;
+  }  /* end for val */
+}
+
+/* Same as CalStats for the thermal band */
+void Cal6Stats(Cal_dn_lut_t *dn_lut, Cal_stats6_t *cal_stats) {
+  int val;
+
+  cal_stats->nvalid = 0;
+  for (val = 0; val < CAL_NDN; val++) {
+    if (cal_stats->dn_hist[val] == 0 || !dn_lut->valid[val])
+      continue;
+
+    cal_stats->nvalid += cal_stats->dn_hist[val];
+    if (cal_stats->first) {
+      cal_stats->idn_min = val;
+      cal_stats->rad_min = dn_lut->rad[val];
+      cal_stats->rad_max = dn_lut->rad[val];
+      cal_stats->temp_min = dn_lut->val[val];
+      cal_stats->temp_max = dn_lut->val[val];
+      cal_stats->itemp_min = dn_lut->out[val];
+      cal_stats->itemp_max = dn_lut->out[val];
+      cal_stats->first = false;
+    } else {
+      if (dn_lut->rad[val] < cal_stats->rad_min)
+        cal_stats->rad_min = dn_lut->rad[val];
+      if (dn_lut->rad[val] > cal_stats->rad_max)
+        cal_stats->rad_max = dn_lut->rad[val];
+
+      if (dn_lut->val[val] < cal_stats->temp_min)
+        cal_stats->temp_min = dn_lut->val[val];
+      if (dn_lut->val[val] > cal_stats->temp_max)
+        cal_stats->temp_max = dn_lut->val[val];
+
+      if (dn_lut->out[val] < cal_stats->itemp_min) 
+        cal_stats->itemp_min = dn_lut->out[val];
+      if (dn_lut->out[val] > cal_stats->itemp_max) 
+        cal_stats->itemp_max = dn_lut->out[val];
+    }
+    cal_stats->idn_max = val;
+  }  /* end for val */
+}
+
 /*************************************************************************
  *** this program returns the correct value (as an int)                ***
  *************************************************************************/
@@ -8,6 +8,17 @@
 static const int SATU_VAL[7]={255,255,255,255,255,255,255};
 static const int SATU_VAL6= 254;
 
+#define CAL_NDN (256)  /* number of input DN values (8-bit input) */
+
+/* DN to output lookup table of a band */
+typedef struct {
+  int16 out[CAL_NDN];   /* output value (saturated DNs are out_satu) */
+  bool valid[CAL_NDN];  /* the DN is calibrated, i.e. is not saturated */
+  float rad[CAL_NDN];   /* TOA radiance */
+  float val[CAL_NDN];   /* TOA reflectance or brightness temperature, capped
+                           to the valid range */
+} Cal_dn_lut_t;
+
 typedef struct {
   bool first[NBAND_REFL_MAX];
   unsigned char idn_min[NBAND_REFL_MAX];
@@ -20,6 +31,8 @@ typedef struct {
   int iref_max[NBAND_REFL_MAX];
   long nfill[NBAND_REFL_MAX];
   long nvalid[NBAND_REFL_MAX];
+  long dn_hist[NBAND_REFL_MAX][CAL_NDN]; /* number of non-fill pixels of
+                                            each DN */
 } Cal_stats_t;
 
 typedef struct {
@@ -34,13 +47,24 @@ typedef struct {
   int itemp_max;
   long nfill;
   long nvalid;
+  long dn_hist[CAL_NDN];  /* number of non-fill pixels of each DN */
 } Cal_stats6_t;
 
-bool Cal(Lut_t *lut, int iband, Input_t *input, unsigned char *line_in, 
-  int16 *line_out, unsigned char *line_out_qa, Cal_stats_t *cal_stats, int iy);
+bool CalDnLut(Lut_t *lut, int iband, Input_t *input, Cal_dn_lut_t *dn_lut);
+
+bool Cal6DnLut(Lut_t *lut, Cal_dn_lut_t *dn_lut);
+
+bool Cal(Lut_t *lut, int iband, Input_t *input, Cal_dn_lut_t *dn_lut,
+  unsigned char *line_in, int16 *line_out, unsigned char *line_out_qa,
+  Cal_stats_t *cal_stats);
+
+bool Cal6(Lut_t *lut, Input_t *input, Cal_dn_lut_t *dn_lut,
+  unsigned char *line_in, int16 *line_out, unsigned char *line_out_qa,
+  Cal_stats6_t *cal_stats);
+
+void CalStats(int iband, Cal_dn_lut_t *dn_lut, Cal_stats_t *cal_stats);
 
-bool Cal6(Lut_t *lut, Input_t *input, unsigned char *line_in, 
-  int16 *line_out, unsigned char *line_out_qa, Cal_stats6_t *cal_stats, int iy);
+void Cal6Stats(Cal_dn_lut_t *dn_lut, Cal_stats6_t *cal_stats);
 
 int getValue(unsigned char* line_in, int ind);
 
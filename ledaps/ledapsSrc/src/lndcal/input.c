@@ -28,6 +28,10 @@
  Added support for pulling the TOA reflectance parameters, K1/K2 consts, and
     earth-sun distance from the XML, if they exist.
 
+ Revision 2015/11/09
+ Added the optional memory mapped access to the binary files; the lines
+    are then copied from the mapping instead of read with fseek/fread.
+
 !Team Unique Header:
   This software was developed by the MODIS Land Science Team Support 
   Group for the Laboratory for Terrestrial Physics (Code 922) at the 
@@ -62,6 +66,10 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include "input.h"
 #include "util.h"
 #include "error.h"
@@ -70,8 +78,27 @@
 #include "date.h"
 #define INPUT_FILL (0)
 
+/* Map the first len bytes of the open file fp read-only, with a hint that
+   it is read sequentially.  Returns NULL if the file is too short or can't
+   be mapped. */
+static uint8 *MapInputFile(FILE *fp, size_t len)
+{
+  struct stat st;
+  void *map;
+
+  if (fstat(fileno(fp), &st) != 0 || (size_t)st.st_size < len)
+    return NULL;
+  map = mmap(NULL, len, PROT_READ, MAP_SHARED, fileno(fp), 0);
+  if (map == MAP_FAILED)
+    return NULL;
+  madvise(map, len, MADV_SEQUENTIAL);
+
+  return (uint8 *)map;
+}
+
+
 /* Functions */
-Input_t *OpenInput(Espa_internal_meta_t *metadata)
+Input_t *OpenInput(Espa_internal_meta_t *metadata, bool use_mmap)
 /* 
 !C******************************************************************************
 
@@ -80,6 +107,8 @@ Input_t *OpenInput(Espa_internal_meta_t *metadata)
  
 !Input Parameters:
  metadata     'Espa_internal_meta_t' data structure with XML info
+ use_mmap     boolean to indicate if the binary files are memory mapped
+              instead of read line by line
 
 !Output Parameters:
  (returns)      'input' data structure or NULL when an error occurs
@@ -105,6 +134,10 @@ Input_t *OpenInput(Espa_internal_meta_t *metadata)
     RETURN_ERROR("getting input from header file", "OpenInput", NULL);
   }
 
+  for (ib = 0; ib < NBAND_REFL_MAX; ib++)
+    this->map[ib] = NULL;
+  this->map_th = NULL;
+
   /* Open files for access */
   if (this->file_type == INPUT_TYPE_BINARY) {
     for (ib = 0; ib < this->nband; ib++) {
@@ -114,13 +147,28 @@ Input_t *OpenInput(Espa_internal_meta_t *metadata)
         break;
       }
       this->open[ib] = true;
+      if (use_mmap) {
+        this->map[ib] = MapInputFile(this->fp_bin[ib],
+          (size_t)this->size.l * this->size.s * sizeof(uint8));
+        if (this->map[ib] == NULL) {
+          error_string = "mapping binary file";
+          break;
+        }
+      }
     }
     if ( this->nband_th == 1 ) {
       this->fp_bin_th = fopen(this->file_name_th, "r");
       if (this->fp_bin_th == NULL) 
         error_string = "opening thermal binary file";
-      else
+      else {
         this->open_th = true;
+        if (use_mmap) {
+          this->map_th = MapInputFile(this->fp_bin_th,
+            (size_t)this->size_th.l * this->size_th.s * sizeof(uint8));
+          if (this->map_th == NULL)
+            error_string = "mapping thermal binary file";
+        }
+      }
     }
   } else 
     error_string = "invalid file type";
@@ -130,6 +178,11 @@ Input_t *OpenInput(Espa_internal_meta_t *metadata)
       free(this->file_name[ib]);
       this->file_name[ib] = NULL;
 
+      if (this->map[ib] != NULL) {
+        munmap(this->map[ib],
+          (size_t)this->size.l * this->size.s * sizeof(uint8));
+        this->map[ib] = NULL;
+      }
       if (this->open[ib]) {
         if ( this->file_type == INPUT_TYPE_BINARY )
           fclose(this->fp_bin[ib]);
@@ -138,6 +191,11 @@ Input_t *OpenInput(Espa_internal_meta_t *metadata)
     }
     free(this->file_name_th);
     this->file_name_th = NULL;
+    if (this->map_th != NULL) {
+      munmap(this->map_th,
+        (size_t)this->size_th.l * this->size_th.s * sizeof(uint8));
+      this->map_th = NULL;
+    }
     if ( this->file_type == INPUT_TYPE_BINARY )
       fclose(this->fp_bin_th);  
     this->open_th = false;
@@ -163,6 +221,12 @@ bool GetInputLine(Input_t *this, int iband, int iline, unsigned char *line)
   if (!this->open[iband])
     RETURN_ERROR("band not open", "GetInputLine", false);
 
+  if (this->map[iband] != NULL) {
+    memcpy(line, &this->map[iband][(size_t)iline * this->size.s],
+      (size_t)this->size.s * sizeof(uint8));
+    return true;
+  }
+
   buf_void = (void *)line;
   if (this->file_type == INPUT_TYPE_BINARY) {
     loc = (long) (iline * this->size.s * sizeof(uint8));
@@ -190,6 +254,12 @@ bool GetInputLineTh(Input_t *this, int iline, unsigned char *line)
   if (!this->open_th)
     RETURN_ERROR("band not open", "GetInputLine", false);
 
+  if (this->map_th != NULL) {
+    memcpy(line, &this->map_th[(size_t)iline * this->size_th.s],
+      (size_t)this->size_th.s * sizeof(uint8));
+    return true;
+  }
+
   buf_void = (void *)line;
   if (this->file_type == INPUT_TYPE_BINARY) {
     loc = (long) (iline * this->size_th.s * sizeof(uint8));
@@ -235,6 +305,11 @@ bool CloseInput(Input_t *this)
   for (ib = 0; ib < this->nband; ib++) {
     if (this->open[ib]) {
       none_open = false;
+      if (this->map[ib] != NULL) {
+        munmap(this->map[ib],
+          (size_t)this->size.l * this->size.s * sizeof(uint8));
+        this->map[ib] = NULL;
+      }
       if (this->file_type == INPUT_TYPE_BINARY)
         fclose(this->fp_bin[ib]);
       this->open[ib] = false;
@@ -244,6 +319,11 @@ bool CloseInput(Input_t *this)
   /*** now close the thermal file ***/
   if (this->open_th) 
   {
+    if (this->map_th != NULL) {
+      munmap(this->map_th,
+        (size_t)this->size_th.l * this->size_th.s * sizeof(uint8));
+      this->map_th = NULL;
+    }
     if (this->file_type == INPUT_TYPE_BINARY)
       fclose(this->fp_bin_th);
     this->open_th = false;
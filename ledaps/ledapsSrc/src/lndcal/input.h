@@ -109,11 +109,14 @@ typedef struct {
   bool open_th;            /* thermal open flag */
   FILE *fp_bin[NBAND_REFL_MAX];  /* File pointer for binary files */
   FILE *fp_bin_th;         /* File pointer for thermal binary file */
+  uint8 *map[NBAND_REFL_MAX]; /* Mapped binary files; NULL if not mapped */
+  uint8 *map_th;           /* Mapped thermal binary file; NULL if not
+                              mapped */
 } Input_t;
 
 /* Prototypes */
 
-Input_t *OpenInput(Espa_internal_meta_t *metadata);
+Input_t *OpenInput(Espa_internal_meta_t *metadata, bool use_mmap);
 bool GetInputLine(Input_t *this, int iband, int iline, unsigned char *line);
 bool GetInputLineTh(Input_t *this, int iline, unsigned char *line);
 bool CloseInput(Input_t *this);
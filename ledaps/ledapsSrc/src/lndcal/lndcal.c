@@ -15,6 +15,9 @@
 #include "util.h"
 
 #include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include <sys/types.h>
 #include <sys/mman.h>
 #include <fcntl.h>
@@ -44,6 +47,14 @@
  * revision 2.0.1 8/5/2014  Gail Schmidt, USGS/EROS
  * - obtain the location of the ESPA schema file from an environment variable
  *   vs. the ESPA http site
+ *
+ * revision 2.1.0 11/12/2015
+ * - calibrate through per-band DN lookup tables built once before the line
+ *   loops; the statistics come from the DN histograms
+ *
+ * revision 2.1.1 11/13/2015
+ * - the thermal and reflective lines are calibrated in parallel (OpenMP) by
+ *   blocks of CAL_BLOCK_LINES lines, with per-thread statistics
  */
 
 int main (int argc, const char **argv) {
@@ -52,15 +63,21 @@ int main (int argc, const char **argv) {
   Lut_t *lut = NULL;
   Output_t *output = NULL;
   Output_t *output_th = NULL;
-  int iline, isamp,oline, ib, jb, iz, val;
-  unsigned char *line_in = NULL;
-  unsigned char *line_in_thz = NULL;
-  unsigned char *line_out_qa = NULL;
-  int16 *line_out = NULL;
-  int16 *line_out_th = NULL;
-  int16 *line_out_thz = NULL;
+  int iline, iline0, il, nblk, oline, ib, iz;
+  unsigned char *blk_line_in = NULL;  /* input lines of a block */
+  unsigned char *blk_in_thz = NULL;   /* zoomed thermal input lines */
+  unsigned char *blk_qa = NULL;       /* QA lines of a block */
+  int16 *blk_line_out = NULL;         /* output lines of a block */
+  int16 *blk_out_th = NULL;           /* thermal output lines of a block */
+  int16 *blk_out_thz = NULL;          /* zoomed thermal output lines */
   Cal_stats_t cal_stats;
   Cal_stats6_t cal_stats6;
+  Cal_stats_t *thr_stats = NULL;      /* statistics of each thread */
+  Cal_stats6_t *thr_stats6 = NULL;
+  int nthreads = 1;
+  int nb_cal_error;
+  Cal_dn_lut_t dn_lut[NBAND_REFL_MAX];
+  Cal_dn_lut_t dn_lut6;
   int nps,nls, nps6, nls6;
   int zoomx, zoomy;
   int i,odometer_flag=0;
@@ -70,8 +87,7 @@ int main (int argc, const char **argv) {
   size_t input_psize;
   int qa_band = QA_BAND_NUM;
   int nband_refl = NBAND_REFL_MAX;
-  int ifill, num_zero;
-  int maxth=0;
+  int ifill;
   int mss_flag=0;
   Espa_internal_meta_t xml_metadata;  /* XML metadata structure */
   Envi_header_t envi_hdr;   /* output ENVI header information */
@@ -109,7 +125,7 @@ int main (int argc, const char **argv) {
       "gains and biases should be in that file.", "main");
   
   /* Open input file */
-  input = OpenInput (&xml_metadata);
+  input = OpenInput (&xml_metadata, param->input_mmap);
   if (input == (Input_t *)NULL)
     EXIT_ERROR("setting up input from XML structure", "main");
 
@@ -124,9 +140,19 @@ int main (int argc, const char **argv) {
   zoomx= nint( (float)nps / (float)nps6 );
   zoomy= nint( (float)nls / (float)nls6 );
 
+  memset(&cal_stats, 0, sizeof(cal_stats));
+  memset(&cal_stats6, 0, sizeof(cal_stats6));
   for (ib = 0; ib < input->nband; ib++) 
     cal_stats.first[ib] = true;
   cal_stats6.first = true;
+
+  /* Compute the output value of each input DN */
+  for (ib = 0; ib < input->nband; ib++) 
+    if (!CalDnLut(lut, ib, input, &dn_lut[ib]))
+      EXIT_ERROR("computing the calibration lookup table", "main");
+  if (input->nband_th > 0)
+    if (!Cal6DnLut(lut, &dn_lut6))
+      EXIT_ERROR("computing the thermal calibration lookup table", "main");
   if (input->meta.inst == INST_MSS)mss_flag=1; 
 
   /* Open the output files.  Raw binary band files will be be opened. */
@@ -134,11 +160,12 @@ int main (int argc, const char **argv) {
     mss_flag);
   if (output == NULL) EXIT_ERROR("opening output file", "main");
 
-  /* Allocate memory for the input buffer, enough for all reflectance bands */
+  /* Allocate memory for the input blocks, enough for all reflectance bands */
   input_psize = sizeof(unsigned char);
-  line_in = calloc (input->size.s * nband_refl, input_psize);
-   if (line_in == NULL) 
-     EXIT_ERROR("allocating input line buffer", "main");
+  blk_line_in = calloc ((size_t)CAL_BLOCK_LINES * input->size.s * nband_refl,
+    input_psize);
+   if (blk_line_in == NULL) 
+     EXIT_ERROR("allocating input block buffer", "main");
 
   /* Create and open output thermal band, if one exists */
   if ( input->nband_th > 0 ) {
@@ -147,90 +174,136 @@ int main (int argc, const char **argv) {
     if (output_th == NULL)
       EXIT_ERROR("opening output therm file", "main");
 
-    /* Allocate memory for the thermal input and output buffer, only holds
-       one band */
-    line_out_th = calloc(input->size_th.s, sizeof(int16));
-    if (line_out_th == NULL) 
-      EXIT_ERROR("allocating thermal output line buffer", "main");
+    /* Allocate memory for the thermal output block, only holds one band */
+    blk_out_th = calloc ((size_t)CAL_BLOCK_LINES * input->size.s,
+      sizeof(int16));
+    if (blk_out_th == NULL) 
+      EXIT_ERROR("allocating thermal output block buffer", "main");
 
     if (zoomx == 1) {
-      line_out_thz = line_out_th;
-      line_in_thz = line_in;
+      blk_out_thz = blk_out_th;
+      blk_in_thz = blk_line_in;
     }
     else {
-      line_out_thz = calloc (input->size.s, sizeof(int16));
-      if (line_out_thz == NULL) 
-        EXIT_ERROR("allocating thermal zoom output line buffer", "main");
-      line_in_thz = calloc (input->size.s, input_psize);
-      if (line_in_thz == NULL) 
-        EXIT_ERROR("allocating thermal zoom input line buffer", "main");
+      blk_out_thz = calloc ((size_t)CAL_BLOCK_LINES * input->size.s,
+        sizeof(int16));
+      if (blk_out_thz == NULL) 
+        EXIT_ERROR("allocating thermal zoom output block buffer", "main");
+      blk_in_thz = calloc ((size_t)CAL_BLOCK_LINES * input->size.s,
+        input_psize);
+      if (blk_in_thz == NULL) 
+        EXIT_ERROR("allocating thermal zoom input block buffer", "main");
     }
   } else {
     printf("*** no output thermal file ***\n"); 
   }
 
-  /* Allocate memory for output lines for both the image and QA data */
-  line_out = calloc (input->size.s, sizeof (int16));
-  if (line_out == NULL) 
-    EXIT_ERROR("allocating output line buffer", "main");
-
-  line_out_qa = calloc (input->size.s, sizeof(unsigned char));
-  if (line_out_qa == NULL) 
-    EXIT_ERROR("allocating qa output line buffer", "main");
-  memset (line_out_qa, 0, input->size.s * sizeof(unsigned char));    
-
-  /* Do for each THERMAL line */
+  /* Allocate memory for output blocks for both the image and QA data */
+  blk_line_out = calloc ((size_t)CAL_BLOCK_LINES * input->size.s * nband_refl,
+    sizeof (int16));
+  if (blk_line_out == NULL) 
+    EXIT_ERROR("allocating output block buffer", "main");
+
+  blk_qa = calloc ((size_t)CAL_BLOCK_LINES * input->size.s,
+    sizeof(unsigned char));
+  if (blk_qa == NULL) 
+    EXIT_ERROR("allocating qa output block buffer", "main");
+
+  /* The lines of a block are read in order, calibrated in parallel and
+     written in order.  Each thread has its own statistics, which are merged
+     at the end. */
+#ifdef _OPENMP
+  if (param->num_threads > 0)
+    omp_set_num_threads(param->num_threads);
+  nthreads = omp_get_max_threads();
+#endif
+  thr_stats = calloc (nthreads, sizeof(Cal_stats_t));
+  thr_stats6 = calloc (nthreads, sizeof(Cal_stats6_t));
+  if (thr_stats == NULL || thr_stats6 == NULL)
+    EXIT_ERROR("allocating thread statistics", "main");
+
+  /* Do for each block of THERMAL lines */
   oline= 0;
   if (input->nband_th > 0) {
     ifill= (int)lut->in_fill;
-    for (iline = 0; iline < input->size_th.l; iline++) {
-      ib=0;
-      if (!GetInputLineTh(input, iline, line_in))
-        EXIT_ERROR("reading input data for a line", "main");
-
-      if ( odometer_flag && ( iline==0 || iline ==(nls-1) || iline%100==0  ) ){ 
-        if ( zoomy == 1 )
-          printf("--- main loop BAND6 Line %d --- \r",iline); 
-        else
-          printf("--- main loop BAND6 Line in=%d out=%d --- \r",iline,oline); 
-        fflush(stdout); 
+    for (iline0 = 0; iline0 < input->size_th.l; iline0 += CAL_BLOCK_LINES) {
+      nblk = input->size_th.l - iline0;
+      if (nblk > CAL_BLOCK_LINES)
+        nblk = CAL_BLOCK_LINES;
+
+      for (il = 0, iline = iline0; il < nblk; il++, iline++) {
+        if (!GetInputLineTh(input, iline, &blk_line_in[il*nps]))
+          EXIT_ERROR("reading input data for a line", "main");
+
+        if ( odometer_flag && ( iline==0 || iline ==(nls-1) || iline%100==0 ) ){ 
+          if ( zoomy == 1 )
+            printf("--- main loop BAND6 Line %d --- \r",iline); 
+          else
+            printf("--- main loop BAND6 Line in=%d out=%d --- \r",iline,
+              iline*zoomy); 
+          fflush(stdout); 
+        }
       }
 
-      memset(line_out_qa, 0, input->size.s*sizeof(unsigned char));    
-      if (!Cal6(lut, input, line_in, line_out_th, line_out_qa, &cal_stats6,
-        iline))
-        EXIT_ERROR("doing calibration for a line", "main");
+      /* errors are counted and reported after the parallel loop, since a
+         thread can't exit while the others are still processing */
+      nb_cal_error = 0;
+      #pragma omp parallel for schedule(dynamic) reduction(+:nb_cal_error)
+      for (il = 0; il < nblk; il++) {
+        int isamp, val;
+        unsigned char *line_in = &blk_line_in[il*nps];
+        unsigned char *line_in_thz = &blk_in_thz[il*nps];
+        unsigned char *line_out_qa = &blk_qa[il*nps];
+        int16 *line_out_th = &blk_out_th[il*nps];
+        int16 *line_out_thz = &blk_out_thz[il*nps];
+#ifdef _OPENMP
+        int ithr = omp_get_thread_num();
+#else
+        int ithr = 0;
+#endif
+
+        memset(line_out_qa, 0, input->size.s*sizeof(unsigned char));    
+        if (!Cal6(lut, input, &dn_lut6, line_in, line_out_th, line_out_qa,
+          &thr_stats6[ithr])) {
+          nb_cal_error++;
+          continue;
+        }
 
-      if ( zoomx>1 ) {
-        zoomIt(line_out_thz, line_out_th, nps/zoomx, zoomx );
-        zoomIt8(line_in_thz, line_in, nps/zoomx, zoomx );
-      }
+        if ( zoomx>1 ) {
+          zoomIt(line_out_thz, line_out_th, nps/zoomx, zoomx );
+          zoomIt8(line_in_thz, line_in, nps/zoomx, zoomx );
+        }
 
-      for ( iz=0; iz<zoomy; iz++ ) {
         for (isamp = 0; isamp < input->size.s; isamp++) {
           val= getValue(line_in_thz, isamp);
-          if ( val> maxth) maxth=val;
           if ( val==ifill) line_out_qa[isamp] = lut->qa_fill; 
           else if ( val>=SATU_VAL6 ) line_out_qa[isamp] = ( 0x000001 << 6 ); 
         }
+      }
+      if (nb_cal_error > 0)
+        EXIT_ERROR("doing calibration for a line", "main");
 
-        if ( oline<nls ) {
-          if (!PutOutputLine(output_th, ib, oline, line_out_thz)) {
-            sprintf(msgbuf,"write thermal error ib=%d oline=%d iline=%d",ib,
-              oline,iline);
-            EXIT_ERROR(msgbuf, "main");
-          }
-
-          if (input->meta.inst != INST_MSS) 
-            if (!PutOutputLine(output_th, ib+1, oline, line_out_qa)) {
-	          sprintf(msgbuf,"write thermal QA error ib=%d oline=%d iline=%d",
-                ib+1,oline,iline);
+      for (il = 0, iline = iline0; il < nblk; il++, iline++) {
+        ib=0;
+        for ( iz=0; iz<zoomy; iz++ ) {
+          if ( oline<nls ) {
+            if (!PutOutputLine(output_th, ib, oline, &blk_out_thz[il*nps])) {
+              sprintf(msgbuf,"write thermal error ib=%d oline=%d iline=%d",ib,
+                oline,iline);
               EXIT_ERROR(msgbuf, "main");
             }
+
+            if (input->meta.inst != INST_MSS) 
+              if (!PutOutputLine(output_th, ib+1, oline, &blk_qa[il*nps])) {
+	            sprintf(msgbuf,"write thermal QA error ib=%d oline=%d iline=%d",
+                  ib+1,oline,iline);
+                EXIT_ERROR(msgbuf, "main");
+              }
+          }
+          oline++;
         }
-        oline++;
       }
-    } /* end loop for each thermal line */
+    } /* end loop for each block of thermal lines */
   }
   if (odometer_flag) printf("\n");
 
@@ -238,49 +311,99 @@ int main (int argc, const char **argv) {
     if (!CloseOutput(output_th))
       EXIT_ERROR("closing output thermal file", "main");
 
-  /* Do for each REFLECTIVE line */
+  /* Do for each block of REFLECTIVE lines */
   ifill= (int)lut->in_fill;
-  for (iline = 0; iline < input->size.l; iline++){
-    /* Do for each band */
+  for (iline0 = 0; iline0 < input->size.l; iline0 += CAL_BLOCK_LINES) {
+    nblk = input->size.l - iline0;
+    if (nblk > CAL_BLOCK_LINES)
+      nblk = CAL_BLOCK_LINES;
 
-    if ( odometer_flag && ( iline==0 || iline ==(nls-1) || iline%100==0  ) )
-     {printf("--- main reflective loop Line %d ---\r",iline); fflush(stdout);}
+    for (il = 0, iline = iline0; il < nblk; il++, iline++) {
+      if ( odometer_flag && ( iline==0 || iline ==(nls-1) || iline%100==0 ) )
+       {printf("--- main reflective loop Line %d ---\r",iline); fflush(stdout);}
 
-    memset(line_out_qa, 0, input->size.s*sizeof(unsigned char));
-    
-    for (ib = 0; ib < input->nband; ib++) {
-      if (!GetInputLine(input, ib, iline, &line_in[ib*nps]))
-        EXIT_ERROR("reading input data for a line", "main");
-    }
-    
-    for (isamp = 0; isamp < input->size.s; isamp++){
-      num_zero=0;
       for (ib = 0; ib < input->nband; ib++) {
-        jb= (ib != 5 ) ? ib+1 : ib+2;
-        val= getValue((unsigned char *)&line_in[ib*nps], isamp);
-	    if ( val==ifill   )num_zero++;
-        if ( val==SATU_VAL[ib] ) line_out_qa[isamp]|= ( 0x000001 <<jb ); 
+        if (!GetInputLine(input, ib, iline,
+          &blk_line_in[((size_t)il*nband_refl + ib)*nps]))
+          EXIT_ERROR("reading input data for a line", "main");
       }
-      /* Feng fixed bug by changing "|=" to "=" below (4/17/09) */
-      if ( num_zero >  0 )line_out_qa[isamp] = lut->qa_fill; 
     }
 
-    for (ib = 0; ib < input->nband; ib++) {
-      if (!Cal(lut, ib, input, &line_in[ib*nps], line_out, line_out_qa,
-        &cal_stats,iline))
-        EXIT_ERROR("doing calibraton for a line", "main");
+    /* Build the fill/saturation QA of each line */
+    #pragma omp parallel for schedule(dynamic)
+    for (il = 0; il < nblk; il++) {
+      int isamp, ib, jb, val, num_zero;
+      unsigned char *line_in = &blk_line_in[(size_t)il*nband_refl*nps];
+      unsigned char *line_out_qa = &blk_qa[il*nps];
+
+      memset(line_out_qa, 0, input->size.s*sizeof(unsigned char));
+      for (isamp = 0; isamp < input->size.s; isamp++){
+        num_zero=0;
+        for (ib = 0; ib < input->nband; ib++) {
+          jb= (ib != 5 ) ? ib+1 : ib+2;
+          val= getValue((unsigned char *)&line_in[ib*nps], isamp);
+	      if ( val==ifill   )num_zero++;
+          if ( val==SATU_VAL[ib] ) line_out_qa[isamp]|= ( 0x000001 <<jb ); 
+        }
+        /* Feng fixed bug by changing "|=" to "=" below (4/17/09) */
+        if ( num_zero >  0 )line_out_qa[isamp] = lut->qa_fill; 
+      }
+    }
+
+    /* Calibrate each band of each line; errors are reported after the
+       parallel loop */
+    nb_cal_error = 0;
+    #pragma omp parallel for collapse(2) schedule(dynamic) \
+      reduction(+:nb_cal_error)
+    for (il = 0; il < nblk; il++) {
+      for (ib = 0; ib < input->nband; ib++) {
+        size_t k = (size_t)il*nband_refl + ib;
+#ifdef _OPENMP
+        int ithr = omp_get_thread_num();
+#else
+        int ithr = 0;
+#endif
+
+        if (!Cal(lut, ib, input, &dn_lut[ib], &blk_line_in[k*nps],
+          &blk_line_out[k*nps], &blk_qa[il*nps], &thr_stats[ithr]))
+          nb_cal_error++;
+      }
+    }
+    if (nb_cal_error > 0)
+      EXIT_ERROR("doing calibraton for a line", "main");
 
-      if (!PutOutputLine(output, ib, iline, line_out))
-        EXIT_ERROR("reading input data for a line", "main");
-    } /* End loop for each band */
+    for (il = 0, iline = iline0; il < nblk; il++, iline++) {
+      for (ib = 0; ib < input->nband; ib++) {
+        if (!PutOutputLine(output, ib, iline,
+          &blk_line_out[((size_t)il*nband_refl + ib)*nps]))
+          EXIT_ERROR("reading input data for a line", "main");
+      } /* End loop for each band */
         
-    if (input->meta.inst != INST_MSS) 
-      if (!PutOutputLine(output, qa_band, iline, line_out_qa))
-        EXIT_ERROR("writing qa data for a line", "main");
-  } /* End loop for each line */
+      if (input->meta.inst != INST_MSS) 
+        if (!PutOutputLine(output, qa_band, iline, &blk_qa[il*nps]))
+          EXIT_ERROR("writing qa data for a line", "main");
+    }
+  } /* End loop for each block of lines */
+
+  /* Merge the statistics of the threads */
+  for (i = 0; i < nthreads; i++) {
+    for (ib = 0; ib < input->nband; ib++) {
+      cal_stats.nfill[ib] += thr_stats[i].nfill[ib];
+      for (iz = 0; iz < CAL_NDN; iz++)
+        cal_stats.dn_hist[ib][iz] += thr_stats[i].dn_hist[ib][iz];
+    }
+    cal_stats6.nfill += thr_stats6[i].nfill;
+    for (iz = 0; iz < CAL_NDN; iz++)
+      cal_stats6.dn_hist[iz] += thr_stats6[i].dn_hist[iz];
+  }
 
   if ( odometer_flag )printf("\n");
 
+  for (ib = 0; ib < input->nband; ib++)
+    CalStats(ib, &dn_lut[ib], &cal_stats);
+  if ( input->nband_th > 0 )
+    Cal6Stats(&dn_lut6, &cal_stats6);
+
   for (ib = 0; ib < input->nband; ib++) {
     printf(
       " band %d rad min %8.5g max %8.4f  |  ref min  %8.5f max  %8.4f\n", 
@@ -298,19 +421,23 @@ int main (int argc, const char **argv) {
   if (!CloseInput(input)) EXIT_ERROR("closing input file", "main");
   if (!CloseOutput(output)) EXIT_ERROR("closing input file", "main");
 
-  /* Write the ENVI header for reflectance files */
-  for (ib = 0; ib < output->nband; ib++) {
-    /* Create the ENVI header file this band */
-    if (create_envi_struct (&output->metadata.band[ib], &xml_metadata.global,
-      &envi_hdr) != SUCCESS)
-        EXIT_ERROR("Creating the ENVI header structure for this file.", "main");
-
-    /* Write the ENVI header */
-    strcpy (envi_file, output->metadata.band[ib].file_name);
-    cptr = strchr (envi_file, '.');
-    strcpy (cptr, ".hdr");
-    if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
-        EXIT_ERROR("Writing the ENVI header file.", "main");
+  /* Write the ENVI header for reflectance files (not written when the
+     fused ledaps driver only keeps them in memory) */
+  if (output_mem_put == NULL || output_mem_write_refl) {
+    for (ib = 0; ib < output->nband; ib++) {
+      /* Create the ENVI header file this band */
+      if (create_envi_struct (&output->metadata.band[ib], &xml_metadata.global,
+        &envi_hdr) != SUCCESS)
+          EXIT_ERROR("Creating the ENVI header structure for this file.",
+            "main");
+
+      /* Write the ENVI header */
+      strcpy (envi_file, output->metadata.band[ib].file_name);
+      cptr = strchr (envi_file, '.');
+      strcpy (cptr, ".hdr");
+      if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
+          EXIT_ERROR("Writing the ENVI header file.", "main");
+    }
   }
 
   /* Write the ENVI header for thermal files */
@@ -354,20 +481,24 @@ int main (int argc, const char **argv) {
   if (!FreeOutput(output)) 
     EXIT_ERROR("freeing output file stucture", "main");
 
-  free(line_out);
-  line_out = NULL;
-  free(line_in);
-  line_in = NULL;
-  free(line_out_qa);
-  line_out_qa = NULL;
-  free(line_out_th);
-  line_out_th = NULL;
+  free(blk_line_out);
+  blk_line_out = NULL;
+  free(blk_line_in);
+  blk_line_in = NULL;
+  free(blk_qa);
+  blk_qa = NULL;
+  free(blk_out_th);
+  blk_out_th = NULL;
   if (zoomx != 1) {
-    free(line_in_thz);
-    free(line_out_thz);
+    free(blk_in_thz);
+    free(blk_out_thz);
   }
-  line_in_thz = NULL;
-  line_out_thz = NULL;
+  blk_in_thz = NULL;
+  blk_out_thz = NULL;
+  free(thr_stats);
+  thr_stats = NULL;
+  free(thr_stats6);
+  thr_stats6 = NULL;
 
   /* All done */
   printf ("lndcal complete.\n");
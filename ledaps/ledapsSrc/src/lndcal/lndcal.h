@@ -15,6 +15,7 @@
 #define NBAND_QA       (1)
 #define NBAND_CAL_MAX (NBAND_REFL_MAX + NBAND_QA)
 #define QA_BAND_NUM (6)
+#define CAL_BLOCK_LINES (64)  /* lines calibrated in parallel at a time */
 
 typedef signed short int16;
 typedef unsigned char uint8;
@@ -49,6 +49,10 @@
  Gail Schmidt, USGS EROS
  Modified application to utilize the ESPA internal raw binary format.
 
+ Revision 2.1 2015/11/16
+ Added the in-memory hand-over of the output bands (output_mem_put) for
+ the fused ledaps driver.
+
 !Team Unique Header:
   This software was developed by the MODIS Land Science Team Support 
   Group for the Laboratory for Terrestrial Physics (Code 922) at the 
@@ -73,11 +77,15 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
 #include "output.h"
 #include "const.h"
 #include "error.h"
 #include "cal.h"
 
+bool (*output_mem_put)(char *file_name, void *buf, size_t size) = NULL;
+bool output_mem_write_refl = true;
+
 Output_t *OpenOutput(Espa_internal_meta_t *in_meta, Input_t *input,
   Param_t *param, Lut_t *lut, bool thermal, int mss_flag)
 /* 
@@ -316,9 +324,22 @@ revision 2.0.1 3/25/2014
        file for write access */
     sprintf (bmeta[ib].file_name, "%s_%s.img", scene_name,
       bmeta[ib].name);
-    this->fp_bin[ib] = open_raw_binary (bmeta[ib].file_name, "w");
-    if (this->fp_bin[ib] == NULL)
-      RETURN_ERROR("unable to open output band file", "OpenOutput", NULL);
+    this->fp_bin[ib] = NULL;
+    if (output_mem_put == NULL || thermal || output_mem_write_refl) {
+      this->fp_bin[ib] = open_raw_binary (bmeta[ib].file_name, "w");
+      if (this->fp_bin[ib] == NULL)
+        RETURN_ERROR("unable to open output band file", "OpenOutput", NULL);
+    }
+
+    /* Keep the whole band in memory for the fused driver */
+    this->mem[ib] = NULL;
+    if (output_mem_put != NULL) {
+      this->mem[ib] = malloc ((size_t)this->size.l * this->size.s *
+        (bmeta[ib].data_type == ESPA_INT16 ? sizeof(int16) :
+        sizeof(unsigned char)));
+      if (this->mem[ib] == NULL)
+        RETURN_ERROR("allocating in-memory output band", "OpenOutput", NULL);
+    }
   }  /* for ib */
   this->open = true;
 
@@ -347,12 +368,28 @@ bool CloseOutput(Output_t *this)
 */
 {
   int ib;
+  size_t nbytes;      /* number of bytes in each pixel */
 
   if (!this->open)
     RETURN_ERROR("image files not open", "CloseOutput", false);
 
-  for (ib = 0; ib < this->nband; ib++)
-    close_raw_binary (this->fp_bin[ib]);
+  for (ib = 0; ib < this->nband; ib++) {
+    if (this->fp_bin[ib] != NULL)
+      close_raw_binary (this->fp_bin[ib]);
+
+    /* Hand the in-memory band over to the fused driver */
+    if (this->mem[ib] != NULL) {
+      if (this->metadata.band[ib].data_type == ESPA_INT16)
+        nbytes = sizeof (int16);
+      else
+        nbytes = sizeof (unsigned char);
+      if (!output_mem_put (this->metadata.band[ib].file_name,
+          this->mem[ib], (size_t)this->size.l * this->size.s * nbytes))
+        RETURN_ERROR("handing over in-memory output band", "CloseOutput",
+          false);
+      this->mem[ib] = NULL;
+    }
+  }
 
   this->open = false;
   return true;
@@ -425,9 +462,13 @@ bool PutOutputLine(Output_t *this, int iband, int iline, void *line)
     nbytes = sizeof (int16);
   else
     nbytes = sizeof (unsigned char);
-  if (write_raw_binary (this->fp_bin[iband], 1, this->size.s, nbytes, line)
+  if (this->fp_bin[iband] != NULL &&
+      write_raw_binary (this->fp_bin[iband], 1, this->size.s, nbytes, line)
       != SUCCESS)
     RETURN_ERROR("writing output line", "PutOutputLine", false);
+  if (this->mem[iband] != NULL)
+    memcpy ((char *)this->mem[iband] + (size_t)iline * this->size.s * nbytes,
+      line, (size_t)this->size.s * nbytes);
 
   return true;
 }
@@ -61,9 +61,22 @@ typedef struct {
   Espa_internal_meta_t metadata;  /* metadata container to hold the band
                            metadata for the output bands; global metadata
                            won't be valid */
-  FILE *fp_bin[NBAND_CAL_MAX];  /* File pointer for binary files */
+  FILE *fp_bin[NBAND_CAL_MAX];  /* File pointer for binary files; NULL if
+                           the band is only kept in memory */
+  void *mem[NBAND_CAL_MAX];  /* Whole band kept in memory for the fused
+                           ledaps driver; NULL if not kept */
 } Output_t;
 
+/* In-memory hand-over of the output bands, set by the fused ledaps driver
+   to pass the TOA bands to lndsr without reading them back from disk.
+   CloseOutput gives each band to 'output_mem_put', which takes the buffer;
+   NULL = only write the band files. */
+
+extern bool (*output_mem_put)(char *file_name, void *buf, size_t size);
+extern bool output_mem_write_refl;  /* also write the reflectance and QA band
+                                       files; the thermal band files are
+                                       always written */
+
 /* Prototypes */
 
 Output_t *OpenOutput(Espa_internal_meta_t *metadata, Input_t *input,
@@ -37,6 +37,13 @@
  Revision 03/31/2015 Gail Schmidt, USGS EROS
  Added an existance check for the TOA reflectance (and K1/K2 consts).
 
+ Revision 11/09/2015
+ Added the optional INPUT_MMAP parameter to memory map the input files.
+
+ Revision 11/13/2015
+ Added the optional NUM_THREADS parameter for the number of calibration
+ threads.
+
 !Team Unique Header:
   This software was developed by the MODIS Land Science Team Support 
   Group for the Laboratory for Terrestrial Physics (Code 922) at the 
@@ -90,6 +97,8 @@ typedef enum {
   PARAM_START = 0,
   PARAM_XML_FILE,
   PARAM_LEDAPSVERSION,
+  PARAM_INPUT_MMAP,
+  PARAM_NUM_THREADS,
   PARAM_END,
   PARAM_MAX
 } Param_key_t;
@@ -98,6 +107,8 @@ Key_string_t Param_string[PARAM_MAX] = {
   {(int)PARAM_START,       "PARAMETER_FILE"},
   {(int)PARAM_XML_FILE,    "XML_FILE"},
   {(int)PARAM_LEDAPSVERSION,  "LEDAPSVersion"},
+  {(int)PARAM_INPUT_MMAP,  "INPUT_MMAP"},
+  {(int)PARAM_NUM_THREADS,  "NUM_THREADS"},
   {(int)PARAM_END,         "END"}
 };
 
@@ -156,6 +167,8 @@ Param_t *GetParam(int argc, const char **argv)
   this->param_file_name         = NULL;
   this->input_xml_file_name     = NULL;
   this->LEDAPSVersion           = NULL;
+  this->input_mmap              = false;
+  this->num_threads             = 0;
 
   /* Populate the data structure */
   this->param_file_name = DupString(param_file_name);
@@ -247,6 +260,41 @@ Param_t *GetParam(int argc, const char **argv)
         }
         break;
 
+      case PARAM_INPUT_MMAP:
+        if (key.nval <= 0) {
+          error_string = "no input mmap value";
+          break;
+        } else if (key.nval > 1) {
+          error_string = "too many input mmap values";
+          break;
+        }
+        key.value[0][key.len_value[0]] = '\0';
+        if (!strcmp(key.value[0], "true") || !strcmp(key.value[0], "yes"))
+          this->input_mmap = true;
+        else if (!strcmp(key.value[0], "false") || !strcmp(key.value[0], "no"))
+          this->input_mmap = false;
+        else {
+          error_string = "invalid input mmap value";
+          break;
+        }
+        break;
+
+      case PARAM_NUM_THREADS:
+        if (key.nval <= 0) {
+          error_string = "no number of threads";
+          break;
+        } else if (key.nval > 1) {
+          error_string = "too many number of threads values";
+          break;
+        }
+        key.value[0][key.len_value[0]] = '\0';
+        if (sscanf(key.value[0], "%d", &this->num_threads) != 1 ||
+            this->num_threads < 0) {
+          error_string = "invalid number of threads";
+          break;
+        }
+        break;
+
       case PARAM_END:
         if (key.nval != 0) {
           error_string = "no value expected (end key)";
@@ -71,6 +71,9 @@ typedef struct {
   char *param_file_name;         /* Parameter file name                */
   char *input_xml_file_name;     /* Input XML metadata file name       */
   char *LEDAPSVersion;           /* LEDAPS Version                     */
+  bool input_mmap;               /* True to memory map the input files */
+  int  num_threads;              /* number of calibration threads;
+                                    0 = OpenMP default                 */
 } Param_t;
 
 /* Prototypes */
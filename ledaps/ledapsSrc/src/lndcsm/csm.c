@@ -12,10 +12,12 @@
 #include "const.h"
 #include "error.h"
 #include "util.h"
+#include "morph.h"
 #define WRITE_SIEVE 0
 #define LOG_FLAG 1
 #define HIST_LOG_FLAG 1
 #define CLMASK_LOG ("cloud_mask.log")
+#define MBYTE (1024*1024)
 FILE* mout;      /* most of the log messages go here                         */
 Pbuf_t *pst;     /* Print message log */
 char pb[256];
@@ -57,9 +59,13 @@ bool CloudMask(
  unsigned char* clmask;
  unsigned char* clmaskb;
  unsigned char* clmaskb2;
+ unsigned char* clmask_nxt;
+ unsigned char* clmaskb_nxt;
+ unsigned char* swap_ptr;
  unsigned char* bmask_img;
  unsigned char* imask_img;
  unsigned char* omask_img;
+ morph_mask_t* kmask;
 /*--------------------------------------------------------------------------!*/
 /*-                          cloud mask pointers                           -!*/
 /*--------------------------------------------------------------------------!*/
@@ -98,6 +104,7 @@ bool CloudMask(
      , b6histogram[HISTSIZ]
      , cloudvalues 
      , cloudvalues2 
+     , precloudvalues
      , cloudval254
      , cloudval255
      , iclpercentorig                                      /* int */
@@ -123,11 +130,9 @@ bool CloudMask(
      , *therm_line
      , *line_in_buf
      , *line_in[NBAND_REFL_MAX]
-     , ik
-     , ival
-     , oval
-     , yy,xx,yyy,xxx
      , ksize
+     , kbefore
+     , kafter
      , bufptr=0
        ;                                                   /* int */
 /*--------------------------------------------------------------------------!*/
@@ -216,7 +221,6 @@ bool CloudMask(
  imgfile_t clmask_File;
  imgfile_t sive_File;
  imgfile_t clmaskb_File;
- imgfile_t clmaskb2_File;
 /*--------------------------------------------------------------------------!*/
 /*-                            output flag values                          -!*/
 /*--------------------------------------------------------------------------!*/
@@ -234,6 +238,7 @@ bool CloudMask(
  time_t clock;
  char date_time[21];
  bool therm_flag;
+ bool mem_flag;
 /*--------------------------------------------------------------------------!*/
  therm_flag=( input_th!=(Input_t *)NULL );
 
@@ -264,15 +269,29 @@ bool CloudMask(
  yhalf= nls / 2;
 /*--------------------------------------------------------------------------!*/
 /*-            open for write (read/write) temporary image files           -!*/
+/*-   held in memory if they fit the memory budget (0= no budget), else    -!*/
+/*-   (or if they can not be allocated) on temporary files                 -!*/
 /*--------------------------------------------------------------------------!*/
- if(!img_openw(&b6tempeture_File,"b6tempeture_temp.img",nps,nls,1,sizeof(float)
-   ) )  ERROR("opening b6tempeture","csm");
- if(!img_openw( &clmaskb_File,  "clmaskb_temp.img",  nps, nls,1,sizeof(char) 
-    ) )  ERROR("opening clmaskb","csm");
- if(!img_openw( &clmaskb2_File, "clmaskb2_temp.img", nps, nls,1,sizeof(char) 
-    ) )  ERROR("opening clmaskb2","csm");
- if(!img_openw( &clmask_File, "clmask.img", nps, nls,1,sizeof(char)  ) ) 
-   ERROR("opening clmask","csm");
+ if ( therm_flag )
+   {
+   mem_flag= ( param->mem_budget==0 || (double)nps*nls*(sizeof(float)+2) 
+               <= (double)param->mem_budget*MBYTE );
+   if ( !mem_flag || !img_openm(&b6tempeture_File,"b6tempeture_temp.img",
+                                nps,nls,1,sizeof(float)) )
+     if(!img_openw(&b6tempeture_File,"b6tempeture_temp.img",nps,nls,1,
+        sizeof(float) ) )  ERROR("opening b6tempeture","csm");
+   if ( !mem_flag || !img_openm(&clmaskb_File,"clmaskb_temp.img",
+                                nps,nls,1,sizeof(char)) )
+     if(!img_openw( &clmaskb_File,  "clmaskb_temp.img",  nps, nls,1,
+        sizeof(char) ) )  ERROR("opening clmaskb","csm");
+   if ( !mem_flag || !img_openm(&clmask_File,"clmask.img",
+                                nps,nls,1,sizeof(char)) )
+     if(!img_openw( &clmask_File, "clmask.img", nps, nls,1,sizeof(char)  ) ) 
+       ERROR("opening clmask","csm");
+   sprintf(pb,"temporary images held in %s",
+     ( b6tempeture_File.mem!=NULL && clmaskb_File.mem!=NULL && 
+       clmask_File.mem!=NULL ) ? "memory" : "files");  pr(pst);
+   }
 
 /*--------------------------------------------------------------------------!*/
 /*-                     initalize (open) virtual buffers                   -!*/
@@ -306,6 +325,10 @@ bool CloudMask(
  if ( !clmaskb )ERROR(" allocate clmaskb failed ","csm"); 
  clmaskb2=  (unsigned char*)malloc ( nps*4* sizeof(unsigned char) ); 
  if ( !clmaskb2 )ERROR(" allocate clmaskb2 failed ","csm"); 
+ clmask_nxt=  (unsigned char*)malloc ( nps* sizeof(unsigned char) ); 
+ if ( !clmask_nxt )ERROR(" allocate clmask_nxt failed ","csm"); 
+ clmaskb_nxt=  (unsigned char*)malloc ( nps* sizeof(unsigned char) ); 
+ if ( !clmaskb_nxt )ERROR(" allocate clmaskb_nxt failed ","csm"); 
  ib2buf= (double*)malloc ( nps* sizeof(double) ); 
  if ( !ib2buf )ERROR(" allocate ib2buf failed ","csm"); 
  ib3buf= (double*)malloc ( nps* sizeof(double) ); 
@@ -778,7 +801,8 @@ bool CloudMask(
  
  if ( cloudvalues >  0)
    {
-   moment( &b6clouds, cloudvalues, result );
+   histo_moment( &b6clouds, cloudvalues, b6histogram, HMIN,  HMAX, 
+                 &b6min, &b6max, result, mean_std );
    b6mean = result[0];
    sprintf(pb,"cloud thermal mean     %f", result[0] ); pr(pst);
    sprintf(pb,"cloud thermal variance %f", result[1] ); pr(pst);
@@ -786,7 +810,6 @@ bool CloudMask(
    sprintf(pb,"cloud kurtosis         %f", result[3] ); pr(pst);
    sprintf(pb,"cloud meanabsdev       %f", result[4] ); pr(pst);
    sprintf(pb,"cloud stdv             %f", result[5] ); pr(pst);
-   compute_std( &b6clouds, cloudvalues, mean_std );
    }
   else
     {
@@ -829,10 +852,8 @@ bool CloudMask(
 /*--------------------------------------------------------------------------!*/
    if ( index > 0 )
      {
-     compute_std( &b6clouds, cloudvalues, mean_std );
-     b6sd= mean_std[1];
+     b6sd= mean_std[1];   /* histogram done with the moments */
 
-     histo( &b6clouds, index, b6histogram, HMIN,  HMAX, &b6min, &b6max ) ;
      bins= nint( b6max ) - nint( b6min ) + 1; /* number of bins used*/
 
      if ( HIST_LOG_FLAG ) 
@@ -1055,7 +1076,8 @@ bool CloudMask(
    index= cloudvalues;
    if ( index > 0 )
      {
-     histo( &b6clouds, index, b6histogram, HMIN,  HMAX, &b6min, &b6max1 ) ;
+     histo_moment( &b6clouds, index, b6histogram, HMIN,  HMAX, 
+                   &b6min, &b6max1, result, mean_std );
      bins= nint( b6max1 ) - nint( b6min ) + 1; /* number of bins used*/
 
      if ( HIST_LOG_FLAG ) 
@@ -1077,7 +1099,6 @@ bool CloudMask(
 
  if ( cloudvalues >  0)
    {
-   moment( &b6clouds, cloudvalues, result ); 
    b6mean1 = result[0];
    sprintf(pb," cloud mean   : %6.2f",b6mean1); pr(pst);
    cenb(pst,"-"); cenb(pst," "); 
@@ -1092,7 +1113,8 @@ bool CloudMask(
    index= cloudvalues2;
    if ( index > 0 )
      {
-     histo( &b6clouds200, index, b6histogram, HMIN,  HMAX, &b6min, &b6max2 ) ;
+     histo_moment( &b6clouds200, index, b6histogram, HMIN,  HMAX, 
+                   &b6min, &b6max2, result, mean_std );
      bins= nint( b6max2 ) - nint( b6min ) + 1; /* number of bins used*/
      if ( HIST_LOG_FLAG ) 
        {
@@ -1112,7 +1134,6 @@ bool CloudMask(
      cenb(pst,"17.5% Threshold Statistics");   cenb(pst,"-");   cenb(pst," "); 
      sprintf(pb," cloud minimum: %6.2f ",b6min);   pr(pst);
      sprintf(pb," cloud maximum: %6.2f ",b6max2);  pr(pst);     
-     moment( &b6clouds200, cloudvalues2, result );
      b6mean2 = result[0];
      sprintf(pb," cloud mean   : %6.2f ",b6mean2);   pr(pst); cenb(pst," ");
      }
@@ -1318,58 +1339,49 @@ bool CloudMask(
 /*--------------------------------------------------------------------------!*/
 /*- set up for spatial filter                                              -!*/
 /*- spatial filter modified to work on both snow and cloud masks           -!*/
-/*- clmaskb image set to 1 for cloud 16 for snow                           -!*/
+/*- clmaskb2 lines set to 1 for cloud 16 for snow; they are made from the  -!*/
+/*- unfiltered clmaskb and clmask one line ahead of the filter             -!*/
 /*--------------------------------------------------------------------------!*/
- cloudvalues=0;
- for (iy=0; iy<nls; iy++ )
+ precloudvalues=0;
+ if ( !get_line(&clmaskb_File,  (unsigned char*)clmaskb_nxt,   0 ) )
+   ERROR("getline from clmaskb","csm" );
+ if ( !get_line( &clmask_File,   (unsigned char*)clmask_nxt,   0 ) )
+    ERROR("getline from clmask","csm" );
+ for ( ix=0; ix<nps; ix++)
    {
-   if ( !get_line(&clmaskb_File,  (unsigned char*)clmaskb,   iy ) )
-     ERROR("getline from clmaskb","csm" );
-   if ( !get_line( &clmask_File,   (unsigned char*)clmask,   iy ) )
-      ERROR("getline from clmask","csm" );
-
-   for ( ix=0; ix<nps; ix++)
-     {
-     clmaskb2[ix]= ( clmaskb[ix] == b255 || clmaskb[ix]== b254 ) ? b1 : b0;
-     if ( clmask[ix] == CLSTAT_S ) clmaskb2[ix]+= 16;
-     if ( clmaskb2[ix]==b1 ) cloudvalues++;
-     }
-
-   if ( !put_line(&clmaskb2_File, (char*)clmaskb2, iy) )
-     ERROR("putline clmaskb2 file","csm" );
-
-   if ( ( iy==0 || iy ==(nls-1) || iy%100==0 ) && odometer_flag )
-     {
-     printf("--- pre spatial filter pass line %d of %d --- \r",iy,nls-1); 
-     fflush(stdout); 
-     }
+   clmaskb2[ix]= ( clmaskb_nxt[ix] == b255 || clmaskb_nxt[ix]== b254 ) ? b1 : b0;
+   if ( clmask_nxt[ix] == CLSTAT_S ) clmaskb2[ix]+= 16;
+   if ( clmaskb2[ix]==b1 ) precloudvalues++;
    }
- if ( odometer_flag )printf("\n");
- sprintf(pb,"cloudvalues prior to final filter=%d ",cloudvalues);   pr(pst); 
 /*--------------------------------------------------------------------------!*/
 /*-                             spatial filter                             -!*/
 /*-                  fill in cloud holes if clouds exist                   -!*/
 /*--------------------------------------------------------------------------!*/
- memset(clmaskb2, 0, nps*4*sizeof(unsigned char));
  filt_new= 0;
  new_snow= 0;
  memset(cloud,0,sizeof(int)*2*2);
  cloudvalues= 0;
- if ( !get_line( &clmaskb2_File, (unsigned char*)&clmaskb2[0*nps], 0 ) )
-  ERROR("getline from clmaskb2","csm" );
 
  for (iy=0; iy<nls; iy++ )
    {
-   if ( !get_line( &clmaskb_File,  (unsigned char*)clmaskb,  iy ) )
-    ERROR("getline from clmaskb","csm" );
-   if ( !get_line( &clmask_File,   (unsigned char*)clmask,   iy ) )
-    ERROR("getline from clmask","csm" );
+   swap_ptr= clmaskb; clmaskb= clmaskb_nxt; clmaskb_nxt= swap_ptr;
+   swap_ptr= clmask;  clmask=  clmask_nxt;  clmask_nxt=  swap_ptr;
 
    p= (iy+1)%3;
    if ( (iy+1)<nls )
-     if ( !get_line( &clmaskb2_File, (unsigned char*)&clmaskb2[p*nps], iy+1 ) )
-      ERROR("getline from clmaskb2","csm" );
-
+     {
+     if ( !get_line( &clmaskb_File,  (unsigned char*)clmaskb_nxt,  iy+1 ) )
+      ERROR("getline from clmaskb","csm" );
+     if ( !get_line( &clmask_File,   (unsigned char*)clmask_nxt,   iy+1 ) )
+      ERROR("getline from clmask","csm" );
+     for ( ix=0; ix<nps; ix++)
+       {
+       clmaskb2[p*nps+ix]= 
+         ( clmaskb_nxt[ix] == b255 || clmaskb_nxt[ix]== b254 ) ? b1 : b0;
+       if ( clmask_nxt[ix] == CLSTAT_S ) clmaskb2[p*nps+ix]+= 16;
+       if ( clmaskb2[p*nps+ix]==b1 ) precloudvalues++;
+       }
+     }
    clmaskb2p= &clmaskb2[p*nps];
    clmaskb2m= &clmaskb2[((p+1)%3)*nps];
    clmaskb2c= &clmaskb2[((p+2)%3)*nps];
@@ -1433,11 +1445,10 @@ bool CloudMask(
    if ( param->sieve_thresh>0 || param->apply_kernel>0 )
      memcpy(&imask_img[nps*iy],clmask,nps);
 
-   if ( !put_line(&clmaskb_File, (char*)clmaskb, iy ) )
-     ERROR("putline clmaskb file","csm" );
-
-   if ( !put_line(&clmask_File, (char*)clmask, iy ) )
-     ERROR("putline clmask file","csm" );
+   /* without the kernel the filtered (unsieved) mask is the final mask */
+   if ( param->apply_kernel<=0 )
+     if (!PutOutputLine(output, CLMASK, iy, clmask))
+       ERROR("writing output data for a line (CLMASK)", "csm");
 
    if ( ( iy==0 || iy ==(nls-1) || iy%100==0 ) && odometer_flag )
       {
@@ -1446,6 +1457,7 @@ bool CloudMask(
       }
    }
  if ( odometer_flag )printf("\n");
+ sprintf(pb,"cloudvalues prior to final filter=%d ",precloudvalues); pr(pst); 
  
 /*--------------------------------------------------------------------------!*/
 /*-                                sieve filter                            -!*/
@@ -1479,72 +1491,42 @@ bool CloudMask(
 
  if ( param->apply_kernel>0 )
    {
+   /* applying the ksize x ksize kernel N times is the same as dilating
+      once by a kernel N times as large */
    ksize= param->ksize;
-   for (ik=0; ik<param->apply_kernel; ik++ )
-     {
-     for (iy=0; iy<nls; iy++ )
-       {
-       for ( ix=0; ix<nps; ix++)
-         {
-         oval= imask_img[iy*nps+ix];
-         for (yy=0; yy<ksize; yy++)
-           {
-           yyy= iy-(ksize/2)+yy;
-           for (xx=0; xx<ksize; xx++)
-             {
-             xxx= ix-(ksize/2)+xx;
-             if ( xxx>=0 && xxx<nps && yyy>=0 && yyy<nls )
-               {
-               ival= imask_img[yyy*nps+xxx];
-               if ( ival == CLSTAT_C )oval= CLSTAT_C;
-               }
-             }
-           }
-         omask_img[iy*nps+ix]= oval;
-         }
-       }
-     if ( ik < (param->apply_kernel-1) )
-       {
-       imask_img= & bmask_img[ ((bufptr++)%2)*nps*nls ];
-       omask_img= & bmask_img[ ((bufptr  )%2)*nps*nls ]; 
-       }
-    else
-       {
-       sprintf(pb,"last ik=%d",ik); pr(pst); 
-       }
-     }
+   kbefore= param->apply_kernel*(ksize/2);
+   kafter=  param->apply_kernel*(ksize-1-ksize/2);
+   kmask= morph_alloc( nls, nps );
+   if ( !kmask )ERROR("allocate kernel bit mask failed ","csm"); 
+   for (iy=0; iy<nls; iy++ )
+     morph_set_line_value( kmask, iy, &imask_img[iy*nps], CLSTAT_C );
+   if ( morph_dilate( kmask, kbefore, kafter, kbefore, kafter ) )
+     ERROR("dilating kernel bit mask failed ","csm"); 
+   sprintf(pb,"kernel dilation %d x %d",kbefore+kafter+1,kbefore+kafter+1); pr(pst); 
 /*--------------------------------------------------------------------------!*/
-/*-                               write mask                               -!*/
+/*-                         expand and write final mask                    -!*/
 /*--------------------------------------------------------------------------!*/
-     for (iy=0; iy<nls; iy++ )
+   for (iy=0; iy<nls; iy++ )
+     {
+     for ( ix=0; ix<nps; ix++)
        {
-       if ( !put_line(&clmask_File, (char*)&omask_img[iy*nps], iy ) )
-         ERROR("putline clmask file","csm" );
-
-       if ( ( iy==0 || iy ==(nls-1) || iy%100==0 ) && odometer_flag )
-          {
-          printf("--- expand with kernel, line %d of %d --- \r",iy,nls-1);
-          fflush(stdout); 
-          }
+       if ( morph_test( kmask, iy, ix ) )
+         omask_img[iy*nps+ix]= CLSTAT_C;
+       else
+         omask_img[iy*nps+ix]= imask_img[iy*nps+ix];
        }
-     if ( odometer_flag )printf("\n");
-   }
-/*--------------------------------------------------------------------------!*/
-/*-                            write final mask                            -!*/
-/*--------------------------------------------------------------------------!*/
- for (iy=0; iy<nls; iy++ )
-   {
-   if ( !get_line( &clmask_File, (unsigned char*)clmask, iy ) )
-    ERROR("getline from clmask","csm" );
-    if (!PutOutputLine(output, CLMASK, iy, clmask))
-      ERROR("writing output data for a line (CLMASK)", "csm");
-   if ( ( iy==0 || iy ==(nls-1) || iy%100==0 ) && odometer_flag )
-      {
-      printf("--- write final mask, line %d of %d --- \r",iy,nls-1);
-      fflush(stdout); 
-      }
+     if (!PutOutputLine(output, CLMASK, iy, &omask_img[iy*nps]))
+       ERROR("writing output data for a line (CLMASK)", "csm");
+
+     if ( ( iy==0 || iy ==(nls-1) || iy%100==0 ) && odometer_flag )
+        {
+        printf("--- expand with kernel, line %d of %d --- \r",iy,nls-1);
+        fflush(stdout); 
+        }
+     }
+   if ( odometer_flag )printf("\n");
+   morph_free( kmask );
    }
- if ( odometer_flag )printf("\n");
 
 
 /*--------------------------------------------------------------------------!*/
@@ -1570,7 +1552,6 @@ bool CloudMask(
 /*--------------------------------------------------------------------------!*/
  img_close_rm( &b6tempeture_File );
  img_close_rm( &clmaskb_File   );
- img_close_rm( &clmaskb2_File  );
  img_close_rm( &clmask_File    );
 /*--------------------------------------------------------------------------!*/
 /*-                         close virutal buffers                          -!*/
@@ -1588,6 +1569,8 @@ bool CloudMask(
  free( clmaski2  );
  free( clmaskb   );
  free( clmaskb2  );
+ free( clmask_nxt );
+ free( clmaskb_nxt);
  free( ib2buf    );
  free( ib3buf    );
  free( ib4buf    );
@@ -1599,14 +1582,47 @@ bool CloudMask(
 /*--------------------------------------------------------------------------!*/
 /*--------------------------------------------------------------------------!*/
 /*-                                                                        -!*/
-/*-                          histogram function                            -!*/
+/*-                      histogram and moment function                     -!*/
 /*-                                                                        -!*/
 /*--------------------------------------------------------------------------!*/
 /*--------------------------------------------------------------------------!*/
-void histo( vbuf_t* vb, int num, int* outhist, const int HMIN, const int HMAX, 
-            float* omin, float* omax ) 
+void histo_moment( vbuf_t* vb, int num, int* outhist, const int HMIN, 
+            const int HMAX, float* omin, float* omax, float* output, 
+            float* mean_std ) 
 {
 int i,j,num_above,num_below;
+double  n
+      , mean
+      , delta
+      , delta_n
+      , term
+      , m2
+      , m3
+      , m4
+      , variance
+      , stdv
+      , sumadif;
+/*--------------------------------------------------------------------------!*/
+/*                                                                         -!*/
+/*  the purpose of this routine is to histogram the values and to compute  -!*/
+/*  some statistics, in two passes through the values                      -!*/
+/*  the histogram is in outhist, its extent in omin and omax               -!*/
+/*  the statistics are in the array output                                 -!*/
+/*  the contents are as follows:                                           -!*/
+/*  output(1)= mean                                                        -!*/
+/*  output(2)= variance                                                    -!*/
+/*  output(3)= skewness                                                    -!*/
+/*  output(4)= kurtosis                                                    -!*/
+/*  output(5)= mean absolute deviation                                     -!*/
+/*  output(6)= standard deviation                                          -!*/
+/*  and mean_std holds the mean and the (unclamped) standard deviation     -!*/
+/*                                                                         -!*/
+/*  the central moments are updated for each value (Welford, Terriberry)   -!*/
+/*  along with the histogram, instead of being summed in separate passes.  -!*/
+/*  The mean absolute deviation needs the final mean, so it is summed in   -!*/
+/*  a second pass over the values (in memory or mapped).                   -!*/
+/*                                                                         -!*/
+/*--------------------------------------------------------------------------!*/
 /*--------------------------------------------------------------------------!*/
 /*                                initalize                                -!*/
 /*--------------------------------------------------------------------------!*/
@@ -1616,13 +1632,21 @@ int i,j,num_above,num_below;
       *omin= 1024;
       *omax=-1024;
 
-      for (i=0; i<1024; i++)outhist[i]= 0;
+      for (i=0; i<1024; i++)
+        {
+        outhist[i]= 0;
+        }
+      n=    0.0;
+      mean= 0.0;
+      m2=   0.0;
+      m3=   0.0;
+      m4=   0.0;
 /*--------------------------------------------------------------------------!*/
-/*                             fill histogram                              -!*/
+/*                   fill histogram and update the moments                 -!*/
 /*--------------------------------------------------------------------------!*/
       for (i=0; i<num; i++)
         {
-        float data= virget( vb,i );
+        float data= vb->buffer[i];
         j= (int)data ;
         if ( j == 0 )
             j= HMIN;
@@ -1641,6 +1665,16 @@ int i,j,num_above,num_below;
          outhist[ j-1 ]= outhist[ j-1 ] + 1;
          if ( data < *omin )*omin= data;
          if ( data > *omax )*omax= data;
+
+         n= n + 1.0;
+         delta= (double)data - mean;
+         delta_n= delta / n;
+         term= delta * delta_n * ( n - 1.0 );
+         mean= mean + delta_n;
+         m4= m4 + term * delta_n * delta_n * ( n * n - 3.0 * n + 3.0 )
+                + 6.0 * delta_n * delta_n * m2 - 4.0 * delta_n * m3;
+         m3= m3 + term * delta_n * ( n - 2.0 ) - 3.0 * delta_n * m2;
+         m2= m2 + term;
         }
 /*--------------------------------------------------------------------------!*/
 /*                    check for histogram extent error                     -!*/
@@ -1659,84 +1693,23 @@ int i,j,num_above,num_below;
         {
         cenb(pst," histogram limit error"); 
         }
-}
-/*--------------------------------------------------------------------------!*/
-/*--------------------------------------------------------------------------!*/
-/*-                                                                        -!*/
-/*-                            moment function                             -!*/
-/*-                                                                        -!*/
 /*--------------------------------------------------------------------------!*/
+/*                             statistics                                  -!*/
 /*--------------------------------------------------------------------------!*/
-void moment( vbuf_t* vb, const int num, float* output ) 
-{
-int  i;
-double  mean
-      , variance
-      , skewness
-      , kurtosis
-      , meanabsdev
-      , stdv
-      , sum    
-      , sumsq  
-      , sumdsq 
-      , sumadif
-      , sumskew
-      , sumkert;
-/*--------------------------------------------------------------------------!*/
-/*                                                                         -!*/
-/*  the purpose of this routine is to compute some statistics              -!*/
-/*  the output is in the array output                                      -!*/
-/*  the contents are as follows:                                           -!*/
-/*  output(1)= mean                                                        -!*/
-/*  output(2)= variance                                                    -!*/
-/*  output(3)= skewness                                                    -!*/
-/*  output(4)= kurtosis                                                    -!*/
-/*  output(5)= mean absolute deviation                                     -!*/
-/*  output(5)= standard deviation                                          -!*/
-/*  warning elimination                                                    -!*/
-/*                                                                         -!*/
-/*--------------------------------------------------------------------------!*/
- sum=     0.0;
- sumsq=   0.0;
- sumdsq=  0.0;
- sumadif= 0.0;
- sumskew= 0.0;
- sumkert= 0.0;
-
-
- for (i=0; i<num; i++)
-   {
-   double data= (double)virget( vb,i );
-   sum= sum + data;
-   sumsq= sumsq + ( data * data );
-   }
- mean= sum/ (double)num;
-
- for (i=0; i<num; i++)
-   {
-   double data= (double)virget( vb,i );
-   sumdsq= sumdsq + pow( data - mean,2);
-   sumadif= sumadif + fabs( data - mean );
-   }
-
- variance= sumdsq / (float)max(num-1,1);
- stdv= max( sqrt( variance ) , 0.01 );
- meanabsdev= sumadif/(float)num;
+      sumadif= 0.0;
+      for (i=0; i<num; i++)
+        sumadif= sumadif + fabs( (double)vb->buffer[i] - mean );
 
- for (i=0; i<num; i++)
-   {
-   double data= (double)virget( vb,i );
-   sumskew= sumskew + pow( ( data - mean )/stdv ,3);
-   sumkert= sumkert + pow( ( data - mean )/stdv ,4);
-   }
+      variance= m2 / (float)max(num-1,1);
+      stdv= max( sqrt( variance ) , 0.01 );
 
- skewness= sumskew / (double)num;
- kurtosis= sumkert / (double)num;
+      output[1-1]= (double)mean;
+      output[2-1]= (double)variance;
+      output[3-1]= (double)( m3 / (double)num / pow( stdv, 3 ) );
+      output[4-1]= (double)( m4 / (double)num / pow( stdv, 4 ) );
+      output[5-1]= (double)( sumadif / (float)num );
+      output[6-1]= (double)stdv;
 
- output[1-1]= (double)mean;
- output[2-1]= (double)variance;
- output[3-1]= (double)skewness;
- output[4-1]= (double)kurtosis;
- output[5-1]= (double)meanabsdev;
- output[6-1]= (double)stdv;
+      mean_std[0]= (float)mean;
+      mean_std[1]= (float)sqrt( m2 / (double)(num-1) );
 }
@@ -19,10 +19,9 @@ bool CloudMask(
              ,  int odometer_flag
                 );
 /*****************************************************************************/
-void moment( vbuf_t* vb,       const int num, float* output );
-void histo( vbuf_t* vb, int num, int* outhist, const int hmin, const int hmax, 
-            float* omin, float* omax ) ;
-void compute_std(vbuf_t* vb, const int num, float* mean_std);
+void histo_moment( vbuf_t* vb, int num, int* outhist, const int hmin, 
+            const int hmax, float* omin, float* omax, float* output, 
+            float* mean_std );
 /*****************************************************************************/
 #endif
 /*****************************************************************************/
@@ -31,6 +31,10 @@
  Gail Schmidt, USGS EROS
  Modified application to utilize only one version number - LEDAPSVersion
 
+ Revision 1.6 2015/11/18
+ Added the optional MEM_BUDGET parameter to hold the intermediate images
+ in memory.
+
 !Team Unique Header:
   This software was developed by the MODIS Land Science Team Support 
   Group for the Laboratory for Terrestrial Physics (Code 922) at the 
@@ -88,6 +92,7 @@ typedef enum {
   PARAM_CSM_FILE,
   PARAM_CSM_FILTER,
   PARAM_LEDAPSVERSION,
+  PARAM_MEM_BUDGET,
   PARAM_END,
   PARAM_MAX
 } Param_key_t;
@@ -99,6 +104,7 @@ Key_string_t Param_string[PARAM_MAX] = {
   {(int)PARAM_CSM_FILE,  "CSM_FILE"},
   {(int)PARAM_CSM_FILTER,"CSM_FILTER"},
   {(int)PARAM_LEDAPSVERSION,  "LEDAPSVersion"},
+  {(int)PARAM_MEM_BUDGET,"MEM_BUDGET"},
   {(int)PARAM_END,       "END"}
 };
 
@@ -198,6 +204,7 @@ Param_t *GetParam(int argc, const char **argv)
   this->apply_kernel =  0;
   this->ksize =         0;
   this->sieve_thresh =  0;
+  this->mem_budget =    0;
 
   /* Populate the data structure */
 
@@ -372,6 +379,22 @@ Param_t *GetParam(int argc, const char **argv)
         }
         break;
 
+      case PARAM_MEM_BUDGET:
+        if (key.nval <= 0) {
+          error_string = "no memory budget";
+          break;
+        } else if (key.nval > 1) {
+          error_string = "too many memory budget values";
+          break;
+        }
+        key.value[0][key.len_value[0]] = '\0';
+        if (sscanf(key.value[0], "%d", &this->mem_budget) != 1 ||
+            this->mem_budget < 0) {
+          error_string = "invalid memory budget";
+          break;
+        }
+        break;
+
       case PARAM_END:
         if (key.nval != 0) {
 	  error_string = "no value expected (end key)";
@@ -72,6 +72,8 @@ typedef struct {
   int apply_kernel;              /* apply kernel N times               */
   int ksize;                     /* kernel size                        */
   int sieve_thresh;              /* sieve threshold size               */
+  int mem_budget;                /* memory budget (MB) of the temporary
+                                    images, 0 for no budget            */
   bool therm_flag;
 } Param_t;
 
@@ -269,6 +269,7 @@ bool img_openw( imgfile_t* iFile, const char* fname,
 {
   char hdr[512];
   int io_size;
+  iFile->mem= NULL;
   iFile->fp= open( fname, (O_CREAT|O_RDWR), (S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP) );
   if ( iFile->fp==-1 )
     { 
@@ -291,11 +292,30 @@ bool img_openw( imgfile_t* iFile, const char* fname,
  strcpy(iFile->fname,fname);
  return true;
 }
+/* open a scratch image held in memory; returns false (without reporting an
+   error) if it can not be allocated so the caller can fall back to a file */
+bool img_openm( imgfile_t* iFile, const char* fname, 
+               const int np, const int nl, const int nb, const int ps )
+{
+  iFile->mem= (unsigned char*)calloc( (size_t)np*nl*nb*ps, 1 );
+  if ( iFile->mem==NULL )return false;
+  iFile->fp= -1;
+  iFile->np= np;
+  iFile->nl= nl;
+  iFile->nb= nb;
+  iFile->ps= ps;
+  iFile->tiff_flag= 0;
+  iFile->sz= np*nl*nb*ps;
+ iFile->fname= (char*)malloc( strlen(fname)+1 );
+ strcpy(iFile->fname,fname);
+ return true;
+}
 bool img_openr( imgfile_t* iFile, const char* fname )
 {
   int n_read;
   char buf[512];
  
+  iFile->mem= NULL;
   iFile->fp= open( fname, O_RDONLY );
   if ( iFile->fp==-1 )
     {
@@ -317,12 +337,18 @@ bool img_openr( imgfile_t* iFile, const char* fname )
 bool img_close( imgfile_t* iFile )
 {
   free( iFile->fname );
+  if ( iFile->mem!=NULL )
+    {
+    free( iFile->mem );
+    iFile->mem= NULL;
+    return true;
+    }
   close( iFile->fp );
   return true;
 }
 bool img_close_rm( imgfile_t* iFile )
 {
-  remove( iFile->fname );
+  if ( iFile->mem==NULL )remove( iFile->fname );
   img_close( iFile );
   return true;
 }
@@ -332,6 +358,11 @@ int stat=0;
 int np= iFile->np;
 int ps= iFile->ps;
 int nb= iFile->nb;
+if ( iFile->mem!=NULL )
+  {
+  memcpy(&iFile->mem[(size_t)line*np*ps*nb], buf, np*ps*nb);
+  return true;
+  }
 stat=lseek(iFile->fp, 512*iFile->tiff_flag + line*np*ps*nb, SEEK_SET );
 if ( stat==-1 )
   {
@@ -353,6 +384,11 @@ int stat=0;
 int np= iFile->np;
 int ps= iFile->ps;
 int nb= iFile->nb;
+if ( iFile->mem!=NULL )
+ {
+ memcpy(buf, &iFile->mem[(size_t)line*np*ps*nb], np*ps*nb);
+ return true;
+ }
 stat=lseek(iFile->fp, 512*iFile->tiff_flag + line*np*ps*nb, SEEK_SET );
 if ( stat==-1 )
  {
@@ -48,23 +48,6 @@ while ( token!=(char*)NULL && itok<3 )
 return sign*answer;
 }
 
-void compute_std(vbuf_t* vb, const int num, float* mean_std)
-{
-int i;
-double data;
-double sum=0.0;
-double sumsq=0.0;
-for (i=0; i<num; i++)
-  {
-  data= (double)virget( vb,i );
-  sum    += data;
-  sumsq  += data*data;
-  }
-mean_std[0]= (float)(sum/(double)num);
-mean_std[1]= (float)(sqrt((sumsq- sum*sum/(double)num)/(double)(num-1)));
-}
-
-
 Pbuf_t *InitPr(FILE* mfout, char* buf, int wid, const char edge)
 {
   Pbuf_t *xthis;
@@ -26,7 +26,6 @@ char* format_deg2dms(const double deg, char* dms, const char delim_in);
 char* deg2dms(const double deg, char* dms);
 char* deg2dms0(const double deg, char* dms);
 double dms2deg(const char* dms);
-void compute_std(vbuf_t* vb, const int num, float* mean_std);
 void printit(FILE* mfout, char* buf,int wid, char edge);
 void center(FILE* mfout, char* buf,int wid, char edge);
 typedef struct {
@@ -2,90 +2,137 @@
 #include <string.h>     /* for strlen       */
 #include <math.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <ctype.h> 
 #include <time.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include "virbuf.h"
 char msgbuf[1024];
+/*
+ The values are kept in a growable memory arena; once the arena would grow
+ over VIR_MEM_BUDGET bytes, it is moved to a file which is memory mapped, so
+ the buffer is always one contiguous array of values (virbuf->buffer).
+*/
 bool virinit( vbuf_t* virbuf, char* fname, const int blocking )
 {
-virbuf->file= open(fname,(O_CREAT|O_RDWR),(S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP));
-if ( virbuf->file==-1 )
-  { 
-  sprintf(msgbuf,"*** error opening file \"%s\"",fname); 
-  RETURN_ERROR(msgbuf,"virnit", false);
-  }
 virbuf->size=0;
-virbuf->current_line=0;
+virbuf->capacity=0;
 virbuf->blocking= blocking;
-virbuf->buffer = (float*)malloc ( blocking* sizeof(float) );
+virbuf->file= -1;
+virbuf->buffer= NULL;
 virbuf->fname = (char*)malloc ( (strlen(fname)+1)* sizeof(char) );
+if ( virbuf->fname==NULL )
+  RETURN_ERROR("allocating file name","virinit", false);
 strcpy(virbuf->fname,fname);
 return true;
 }
 bool virclose( vbuf_t* virbuf )
 {
+if ( virbuf->file==-1 )
+  free( virbuf->buffer );
+ else
+  {
+  munmap( virbuf->buffer, (size_t)virbuf->capacity*sizeof(float) );
+  close( virbuf->file );
+  remove( virbuf->fname );
+  }
 virbuf->size=0;
-virbuf->current_line=0;
-close( virbuf->file );
-free( virbuf->buffer );
-remove( virbuf->fname );
+virbuf->capacity=0;
+virbuf->file= -1;
+virbuf->buffer= NULL;
 free( virbuf->fname );
 return true;
 }
 bool vir_reinit( vbuf_t* virbuf )
 {
-int seek_status, seek_addr;
 virbuf->size=0;
-virbuf->current_line=0;
-seek_addr= virbuf->blocking * virbuf->current_line * sizeof(float) ;
-seek_status= lseek(virbuf->file, seek_addr, SEEK_SET );
-if (seek_status == -1)
-    return false;
 return true;
 }
-bool virput( vbuf_t* virbuf, float value )
+static bool virgrow( vbuf_t* virbuf )
 {
-virbuf->buffer[ virbuf->size ]= value;
-virbuf->size++;
-if ( virbuf->size == virbuf->blocking )
+int capacity;
+size_t nbytes;
+float* buffer;
+
+/* the values are indexed with an int, so the capacity is capped at INT_MAX */
+if ( virbuf->capacity==INT_MAX )
+  RETURN_ERROR("buffer is full","virgrow", false);
+capacity= ( virbuf->capacity > INT_MAX/2 ) ? INT_MAX : virbuf->capacity*2;
+if ( capacity < virbuf->blocking )
+  capacity= virbuf->blocking;
+nbytes= (size_t)capacity*sizeof(float);
+/*--------------------------------------------------------------------------!*/
+/*-                         grow the memory arena                          -!*/
+/*--------------------------------------------------------------------------!*/
+if ( virbuf->file==-1 && nbytes <= VIR_MEM_BUDGET )
   {
-  write(virbuf->file, (char*)virbuf->buffer, virbuf->blocking*sizeof(float) );
+  buffer= (float*)realloc( virbuf->buffer, nbytes );
+  if ( buffer==NULL )
+    RETURN_ERROR("growing the buffer","virgrow", false);
+  virbuf->buffer= buffer;
+  virbuf->capacity= capacity;
+  return true;
+  }
+/*--------------------------------------------------------------------------!*/
+/*-        grow the file and map it again, moving the arena to it          -!*/
+/*--------------------------------------------------------------------------!*/
+if ( virbuf->file==-1 )
+  {
+  virbuf->file= open(virbuf->fname,(O_CREAT|O_TRUNC|O_RDWR),
+    (S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP));
   if ( virbuf->file==-1 )
     { 
+    sprintf(msgbuf,"*** error opening file \"%s\"",virbuf->fname); 
+    RETURN_ERROR(msgbuf,"virgrow", false);
+    }
+  if ( write(virbuf->file, (char*)virbuf->buffer,
+       (size_t)virbuf->size*sizeof(float) ) != 
+       (ssize_t)((size_t)virbuf->size*sizeof(float)) )
+    { 
     sprintf(msgbuf,"*** error writing to file \"%s\"",virbuf->fname); 
-    RETURN_ERROR(msgbuf,"virput", false);
+    RETURN_ERROR(msgbuf,"virgrow", false);
     }
-  virbuf->current_line++;
-  virbuf->size=0;
+  free( virbuf->buffer );
   }
+ else
+  munmap( virbuf->buffer, (size_t)virbuf->capacity*sizeof(float) );
+virbuf->buffer= NULL;
+
+if ( ftruncate( virbuf->file, (off_t)nbytes )==-1 )
+  { 
+  sprintf(msgbuf,"*** error growing file \"%s\"",virbuf->fname); 
+  RETURN_ERROR(msgbuf,"virgrow", false);
+  }
+buffer= (float*)mmap( NULL, nbytes, (PROT_READ|PROT_WRITE), MAP_SHARED,
+  virbuf->file, 0 );
+if ( buffer==MAP_FAILED )
+  { 
+  sprintf(msgbuf,"*** error mapping file \"%s\"",virbuf->fname); 
+  RETURN_ERROR(msgbuf,"virgrow", false);
+  }
+virbuf->buffer= buffer;
+virbuf->capacity= capacity;
+return true;
+}
+bool virput( vbuf_t* virbuf, float value )
+{
+if ( virbuf->size == virbuf->capacity )
+  if ( !virgrow( virbuf ) )
+    RETURN_ERROR("growing the buffer","virput", false);
+virbuf->buffer[ virbuf->size ]= value;
+virbuf->size++;
 return true;
 }
 bool virflush( vbuf_t* virbuf )
 {
-write(virbuf->file, (char*)virbuf->buffer,virbuf->blocking*sizeof(float) ); 
+/* nothing to write; the values are in memory or in the mapped file */
 return true;
 }
 float virget( vbuf_t* virbuf, int index )
 {
-int line= index/virbuf->blocking;
-if ( line != virbuf->current_line )
-  {
-  int seek_status,seek_addr,n_read;
-  virbuf->current_line= line;
-  seek_addr= virbuf->blocking * virbuf->current_line * sizeof(float) ;
-  seek_status= lseek(virbuf->file, seek_addr, SEEK_SET );
-  if (seek_status == -1)
-      return false;
-  n_read=read(virbuf->file,(char*)virbuf->buffer,virbuf->blocking*sizeof(float));
-  if ((virbuf->file==-1) || (n_read != virbuf->blocking * sizeof(float)))
-    { 
-    sprintf(msgbuf,"*** error reading  file \"%s\"",virbuf->fname); 
-    RETURN_ERROR(msgbuf,"virget", false);
-    }
-  }
-return virbuf->buffer[ index%virbuf->blocking ];
+return virbuf->buffer[ index ];
 }
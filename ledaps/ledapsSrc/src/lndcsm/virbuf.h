@@ -1,17 +1,21 @@
 #ifndef VIRB_HPP
 #define VIRB_HPP
+#include <stddef.h>
 #include "bool.h"
 #include "error.h"
+/* Size (bytes) over which a virtual buffer is moved from memory to a memory
+   mapped file */
+#ifndef VIR_MEM_BUDGET
+#define VIR_MEM_BUDGET (256*1024*1024)
+#endif
 typedef struct 
 {
-int size;
-int all;
-int blocking;
-int current_line;
-int file;
-float* buffer;
-float* data_buffer;
-char* fname;
+int size;          /* number of values put                                   */
+int capacity;      /* number of values the buffer can hold                   */
+int blocking;      /* minimum growth of the buffer (values)                  */
+int file;          /* backing file, -1 while the buffer is in memory         */
+float* buffer;     /* the values, in memory or mapped from the file          */
+char* fname;       /* name of the backing file                               */
 } vbuf_t ;
 
 bool virinit( vbuf_t *virbuf, char* fname, const int blocking );
@@ -3,6 +3,7 @@
 #include "error.h"
 #include "sixs_runs.h"
 #include "clouds.h"
+#include "morph.h"
 
 /****************************************************************************
 History:
@@ -12,6 +13,10 @@ Modified on 2/5/2014 by Gail Schmidt, USGS/EROS
   The scaling factor of band 6 has changed from 0.01 to 0.1.
   Instead of dividing by 10000 and 10 for the scaling, modified to multiply
     by 0.0001 and 0.1.  Multiplication is faster.
+Modified on 11/17/2015
+  The cloud and cloud shadow dilations are done on bit masks with the
+    rectangle dilation of libmorph (../morph), instead of setting the
+    window around every cloud/shadow pixel.
 ****************************************************************************/
 
 
@@ -332,42 +337,38 @@ bit 4 = land/water mask 1=land 0=water
 bit 5 = cloud 0=clear 1=cloudy
 bit 6 = cloud shadow 
 bit 7 = snow
-**/
 
-	int il,is,il_adj,is_adj,buf_ind;
-	int k;
+The clouds of the current region (cloud_buf[1]) are dilated over the
+previous, current and next regions, stacked in one bit mask: a pixel is
+adjacent cloud if there is a cloud from dilate_dist-1 lines/samples before
+it to dilate_dist lines/samples after it.
+**/
 
-	for (il=0;il<lut->ar_region_size.l;il++) {
-		for (is=0;is<nsamp;is++) {
+	int il,is,buf_ind,nlines;
+	morph_mask_t *mask;
 
-			if (cloud_buf[1][il][is] & 0x20) { /* if cloudy dilate */
+	nlines=lut->ar_region_size.l;
+	if ((mask=morph_alloc(3*nlines,nsamp))==NULL)
+		return false;
+	for (il=0;il<nlines;il++)
+		morph_set_line(mask,nlines+il,(unsigned char *)cloud_buf[1][il],0x20);
+	if (morph_dilate(mask,dilate_dist-1,dilate_dist,dilate_dist-1,dilate_dist)) {
+		morph_free(mask);
+		return false;
+	}
 
-				for (k=(il-dilate_dist);k<(il+dilate_dist);k++) {
-					il_adj=k;
-					buf_ind=1;
-					if (k < 0) {
-						buf_ind--;
-						il_adj += lut->ar_region_size.l; 
-					}
-					if (k >= lut->ar_region_size.l) {
-						buf_ind++;
-						il_adj -= lut->ar_region_size.l; 
-					}
-					if ((il_adj>=0)&&(il_adj<lut->ar_region_size.l)) {
-						for (is_adj=(is-dilate_dist);is_adj<(is+dilate_dist);is_adj++) {
-							if ((is_adj>=0)&&(is_adj<nsamp)) {
-								if (!(cloud_buf[buf_ind][il_adj][is_adj] & 0x20)) { /* if not cloudy */
-									cloud_buf[buf_ind][il_adj][is_adj] &= 0xfb; /* reset adjacent cloud bit */
-									cloud_buf[buf_ind][il_adj][is_adj] &= 0xbf; /* reset shadow bit */
-									cloud_buf[buf_ind][il_adj][is_adj] |= 0x04; /* set adjacent cloud bit */
-								}
-							}
-						}
-					}
+	for (buf_ind=0;buf_ind<3;buf_ind++) {
+		for (il=0;il<nlines;il++) {
+			for (is=0;is<nsamp;is++) {
+				if (morph_test(mask,buf_ind*nlines+il,is) &&
+				    !(cloud_buf[buf_ind][il][is] & 0x20)) { /* if not cloudy */
+					cloud_buf[buf_ind][il][is] &= 0xbf; /* reset shadow bit */
+					cloud_buf[buf_ind][il][is] |= 0x04; /* set adjacent cloud bit */
 				}
-			} /* if cloudy */
+			}
 		}
 	}
+	morph_free(mask);
 	return true;
 }
 
@@ -463,44 +464,35 @@ bit 4 = land/water mask 1=land 0=water
 bit 5 = cloud 0=clear 1=cloudy
 bit 6 = cloud shadow 
 bit 7 = snow
+
+The cloud shadows of the previous region (cloud_buf[0]) are dilated by
+dilate_dist lines/samples over the previous and current regions, stacked in
+one bit mask.
 **/
 
-	int il,is,il_adj,is_adj,buf_ind;
-	int k;
-	char *fill_mask;
+	int il,is,buf_ind,nlines;
+	morph_mask_t *mask;
 
-	if ((fill_mask=(char *)calloc(lut->ar_region_size.l*nsamp,sizeof(char)))==NULL)
+	nlines=lut->ar_region_size.l;
+	if ((mask=morph_alloc(2*nlines,nsamp))==NULL)
+		return false;
+	for (il=0;il<nlines;il++)
+		morph_set_line(mask,il,(unsigned char *)cloud_buf[0][il],0x40);
+	if (morph_dilate(mask,dilate_dist,dilate_dist,dilate_dist,dilate_dist)) {
+		morph_free(mask);
 		return false;
-	for (il=0;il<lut->ar_region_size.l;il++) {
-		for (is=0;is<nsamp;is++) {
-			if ((cloud_buf[0][il][is] & 0x40)&&(!fill_mask[il*nsamp+is])) { /* if cloud shadow dilate */
-				for (k=(il-dilate_dist);k<=(il+dilate_dist);k++) {
-					il_adj=k;
-					buf_ind=0;
-					if (k >= lut->ar_region_size.l) {
-						buf_ind++;
-						il_adj -= lut->ar_region_size.l; 
-					}
-					if (k>=0) {
-						if ((il_adj>=0)&&(il_adj<lut->ar_region_size.l)) {
-							for (is_adj=(is-dilate_dist);is_adj<=(is+dilate_dist);is_adj++) {
-								if ((is_adj>=0)&&(is_adj<nsamp)) {
-									if (!((cloud_buf[buf_ind][il_adj][is_adj] & 0x20)||
-									  	(cloud_buf[buf_ind][il_adj][is_adj] & 0x04)||
-									  	(cloud_buf[buf_ind][il_adj][is_adj] & 0x40))) { /* if not cloud, adjacent cloud or cloud shadow */
-										cloud_buf[buf_ind][il_adj][is_adj] |= 0x40; /* set adjacent cloud shadow bit */
-										fill_mask[il_adj*nsamp+is_adj]=1;
-									}
-								}
-							}
-						}
-					}
-				}
-			} /* if cloud shadow */
-		}
 	}
-	free(fill_mask);
 
+	for (buf_ind=0;buf_ind<2;buf_ind++) {
+		for (il=0;il<nlines;il++) {
+			for (is=0;is<nsamp;is++) {
+				if (morph_test(mask,buf_ind*nlines+il,is) &&
+				    !(cloud_buf[buf_ind][il][is] & 0x64)) /* if not cloud, adjacent cloud or cloud shadow */
+					cloud_buf[buf_ind][il][is] |= 0x40; /* set adjacent cloud shadow bit */
+			}
+		}
+	}
+	morph_free(mask);
 
 	return true;
 }
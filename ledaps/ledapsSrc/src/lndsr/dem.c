@@ -0,0 +1,261 @@
+/*
+!C****************************************************************************
+
+!File: dem.c
+
+!Description: Functions reading the window of the CMG DEM covering the scene,
+ or mapping a raw copy of the whole DEM, and looking up the surface pressure
+ from it.
+
+!Revision History:
+ Revision 1.0 2015/11/20
+ Original Version.
+
+!Design Notes:
+   1. Only the DEM rows/columns covering the scene plus DEM_MARGIN degrees
+      are read from the HDF DEM; a scene across the dateline (or over a
+      pole) gets all the columns.
+   2. With a raw DEM file (DEM_RAW_FILE), the whole DEM is mapped read-only
+      and shared by concurrent runs.  The raw DEM is created from the HDF
+      DEM if it doesn't exist, through a temporary file renamed at the end.
+
+!END****************************************************************************
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "myhdf.h"
+#include "dem.h"
+#include "const.h"
+
+/* map the raw DEM (DEM_NBLAT x DEM_NBLON shorts) read-only and shared, so
+   that concurrent runs share its pages; NULL if it can't be mapped */
+static dem_t *map_raw_dem(char *raw_file) {
+	dem_t *dem;
+	struct stat st;
+	size_t len=(size_t)DEM_NBLAT*DEM_NBLON*sizeof(short);
+	void *map;
+	int fd;
+
+	if ((fd=open(raw_file,O_RDONLY))<0)
+		return NULL;
+	if (fstat(fd,&st)||((size_t)st.st_size!=len)) {
+		fprintf(stderr,"WARNING: unexpected size of raw DEM %s\n",raw_file);
+		close(fd);
+		return NULL;
+	}
+	map=mmap(NULL,len,PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+	if (map==MAP_FAILED)
+		return NULL;
+	if ((dem=(dem_t *)malloc(sizeof(dem_t)))==NULL) {
+		munmap(map,len);
+		return NULL;
+	}
+	dem->data=(short *)map;
+	dem->row0=0;
+	dem->col0=0;
+	dem->nrows=DEM_NBLAT;
+	dem->ncols=DEM_NBLON;
+	dem->map=map;
+	dem->map_len=len;
+	return dem;
+}
+
+/* save the whole DEM as a raw DEM for the next runs; written to a temporary
+   file renamed at the end, so that concurrent runs never map a partial
+   file.  A failure is only reported. */
+static void save_raw_dem(char *raw_file, dem_t *dem) {
+	FILE *fd;
+	char tmpname[1024];
+	size_t n=(size_t)DEM_NBLAT*DEM_NBLON,nw;
+
+	snprintf(tmpname,sizeof(tmpname),"%s.%d",raw_file,(int)getpid());
+	if ((fd=fopen(tmpname,"wb"))==NULL) {
+		fprintf(stderr,"WARNING: can't create raw DEM %s\n",raw_file);
+		return;
+	}
+	nw=fwrite(dem->data,sizeof(short),n,fd);
+	if (fclose(fd)||(nw!=n)||rename(tmpname,raw_file)) {
+		fprintf(stderr,"WARNING: can't create raw DEM %s\n",raw_file);
+		remove(tmpname);
+	}
+}
+
+/* DEM rows/columns covering the scene plus DEM_MARGIN degrees, from the
+   lat/long of points along the scene edges; the whole grid if they can't
+   all be mapped.  A scene across the dateline (or over a pole) gets all the
+   columns. */
+static void scene_window(Geoloc_t *space, int nl, int ns, int *row0,
+  int *col0, int *nrows, int *ncols) {
+	Img_coord_float_t img;
+	Geo_coord_t geo;
+	double lat,lon,latmin=90.,latmax=-90.,lonmin=180.,lonmax=-180.;
+	int i,k,row1,col1;
+
+	*row0=0;
+	*col0=0;
+	*nrows=DEM_NBLAT;
+	*ncols=DEM_NBLON;
+	img.is_fill=false;
+	for (k=0;k<4;k++)
+		for (i=0;i<=DEM_NB_EDGE_PTS;i++) {
+			if (k<2) {
+				img.l=(k==0)?0.:(double)(nl-1);
+				img.s=(double)i*(ns-1)/DEM_NB_EDGE_PTS;
+			} else {
+				img.l=(double)i*(nl-1)/DEM_NB_EDGE_PTS;
+				img.s=(k==2)?0.:(double)(ns-1);
+			}
+			if (!from_space(space,&img,&geo))
+				return;
+			lat=geo.lat*DEG;
+			lon=geo.lon*DEG;
+			if (lat<latmin) latmin=lat;
+			if (lat>latmax) latmax=lat;
+			if (lon<lonmin) lonmin=lon;
+			if (lon>lonmax) lonmax=lon;
+		}
+
+	*row0=(int)((DEM_LATMAX-(latmax+DEM_MARGIN))/DEM_DLAT+0.5);
+	if (*row0<0) *row0=0;
+	row1=(int)((DEM_LATMAX-(latmin-DEM_MARGIN))/DEM_DLAT+0.5);
+	if (row1>=DEM_NBLAT) row1=DEM_NBLAT-1;
+	*nrows=row1-*row0+1;
+	if (lonmax-lonmin>180.)
+		return;
+	*col0=(int)(((lonmin-DEM_MARGIN)-DEM_LONMIN)/DEM_DLON+0.5);
+	if (*col0<0) *col0=0;
+	col1=(int)(((lonmax+DEM_MARGIN)-DEM_LONMIN)/DEM_DLON+0.5);
+	if (col1>=DEM_NBLON) col1=DEM_NBLON-1;
+	*ncols=col1-*col0+1;
+}
+
+/* DEM for the scene: the raw DEM raw_file mapped if it is given and exists;
+   otherwise the scene window read from the HDF DEM dem_file (or the whole
+   DEM, saved as raw_file for the next runs, if raw_file is given) */
+dem_t *read_dem(char *dem_file, char *raw_file, Geoloc_t *space, int nl,
+  int ns) {
+	dem_t *dem;
+	int32 sds_file_id,sds_id,status;
+	char sds_name[256];
+	int32 dim_sizes[2],start[2],stride[2],edges[2];
+	int32 data_type,n_attrs,rank;
+
+	if ((raw_file!=NULL)&&((dem=map_raw_dem(raw_file))!=NULL)) {
+		printf("Mapped raw DEM %s\n",raw_file);
+		return dem;
+	}
+
+	if ((dem=(dem_t *)malloc(sizeof(dem_t)))==NULL) {
+		fprintf(stderr,"ERROR: allocating DEM\n");
+		return NULL;
+	}
+	dem->map=NULL;
+	dem->map_len=0;
+	if (raw_file!=NULL) {
+		dem->row0=0;
+		dem->col0=0;
+		dem->nrows=DEM_NBLAT;
+		dem->ncols=DEM_NBLON;
+	} else
+		scene_window(space,nl,ns,&dem->row0,&dem->col0,&dem->nrows,
+		  &dem->ncols);
+
+	sds_file_id=SDstart(dem_file,DFACC_RDONLY);
+	if (sds_file_id==HDF_ERROR) {
+		fprintf(stderr,"ERROR: opening DEM file %s\n",dem_file);
+		free(dem);
+		return NULL;
+	}
+	sds_id=SDselect(sds_file_id,0);
+	status=SDgetinfo(sds_id,sds_name,&rank,dim_sizes,&data_type,&n_attrs);
+	if ((status!=0)||(rank!=2)||(dim_sizes[0]!=DEM_NBLAT)||
+	  (dim_sizes[1]!=DEM_NBLON)) {
+		fprintf(stderr,"ERROR: unexpected DEM size in %s\n",dem_file);
+		SDendaccess(sds_id);
+		SDend(sds_file_id);
+		free(dem);
+		return NULL;
+	}
+	start[0]=dem->row0;
+	start[1]=dem->col0;
+	edges[0]=dem->nrows;
+	edges[1]=dem->ncols;
+	stride[0]=1;
+	stride[1]=1;
+	dem->data=(short *)malloc((size_t)dem->nrows*dem->ncols*sizeof(short));
+	if (dem->data==NULL) {
+		fprintf(stderr,"ERROR: allocating DEM\n");
+		SDendaccess(sds_id);
+		SDend(sds_file_id);
+		free(dem);
+		return NULL;
+	}
+	status=SDreaddata(sds_id,start,stride,edges,dem->data);
+	SDendaccess(sds_id);
+	SDend(sds_file_id);
+	if (status!=0) {
+		fprintf(stderr,"ERROR: reading DEM file %s\n",dem_file);
+		free_dem(dem);
+		return NULL;
+	}
+	printf("DEM window: rows %d-%d, columns %d-%d\n",dem->row0,
+	  dem->row0+dem->nrows-1,dem->col0,dem->col0+dem->ncols-1);
+
+	if (raw_file!=NULL)
+		save_raw_dem(raw_file,dem);
+	return dem;
+}
+
+float get_dem_spres(dem_t *dem, float lat, float lon) {
+	int idem,jdem;
+	float dem_spres;
+		
+	idem=(int)((DEM_LATMAX-lat)/DEM_DLAT+0.5);
+	if (idem<0)
+		idem=0;
+	if (idem >= DEM_NBLAT)
+		idem=DEM_NBLAT-1;
+	jdem=(int)((lon-DEM_LONMIN)/DEM_DLON+0.5);
+	if (jdem<0)
+		jdem=0;
+	if (jdem >= DEM_NBLON)
+		jdem=DEM_NBLON-1;
+
+	/* the window covers the scene with a margin, so this only guards
+	   against points outside of it */
+	idem-=dem->row0;
+	if (idem<0)
+		idem=0;
+	if (idem >= dem->nrows)
+		idem=dem->nrows-1;
+	jdem-=dem->col0;
+	if (jdem<0)
+		jdem=0;
+	if (jdem >= dem->ncols)
+		jdem=dem->ncols-1;
+
+	if (dem->data[idem*dem->ncols+jdem]== -9999)
+		dem_spres=1013;
+	else
+		dem_spres=1013.2*exp(-dem->data[idem*dem->ncols+jdem]/8000.);
+
+	return dem_spres;
+}
+
+void free_dem(dem_t *dem) {
+	if (dem==NULL)
+		return;
+	if (dem->map!=NULL)
+		munmap(dem->map,dem->map_len);
+	else
+		free(dem->data);
+	free(dem);
+}
@@ -0,0 +1,36 @@
+#ifndef DEM_H
+#define DEM_H
+#include "espa_geoloc.h"
+
+/* DEM Definition: U_char format, 1 count = 100 meters */
+/* 0 = 0 meters */
+
+#define DEMFILE "CMGDEM.hdf"
+#define DEM_NBLAT 3600
+#define DEM_DLAT 0.05
+#define DEM_LATMIN (-90.0)
+#define DEM_LATMAX 90.0
+#define DEM_NBLON 7200
+#define DEM_DLON 0.05
+#define DEM_LONMIN (-180.0)
+#define DEM_LONMAX 180.0
+#define DEM_MARGIN 0.5		/* margin (degrees) around the scene */
+#define DEM_NB_EDGE_PTS 8	/* points mapped along each scene edge */
+
+/* DEM window covering a scene: rows row0..row0+nrows-1 and columns
+   col0..col0+ncols-1 of the global DEM grid.  It is read from the HDF DEM,
+   or is the whole grid of a raw DEM memory mapped (shared) read-only. */
+typedef struct {
+	short *data;			/* DEM window */
+	int row0,col0;			/* global row/column of data[0] */
+	int nrows,ncols;		/* window size */
+	void *map;			/* mapped raw DEM, NULL if read */
+	size_t map_len;
+} dem_t;
+
+dem_t *read_dem(char *dem_file, char *raw_file, Geoloc_t *space, int nl,
+  int ns);
+float get_dem_spres(dem_t *dem, float lat, float lon);
+void free_dem(dem_t *dem);
+
+#endif
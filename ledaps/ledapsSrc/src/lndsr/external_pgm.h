@@ -1,8 +0,0 @@
-#ifndef EXTERNAL_PGM_H
-#define EXTERNAL_PGM_H
-
-/* Prototypes */
-extern char *get_sixs_path();
-
-
-#endif
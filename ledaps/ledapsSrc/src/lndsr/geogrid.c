@@ -0,0 +1,231 @@
+/*
+!C****************************************************************************
+
+!File: geogrid.c
+
+!Description: Functions serving the lat/long of the scene pixels from a coarse
+ grid of projected control points, instead of projecting every pixel.
+
+!Revision History:
+ Revision 1.0 2015/11/19
+ Original Version.
+
+ Revision 1.1 2015/11/20
+ Added geogrid_anc_line to look up a single layer ancillary field along a
+ line.
+
+!Design Notes:
+   1. The control points are every GEOGRID_STEP lines/samples, plus the last
+      line/sample of the scene.  The spacing is halved until the bilinear
+      interpolation error, checked at the middle of the cells and of their
+      top/left edges, is within the error bound.  If that needs a spacing
+      below GEOGRID_MIN_STEP, or a control point can't be mapped, every pixel
+      is mapped exactly with from_space (step = 0).
+   2. The longitudes of the control points are unwrapped across the
+      dateline, and wrapped back when interpolated.
+   3. The grid is read-only once made, so it can be shared by threads.
+
+!END****************************************************************************
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "geogrid.h"
+#include "const.h"
+
+/* line (or sample) of control point k of a grid of n points over size
+   pixels; the last point is on the last pixel */
+static double grid_pos(int k, int n, int size, int step) {
+	if (k<n-1)
+		return (double)k*step;
+	return (size-1>(n-2)*step) ? (double)(size-1) : (double)((n-2)*step+1);
+}
+
+static double wrap_lon(double lon) {
+	while (lon>=180.) lon-=360.;
+	while (lon<-180.) lon+=360.;
+	return lon;
+}
+
+static int map_exact(geogrid_t *grid, double l, double s, double *lat, double *lon) {
+	Img_coord_float_t img;
+	Geo_coord_t geo;
+
+	img.l=l+grid->off_l;
+	img.s=s+grid->off_s;
+	img.is_fill=false;
+	grid->nb_proj++;
+	if (!from_space(grid->space,&img,&geo))
+		return -1;
+	*lat=geo.lat*DEG;
+	*lon=geo.lon*DEG;
+	return 0;
+}
+
+/* grid cell (index k of its upper left control point) and fractional
+   position t,u within it of line/sample l,s */
+static void grid_cell(geogrid_t *grid, double l, double s, int *k, double *t, double *u) {
+	int r,c;
+	double l0,l1,s0,s1;
+
+	r=(int)(l/grid->step);
+	if (r>grid->nl_grid-2) r=grid->nl_grid-2;
+	if (r<0) r=0;
+	c=(int)(s/grid->step);
+	if (c>grid->ns_grid-2) c=grid->ns_grid-2;
+	if (c<0) c=0;
+	l0=grid_pos(r,grid->nl_grid,grid->nl,grid->step);
+	l1=grid_pos(r+1,grid->nl_grid,grid->nl,grid->step);
+	s0=grid_pos(c,grid->ns_grid,grid->ns,grid->step);
+	s1=grid_pos(c+1,grid->ns_grid,grid->ns,grid->step);
+	*t=(l-l0)/(l1-l0);
+	*u=(s-s0)/(s1-s0);
+	*k=r*grid->ns_grid+c;
+}
+
+static double interp_cell(geogrid_t *grid, double *v, int k, double t, double u) {
+	return (1.-t)*((1.-u)*v[k]+u*v[k+1])+
+	  t*((1.-u)*v[k+grid->ns_grid]+u*v[k+grid->ns_grid+1]);
+}
+
+static void interp_grid(geogrid_t *grid, double l, double s, double *lat, double *lon) {
+	int k;
+	double t,u;
+
+	grid_cell(grid,l,s,&k,&t,&u);
+	*lat=interp_cell(grid,grid->lat,k,t,u);
+	*lon=wrap_lon(interp_cell(grid,grid->lon,k,t,u));
+}
+
+/* project the control points for grid->step and measure the interpolation
+   error within the cells; returns -1 if a point can not be mapped */
+static int build_grid(geogrid_t *grid) {
+	int r,c,k;
+	double l,s,l0,l1,s0,s1,ref,lat,lon,glat,glon,err;
+
+	grid->nl_grid=(grid->nl-1+grid->step-1)/grid->step+1;
+	if (grid->nl_grid<2) grid->nl_grid=2;
+	grid->ns_grid=(grid->ns-1+grid->step-1)/grid->step+1;
+	if (grid->ns_grid<2) grid->ns_grid=2;
+	grid->lat=(double *)malloc(grid->nl_grid*grid->ns_grid*sizeof(double));
+	grid->lon=(double *)malloc(grid->nl_grid*grid->ns_grid*sizeof(double));
+	if ((grid->lat==NULL)||(grid->lon==NULL))
+		return -1;
+
+	for (r=0;r<grid->nl_grid;r++) {
+		l=grid_pos(r,grid->nl_grid,grid->nl,grid->step);
+		for (c=0;c<grid->ns_grid;c++) {
+			k=r*grid->ns_grid+c;
+			s=grid_pos(c,grid->ns_grid,grid->ns,grid->step);
+			if (map_exact(grid,l,s,&grid->lat[k],&grid->lon[k]))
+				return -1;
+			/* unwrap across the dateline from the previous point */
+			if ((r>0)||(c>0)) {
+				ref=(c>0)?grid->lon[k-1]:grid->lon[k-grid->ns_grid];
+				while (grid->lon[k]-ref>180.) grid->lon[k]-=360.;
+				while (grid->lon[k]-ref<-180.) grid->lon[k]+=360.;
+			}
+		}
+	}
+
+	/* check the middle of the cells and of their top and left edges (the
+	   bottom and right edges are checked by the next cells, except for the
+	   last ones, which are close to the scene edges anyway) */
+	grid->err=0.;
+	for (r=0;r<grid->nl_grid-1;r++) {
+		l0=grid_pos(r,grid->nl_grid,grid->nl,grid->step);
+		l1=grid_pos(r+1,grid->nl_grid,grid->nl,grid->step);
+		for (c=0;c<grid->ns_grid-1;c++) {
+			s0=grid_pos(c,grid->ns_grid,grid->ns,grid->step);
+			s1=grid_pos(c+1,grid->ns_grid,grid->ns,grid->step);
+			for (k=0;k<3;k++) {
+				l=(k==1)?l0:(l0+l1)/2.;
+				s=(k==2)?s0:(s0+s1)/2.;
+				if (map_exact(grid,l,s,&lat,&lon))
+					return -1;
+				interp_grid(grid,l,s,&glat,&glon);
+				err=fabs(wrap_lon(glon-lon));
+				if (fabs(glat-lat)>err)
+					err=fabs(glat-lat);
+				if (err>grid->err)
+					grid->err=err;
+				if (grid->err>grid->max_err)
+					return 0;
+			}
+		}
+	}
+	return 0;
+}
+
+geogrid_t *make_geogrid(Geoloc_t *space, int nl, int ns, double off_l,
+  double off_s, double max_err) {
+	geogrid_t *grid;
+
+	if ((grid=(geogrid_t *)malloc(sizeof(geogrid_t)))==NULL) {
+		fprintf(stderr,"ERROR: allocating geolocation grid\n");
+		return NULL;
+	}
+	grid->space=space;
+	grid->nl=nl;
+	grid->ns=ns;
+	grid->off_l=off_l;
+	grid->off_s=off_s;
+	grid->max_err=max_err;
+	grid->err=0.;
+	grid->nb_proj=0;
+	grid->lat=NULL;
+	grid->lon=NULL;
+
+	for (grid->step=GEOGRID_STEP;max_err>0.&&grid->step>=GEOGRID_MIN_STEP;
+	  grid->step/=2) {
+		if (!build_grid(grid)&&(grid->err<=max_err))
+			return grid;
+		free(grid->lat);
+		free(grid->lon);
+		grid->lat=NULL;
+		grid->lon=NULL;
+	}
+
+	/* fall back to the exact mapping of every pixel */
+	grid->step=0;
+	grid->err=0.;
+	return grid;
+}
+
+int geogrid_latlon(geogrid_t *grid, int il, int is, float *lat, float *lon) {
+	double dlat,dlon;
+
+	if (grid->step==0) {
+		if (map_exact(grid,(double)il,(double)is,&dlat,&dlon))
+			return -1;
+	} else
+		interp_grid(grid,(double)il,(double)is,&dlat,&dlon);
+	*lat=(float)dlat;
+	*lon=(float)dlon;
+	return 0;
+}
+
+/* single layer ancillary field anc along line il, looked up with its own
+   bilinear interpolation at the lat/long of every pixel (the lat/long are
+   interpolated from the grid, the field isn't) */
+int geogrid_anc_line(geogrid_t *grid, t_ncep_ancillary *anc, int il,
+  float *line) {
+	int is;
+	float lat,lon;
+
+	for (is=0;is<grid->ns;is++) {
+		if (geogrid_latlon(grid,il,is,&lat,&lon))
+			return -1;
+		interpol_spatial_anc(anc,lat,lon,&line[is]);
+	}
+	return 0;
+}
+
+void free_geogrid(geogrid_t *grid) {
+	if (grid==NULL)
+		return;
+	free(grid->lat);
+	free(grid->lon);
+	free(grid);
+}
@@ -0,0 +1,37 @@
+#ifndef GEOGRID_H
+#define GEOGRID_H
+#include "espa_geoloc.h"
+#include "read_grib_tools.h"
+
+#define GEOGRID_STEP 32			/* initial control point spacing (pixels) */
+#define GEOGRID_MIN_STEP 4		/* below this the exact mapping is used */
+#define GEOGRID_MAX_ERROR 0.0001	/* default error bound (degrees) */
+
+/* Lat/long of a scene served by bilinear interpolation of a coarse grid of
+   control points, each projected once with from_space().  The spacing is
+   halved until the interpolation error (checked at the middle of the cells
+   and of their edges) is within the error bound; if that needs a spacing
+   below GEOGRID_MIN_STEP (or a control point can not be mapped) every pixel
+   is mapped exactly (step = 0). */
+typedef struct {
+	Geoloc_t *space;		/* mapping of the scene */
+	int nl,ns;			/* scene size */
+	double off_l,off_s;		/* offset added to the pixel line/sample */
+	int step;			/* control point spacing, 0 = exact */
+	int nl_grid,ns_grid;		/* number of control point rows/columns */
+	double *lat,*lon;		/* control points lat/long (degrees); the
+					   longitudes are unwrapped across the
+					   dateline */
+	double max_err;			/* error bound (degrees) */
+	double err;			/* max error found in the cells */
+	long nb_proj;			/* number of from_space() calls */
+} geogrid_t;
+
+geogrid_t *make_geogrid(Geoloc_t *space, int nl, int ns, double off_l,
+  double off_s, double max_err);
+int geogrid_latlon(geogrid_t *grid, int il, int is, float *lat, float *lon);
+int geogrid_anc_line(geogrid_t *grid, t_ncep_ancillary *anc, int il,
+  float *line);
+void free_geogrid(geogrid_t *grid);
+
+#endif
@@ -92,9 +92,13 @@ delivering this software to the DAAC. */
 #include <math.h>
 #include <float.h>
 #include "grib.h"
+#include "read_grib_tools.h"
 
 int read_grib_array(FILE *input, char *what, char *where, int *nx, int *ny, float **narray);
 int read_grib_date(FILE *input, char *what, char *where, char *date);
+int index_grib(FILE *input, t_grib_msg **msgs, int *nmsg);
+int decode_grib(FILE *input, t_grib_msg *index, int *n_rows, int *n_cols,
+                float **narray);
 unsigned char *seek_grib(FILE *file, long *pos, long *len_grib, 
                          unsigned char *buffer, unsigned int buf_len);
 int read_grib(FILE *file, long pos, long len_grib, unsigned char *buffer);
@@ -522,6 +526,215 @@ none
     }
 }
 
+int index_grib(FILE *input, t_grib_msg **msgs, int *nmsg) 
+/*
+!C*****************************************************************************
+!Description:  Routine builds the index of the messages of a GRIB-format file
+               in one scan of the file.  Only the header and PDS of each
+	       message are read.
+
+!Input Parameters:
+input:    pointer to GRIB-format file, returned from fopen()
+
+!Output Parameters:
+msgs:     array of the nmsg index entries (parameter, level, date, position
+          and length of each message), allocated by this routine
+nmsg:     number of messages in the file
+
+!Returns:
+	-1	memory error
+	 0	success
+
+!Revision History:
+        Revision 1.0, 20-NOV-2015
+	1.  Original version, from the loop of read_grib_date().
+
+!Design Notes
+	The parameter, level and date are all in the first 28 bytes of the
+	PDS, which seek_grib() always returns.
+!END***************************************************************************
+*/
+{
+
+    unsigned char buffer[MSEEK];
+    long int len_grib, pos = 0;
+    unsigned char *msg, *pds;
+    int nalloc = 0;
+    t_grib_msg *tmp;
+
+    *msgs = NULL;
+    *nmsg = 0;
+    for (;;) {
+	msg = seek_grib(input, &pos, &len_grib, buffer, MSEEK);
+	if (msg == NULL || len_grib <= 0)
+	    return(0);
+
+	if (*nmsg == nalloc) {
+	    nalloc += 64;
+	    tmp = (t_grib_msg *) realloc((void *) *msgs, nalloc * sizeof(t_grib_msg));
+	    if (tmp == NULL) {
+		free(*msgs);
+		*msgs = NULL;
+		*nmsg = 0;
+		return(-1);
+	    }
+	    *msgs = tmp;
+	}
+
+        pds = (msg + 8);
+	tmp = &(*msgs)[*nmsg];
+	strncpy(tmp->what, k5toa(pds), sizeof(tmp->what) - 1);
+	tmp->what[sizeof(tmp->what) - 1] = '\0';
+	strncpy(tmp->where, levels(PDS_KPDS6(pds), PDS_KPDS7(pds)), sizeof(tmp->where) - 1);
+	tmp->where[sizeof(tmp->where) - 1] = '\0';
+	ASCII_TCA_PDS_date(pds, 0, tmp->date);
+	tmp->pos = pos;
+	tmp->len_grib = len_grib;
+	(*nmsg)++;
+
+        pos += len_grib;
+    }
+}
+
+
+int decode_grib(FILE *input, t_grib_msg *index, int *n_rows, int *n_cols,
+                float **narray) 
+/*
+!C*****************************************************************************
+!Description:  Routine decodes the GRIB message of a GRIB-format file at the
+               position given by its index entry (from index_grib()).
+
+!Input Parameters:
+input:    pointer to GRIB-format file, returned from fopen()
+index:    index entry of the message
+
+!Output Parameters:
+n_rows:   the number of rows and
+n_cols:       columns of data retrieved
+narray:   array that contains the data, with each line starting at
+          longitude = -180 like read_grib_array()
+
+!Returns:
+	-1	memory error
+	-3      file error -- "missing end section" or short message
+	 0	success
+
+!Revision History:
+        Revision 1.0, 20-NOV-2015
+	1.  Original version, from read_grib_array() without the search.
+
+!Design Notes
+!END***************************************************************************
+*/
+{
+
+    unsigned char *buffer;
+    double temp;
+    int i, j, jj, nx, ny;
+    long int nxny, lj, ljj;
+    unsigned char *pds, *gds, *bms, *bds, *pointer;
+    float *temp_array;
+
+    if ((buffer = (unsigned char *) malloc(index->len_grib)) == NULL) {
+        return(-1);
+    }
+    if (!read_grib(input, index->pos, index->len_grib, buffer)) {
+        free(buffer);
+        return(-3);
+    }
+
+    pds = (buffer + 8);
+    pointer = pds + PDS_LEN(pds);
+    if (PDS_HAS_GDS(pds)) {
+        gds = pointer;
+        pointer += GDS_LEN(gds);
+    }
+    else {
+        gds = NULL;
+    }
+    if (PDS_HAS_BMS(pds)) {
+        bms = pointer;
+        pointer += BMS_LEN(bms);
+    }
+    else {
+        bms = NULL;
+    }
+    bds = pointer;
+    pointer += BDS_LEN(bds);
+
+    /* end section - "7777" in ascii */
+    if (pointer + 4 > buffer + index->len_grib ||
+        pointer[0] != 0x37 || pointer[1] != 0x37 ||
+        pointer[2] != 0x37 || pointer[3] != 0x37) {
+        free(buffer);
+        return(-3);
+    }
+
+    /* figure out size of array */
+    if (gds != NULL) {
+        GDS_grid(gds, &nx, &ny, &nxny);
+    }
+    else if (bms != NULL) {
+        nxny = nx = BMS_nxny(bms);
+        ny = 1;
+    }
+    else {
+        if (BDS_NumBits(bds) == 0) {
+            nxny = nx = 1;
+        }
+        else {
+            nxny = nx = BDS_NValues(bds);
+        }
+        ny = 1;
+    }
+
+#ifdef CHECK_GRIB
+    if (BDS_NumBits(bds) != 0) {
+        i = BDS_NValues(bds);
+        if (bms != NULL) {
+            i += missing_points(BMS_bitmap(bms),nx*ny);
+        }
+        if (i != nxny) {
+            nxny = nx = i;
+            ny = 1;
+        }
+    }
+#endif
+
+    if ((*narray = (float *) malloc(sizeof(float) * nxny)) == NULL) {
+        free(buffer);
+        return(-1);
+    }
+    if ((temp_array = (float *) malloc(sizeof(float) * nxny)) == NULL) {
+        free(buffer);
+        free(*narray);
+        *narray = NULL;
+        return(-1);
+    }
+
+    temp = int_power(10.0, - PDS_DecimalScale(pds));
+    BDS_unpack(temp_array, bds + 11, BMS_bitmap(bms), BDS_NumBits(bds), nxny,
+        temp*BDS_RefValue(bds),temp*int_power(2.0, BDS_BinScale(bds)));
+    free(buffer);
+
+    /* each line starts at longitude = 0; reformat to start at 
+       longitude = -180 (or so) */
+    lj = 0L;
+    for (i=0;i<ny;i++)
+        for (j=0;j<nx;j++) {
+            jj = j + nx/2;
+            if (jj >= nx) jj -= nx;
+            ljj = i*nx + jj;
+            (*narray)[ljj] = temp_array[lj];
+            lj++;
+        }
+
+    free(temp_array);
+    *n_cols = nx;
+    *n_rows = ny;
+    return(0);
+}
+
 #ifndef min
    #define min(a,b)  ((a) < (b) ? (a) : (b))
 #endif
@@ -1093,8 +1306,10 @@ char *levels(int kpds6, int kpds7)
 {
 
 	int o11, o12;
-        char x[128];
+        static char x[128];   /* returned to the caller */
 	
+	x[0] = '\0';
+
 	/* octets 11 and 12 */
 	o11 = kpds7 / 256;
 	o12 = kpds7 % 256;
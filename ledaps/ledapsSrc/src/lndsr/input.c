@@ -23,6 +23,14 @@
  Gail Schmidt, USGS EROS
  Modified to use ESPA internal raw binary format
 
+ Modified on 11/9/2015
+  Added the optional memory mapped access to the input binary files and
+  GetInputLinePtr, which returns a pointer to the line in the mapping.
+
+ Modified on 11/16/2015
+  Added the input bands handed over in memory by the fused ledaps driver
+  (input_mem_get).
+
 !Team Unique Header:
   This software was developed by the MODIS Land Science Team Support 
   Group for the Laboratory for Terrestrial Physics (Code 922) at the 
@@ -47,6 +55,12 @@
    1. The following public functions handle the input data:
 
 	OpenInput - Setup 'input' data structure and open file for access.
+	GetInputLine - Read a line of a band.
+	GetInputLinePtr - Get a pointer to a line of a band, without copying
+	  it when the input is memory mapped.
+	GetInputQALine - Read a line of the QA band.
+	  (The bands handed over in memory by the fused ledaps driver through
+	  'input_mem_get' are read like memory mapped files.)
 	CloseInput - Close the input file.
 	FreeOutput - Free the 'input' data structure memory.
 
@@ -57,7 +71,11 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include "input.h"
 #include "error.h"
 #include "mystring.h"
@@ -66,8 +84,29 @@
 
 #define INPUT_FILL (-9999)
 
+Input_mem_get_t input_mem_get = NULL;
+
+/* Map the first len bytes of the open file fp read-only, with a hint that
+   it is read sequentially.  Returns NULL if the file is too short or can't
+   be mapped. */
+static void *MapInputFile(FILE *fp, size_t len)
+{
+  struct stat st;
+  void *map;
+
+  if (fstat(fileno(fp), &st) != 0 || (size_t)st.st_size < len)
+    return NULL;
+  map = mmap(NULL, len, PROT_READ, MAP_SHARED, fileno(fp), 0);
+  if (map == MAP_FAILED)
+    return NULL;
+  madvise(map, len, MADV_SEQUENTIAL);
+
+  return map;
+}
+
+
 /* Functions */
-Input_t *OpenInput(Espa_internal_meta_t *metadata, bool thermal)
+Input_t *OpenInput(Espa_internal_meta_t *metadata, bool thermal, bool use_mmap)
 /* 
 !C******************************************************************************
 
@@ -77,6 +116,8 @@ Input_t *OpenInput(Espa_internal_meta_t *metadata, bool thermal)
 !Input Parameters:
  metadata     'Espa_internal_meta_t' data structure with XML info
  thermal      boolean to indicate if thermal data is being processed
+ use_mmap     boolean to indicate if the input files are memory mapped
+              instead of read line by line
 
 !Output Parameters:
  (returns)      'input' data structure or NULL when an error occurs
@@ -102,36 +143,83 @@ Input_t *OpenInput(Espa_internal_meta_t *metadata, bool thermal)
     RETURN_ERROR("getting input from header file", "OpenInput", NULL);
   }
 
-  /* Open TOA reflectance files for access */
+  this->use_mmap = use_mmap;
+  for (ib = 0; ib < NBAND_REFL_MAX; ib++)
+    this->map[ib] = NULL;
+  this->map_qa = NULL;
+
+  /* Open TOA reflectance files for access.  The bands handed over in
+     memory by the fused ledaps driver are used in place, like a mapping. */
   for (ib = 0; ib < this->nband; ib++) {
+    if (input_mem_get != NULL) {
+      this->map[ib] = (int16 *)input_mem_get(this->file_name[ib],
+        (size_t)this->size.l * this->size.s * sizeof(int16));
+      if (this->map[ib] != NULL) {
+        this->fp_bin[ib] = NULL;
+        this->open[ib] = true;
+        continue;
+      }
+    }
     this->fp_bin[ib] = fopen(this->file_name[ib], "r");
     if (this->fp_bin[ib] == NULL) {
       error_string = "opening input TOA binary file";
       break;
     }
     this->open[ib] = true;
+    if (this->use_mmap) {
+      this->map[ib] = (int16 *)MapInputFile(this->fp_bin[ib],
+        (size_t)this->size.l * this->size.s * sizeof(int16));
+      if (this->map[ib] == NULL) {
+        error_string = "mapping input TOA binary file";
+        break;
+      }
+    }
   }
 
   /* Open QA file for access */
-  this->fp_bin_qa = fopen(this->file_name_qa, "r");
-  if (this->fp_bin_qa == NULL) 
+  if (input_mem_get != NULL)
+    this->map_qa = (uint8 *)input_mem_get(this->file_name_qa,
+      (size_t)this->size.l * this->size.s * sizeof(uint8));
+  if (this->map_qa != NULL) {
+    this->fp_bin_qa = NULL;
+    this->open_qa = true;
+  }
+  else if ((this->fp_bin_qa = fopen(this->file_name_qa, "r")) == NULL) 
     error_string = "opening QA binary file";
-  else
+  else {
     this->open_qa = true;
+    if (this->use_mmap) {
+      this->map_qa = (uint8 *)MapInputFile(this->fp_bin_qa,
+        (size_t)this->size.l * this->size.s * sizeof(uint8));
+      if (this->map_qa == NULL)
+        error_string = "mapping QA binary file";
+    }
+  }
 
   if (error_string != NULL) {
     for (ib = 0; ib < this->nband; ib++) {
       free(this->file_name[ib]);
       this->file_name[ib] = NULL;
 
+      if (this->map[ib] != NULL && this->fp_bin[ib] != NULL) {
+        munmap(this->map[ib],
+          (size_t)this->size.l * this->size.s * sizeof(int16));
+        this->map[ib] = NULL;
+      }
       if (this->open[ib]) {
-        fclose(this->fp_bin[ib]);
+        if (this->fp_bin[ib] != NULL)
+          fclose(this->fp_bin[ib]);
         this->open[ib] = false;
       }
     }
+    if (this->map_qa != NULL && this->fp_bin_qa != NULL) {
+      munmap(this->map_qa, (size_t)this->size.l * this->size.s * sizeof(uint8));
+      this->map_qa = NULL;
+    }
     free(this->file_name_qa);
     this->file_name_qa = NULL;
-    fclose(this->fp_bin_qa);  
+    if (this->fp_bin_qa != NULL)
+      fclose(this->fp_bin_qa);  
     this->open_qa = false;
     free(this);
     this = NULL;
@@ -173,6 +261,17 @@ bool CloseInput(Input_t *this)
   for (ib = 0; ib < this->nband; ib++) {
     if (this->open[ib]) {
       none_open = false;
+      if (this->fp_bin[ib] == NULL) {
+        /* in memory, owned by the fused driver */
+        this->map[ib] = NULL;
+        this->open[ib] = false;
+        continue;
+      }
+      if (this->map[ib] != NULL) {
+        munmap(this->map[ib],
+          (size_t)this->size.l * this->size.s * sizeof(int16));
+        this->map[ib] = NULL;
+      }
       fclose(this->fp_bin[ib]);
       this->open[ib] = false;
     }
@@ -181,7 +280,16 @@ bool CloseInput(Input_t *this)
   /*** now close the QA file ***/
   if (this->open_qa) 
   {
-    fclose(this->fp_bin_qa);
+    if (this->fp_bin_qa == NULL)
+      this->map_qa = NULL;  /* in memory, owned by the fused driver */
+    else {
+      if (this->map_qa != NULL) {
+        munmap(this->map_qa,
+          (size_t)this->size.l * this->size.s * sizeof(uint8));
+        this->map_qa = NULL;
+      }
+      fclose(this->fp_bin_qa);
+    }
     this->open_qa = false;
   }
 
@@ -243,6 +351,13 @@ bool GetInputLine(Input_t *this, int iband, int iline, int16 *line)
   if (!this->open[iband])
     RETURN_ERROR("band not open", "GetInputLine", false);
 
+  /* Copy the line from the mapped file */
+  if (this->map[iband] != NULL) {
+    memcpy(line, &this->map[iband][(size_t)iline * this->size.s],
+      (size_t)this->size.s * sizeof(int16));
+    return true;
+  }
+
   /* Read the data */
   buf_void = (void *)line;
   loc = (long) (iline * this->size.s * sizeof(int16));
@@ -256,6 +371,40 @@ bool GetInputLine(Input_t *this, int iband, int iline, int16 *line)
 }
 
 
+int16 *GetInputLinePtr(Input_t *this, int iband, int iline, int16 *line)
+/* 
+!C******************************************************************************
+
+!Description: 'GetInputLinePtr' returns a pointer to a line of a band.  When
+ the input is memory mapped the pointer is into the mapping and the line is
+ not copied; otherwise the line is read into 'line'.  The returned line must
+ not be modified.
+ 
+!Input Parameters:
+ this           'input' data structure
+ iband          band index
+ iline          line index
+ line           buffer of at least 'size.s' values for the line when the
+                input is not memory mapped
+
+!Output Parameters:
+ (returns)      pointer to the line or NULL when an error occurs
+
+!Team Unique Header:
+
+!END****************************************************************************
+*/
+{
+  if (this != NULL && iband >= 0 && iband < this->nband &&
+      iline >= 0 && iline < this->size.l && this->map[iband] != NULL)
+    return &this->map[iband][(size_t)iline * this->size.s];
+
+  if (!GetInputLine(this, iband, iline, line))
+    return NULL;
+  return line;
+}
+
+
 bool GetInputQALine(Input_t *this, int iline, uint8 *line) 
 {
   long loc;
@@ -268,6 +417,12 @@ bool GetInputQALine(Input_t *this, int iline, uint8 *line)
   if (!this->open_qa)
     RETURN_ERROR("QA band not open", "GetInputQALine", false);
 
+  if (this->map_qa != NULL) {
+    memcpy(line, &this->map_qa[(size_t)iline * this->size.s],
+      (size_t)this->size.s * sizeof(uint8));
+    return true;
+  }
+
   buf_void = (void *)line;
   loc = (long) (iline * this->size.s * sizeof(uint8));
   if (fseek(this->fp_bin_qa, loc, SEEK_SET))
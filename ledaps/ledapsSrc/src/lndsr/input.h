@@ -79,12 +79,27 @@ typedef struct {
   bool open_qa;            /* Flag to indicate whether the specific input
                               file is open for access; 'true' = open, 
                               'false' = not open */
+  bool use_mmap;           /* Flag to indicate whether the input files are
+                              memory mapped instead of read line by line */
+  int16 *map[NBAND_REFL_MAX]; /* Mapped input binary files; NULL if not
+                                 mapped */
+  uint8 *map_qa;           /* Mapped QA binary file; NULL if not mapped */
 } Input_t;
 
+/* In-memory input bands, set by the fused ledaps driver to hand the lndcal
+   TOA bands over without writing and reading them back.  Returns the band
+   of the given file name and size in bytes, or NULL if it is not in memory
+   (then the file is read). */
+
+typedef void *(*Input_mem_get_t)(char *file_name, size_t size);
+
+extern Input_mem_get_t input_mem_get;
+
 /* Prototypes */
 
-Input_t *OpenInput(Espa_internal_meta_t *metadata, bool thermal);
+Input_t *OpenInput(Espa_internal_meta_t *metadata, bool thermal, bool use_mmap);
 bool GetInputLine(Input_t *this, int iband, int iline, int16 *line);
+int16 *GetInputLinePtr(Input_t *this, int iband, int iline, int16 *line);
 bool CloseInput(Input_t *this);
 bool FreeInput(Input_t *this);
 bool InputMetaCopy(Input_meta_t *this, int nband, Input_meta_t *copy);
@@ -34,6 +34,49 @@
   scale factor or add offset versus the previous version which was int16
   with a scale factor and add offset.  The underlying NCEP variables have
   changed, as delivered from NOAA/NCEP.
+
+  Modified on 11/3/2015
+  The 6S code is linked in as a library and run in-process, so lndsr no
+  longer needs to locate the sixsV1.0B executable.
+
+  Modified on 11/5/2015
+  The 6S tables can be interpolated from a LUT precomputed by sixs_lut_gen
+  (SIXS_LUT_FILE parameter) instead of running 6S for the scene.
+
+  Modified on 11/6/2015
+  The cloud shadow pass and the aerosol retrieval are done in a single read
+  of the input (the aerosol of a region is retrieved as soon as its masks
+  are final), the dark target/cloud masks are kept in memory instead of a
+  temporary file, and the clear pixel stats pass only reads the input when
+  the thermal band is available.
+
+  Modified on 11/9/2015
+  Added the optional memory mapped input (INPUT_MMAP parameter); the
+  surface reflectance pass then uses the input lines in place.
+
+  Modified on 11/10/2015
+  The surface reflectance pass processes blocks of SR_BLOCK_LINES lines in
+  parallel with OpenMP (NUM_THREADS parameter); the lines are still written
+  in order and the statistics merged in line order.
+
+  Modified on 11/19/2015
+  The lat/long of the clear pixel stats pass are interpolated from a coarse
+  grid of projected control points (geogrid.c) within GEOGRID_MAX_ERROR
+  degrees, instead of calling from_space for every pixel.
+
+  Modified on 11/20/2015
+  The ancillary data (WV, ozone, surface pressure and air temperature) are
+  interpolated in time at the scene time once, then resampled on the AR
+  grid, the cld_diags grid and the pixels of the clear pixel stats pass,
+  instead of interpolating every layer at every point.
+
+  Modified on 11/20/2015
+  The four NCEP fields are read in one pass over the NCEP GRIB files, from
+  their message index (optionally saved next to them, NCEP_INDEX).
+
+  Modified on 11/20/2015
+  Only the DEM window covering the scene is read (dem.c), or the raw DEM
+  given by DEM_RAW_FILE is memory mapped.
 **************************************************************************/
 
 #include <stdio.h>
@@ -42,6 +85,9 @@
 #include <string.h>
 #include <unistd.h>
 #include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "lndsr.h"
 #include "keyvalue.h"
@@ -59,6 +105,9 @@
 
 #include "read_grib_tools.h"
 #include "sixs_runs.h"
+#include "sixs_lut.h"
+#include "geogrid.h"
+#include "dem.h"
 
 #define AERO_NB_BANDS 3
 #define AERO_STATS_NB_BANDS 3
@@ -70,18 +119,6 @@
 /* #define DEBUG_AR	0 */
 /* #define DEBUG_CLD 1 */
 
-/* DEM Definition: U_char format, 1 count = 100 meters */
-/* 0 = 0 meters */
-
-#define DEMFILE "CMGDEM.hdf"
-#define DEM_NBLAT 3600
-#define DEM_DLAT 0.05
-#define DEM_LATMIN (-90.0)
-#define DEM_LATMAX 90.0
-#define DEM_NBLON 7200
-#define DEM_DLON 0.05
-#define DEM_LONMIN (-180.0)
-#define DEM_LONMAX 180.0
 #define P_DFTVALUE 1013.0
 
 /* Type definitions */
@@ -94,12 +131,6 @@ int diags_il_ar;
 #ifdef DEBUG_CLD
 FILE *fd_cld_diags;
 #endif
-/* reading the DEM in hdf */
-int32 sds_file_id,sds_id,status;
-char sds_name[256];
-int32 sds_index;
-int32 dim_sizes[2],start[2],stride[2],edges[2];
-int32 data_type,n_attrs,rank;
 /* Prototypes */
 #ifndef  HPUX
 #define chand chand_
@@ -109,9 +140,7 @@ void chand(float *phi,float *muv,float *mus,float *tau_ray,float *actual_rho_ray
 void csalbr(float *tau_ray,float *actual_S_r);
 int update_atmos_coefs(atmos_t *atmos_coef,Ar_gridcell_t *ar_gridcell, sixs_tables_t *sixs_tables,int ***line_ar,Lut_t *lut,int nband, int bkgd_aerosol);
 int update_gridcell_atmos_coefs(int irow,int icol,atmos_t *atmos_coef,Ar_gridcell_t *ar_gridcell, sixs_tables_t *sixs_tables,int **line_ar,Lut_t *lut,int nband, int bkgd_aerosol);
-void set_sixs_path_from(const char *path);
 float calcuoz(short jday,float flat);
-float get_dem_spres(short *dem,float lat,float lon);
 void swapbytes(void *val,int nbbytes);
 
 #ifdef SAVE_6S_RESULTS
@@ -120,6 +149,7 @@ int read_6S_results_from_file(char *filename,sixs_tables_t *sixs_tables);
 int write_6S_results_to_file(char *filename,sixs_tables_t *sixs_tables);
 #endif
 void sun_angles (short jday,float gmt,float flat,float flon,float *ts,float *fs);
+void set_ar_gridcell_line(Ar_gridcell_t *ar_gridcell, Lut_t *lut, int il_ar);
 /* Functions */
 
 int main (int argc, const char **argv) {
@@ -129,12 +159,18 @@ int main (int argc, const char **argv) {
   InputOzon_t *ozon_input = NULL;
   Lut_t *lut = NULL;
   Output_t *output = NULL;
-  int i,j,il, is,ib,i_aot,j_aot,ifree;
+  int i,j,il, is,ib,ifree;
   int il_start, il_end, il_ar, il_region, is_ar;
-  int16 *line_out[NBAND_SR_MAX];
-  int16 *line_out_buf = NULL;
+  int16 *blk_line_out[SR_BLOCK_LINES][NBAND_SR_MAX];
+  int16 *blk_out_buf = NULL;
   int16 ***line_in = NULL;
+  int16 ***line_in_region[2];
   int16 **line_in_band_buf = NULL;
+  int16 *blk_line_in[SR_BLOCK_LINES][NBAND_REFL_MAX];
+  int16 *blk_b6_line[SR_BLOCK_LINES];
+  int16 *blk_in_buf = NULL;
+  int nb_sr_lines;
+  int nb_sr_error;
   int16 *line_in_buf = NULL;
   int ***line_ar = NULL;
   int **line_ar_band_buf = NULL;
@@ -148,15 +184,16 @@ int main (int argc, const char **argv) {
   uint8** qa_line = NULL;
   uint8* qa_line_buf = NULL;
   char **ddv_line = NULL;
-  char *ddv_line_buf = NULL;
+  char *ddv_buf = NULL;
+  size_t ddv_region_size;
   char **rot_cld[3],**ptr_rot_cld[3],**ptr_tmp_cld;
   char **rot_cld_block_buf = NULL;
   char *rot_cld_buf = NULL;
   char envi_file[STR_SIZE]; /* name of the output ENVI header file */
   char *cptr = NULL;        /* pointer to the file extension */
-  bool refl_is_fill;
 
   Sr_stats_t sr_stats;
+  Sr_stats_t blk_sr_stats[SR_BLOCK_LINES];
   Ar_stats_t ar_stats;
   Ar_gridcell_t ar_gridcell;
   float *prwv_in[NBAND_PRWV_MAX];
@@ -166,37 +203,37 @@ int main (int argc, const char **argv) {
                                for polar scenes that are ascending or flipped */
   
   int nbpts;
-  int inter_aot[3];
   float scene_gmt;
 
   Geoloc_t *space = NULL;
+  geogrid_t *geogrid = NULL;
   Space_def_t space_def;
   char *dem_name = NULL;
   Img_coord_float_t img;
-  Img_coord_int_t loc;
   Geo_coord_t geo;
 
   t_ncep_ancillary anc_O3,anc_WV,anc_SP,anc_ATEMP;
+  t_ncep_ancillary scene_O3,scene_WV,scene_SP,scene_ATEMP;
+  t_ncep_ancillary *ncep_anc[4]={&anc_O3,&anc_WV,&anc_SP,&anc_ATEMP};
+  int ncep_type[4]={TYPE_OZONE_DATA,TYPE_WV_DATA,TYPE_SP_DATA,TYPE_ATEMP_DATA};
+  float *cell_lat,*cell_lon;
   double sum_spres_anc,sum_spres_dem;
   int nb_spres_anc,nb_spres_dem;
-  float tmpflt_arr[4];
-  double coef;
-  int tmpint;
   int osize;
   int debug_flag;
 
   sixs_tables_t sixs_tables;
+  sixs_lut_t *sixs_lut;
   float center_lat,center_lon;
+#if defined(DEBUG_AR) || defined(DEBUG_CLD)
   char tmpfilename[128];
-  FILE *fdtmp/*, *fdtmp2 */;
-  int tmpid;                  /* file ID for temporary file (ID not used) */
+#endif
   
-  short *dem_array;
+  dem_t *dem;
   int dem_available;
   
   cld_diags_t cld_diags;
   	
-  float flat,flon/*,fts,ffs*/;
   double delta_y,delta_x;
   float adjust_north;
   
@@ -208,16 +245,10 @@ int main (int argc, const char **argv) {
   Espa_global_meta_t *gmeta = NULL;   /* pointer to global meta */
   Envi_header_t envi_hdr;             /* output ENVI header information */
   
-  /* Vermote additional variable declaration for the cloud mask May 29 2007 */
-  int anom;
-  float t6,t6s_seuil;
-  
   printf ("\nRunning lndsr ....\n");
   debug_flag= DEBUG_FLAG;
   no_ozone_file=0;
   
-  set_sixs_path_from(argv[0]);
-
   /* Read the parameters from the input parameter file */
   param = GetParam(argc, argv);
   if (param == NULL) EXIT_ERROR("getting runtime parameters", "main");
@@ -241,10 +272,12 @@ int main (int argc, const char **argv) {
   gmeta = &xml_metadata.global; /* pointer to global meta */
 
   /* Open input files; grab QA band for reflectance band */
-  input = OpenInput(&xml_metadata, false /* not thermal */);
+  input = OpenInput(&xml_metadata, false /* not thermal */,
+    param->input_mmap);
   if (input == NULL) EXIT_ERROR("bad input file", "main");
 
-  input_b6 = OpenInput(&xml_metadata, true /* thermal */);
+  input_b6 = OpenInput(&xml_metadata, true /* thermal */,
+    param->input_mmap);
   if (input_b6 == NULL) {
     param->thermal_band = false;
     printf ("WARNING: no thermal brightness temp band available. Processing "
@@ -346,22 +379,26 @@ int main (int argc, const char **argv) {
 #endif
   /* Allocate memory for input lines */
 
-  line_in = (int16 ***)calloc((size_t)(lut->ar_region_size.l), 
+  /* Two regions of input lines are kept: the aerosol of a region is
+     retrieved while the cloud masks of the next region are computed */
+  line_in = (int16 ***)calloc((size_t)(2 * lut->ar_region_size.l), 
     sizeof(int16 **));
   if (line_in == NULL) 
     EXIT_ERROR("allocating input line buffer (a)", "main");
 
-  line_in_band_buf = (int16 **)calloc((size_t)(lut->ar_region_size.l * 
+  line_in_band_buf = (int16 **)calloc((size_t)(2 * lut->ar_region_size.l * 
     input->nband), sizeof(int16 *));
   if (line_in_band_buf == NULL) 
     EXIT_ERROR("allocating input line buffer (b)", "main");
 
-  line_in_buf = (int16 *)calloc((size_t)(input->size.s * lut->ar_region_size.l *
-    input->nband), sizeof(int16));
+  line_in_buf = (int16 *)calloc((size_t)(input->size.s * 2 *
+    lut->ar_region_size.l * input->nband), sizeof(int16));
   if (line_in_buf == NULL) 
     EXIT_ERROR("allocating input line buffer (c)", "main");
 
-  for (il = 0; il < lut->ar_region_size.l; il++) {
+  line_in_region[0] = line_in;
+  line_in_region[1] = line_in + lut->ar_region_size.l;
+  for (il = 0; il < 2 * lut->ar_region_size.l; il++) {
     line_in[il] = line_in_band_buf;
     line_in_band_buf += input->nband;
     for (ib = 0; ib < input->nband; ib++) {
@@ -398,15 +435,13 @@ int main (int argc, const char **argv) {
     atemp_line = (float *)calloc((size_t)(input->size.s),sizeof(float));
     if (atemp_line == NULL) EXIT_ERROR("allocating atemp line", "main");
 	 
-  /* Allocate memory for ddv line */
+  /* Allocate memory for the dark target/cloud mask of the whole scene,
+     in full aerosol regions; ddv_line points to the lines of one region */
     ddv_line = (char**)calloc((size_t)(lut->ar_region_size.l),sizeof(char *));
     if (ddv_line == NULL) EXIT_ERROR("allocating ddv line", "main");
-    ddv_line_buf = (char*)calloc((size_t)(input->size.s * lut->ar_region_size.l),sizeof(char));
-    if (ddv_line_buf == NULL) EXIT_ERROR("allocating ddv line buffer", "main");
-	 for (il = 0; il < lut->ar_region_size.l; il++) {
-	 	ddv_line[il]=ddv_line_buf;
-		ddv_line_buf += input->size.s;
-	 }
+    ddv_region_size = (size_t)lut->ar_region_size.l * input->size.s;
+    ddv_buf = (char*)calloc((size_t)lut->ar_size.l * ddv_region_size,sizeof(char));
+    if (ddv_buf == NULL) EXIT_ERROR("allocating ddv buffer", "main");
 
   /* Allocate memory for rotating cloud buffer */
 
@@ -458,14 +493,20 @@ int main (int argc, const char **argv) {
     EXIT_ERROR("allocating ar_gridcell.spres_dem", "main");
 
 
-  /* Allocate memory for output lines */
-  line_out_buf = (int16 *)calloc((size_t)(output->size.s * output->nband_tot), 
-    sizeof(int16));
-  if (line_out_buf == NULL) 
+  /* Allocate memory for the output lines and the input lines (when the
+     input is not memory mapped) of a block of the surface reflectance */
+  blk_out_buf = (int16 *)calloc((size_t)SR_BLOCK_LINES * output->size.s *
+    output->nband_tot, sizeof(int16));
+  if (blk_out_buf == NULL) 
     EXIT_ERROR("allocating output line buffer", "main");
-  line_out[0] = line_out_buf;
-  for (ib = 1; ib < output->nband_tot; ib++)
-    line_out[ib] = line_out[ib - 1] + output->size.s;
+  for (i = 0; i < SR_BLOCK_LINES; i++)
+    for (ib = 0; ib < output->nband_tot; ib++)
+      blk_line_out[i][ib] = &blk_out_buf[((size_t)i * output->nband_tot + ib)
+        * output->size.s];
+  blk_in_buf = (int16 *)calloc((size_t)SR_BLOCK_LINES * input->size.s *
+    (input->nband + 1), sizeof(int16));
+  if (blk_in_buf == NULL) 
+    EXIT_ERROR("allocating input block buffer", "main");
 
   /* Allocate memory for the aerosol lines */
   line_ar = (int ***)calloc((size_t)lut->ar_size.l, sizeof(int **));
@@ -571,9 +612,6 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
      strcpy(anc_O3.filename[2],param->ncep_file_name[2]);
      strcpy(anc_O3.filename[3],param->ncep_file_name[3]);
 
-     if (read_grib_anc(&anc_O3,TYPE_OZONE_DATA))
-          EXIT_ERROR("Can't read NCEP Ozone data","main");
-
      anc_WV.data[0]=NULL;
      anc_WV.data[1]=NULL;
      anc_WV.data[2]=NULL;
@@ -585,8 +623,6 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
      strcpy(anc_WV.filename[1],param->ncep_file_name[1]);
      strcpy(anc_WV.filename[2],param->ncep_file_name[2]);
      strcpy(anc_WV.filename[3],param->ncep_file_name[3]);
-     if (read_grib_anc(&anc_WV,TYPE_WV_DATA))
-       EXIT_ERROR("Can't read NCEP WV data","main");
 
      anc_SP.data[0]=NULL;
      anc_SP.data[1]=NULL;
@@ -599,8 +635,6 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
      strcpy(anc_SP.filename[1],param->ncep_file_name[1]);
      strcpy(anc_SP.filename[2],param->ncep_file_name[2]);
      strcpy(anc_SP.filename[3],param->ncep_file_name[3]);
-     if (read_grib_anc(&anc_SP,TYPE_SP_DATA))
-       EXIT_ERROR("Can't read NCEP SP data","main");
 
      anc_ATEMP.data[0]=NULL;
      anc_ATEMP.data[1]=NULL;
@@ -613,8 +647,10 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
      strcpy(anc_ATEMP.filename[1],param->ncep_file_name[1]);
      strcpy(anc_ATEMP.filename[2],param->ncep_file_name[2]);
      strcpy(anc_ATEMP.filename[3],param->ncep_file_name[3]);
-     if (read_grib_anc(&anc_ATEMP,TYPE_ATEMP_DATA))
-       EXIT_ERROR("Can't read NCEP SP data","main");
+
+     /* the four fields are read in one pass over the NCEP files */
+     if (read_grib_anc_all(ncep_anc,ncep_type,4,param->ncep_index))
+       EXIT_ERROR("Can't read NCEP data","main");
 
    } else {
      EXIT_ERROR("No input NCEP or PRWV data specified","main");
@@ -635,28 +671,12 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
       anc_O3.data[i][j] /= 1000.;  /* convert to cm-atm */
    }
 
-   /* read DEM file */
+   /* read the DEM around the scene (or map the raw DEM) */
    dem_name= (char*)(param->dem_flag ? param->dem_file : DEMFILE );
-  /* Open file for SD access */
-  sds_file_id = SDstart((char *)dem_name, DFACC_RDONLY);
-  if (sds_file_id == HDF_ERROR) {
-    EXIT_ERROR("opening dem_file", "OpenDem");
-  }
-  sds_index=0;		   
-  sds_id= SDselect(sds_file_id,sds_index);
-  status=  SDgetinfo(sds_id, sds_name, &rank, dim_sizes, &data_type,&n_attrs);
-  start[0]=0;
-  start[1]=0;
-  edges[0]=3600;   /* number of lines in the DEM data */
-  edges[1]=7200;   /* number of sampes in the DEM data */
-  stride[0]=1;
-  stride[1]=1;
-  dem_array=(short *)malloc(DEM_NBLAT*DEM_NBLON*sizeof(short));
-  status=SDreaddata(sds_id,start, stride, edges,dem_array);	   
-  if (status != 0 ) {
-      printf("Fatal error DEM file not read\n");
-      exit(EXIT_FAILURE);
-  }
+  dem=read_dem(dem_name, param->dem_raw_file, space, input->size.l,
+    input->size.s);
+  if (dem == NULL)
+    EXIT_ERROR("reading the DEM", "main");
   dem_available=1;
 
 
@@ -670,6 +690,16 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
    }
    print_anc_data(&anc_O3,"OZONE_DATA");
 
+  /* Interpolate the ancillary data in time at the scene time once; they are
+     then only interpolated spatially on the scene grids */
+  if (time_interpol_anc(&anc_WV,scene_gmt,&scene_WV) ||
+      time_interpol_anc(&anc_SP,scene_gmt,&scene_SP) ||
+      time_interpol_anc(&anc_ATEMP,scene_gmt,&scene_ATEMP))
+    EXIT_ERROR("interpolating the ancillary data at the scene time","main");
+  if (!no_ozone_file &&
+      time_interpol_anc(&anc_O3,scene_gmt,&scene_O3))
+    EXIT_ERROR("interpolating the ozone data at the scene time","main");
+
 /****
 	Get center lat lon and deviation from true north
 ****/
@@ -711,24 +741,11 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 	Run 6S and compute atmcor params
 ****/
 /*    printf ("DEBUG: Interpolating WV at scene center ...\n"); */
-   	interpol_spatial_anc(&anc_WV,center_lat,center_lon,tmpflt_arr);
-   	tmpint=(int)(scene_gmt/anc_WV.timeres);
-   	if (tmpint>=(anc_WV.nblayers-1))
-		tmpint=anc_WV.nblayers-2;
-   	coef=(double)(scene_gmt-anc_WV.time[tmpint])/anc_WV.timeres;
-   	sixs_tables.uwv=(1.-coef)*tmpflt_arr[tmpint]+coef*tmpflt_arr[tmpint+1];
+   	regrid_anc(&scene_WV,&center_lat,&center_lon,1,&sixs_tables.uwv);
 
    	if (!no_ozone_file) {
 /*        printf ("DEBUG: Interpolating ozone at scene center ...\n"); */
-   		interpol_spatial_anc(&anc_O3,center_lat,center_lon,tmpflt_arr);
-   		tmpint=(int)(scene_gmt/anc_O3.timeres);
-   		if ( anc_O3.nblayers> 1 ){
-      		if (tmpint>=(anc_O3.nblayers-1))tmpint=anc_O3.nblayers-2;
-   			coef=(double)(scene_gmt-anc_O3.time[tmpint])/anc_O3.timeres;
-    		sixs_tables.uoz=(1.-coef)*tmpflt_arr[tmpint]+coef*tmpflt_arr[tmpint+1];
-		} else {
-    	  	sixs_tables.uoz=tmpflt_arr[tmpint];
-		}
+   		regrid_anc(&scene_O3,&center_lat,&center_lon,1,&sixs_tables.uoz);
    	} else {
          jday=(short)input->meta.acq_date.doy;    	  
          sixs_tables.uoz=calcuoz(jday,(float)center_lat);
@@ -768,7 +785,19 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 		default:
 			EXIT_ERROR("Unknown Instrument", "main");
 	}
-	create_6S_tables(&sixs_tables, &input->meta);
+	if (param->sixs_lut_file != NULL) {
+		sixs_lut = read_6S_lut(param->sixs_lut_file);
+		if (sixs_lut == NULL)
+			EXIT_ERROR("reading 6S LUT file", "main");
+		if (interp_6S_tables(sixs_lut, &sixs_tables)) {
+			printf("Scene is not covered by the 6S LUT, running 6S\n");
+			create_6S_tables(&sixs_tables, param->num_sixs_workers,
+			  param->sixs_cache_dir);
+		}
+		free(sixs_lut);
+	} else
+		create_6S_tables(&sixs_tables, param->num_sixs_workers,
+		  param->sixs_cache_dir);
 #ifdef SAVE_6S_RESULTS
 	write_6S_results_to_file(SIXS_RESULTS_FILENAME,&sixs_tables);
 	}
@@ -793,42 +822,29 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
         ar_gridcell.sun_zen[il_ar*lut->ar_size.s+is_ar]=input->meta.sun_zen*DEG;
         ar_gridcell.view_zen[il_ar*lut->ar_size.s+is_ar]=3.5;
         ar_gridcell.rel_az[il_ar*lut->ar_size.s+is_ar]=corrected_sun_az;
+     }
+  }
 
-    	interpol_spatial_anc(&anc_WV,ar_gridcell.lat[il_ar*lut->ar_size.s+is_ar],ar_gridcell.lon[il_ar*lut->ar_size.s+is_ar],tmpflt_arr);
-    	tmpint=(int)(scene_gmt/anc_WV.timeres);
-    	if (tmpint>=(anc_WV.nblayers-1))
-		tmpint=anc_WV.nblayers-2;
-    	coef=(double)(scene_gmt-anc_WV.time[tmpint])/anc_WV.timeres;
-    	ar_gridcell.wv[il_ar*lut->ar_size.s+is_ar]=(1.-coef)*tmpflt_arr[tmpint]+coef*tmpflt_arr[tmpint+1];
-
-        if (!no_ozone_file) {
-           interpol_spatial_anc(&anc_O3,ar_gridcell.lat[il_ar*lut->ar_size.s+is_ar],ar_gridcell.lon[il_ar*lut->ar_size.s+is_ar],tmpflt_arr);
-    	   tmpint=(int)(scene_gmt/anc_O3.timeres);
-           if ( anc_O3.nblayers> 1 ){
-              if (tmpint>=(anc_O3.nblayers-1))
-                 tmpint=anc_O3.nblayers-2;
-    	      coef=(double)(scene_gmt-anc_O3.time[tmpint])/anc_O3.timeres;
-    	      ar_gridcell.ozone[il_ar*lut->ar_size.s+is_ar]=(1.-coef)*tmpflt_arr[tmpint]+coef*tmpflt_arr[tmpint+1];
-	   		} else {
-    	      ar_gridcell.ozone[il_ar*lut->ar_size.s+is_ar]=tmpflt_arr[tmpint];
-	   		}
-        } else {
+  /* Resample the scene time ancillary data on the AR grid */
+  nbpts=lut->ar_size.l*lut->ar_size.s;
+  regrid_anc(&scene_WV,ar_gridcell.lat,ar_gridcell.lon,nbpts,ar_gridcell.wv);
+  regrid_anc(&scene_SP,ar_gridcell.lat,ar_gridcell.lon,nbpts,ar_gridcell.spres);
+  if (!no_ozone_file)
+     regrid_anc(&scene_O3,ar_gridcell.lat,ar_gridcell.lon,nbpts,ar_gridcell.ozone);
+
+  for (il_ar = 0; il_ar < lut->ar_size.l;il_ar++) {
+     for (is_ar=0;is_ar < lut->ar_size.s; is_ar++) {
+        if (no_ozone_file) {
            jday=(short)input->meta.acq_date.doy;
     	   ar_gridcell.ozone[il_ar*lut->ar_size.s+is_ar]=calcuoz(jday,(float)ar_gridcell.lat[il_ar*lut->ar_size.s+is_ar]);
         }
 
-    	interpol_spatial_anc(&anc_SP,ar_gridcell.lat[il_ar*lut->ar_size.s+is_ar],ar_gridcell.lon[il_ar*lut->ar_size.s+is_ar],tmpflt_arr);
-    	tmpint=(int)(scene_gmt/anc_SP.timeres);
-    	if (tmpint>=(anc_SP.nblayers-1))
-			tmpint=anc_SP.nblayers-2;
-    	coef=(double)(scene_gmt-anc_SP.time[tmpint])/anc_SP.timeres;
-    	ar_gridcell.spres[il_ar*lut->ar_size.s+is_ar]=(1.-coef)*tmpflt_arr[tmpint]+coef*tmpflt_arr[tmpint+1];
         if (ar_gridcell.spres[il_ar*lut->ar_size.s+is_ar] > 0) {
            sum_spres_anc += ar_gridcell.spres[il_ar*lut->ar_size.s+is_ar];
            nb_spres_anc++;
         }
         if (dem_available) {
-	   		ar_gridcell.spres_dem[il_ar*lut->ar_size.s+is_ar]=get_dem_spres(dem_array,ar_gridcell.lat[il_ar*lut->ar_size.s+is_ar],ar_gridcell.lon[il_ar*lut->ar_size.s+is_ar]);
+	   		ar_gridcell.spres_dem[il_ar*lut->ar_size.s+is_ar]=get_dem_spres(dem,ar_gridcell.lat[il_ar*lut->ar_size.s+is_ar],ar_gridcell.lon[il_ar*lut->ar_size.s+is_ar]);
            if (ar_gridcell.spres_dem[il_ar*lut->ar_size.s+is_ar] > 0) {
               sum_spres_dem += ar_gridcell.spres_dem[il_ar*lut->ar_size.s+is_ar];
               nb_spres_dem++;
@@ -869,70 +885,78 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
      		EXIT_ERROR("couldn't allocate memory from cld_diags","main");
 	}
 
-  for (il = 0; il < input->size.l; il++) {
+  /* The lat/long of the pixels of the clear pixels stats pass (for the air
+     temperature) are interpolated from a coarse grid of projected points */
+  if (param->thermal_band) {
+    geogrid = make_geogrid(space, input->size.l, input->size.s, 0., 0.,
+      param->geogrid_max_err);
+    if (geogrid == NULL)
+      EXIT_ERROR("creating the geolocation grid", "main");
+    if (geogrid->step > 0)
+      printf("Geolocation grid: step %d, max error %g deg (%ld projections)\n",
+        geogrid->step, geogrid->err, geogrid->nb_proj);
+    else
+      printf("Geolocation grid: exact mapping of every pixel\n");
+
+    /* air temperature at the center of the cld_diags cells */
+    cell_lat = (float *)malloc(cld_diags.nbcols*sizeof(float));
+    cell_lon = (float *)malloc(cld_diags.nbcols*sizeof(float));
+    if (cell_lat == NULL || cell_lon == NULL)
+      EXIT_ERROR("allocating cld_diags cell lat/long", "main");
+	img.is_fill=false;
+	for (il=0;il<cld_diags.nbrows;il++) {
+		img.l=il*cld_diags.cellheight+cld_diags.cellheight/2.;
+		if (img.l >= input->size.l)
+			img.l = input->size.l-1;
+		for (is=0;is<cld_diags.nbcols;is++) {
+			img.s=is*cld_diags.cellwidth+cld_diags.cellwidth/2.;
+			if (img.s >= input->size.s)
+				img.s = input->size.s-1;
+			if (!from_space(space, &img, &geo))
+    	   		EXIT_ERROR("mapping from space (3)", "main");
+        	cell_lat[is]=geo.lat * DEG;
+        	cell_lon[is]=geo.lon * DEG;
+		}
+		regrid_anc(&scene_ATEMP,cell_lat,cell_lon,cld_diags.nbcols,
+		  cld_diags.airtemp_2m[il]);
+	}
+    free(cell_lat);
+    free(cell_lon);
+  }
+
+  /* The clear pixels stats are only used with the thermal band, so the
+     input is only read for them in that case */
+  for (il = 0; param->thermal_band && il < input->size.l; il++) {
 	if (!(il%100)) 
     {
        printf("Cloud screening for line %d\r",il);
        fflush(stdout);
     }
 
-    /* Read each input band */
+    /* Read each input band (band 2 is not used by cloud detection pass 1) */
     for (ib = 0; ib < input->nband; ib++) {
+      if (ib == 1)
+        continue;
       if (!GetInputLine(input, ib, il, line_in[0][ib]))
         EXIT_ERROR("reading input data for a line (b)", "main");
     }
     if (!GetInputQALine(input, il, qa_line[0]))
       EXIT_ERROR("reading input data for qa_line (1)", "main");
-    if (param->thermal_band) {
-     if (!GetInputLine(input_b6, 0, il, b6_line[0]))
-       EXIT_ERROR("reading input data for b6_line (1)", "main");
-    }
+    if (!GetInputLine(input_b6, 0, il, b6_line[0]))
+      EXIT_ERROR("reading input data for b6_line (1)", "main");
+
+    if (geogrid_anc_line(geogrid, &scene_ATEMP, il, atemp_line))
+      EXIT_ERROR("mapping from space (2)", "main");
 
-    tmpint=(int)(scene_gmt/anc_ATEMP.timeres);
-    if (tmpint>=(anc_ATEMP.nblayers-1))
-	tmpint=anc_ATEMP.nblayers-2;
-    coef=(double)(scene_gmt-anc_ATEMP.time[tmpint])/anc_ATEMP.timeres;
-	img.is_fill=false;
-	img.l=il;
-    for (is=0;is < input->size.s; is++) {
-	img.s=is;
-		if (!from_space(space, &img, &geo))
-    	   EXIT_ERROR("mapping from space (2)", "main");
-        flat=geo.lat * DEG;
-        flon=geo.lon * DEG;
-
-    	interpol_spatial_anc(&anc_ATEMP,flat,flon,tmpflt_arr);
-    	atemp_line[is]=(1.-coef)*tmpflt_arr[tmpint]+coef*tmpflt_arr[tmpint+1];
-	}
     /* Run Cld Screening Pass1 and compute stats */
-    if (param->thermal_band)
-      if (!cloud_detection_pass1(lut, input->size.s, il, line_in[0],
-        qa_line[0], b6_line[0], atemp_line,&cld_diags))
-          EXIT_ERROR("running cloud detection pass 1", "main");
+    if (!cloud_detection_pass1(lut, input->size.s, il, line_in[0],
+      qa_line[0], b6_line[0], atemp_line,&cld_diags))
+        EXIT_ERROR("running cloud detection pass 1", "main");
   } /* end for */
 
   if (param->thermal_band) {
 	for (il=0;il<cld_diags.nbrows;il++) {
-    	tmpint=(int)(scene_gmt/anc_ATEMP.timeres);
-    	if (tmpint>=(anc_ATEMP.nblayers-1))
-			tmpint=anc_ATEMP.nblayers-2;
-    	coef=(double)(scene_gmt-anc_ATEMP.time[tmpint])/anc_ATEMP.timeres;
-		img.is_fill=false;
-		img.l=il*cld_diags.cellheight+cld_diags.cellheight/2.;
-		if (img.l >= input->size.l)
-			img.l = input->size.l-1;
 		for (is=0;is<cld_diags.nbcols;is++) {
-			img.s=is*cld_diags.cellwidth+cld_diags.cellwidth/2.;
-			if (img.s >= input->size.s)
-				img.s = input->size.s-1;
-			if (!from_space(space, &img, &geo))
-    	   		EXIT_ERROR("mapping from space (3)", "main");
-        	flat=geo.lat * DEG;
-        	flon=geo.lon * DEG;
-
-    		interpol_spatial_anc(&anc_ATEMP,flat,flon,tmpflt_arr);
-			cld_diags.airtemp_2m[il][is]=(1.-coef)*tmpflt_arr[tmpint]+coef*tmpflt_arr[tmpint+1];
-
 			if (cld_diags.nb_t6_clear[il][is] > 0) {
 				sum_value=cld_diags.avg_t6_clear[il][is];
 				sumsq_value=cld_diags.std_t6_clear[il][is];
@@ -968,17 +992,10 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 	fclose(fd_cld_diags);
 #endif
   }
-/***
-	Create dark target temporary file
-***/
-	strcpy(tmpfilename, "temporary_dark_target_XXXXXX");
-    if ((tmpid = mkstemp (tmpfilename)) < 1)
-      EXIT_ERROR("creating filename for dark target temporary file", "main");
-    close(tmpid);
-	if ((fdtmp=fopen(tmpfilename,"w"))==NULL)
-      EXIT_ERROR("creating dark target temporary file", "main");
-
-  /* Read input second time and create cloud and cloud shadow masks */
+  /* Read input second time and create cloud and cloud shadow masks.  Once
+     the masks of a region are final (after the shadows of the next region
+     are cast), the aerosol of that region is computed from the input lines
+     still in memory. */
   ptr_rot_cld[0]=rot_cld[0];
   ptr_rot_cld[1]=rot_cld[1];
   ptr_rot_cld[2]=rot_cld[2];
@@ -987,15 +1004,8 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
        il_start < input->size.l; 
        il_start += lut->ar_region_size.l, il_ar++) {
 
-    ar_gridcell.line_lat=&(ar_gridcell.lat[il_ar*lut->ar_size.s]);
-    ar_gridcell.line_lon=&(ar_gridcell.lon[il_ar*lut->ar_size.s]);
-    ar_gridcell.line_sun_zen=&(ar_gridcell.sun_zen[il_ar*lut->ar_size.s]);
-    ar_gridcell.line_view_zen=&(ar_gridcell.view_zen[il_ar*lut->ar_size.s]);
-    ar_gridcell.line_rel_az=&(ar_gridcell.rel_az[il_ar*lut->ar_size.s]);
-    ar_gridcell.line_wv=&(ar_gridcell.wv[il_ar*lut->ar_size.s]);
-    ar_gridcell.line_spres=&(ar_gridcell.spres[il_ar*lut->ar_size.s]);
-    ar_gridcell.line_ozone=&(ar_gridcell.ozone[il_ar*lut->ar_size.s]);
-    ar_gridcell.line_spres_dem=&(ar_gridcell.spres[il_ar*lut->ar_size.s]);
+    set_ar_gridcell_line(&ar_gridcell, lut, il_ar);
+    line_in = line_in_region[il_ar % 2];
     
     il_end = il_start + lut->ar_region_size.l - 1;
     if (il_end >= input->size.l) il_end = input->size.l - 1;
@@ -1038,10 +1048,22 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 		dilate_shadow_mask(lut, input->size.s, ptr_rot_cld, 5);
 	}
 /***
-	Save cloud and cloud shadow in temporary file
+	Save cloud and cloud shadow of the previous region and compute its
+	aerosol
 ***/
-	if (il_ar > 0)
-		if (fwrite(ptr_rot_cld[0][0],lut->ar_region_size.l*input->size.s,1,fdtmp)!=1) EXIT_ERROR("writing dark target to temporary file", "main");
+	if (il_ar > 0) {
+		memcpy(&ddv_buf[(il_ar-1)*ddv_region_size],ptr_rot_cld[0][0],ddv_region_size);
+		set_ar_gridcell_line(&ar_gridcell, lut, il_ar-1);
+		for (i=0;i<lut->ar_region_size.l;i++)
+			ddv_line[i]=&ddv_buf[(il_ar-1)*ddv_region_size+i*input->size.s];
+#ifdef DEBUG_AR
+		diags_il_ar=il_ar-1;
+#endif
+		if (!Ar(il_ar-1,lut, &input->size, line_in_region[(il_ar-1) % 2],
+		    ddv_line, line_ar[il_ar-1], line_ar_stats[il_ar-1], &ar_stats,
+		    &ar_gridcell, &sixs_tables))
+			EXIT_ERROR("computing aerosol", "main");
+	}
 	ptr_tmp_cld=ptr_rot_cld[0];
 	ptr_rot_cld[0]=ptr_rot_cld[1];
 	ptr_rot_cld[1]=ptr_rot_cld[2];
@@ -1051,74 +1073,18 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
   }
 /** Last Block */
   dilate_shadow_mask(lut, input->size.s, ptr_rot_cld, 5);
-  if (fwrite(ptr_rot_cld[0][0],lut->ar_region_size.l*input->size.s,1,fdtmp)!=1) EXIT_ERROR("writing dark target to temporary file", "main");
-   fclose(fdtmp);
-
-
-/***
-	Open temporary file for read and write
-***/
-	if ((fdtmp=fopen(tmpfilename,"r+"))==NULL) EXIT_ERROR("opening dark target temporary file (r+)", "main");
-/*	
-	if ((fdtmp2=fopen("Temporary_AOT1_File.dat","w"))==NULL) EXIT_ERROR("creating temporary aot1 file", "main");
-*/
-  /* Read input second time and compute the aerosol for each region */
-
-  for (il_start = 0, il_ar = 0; 
-       il_start < input->size.l; 
-       il_start += lut->ar_region_size.l, il_ar++) {
-
-    ar_gridcell.line_lat=&(ar_gridcell.lat[il_ar*lut->ar_size.s]);
-    ar_gridcell.line_lon=&(ar_gridcell.lon[il_ar*lut->ar_size.s]);
-    ar_gridcell.line_sun_zen=&(ar_gridcell.sun_zen[il_ar*lut->ar_size.s]);
-    ar_gridcell.line_view_zen=&(ar_gridcell.view_zen[il_ar*lut->ar_size.s]);
-    ar_gridcell.line_rel_az=&(ar_gridcell.rel_az[il_ar*lut->ar_size.s]);
-    ar_gridcell.line_wv=&(ar_gridcell.wv[il_ar*lut->ar_size.s]);
-    ar_gridcell.line_spres=&(ar_gridcell.spres[il_ar*lut->ar_size.s]);
-    ar_gridcell.line_ozone=&(ar_gridcell.ozone[il_ar*lut->ar_size.s]);
-    ar_gridcell.line_spres_dem=&(ar_gridcell.spres[il_ar*lut->ar_size.s]);
-    
-    il_end = il_start + lut->ar_region_size.l - 1;
-    if (il_end >= input->size.l) il_end = input->size.l - 1;
-	 
-	if (fseek(fdtmp,(long)(il_ar*lut->ar_region_size.l*input->size.s),SEEK_SET)) EXIT_ERROR("seeking in temporary file (r)", "main");
-	if (fread(ddv_line[0],lut->ar_region_size.l*input->size.s,1,fdtmp)!=1) EXIT_ERROR("reading dark target to temporary file", "main");
-
-    /* Read each input band for each line in region */
-
-    for (il = il_start, il_region = 0; 
-         il < (il_end + 1); 
-	 il++, il_region++) {
-      for (ib = 0; ib < input->nband; ib++) {
-        if (!GetInputLine(input, ib, il, line_in[il_region][ib]))
-          EXIT_ERROR("reading input data for a line (a)", "main");
-      }
-    }
-
-    /* Compute the aerosol for the regions */
-
-/*    printf("%d\n",il_ar); fflush(stdout); */
-/*  printf("%d\r",il_ar); fflush(stdout);    */
+  memcpy(&ddv_buf[(il_ar-1)*ddv_region_size],ptr_rot_cld[0][0],ddv_region_size);
+  set_ar_gridcell_line(&ar_gridcell, lut, il_ar-1);
+  for (i=0;i<lut->ar_region_size.l;i++)
+    ddv_line[i]=&ddv_buf[(il_ar-1)*ddv_region_size+i*input->size.s];
 #ifdef DEBUG_AR
-	diags_il_ar=il_ar;
+  diags_il_ar=il_ar-1;
 #endif
-    if (!Ar(il_ar,lut, &input->size, line_in, ddv_line, line_ar[il_ar],
-        line_ar_stats[il_ar], &ar_stats, &ar_gridcell, &sixs_tables))
-      EXIT_ERROR("computing aerosol", "main");
-/***
-	Save dark target map in temporary file
-***/
-	if (fseek(fdtmp,il_ar*lut->ar_region_size.l*input->size.s,SEEK_SET)) EXIT_ERROR("seeking in temporary file (w)", "main");
-	if (fwrite(ddv_line[0],lut->ar_region_size.l*input->size.s,1,fdtmp)!=1) EXIT_ERROR("writing dark target to temporary file", "main");
-/**
-	if (fwrite(line_ar[il_ar][0],lut->ar_size.s*2,1,fdtmp2)!=1) EXIT_ERROR("writing aot1 to temporary file", "main");
-**/
-  }
+  if (!Ar(il_ar-1,lut, &input->size, line_in_region[(il_ar-1) % 2],
+      ddv_line, line_ar[il_ar-1], line_ar_stats[il_ar-1], &ar_stats,
+      &ar_gridcell, &sixs_tables))
+    EXIT_ERROR("computing aerosol", "main");
   printf("\n");
-  fclose(fdtmp);
-/**
-  fclose(fdtmp2);
-**/
 #ifdef DEBUG_AR
 	fclose(fd_ar_diags);
 #endif
@@ -1145,41 +1111,70 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 	update_atmos_coefs(&atmos_coef,&ar_gridcell, &sixs_tables,line_ar, lut,input->nband, 1); */
 #endif
 
-  /* Re-read input and compute surface reflectance */
+  /* Re-read input and compute surface reflectance.  The lines of a block
+     are read in order, processed in parallel and written in order. */
+#ifdef _OPENMP
+  if (param->num_threads > 0)
+    omp_set_num_threads(param->num_threads);
+#endif
 
-/***
-	Open temporary file for read
-***/
-	if ((fdtmp=fopen(tmpfilename,"r"))==NULL) EXIT_ERROR("opening dark target temporary file", "main");
+  for (il_start = 0; il_start < input->size.l; il_start += SR_BLOCK_LINES) {
+    nb_sr_lines = input->size.l - il_start;
+    if (nb_sr_lines > SR_BLOCK_LINES)
+      nb_sr_lines = SR_BLOCK_LINES;
 
-  for (il = 0; il < input->size.l; il++) {
+    /* Re-read each input band (not copied if the input is memory mapped) */
+    for (il = il_start, i = 0; i < nb_sr_lines; il++, i++) {
 	if (!(il%100)) 
     {
        printf("Processing surface reflectance for line %d\r",il);
        fflush(stdout);
     }
-    /* Re-read each input band */
-
-    for (ib = 0; ib < input->nband; ib++) {
-      if (!GetInputLine(input, ib, il, line_in[0][ib]))
-        EXIT_ERROR("reading input data for a line (b)", "main");
+      for (ib = 0; ib < input->nband; ib++) {
+        blk_line_in[i][ib] = GetInputLinePtr(input, ib, il,
+          &blk_in_buf[((size_t)i*(input->nband+1)+ib)*input->size.s]);
+        if (blk_line_in[i][ib] == NULL)
+          EXIT_ERROR("reading input data for a line (b)", "main");
+      }
+      blk_b6_line[i] = GetInputLinePtr(input_b6, 0, il,
+        &blk_in_buf[((size_t)i*(input->nband+1)+input->nband)*input->size.s]);
+      if (blk_b6_line[i] == NULL)
+        EXIT_ERROR("reading input data for b6_line (1)", "main");
+
+      for (ib = 0; ib < output->nband_out; ib++) {
+        blk_sr_stats[i].nfill[ib] = 0;
+        blk_sr_stats[i].nsatu[ib] = 0;
+        blk_sr_stats[i].nout_range[ib] = 0;
+        blk_sr_stats[i].first[ib] = true;
+      }
     }
-    
-     if (!GetInputLine(input_b6, 0, il, b6_line[0]))
-       EXIT_ERROR("reading input data for b6_line (1)", "main");
 
-    /* Compute the surface reflectance */
-  	if (!Sr(lut, input->size.s, il, line_in[0], line_out, &sr_stats))
- 	  EXIT_ERROR("computing surface reflectance for a line", "main");
-
-/***
-	Read line from dark target temporary file
-***/
-	if (fread(ddv_line[0],input->size.s,1,fdtmp)!=1) EXIT_ERROR("reading line from dark target temporary file", "main");
+    /* errors are counted and reported after the parallel loop, since a
+       thread can't exit while the others are still processing */
+    nb_sr_error = 0;
+    #pragma omp parallel for schedule(dynamic) reduction(+:nb_sr_error)
+    for (i = 0; i < nb_sr_lines; i++) {
+      int il = il_start + i;
+      int is, ib, i_aot, j_aot;
+      int16 **line_out = blk_line_out[i];
+      int16 **line_in_il = blk_line_in[i];
+      int16 *b6_line_il = blk_b6_line[i];
+      char *ddv_line_il = &ddv_buf[(size_t)il*input->size.s];
+      Img_coord_int_t loc;
+      bool refl_is_fill;
+      int inter_aot[3];
+      int anom;
+      float t6,t6s_seuil;
+
+      /* Compute the surface reflectance */
+      if (!Sr(lut, input->size.s, il, line_in_il, line_out, &blk_sr_stats[i])) {
+        nb_sr_error++;
+        continue;
+      }
 
-	loc.l=il;
-  	 i_aot=il/lut->ar_region_size.l;
-	 for (is=0;is<input->size.s;is++) {
+      loc.l=il;
+      i_aot=il/lut->ar_region_size.l;
+      for (is=0;is<input->size.s;is++) {
 	 	loc.s=is;
 		j_aot=is/lut->ar_region_size.s;
 
@@ -1196,7 +1191,7 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
            band for this pixel is fill */
         refl_is_fill = false;
         for (ib = 0; ib < input->nband; ib++) {
-		    if (line_in[0][ib][is] == lut->in_fill)
+		    if (line_in_il[ib][is] == lut->in_fill)
                 if (!refl_is_fill)
                     refl_is_fill = true;
         }
@@ -1215,15 +1210,15 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
         bit 11: Spectral test-based land/water mask
         bit 12: SR-based adjacent cloud
         **/
-        if (ddv_line[0][is]&0x01)
+        if (ddv_line_il[is]&0x01)
             line_out[lut->nband+DDV][is] = QA_ON;  /* set dark target bit */
-        if (ddv_line[0][is]&0x10)
+        if (ddv_line_il[is]&0x10)
             line_out[lut->nband+LAND_WATER][is] = QA_OFF;  /* land */
         else
             line_out[lut->nband+LAND_WATER][is] = QA_ON;  /* water */
-        if (ddv_line[0][is]&0x20)
+        if (ddv_line_il[is]&0x20)
             line_out[lut->nband+CLOUD][is] = QA_ON;  /* set internal cloud mask bit */
-        if (ddv_line[0][is]&0x80)
+        if (ddv_line_il[is]&0x80)
             line_out[lut->nband+SNOW][is] = QA_ON;  /* set internal snow mask bit */
         /* try to redo the cloud mask Vermote May 29 2007 */
         /* reset cloud shadow and cloud adjacent bits - these are set
@@ -1232,7 +1227,7 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
         line_out[lut->nband+ADJ_CLOUD][is] = QA_OFF;
 				
 		anom=line_out[0][is]-line_out[2][is]/2.;
-		t6=b6_line[0][is]*0.1;
+		t6=b6_line_il[is]*0.1;
 		t6s_seuil=280.+(1000.*0.01);
 		if (( ( anom > 300 ) && ( line_out[4][is] > 300) && ( t6 < t6s_seuil) )
            || ( (line_out[2][is] > 5000) && ( t6 < t6s_seuil)))
@@ -1250,25 +1245,39 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 	  	line_out[lut->nband+AVG_DARK][is]=lut->in_fill;
 	   	line_out[lut->nband+STD_DARK][is]=lut->in_fill;
 		}
-    } /* for is */
-
-  /* Write each output band */
-  for (ib = 0; ib < output->nband_out; ib++) {
-    if (ib >= lut->nband+FILL && ib <= lut->nband+ADJ_CLOUD) {
-       /* fill, DDV, cloud, cloud shadow, snow, land/water, and adjacent
-          cloud QA bands are all 8-bit products */
-      if (!PutOutputLine(output, ib, il, line_out[ib]))
-        EXIT_ERROR("writing output data for a line", "main");
-    }
-    else {
-      if (!PutOutputLine(output, ib, il, line_out[ib]))
-        EXIT_ERROR("writing output data for a line", "main");
+      } /* for is */
+    } /* for i */
+    if (nb_sr_error > 0)
+      EXIT_ERROR("computing surface reflectance for a line", "main");
+
+    /* Write each output band and merge the statistics, in line order */
+    for (il = il_start, i = 0; i < nb_sr_lines; il++, i++) {
+      for (ib = 0; ib < output->nband_out; ib++) {
+        /* fill, DDV, cloud, cloud shadow, snow, land/water, and adjacent
+           cloud QA bands are all 8-bit products (converted by PutOutputLine) */
+        if (!PutOutputLine(output, ib, il, blk_line_out[i][ib]))
+          EXIT_ERROR("writing output data for a line", "main");
+      }
+      for (ib = 0; ib < lut->nband; ib++) {
+        sr_stats.nfill[ib] += blk_sr_stats[i].nfill[ib];
+        sr_stats.nsatu[ib] += blk_sr_stats[i].nsatu[ib];
+        sr_stats.nout_range[ib] += blk_sr_stats[i].nout_range[ib];
+        if (blk_sr_stats[i].first[ib])
+          continue;
+        if (sr_stats.first[ib]) {
+          sr_stats.sr_min[ib] = blk_sr_stats[i].sr_min[ib];
+          sr_stats.sr_max[ib] = blk_sr_stats[i].sr_max[ib];
+          sr_stats.first[ib] = false;
+        } else {
+          if (blk_sr_stats[i].sr_min[ib] < sr_stats.sr_min[ib])
+            sr_stats.sr_min[ib] = blk_sr_stats[i].sr_min[ib];
+          if (blk_sr_stats[i].sr_max[ib] > sr_stats.sr_max[ib])
+            sr_stats.sr_max[ib] = blk_sr_stats[i].sr_max[ib];
+        }
+      }
     }
-  }
-  }  /* for il */
+  }  /* for il_start */
   printf("\n");
-  fclose(fdtmp);
-  unlink(tmpfilename); 
 	
   /* Print the statistics, skip bands that don't exist */
   printf(" total pixels %ld\n", ((long)input->size.l * (long)input->size.s));
@@ -1325,24 +1334,26 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
   if (!FreeOutput(output)) 
     EXIT_ERROR("freeing output file stucture", "main");
 
+  free_geogrid(geogrid);
   free(space);
-  free(line_out[0]);
+  free(blk_out_buf);
+  free(blk_in_buf);
   free(line_ar[0][0]);
   free(line_ar[0]);
   free(line_ar);
   free(line_ar_stats[0][0]);
   free(line_ar_stats[0]);
   free(line_ar_stats);
-  free(line_in[0][0]);
-  free(line_in[0]);
-  free(line_in);
+  free(line_in_region[0][0][0]);
+  free(line_in_region[0][0]);
+  free(line_in_region[0]);
   free(qa_line[0]);
   free(qa_line);
   if (param->thermal_band) {
   	free(b6_line[0]);
   	free(b6_line);
   }
-  free(ddv_line[0]);
+  free(ddv_buf);
   free(ddv_line);
   free(rot_cld[0][0]);
   free(rot_cld[0]);
@@ -1360,8 +1371,13 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
      if (anc_WV.data[ifree]!=NULL) free(anc_WV.data[ifree]);
      if (anc_SP.data[ifree]!=NULL) free(anc_SP.data[ifree]);
   }
+  free_anc_data(&scene_WV);
+  free_anc_data(&scene_SP);
+  free_anc_data(&scene_ATEMP);
+  if (!no_ozone_file)
+     free_anc_data(&scene_O3);
   if (dem_available)
-     free(dem_array);
+     free_dem(dem);
   if (!FreeParam(param)) 
     EXIT_ERROR("freeing parameter stucture", "main");
 
@@ -1520,27 +1536,6 @@ C      / First loop for time/
    return tmpf;
 }
 
-float get_dem_spres(short *dem,float lat,float lon) {
-	int idem,jdem;
-	float dem_spres;
-		
-	idem=(int)((DEM_LATMAX-lat)/DEM_DLAT+0.5);
-	if (idem<0)
-		idem=0;
-	if (idem >= DEM_NBLAT)
-		idem=DEM_NBLAT-1;
-	jdem=(int)((lon-DEM_LONMIN)/DEM_DLON+0.5);
-	if (jdem<0)
-		jdem=0;
-	if (jdem >= DEM_NBLON)
-		jdem=DEM_NBLON-1;
-	if (dem[idem*DEM_NBLON+jdem]== -9999)
-		dem_spres=1013;
-	else
-		dem_spres=1013.2*exp(-dem[idem*DEM_NBLON+jdem]/8000.);
-
-	return dem_spres;
-}
 void swapbytes(void *val,int nbbytes) {
 /******************************************************************************
 !C
@@ -1734,80 +1729,15 @@ void sun_angles (short jday,float gmt,float flat,float flon,float *ts,float *fs)
       return;
 }
 
-/*
- * make sure the SIXS application exists in the path supplied.
- */
-#define MAX_SIXS_PATH_LEN 2048
-#define SIXS_APP   "sixsV1.0B"
-static char sixs_path[MAX_SIXS_PATH_LEN+1] = "";
-void set_sixs_path_from(const char *path)
-{
-  struct stat stbuf;
-  char *cptr = (char *)NULL;
-  
-  /*
-   * if passed in arg is path to a file, get the directory path
-   */
-  strncpy(sixs_path, path, MAX_SIXS_PATH_LEN);
-
-  /*
-   * if path ends in /, remove
-   */
-  for (cptr = &(sixs_path[strlen(sixs_path)-1]); *cptr == '/' && cptr >= &sixs_path[0]; --cptr)
-  {
-    *cptr = (char) 0;
-  }
-  
-  if (stat(sixs_path, &stbuf) != 0)    /* make sure the path exists */
-  {
-    /*    fprintf(stderr, "find_file: can't stat %s\n", sixs_path);
-	  exit(EXIT_FAILURE);*/
-  }
-  
-  /* if it's a file, find the end of the directory */
-  cptr = (char *)NULL;
-  if (! S_ISDIR(stbuf.st_mode))   /* not a directory */
-  {
-    cptr = rindex(sixs_path, '/');
-    if (cptr == NULL)            /* current directory */
-      sixs_path[0] = (char) 0;
-  }
-  
-   
-  /*
-   * create path to sixs application file
-   */
-  if (cptr)
-  {
-    strcpy((cptr+1), SIXS_APP);
-  }
-  else
-  {
-    strcat(sixs_path, SIXS_APP);
-  }
-   
-  /*
-   * and make sure it exists
-   */
-  if (stat(sixs_path, &stbuf) != 0)
-  {
-    /* fprintf(stderr, "find_file: can't stat %s\n", sixs_path);
-       exit(EXIT_FAILURE);*/
-  }
-}
-
-char *get_sixs_path()
-{
-  if (strlen(sixs_path) < 1)
-  {
-    printf("%s\n%s\n%s\n",
-      "NO SIXS_PATH defined!",
-      "  YOU FORGOT TO CALL set_sixs_path_from",
-      "  Cannot continue"
-    );
-    exit(-1);
-  }
-  
-  return &sixs_path[0];
+void set_ar_gridcell_line(Ar_gridcell_t *ar_gridcell, Lut_t *lut, int il_ar) {
+/* Point the line pointers of the aerosol grid cells to aerosol row il_ar */
+    ar_gridcell->line_lat=&(ar_gridcell->lat[il_ar*lut->ar_size.s]);
+    ar_gridcell->line_lon=&(ar_gridcell->lon[il_ar*lut->ar_size.s]);
+    ar_gridcell->line_sun_zen=&(ar_gridcell->sun_zen[il_ar*lut->ar_size.s]);
+    ar_gridcell->line_view_zen=&(ar_gridcell->view_zen[il_ar*lut->ar_size.s]);
+    ar_gridcell->line_rel_az=&(ar_gridcell->rel_az[il_ar*lut->ar_size.s]);
+    ar_gridcell->line_wv=&(ar_gridcell->wv[il_ar*lut->ar_size.s]);
+    ar_gridcell->line_spres=&(ar_gridcell->spres[il_ar*lut->ar_size.s]);
+    ar_gridcell->line_ozone=&(ar_gridcell->ozone[il_ar*lut->ar_size.s]);
+    ar_gridcell->line_spres_dem=&(ar_gridcell->spres[il_ar*lut->ar_size.s]);
 }
-
@@ -21,6 +21,8 @@
 #define NBAND_REFL_MAX (6)
 #define NBAND_PRWV_MAX (3)
 #define NBAND_SR_MAX (NBAND_REFL_MAX + NBAND_SR_EXTRA)
+#define SR_BLOCK_LINES (64)  /* lines processed in parallel in the surface
+                                reflectance pass */
 typedef enum {
   ATMOS_OPACITY = 0,
   FILL,
@@ -46,6 +46,12 @@
  Gail Schmidt, USGS EROS
  Modified application to utilize the ESPA internal raw binary format.
 
+ Revision 2.1 2015/11/10
+ The output lines are collected in blocks of OUTPUT_BLOCK_LINES lines which
+ are written by a writer thread while the next block is filled (double
+ buffering).  This also fixes the leak of the QA line buffer which was
+ allocated for every QA line written.
+
 !Team Unique Header:
   This software was developed by the MODIS Land Science Team Support 
   Group for the Laboratory for Terrestrial Physics (Code 922) at the 
@@ -70,10 +76,101 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
 #include "output.h"
 #include "input.h"
 #include "error.h"
 
+#define OUTPUT_BUF_ALIGN 4096  /* Alignment of the output blocks */
+
+static void *OutputWriter(void *arg)
+/* 
+!C******************************************************************************
+
+!Description: 'OutputWriter' is the writer thread.  It writes the output
+ blocks in order as they are handed over by PutOutputLine/CloseOutput, one
+ write per band and block, until CloseOutput stops it.
+ 
+!Input Parameters:
+ arg            'output' data structure
+
+!Output Parameters:
+ (returns)      NULL
+
+!END****************************************************************************
+*/
+{
+  Output_t *this = (Output_t *)arg;
+  int ibuf = 0;        /* block to be written next */
+  int nlines;          /* number of lines in the block */
+  int ib;              /* looping variable */
+  bool error;
+
+  pthread_mutex_lock(&this->mutex);
+  for (;;) {
+    while (this->pending[ibuf] == 0 && !this->quit)
+      pthread_cond_wait(&this->cond, &this->mutex);
+    if (this->pending[ibuf] == 0)
+      break;
+    nlines = this->pending[ibuf];
+    pthread_mutex_unlock(&this->mutex);
+
+    error = false;
+    for (ib = 0; ib < this->nband_out; ib++) {
+      if (write_raw_binary (this->fp_bin[ib], nlines, this->size.s,
+          this->nbytes[ib], this->buf[ibuf][ib]) != SUCCESS)
+        error = true;
+    }
+
+    pthread_mutex_lock(&this->mutex);
+    if (error)
+      this->write_error = true;
+    this->pending[ibuf] = 0;
+    pthread_cond_broadcast(&this->cond);
+    ibuf = (ibuf + 1) % OUTPUT_NBUF;
+  }
+  pthread_mutex_unlock(&this->mutex);
+
+  return NULL;
+}
+
+
+static bool SubmitOutputBlock(Output_t *this, int nlines)
+/* 
+!C******************************************************************************
+
+!Description: 'SubmitOutputBlock' hands the block being filled over to the
+ writer thread and waits until the next block is free.
+ 
+!Input Parameters:
+ this           'output' data structure
+ nlines         number of lines in the block
+
+!Output Parameters:
+ (returns)      status:
+                  'true' = okay
+                  'false' = a block could not be written
+
+!END****************************************************************************
+*/
+{
+  bool error;
+
+  pthread_mutex_lock(&this->mutex);
+  this->pending[this->cur] = nlines;
+  pthread_cond_broadcast(&this->cond);
+  this->cur = (this->cur + 1) % OUTPUT_NBUF;
+  while (this->pending[this->cur] != 0)
+    pthread_cond_wait(&this->cond, &this->mutex);
+  error = this->write_error;
+  pthread_mutex_unlock(&this->mutex);
+
+  this->cur_line += nlines;
+  this->cur_count = 0;
+
+  return !error;
+}
+
 
 Output_t *OpenOutput(Espa_internal_meta_t *in_meta, Input_t *input,
   Param_t *param, Lut_t *lut)
@@ -119,6 +216,7 @@ revision on 1/15/2015 by Gail Schmidt, USGS/EROS
   int nband_tot;      /* number of total bands with QA, for processing */
   int nband_out;      /* number of total bands with QA, for writing/output */
   int nband_out_extra; /* number of extra QA bands for writing/output */
+  int ibuf;           /* looping variable for the output blocks */
   int rep_indx=-1;    /* band index in XML file for the current product */
   char production_date[MAX_DATE_LEN+1]; /* current date/time for production */
   time_t tp;          /* time structure */
@@ -298,7 +396,30 @@ revision on 1/15/2015 by Gail Schmidt, USGS/EROS
     this->fp_bin[ib] = open_raw_binary (bmeta[ib].file_name, "w");
     if (this->fp_bin[ib] == NULL)
       RETURN_ERROR("unable to open output band file", "OpenOutput", NULL);
+
+    /* Allocate the output blocks of the band */
+    this->nbytes[ib] = (bmeta[ib].data_type == ESPA_INT16) ?
+      sizeof (int16) : sizeof (uint8);
+    for (ibuf = 0; ibuf < OUTPUT_NBUF; ibuf++) {
+      if (posix_memalign (&this->buf[ibuf][ib], OUTPUT_BUF_ALIGN,
+          (size_t)OUTPUT_BLOCK_LINES * this->size.s * this->nbytes[ib]) != 0)
+        RETURN_ERROR("allocating output block", "OpenOutput", NULL);
+    }
   }  /* for ib */
+
+  /* Start the writer thread */
+  for (ibuf = 0; ibuf < OUTPUT_NBUF; ibuf++)
+    this->pending[ibuf] = 0;
+  this->cur = 0;
+  this->cur_line = 0;
+  this->cur_count = 0;
+  this->quit = false;
+  this->write_error = false;
+  if (pthread_mutex_init (&this->mutex, NULL) != 0 ||
+      pthread_cond_init (&this->cond, NULL) != 0)
+    RETURN_ERROR("initializing output writer lock", "OpenOutput", NULL);
+  if (pthread_create (&this->writer, NULL, OutputWriter, this) != 0)
+    RETURN_ERROR("starting output writer thread", "OpenOutput", NULL);
   this->open = true;
 
   /* Successful completion */
@@ -325,15 +446,38 @@ bool CloseOutput(Output_t *this)
 !END****************************************************************************
 */
 {
-  int ib;
+  int ib, ibuf;
+  bool error = false;
 
   if (!this->open)
     RETURN_ERROR("image files not open", "CloseOutput", false);
 
-  for (ib = 0; ib < this->nband_out; ib++)
+  /* Write the last (partial) block and stop the writer thread */
+  if (this->cur_count % this->nband_out != 0)
+    error = true;
+  else if (this->cur_count > 0) {
+    if (!SubmitOutputBlock(this, this->cur_count / this->nband_out))
+      error = true;
+  }
+  pthread_mutex_lock(&this->mutex);
+  this->quit = true;
+  pthread_cond_broadcast(&this->cond);
+  pthread_mutex_unlock(&this->mutex);
+  pthread_join(this->writer, NULL);
+  if (this->write_error)
+    error = true;
+  pthread_cond_destroy(&this->cond);
+  pthread_mutex_destroy(&this->mutex);
+
+  for (ib = 0; ib < this->nband_out; ib++) {
     close_raw_binary (this->fp_bin[ib]);
+    for (ibuf = 0; ibuf < OUTPUT_NBUF; ibuf++)
+      free(this->buf[ibuf][ib]);
+  }
 
   this->open = false;
+  if (error)
+    RETURN_ERROR("writing output lines", "CloseOutput", false);
   return true;
 }
 
@@ -371,11 +515,14 @@ bool PutOutputLine(Output_t *this, int iband, int iline, int16 *line)
 !C******************************************************************************
 
 !Description: 'PutOutputLine' writes a line of data to the output file.
+ The line is copied to the block being filled, which is handed over to the
+ writer thread once all the bands of its lines are put.  The lines must be
+ put in order.
  
 !Input Parameters:
  this           'output' data structure
  iband          index (within Output_t struct) of output band to be written
- iline          output line number (used for validation only)
+ iline          output line number
  line           buffer of data to be written (int16); if it's QA data then
                 it will get converted to uint8 before writing
 
@@ -387,11 +534,10 @@ bool PutOutputLine(Output_t *this, int iband, int iline, int16 *line)
 !END****************************************************************************
 */
 {
-  int ib;              /* looping variable */
-  int nbytes = 0;      /* number of bytes in each pixel */
-  uint8 *qabuf = NULL; /* buffer for QA data */
-  Espa_band_meta_t *bmeta = this->metadata.band;  /* pointer to band metadata */
-  void *void_buf = NULL;
+  int is;              /* looping variable */
+  int nlines;          /* number of lines in the block being filled */
+  uint8 *qabuf = NULL; /* block line for QA data */
+  size_t offset;       /* offset of the line in the block */
 
   /* Check the parameters */
   if (this == NULL) 
@@ -402,28 +548,30 @@ bool PutOutputLine(Output_t *this, int iband, int iline, int16 *line)
     RETURN_ERROR("invalid band number", "PutOutputLine", false);
   if (iline < 0 || iline >= this->size.l)
     RETURN_ERROR("invalid line number", "PutOutputLine", false);
-
-  /* Write the data, only the current line (i.e. one line at a time). If the
-     output band is UINT8, then convert the input line to UINT8 before
-     writing. */
-  if (bmeta[iband].data_type == ESPA_INT16) {
-    nbytes = sizeof (int16);
-    void_buf = line;
-  }
+  nlines = this->size.l - this->cur_line;
+  if (nlines > OUTPUT_BLOCK_LINES)
+    nlines = OUTPUT_BLOCK_LINES;
+  if (iline < this->cur_line || iline >= this->cur_line + nlines)
+    RETURN_ERROR("line not written in order", "PutOutputLine", false);
+
+  /* Copy the line to the block. If the output band is UINT8, then convert
+     the input line to UINT8. */
+  offset = (size_t)(iline - this->cur_line) * this->size.s;
+  if (this->nbytes[iband] == sizeof (int16))
+    memcpy ((int16 *)this->buf[this->cur][iband] + offset, line,
+      this->size.s * sizeof (int16));
   else {
-    nbytes = sizeof (uint8);
-    qabuf = (uint8 *)calloc(this->size.s, nbytes);
-    if (qabuf == NULL) 
-      RETURN_ERROR("allocating output line buffer (uint8)", "PutOutputLine",
-        false);
-    for (ib = 0; ib < this->size.s; ib++)
-      qabuf[ib] = line[ib];
-    void_buf = qabuf;
+    qabuf = (uint8 *)this->buf[this->cur][iband] + offset;
+    for (is = 0; is < this->size.s; is++)
+      qabuf[is] = line[is];
   }
 
-  if (write_raw_binary (this->fp_bin[iband], 1, this->size.s, nbytes, void_buf)
-      != SUCCESS)
-    RETURN_ERROR("writing output line", "PutOutputLine", false);
+  /* Hand the block over to the writer thread once it is complete */
+  this->cur_count++;
+  if (this->cur_count == (long)nlines * this->nband_out) {
+    if (!SubmitOutputBlock(this, nlines))
+      RETURN_ERROR("writing output lines", "PutOutputLine", false);
+  }
 
   return true;
 }
@@ -41,6 +41,7 @@
 #define OUTPUT_H
 
 #include <time.h>
+#include <pthread.h>
 #include "lndsr.h"
 #include "bool.h"
 #include "input.h"
@@ -49,6 +50,9 @@
 #include "espa_metadata.h"
 #include "raw_binary_io.h"
 
+#define OUTPUT_NBUF 2          /* Number of output blocks (double buffer) */
+#define OUTPUT_BLOCK_LINES 64  /* Number of lines of each output block */
+
 /* Structure for the 'output' data type */
 
 typedef struct {
@@ -61,6 +65,20 @@ typedef struct {
                            metadata for the output bands; global metadata
                            won't be valid */
   FILE *fp_bin[NBAND_SR_MAX];  /* File pointer for binary files */
+  int nbytes[NBAND_SR_MAX];    /* Number of bytes of each output pixel */
+  void *buf[OUTPUT_NBUF][NBAND_SR_MAX];  /* Output blocks of
+                           OUTPUT_BLOCK_LINES lines, for each band */
+  int pending[OUTPUT_NBUF];  /* Number of lines of each block waiting for
+                           the writer thread; 0 = block free */
+  int cur;              /* Block being filled by PutOutputLine */
+  int cur_line;         /* First line of the block being filled */
+  long cur_count;       /* Number of band lines put in the block being
+                           filled */
+  bool quit;            /* Flag to stop the writer thread */
+  bool write_error;     /* Flag set by the writer thread on a write error */
+  pthread_t writer;     /* Writer thread */
+  pthread_mutex_t mutex;  /* Protects pending, quit and write_error */
+  pthread_cond_t cond;  /* Signals a change of pending or quit */
 } Output_t;
 
 /* Prototypes */
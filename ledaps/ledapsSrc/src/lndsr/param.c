@@ -38,6 +38,35 @@
  Revision 2.0 02/03/2014 Gail Schmidt, USGS EROS
  Modified applications to use the ESPA internal raw binary file format.
 
+ Revision 2.1 11/02/2015
+ Added the optional NUM_SIXS_WORKERS parameter for the number of 6S runs
+ to execute concurrently.
+
+ Revision 2.2 11/04/2015
+ Added the optional SIXS_CACHE_DIR parameter for the directory of the
+ shared 6S tables cache.
+
+ Revision 2.3 11/05/2015
+ Added the optional SIXS_LUT_FILE parameter for the precomputed 6S LUT.
+
+ Revision 2.4 11/09/2015
+ Added the optional INPUT_MMAP parameter to memory map the input files.
+
+ Revision 2.5 11/10/2015
+ Added the optional NUM_THREADS parameter for the number of threads of the
+ surface reflectance pass.
+
+ Revision 2.6 11/19/2015
+ Added the optional GEOGRID_MAX_ERROR parameter for the error bound of the
+ geolocation grid of the clear pixel stats pass.
+
+ Revision 2.7 11/20/2015
+ Added the optional NCEP_INDEX parameter to save the message index of the
+ NCEP GRIB files next to them.
+
+ Revision 2.8 11/20/2015
+ Added the optional DEM_RAW_FILE parameter for the memory mapped raw DEM.
+
 !Team Unique Header:
   This software was developed by the MODIS Land Science Team Support 
   Group for the Laboratory for Terrestrial Physics (Code 922) at the 
@@ -83,6 +112,7 @@
 #include "param.h"
 #include "mystring.h"
 #include "error.h"
+#include "geogrid.h"
 
 typedef enum {
   PARAM_NULL = -1,
@@ -93,6 +123,14 @@ typedef enum {
   PARAM_OZON_FILE,
   PARAM_DEM_FILE,
   PARAM_LEDAPSVERSION,
+  PARAM_SIXS_WORKERS,
+  PARAM_SIXS_CACHE_DIR,
+  PARAM_SIXS_LUT_FILE,
+  PARAM_INPUT_MMAP,
+  PARAM_NUM_THREADS,
+  PARAM_GEOGRID_MAX_ERROR,
+  PARAM_NCEP_INDEX,
+  PARAM_DEM_RAW_FILE,
   PARAM_END,
   PARAM_MAX
 } Param_key_t;
@@ -105,6 +143,14 @@ Key_string_t Param_string[PARAM_MAX] = {
   {(int)PARAM_OZON_FILE, "OZON_FIL"},
   {(int)PARAM_DEM_FILE,  "DEM_FILE"},
   {(int)PARAM_LEDAPSVERSION,  "LEDAPSVersion"},
+  {(int)PARAM_SIXS_WORKERS,  "NUM_SIXS_WORKERS"},
+  {(int)PARAM_SIXS_CACHE_DIR,  "SIXS_CACHE_DIR"},
+  {(int)PARAM_SIXS_LUT_FILE,  "SIXS_LUT_FILE"},
+  {(int)PARAM_INPUT_MMAP,  "INPUT_MMAP"},
+  {(int)PARAM_NUM_THREADS,  "NUM_THREADS"},
+  {(int)PARAM_GEOGRID_MAX_ERROR,  "GEOGRID_MAX_ERROR"},
+  {(int)PARAM_NCEP_INDEX,  "NCEP_INDEX"},
+  {(int)PARAM_DEM_RAW_FILE,  "DEM_RAW_FILE"},
   {(int)PARAM_END,       "END"}
 };
 
@@ -169,6 +215,14 @@ Param_t *GetParam(int argc, const char **argv)
   this->dem_file = NULL;
   this->dem_flag = false;
   this->thermal_band=false;
+  this->num_sixs_workers = 0;            /* one per online processor */
+  this->sixs_cache_dir = NULL;           /* no 6S tables cache */
+  this->sixs_lut_file = NULL;            /* run 6S for the scene */
+  this->input_mmap = false;              /* read the input line by line */
+  this->num_threads = 0;                 /* OpenMP default */
+  this->geogrid_max_err = GEOGRID_MAX_ERROR;
+  this->ncep_index = false;              /* index the NCEP files each run */
+  this->dem_raw_file = NULL;             /* read the HDF DEM */
 
   /* Populate the data structure */
   this->param_file_name = DupString(param_file_name);
@@ -341,6 +395,143 @@ Param_t *GetParam(int argc, const char **argv)
         }
         break;
 
+      case PARAM_SIXS_WORKERS:
+        if (key.nval <= 0) {
+          error_string = "no number of 6S workers";
+          break;
+        } else if (key.nval > 1) {
+          error_string = "too many number of 6S workers values";
+          break;
+        }
+        key.value[0][key.len_value[0]] = '\0';
+        if (sscanf(key.value[0], "%d", &this->num_sixs_workers) != 1 ||
+            this->num_sixs_workers < 0) {
+          error_string = "invalid number of 6S workers";
+          break;
+        }
+        break;
+
+      case PARAM_SIXS_CACHE_DIR:
+        if (key.nval <= 0)
+          break;
+        else if (key.nval > 1) {
+          error_string = "too many 6S cache directories";
+          break;
+        }
+        if (key.len_value[0] < 1)
+          break;
+        key.value[0][key.len_value[0]] = '\0';
+        this->sixs_cache_dir = DupString(key.value[0]);
+        if (this->sixs_cache_dir == NULL) {
+          error_string = "duplicating 6S cache directory";
+          break;
+        }
+        break;
+
+      case PARAM_SIXS_LUT_FILE:
+        if (key.nval <= 0)
+          break;
+        else if (key.nval > 1) {
+          error_string = "too many 6S LUT file names";
+          break;
+        }
+        if (key.len_value[0] < 1)
+          break;
+        key.value[0][key.len_value[0]] = '\0';
+        this->sixs_lut_file = DupString(key.value[0]);
+        if (this->sixs_lut_file == NULL) {
+          error_string = "duplicating 6S LUT file name";
+          break;
+        }
+        break;
+
+      case PARAM_INPUT_MMAP:
+        if (key.nval <= 0) {
+          error_string = "no input mmap value";
+          break;
+        } else if (key.nval > 1) {
+          error_string = "too many input mmap values";
+          break;
+        }
+        key.value[0][key.len_value[0]] = '\0';
+        if (!strcmp(key.value[0], "true") || !strcmp(key.value[0], "yes"))
+          this->input_mmap = true;
+        else if (!strcmp(key.value[0], "false") || !strcmp(key.value[0], "no"))
+          this->input_mmap = false;
+        else {
+          error_string = "invalid input mmap value";
+          break;
+        }
+        break;
+
+      case PARAM_NUM_THREADS:
+        if (key.nval <= 0) {
+          error_string = "no number of threads";
+          break;
+        } else if (key.nval > 1) {
+          error_string = "too many number of threads values";
+          break;
+        }
+        key.value[0][key.len_value[0]] = '\0';
+        if (sscanf(key.value[0], "%d", &this->num_threads) != 1 ||
+            this->num_threads < 0) {
+          error_string = "invalid number of threads";
+          break;
+        }
+        break;
+
+      case PARAM_GEOGRID_MAX_ERROR:
+        if (key.nval <= 0) {
+          error_string = "no geolocation grid error";
+          break;
+        } else if (key.nval > 1) {
+          error_string = "too many geolocation grid error values";
+          break;
+        }
+        key.value[0][key.len_value[0]] = '\0';
+        if (sscanf(key.value[0], "%lf", &this->geogrid_max_err) != 1 ||
+            this->geogrid_max_err < 0.) {
+          error_string = "invalid geolocation grid error";
+          break;
+        }
+        break;
+
+      case PARAM_NCEP_INDEX:
+        if (key.nval <= 0) {
+          error_string = "no NCEP index value";
+          break;
+        } else if (key.nval > 1) {
+          error_string = "too many NCEP index values";
+          break;
+        }
+        key.value[0][key.len_value[0]] = '\0';
+        if (!strcmp(key.value[0], "true") || !strcmp(key.value[0], "yes"))
+          this->ncep_index = true;
+        else if (!strcmp(key.value[0], "false") || !strcmp(key.value[0], "no"))
+          this->ncep_index = false;
+        else {
+          error_string = "invalid NCEP index value";
+          break;
+        }
+        break;
+
+      case PARAM_DEM_RAW_FILE:
+        if (key.nval <= 0)
+          break;
+        else if (key.nval > 1) {
+          error_string = "too many raw DEM file names";
+          break;
+        }
+        if (key.len_value[0] < 1)
+          break;
+        key.value[0][key.len_value[0]] = '\0';
+        this->dem_raw_file = DupString(key.value[0]);
+        if (this->dem_raw_file == NULL) {
+          error_string = "duplicating raw DEM file name";
+          break;
+        }
+        break;
+
       case PARAM_END:
         if (key.nval != 0) {
           error_string = "no value expected (end key)";
@@ -380,6 +571,9 @@ Param_t *GetParam(int argc, const char **argv)
     free(this->param_file_name);
     free(this->input_xml_file_name);
     free(this->LEDAPSVersion);
+    free(this->sixs_cache_dir);
+    free(this->sixs_lut_file);
+    free(this->dem_raw_file);
     free(this);
     RETURN_ERROR(error_string, "GetParam", NULL);
   }
@@ -412,6 +606,9 @@ bool FreeParam(Param_t *this)
   if (this != NULL) {
     free(this->param_file_name);
     free(this->input_xml_file_name);
+    free(this->sixs_cache_dir);
+    free(this->sixs_lut_file);
+    free(this->dem_raw_file);
     free(this);
   }
   return true;
@@ -26,6 +26,9 @@
  Gail Schmidt
  Modified to support the ESPA internal raw binary format
 
+ Revision 2.1 2015/11/02
+ Added the number of concurrent 6S runs.
+
 !Team Unique Header:
   This software was developed by the MODIS Land Science Team Support 
   Group for the Laboratory for Terrestrial Physics (Code 922) at the 
@@ -79,6 +82,23 @@ typedef struct {
   int  num_ozon_files;        /* number of Ozone hdf files           */
   char *dem_file;             /* DEM file name                       */
   bool dem_flag;              /* false if not present use default    */
+  int  num_sixs_workers;      /* number of concurrent 6S runs; 0 = one
+                                 per online processor                 */
+  char *sixs_cache_dir;       /* directory of the shared 6S tables
+                                 cache; NULL = no cache               */
+  char *sixs_lut_file;        /* precomputed 6S LUT file; NULL = run
+                                 6S for the scene                     */
+  bool input_mmap;            /* True to memory map the input files  */
+  int  num_threads;           /* number of threads of the surface
+                                 reflectance pass; 0 = OpenMP default */
+  double geogrid_max_err;     /* error bound (degrees) of the lat/long
+                                 interpolated in the clear pixel stats
+                                 pass; 0 = map every pixel            */
+  bool ncep_index;            /* True to save the message index of the
+                                 NCEP GRIB files next to them         */
+  char *dem_raw_file;         /* raw DEM memory mapped (created from
+                                 the HDF DEM if missing); NULL = read
+                                 the DEM window of the scene          */
 } Param_t;
 
 /* Prototypes */
@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "read_grib_tools.h"
 
 #define   LEAPYR(y) (!((y)%400) || (!((y)%4) && ((y)%100)))
@@ -9,15 +11,7 @@
 
 short getdoy(short year,short month,short day);
 
-int read_grib_anc(t_ncep_ancillary *anc,int datatype) {
-	FILE *fd;
-	char where[50],tag[50],date[50];
-	int i,grib_ret,ny,nx;
-	short year,doy,month,day,hour,minute;
-	float sec;
-	int read_grib_array(FILE *input, char *what, char *where, int *nx, int *ny, float **narray);
-	int read_grib_date(FILE *input, char *what, char *where, char *date);
-
+static int grib_tag(int datatype,char *tag,char *where) {
 	switch (datatype) {
 		case TYPE_OZONE_DATA:
 			strcpy(tag,OZONE_GRIBTAG);
@@ -46,56 +40,198 @@ int read_grib_anc(t_ncep_ancillary *anc,int datatype) {
 		default:
 			return -1;
 	}		
-	anc->latmin=-90;
-	anc->latmax=90;
-	anc->lonmin=-180;
-	anc->lonmax=180;
-	anc->deltalat=1;
-	anc->deltalon=1;
+	return 0;
+}
+
+/* read the message index saved next to filename; returns -1 if there is
+   none or it is not for the current version of the file (size and
+   modification time) */
+static int load_grib_index(char *filename,t_grib_msg **msgs,int *nmsg) {
+	FILE *fd;
+	char idxname[300],line[300];
+	struct stat st;
+	long size,mtime;
+	int n;
+
+	*msgs=NULL;
+	*nmsg=0;
+	if (stat(filename,&st))
+		return -1;
+	sprintf(idxname,"%s%s",filename,GRIB_INDEX_EXT);
+	if ((fd=fopen(idxname,"r"))==NULL)
+		return -1;
+	if ((fgets(line,sizeof(line),fd)==NULL)||
+	  (sscanf(line,"GRIB_INDEX %ld %ld %d",&size,&mtime,&n)!=3)||
+	  (size!=(long)st.st_size)||(mtime!=(long)st.st_mtime)||(n<=0)||
+	  ((*msgs=(t_grib_msg *)malloc(n*sizeof(t_grib_msg)))==NULL)) {
+		fclose(fd);
+		return -1;
+	}
+	for (*nmsg=0;*nmsg<n;(*nmsg)++)
+		if ((fgets(line,sizeof(line),fd)==NULL)||
+		  (sscanf(line,"%ld %ld %15[^\t]\t%129[^\t]\t%31[^\n]",
+		  &(*msgs)[*nmsg].pos,&(*msgs)[*nmsg].len_grib,(*msgs)[*nmsg].what,
+		  (*msgs)[*nmsg].where,(*msgs)[*nmsg].date)!=5))
+			break;
+	fclose(fd);
+	if (*nmsg<n) {
+		free(*msgs);
+		*msgs=NULL;
+		*nmsg=0;
+		return -1;
+	}
+	return 0;
+}
+
+/* whether message m can be saved in the index: its fields must be non-empty
+   and free of tabs/newlines to be read back (e.g. levels() gives an empty
+   string for unknown levels); the other messages are never looked up */
+static int grib_index_entry(t_grib_msg *m) {
+	return (m->what[0]!='\0')&&(m->where[0]!='\0')&&(m->date[0]!='\0')&&
+	  !strpbrk(m->what,"\t\n")&&!strpbrk(m->where,"\t\n")&&
+	  !strpbrk(m->date,"\t\n");
+}
+
+/* save the message index next to filename; written to a temporary file
+   renamed at the end, so that concurrent runs never read a partial index.
+   A failure is only reported since the index is just rebuilt next time. */
+static void save_grib_index(char *filename,t_grib_msg *msgs,int nmsg) {
+	FILE *fd;
+	char idxname[300],tmpname[320];
+	struct stat st;
+	int i,n;
+
+	if (stat(filename,&st))
+		return;
+	for (i=0,n=0;i<nmsg;i++)
+		if (grib_index_entry(&msgs[i]))
+			n++;
+	if (n==0)
+		return;
+	sprintf(idxname,"%s%s",filename,GRIB_INDEX_EXT);
+	snprintf(tmpname,sizeof(tmpname),"%s.%d",idxname,(int)getpid());
+	if ((fd=fopen(tmpname,"w"))==NULL) {
+		fprintf(stderr,"WARNING: can't save GRIB index %s\n",idxname);
+		return;
+	}
+	fprintf(fd,"GRIB_INDEX %ld %ld %d\n",(long)st.st_size,(long)st.st_mtime,n);
+	for (i=0;i<nmsg;i++)
+		if (grib_index_entry(&msgs[i]))
+			fprintf(fd,"%ld %ld %s\t%s\t%s\n",msgs[i].pos,msgs[i].len_grib,
+			  msgs[i].what,msgs[i].where,msgs[i].date);
+	if (fclose(fd)||rename(tmpname,idxname)) {
+		fprintf(stderr,"WARNING: can't save GRIB index %s\n",idxname);
+		remove(tmpname);
+	}
+}
+
+int read_grib_anc(t_ncep_ancillary *anc,int datatype) {
+	return read_grib_anc_all(&anc,&datatype,1,0);
+}
+
+/* read nbanc ancillary fields from the same GRIB files (anc[0] filenames)
+   in one pass: each file is scanned once for its message index (or the
+   index saved next to it is used, if save_index), then the messages of the
+   fields are decoded from their position */
+int read_grib_anc_all(t_ncep_ancillary **anc,int *datatype,int nbanc,int save_index) {
+	FILE *fd;
+	char where[50],tag[50];
+	int i,k,m,ny,nx,nmsg;
+	short year,doy,month,day,hour,minute;
+	float sec;
+	t_grib_msg *msgs;
+	int index_grib(FILE *input, t_grib_msg **msgs, int *nmsg);
+	int decode_grib(FILE *input, t_grib_msg *index, int *n_rows, int *n_cols,
+	  float **narray);
+
+	for (k=0;k<nbanc;k++) {
+		if (grib_tag(datatype[k],tag,where))
+			return -1;
+		anc[k]->latmin=-90;
+		anc[k]->latmax=90;
+		anc[k]->lonmin=-180;
+		anc[k]->lonmax=180;
+		anc[k]->deltalat=1;
+		anc[k]->deltalon=1;
 	
-	anc->nbrows=-1;
-	anc->nbcols=-1;
-	anc->year=-1;
-	anc->doy=-1;
-	for (i=0;i<anc->nblayers;i++) {
+		anc[k]->nbrows=-1;
+		anc[k]->nbcols=-1;
+		anc[k]->year=-1;
+		anc[k]->doy=-1;
+	}
+	for (i=0;i<anc[0]->nblayers;i++) {
 
-		printf("reading file %s\n",anc->filename[i]);
-		if ((fd=fopen(anc->filename[i],"rb")) != NULL) {
-			read_grib_date(fd, tag, where, date);
-			printf("date=%s\n",date);
-			sscanf(date,"%4hd-%2hd-%2hdT%2hd:%2hd:%f",&year,&month,&day,&hour,&minute,&sec);
-			if (anc->year == -1)
-				anc->year=year;
-			else if (anc->year != year) {
-				fprintf(stderr,"ERROR: inconsistent year in %s\n",anc->filename[i]);
+		printf("reading file %s\n",anc[0]->filename[i]);
+		if ((fd=fopen(anc[0]->filename[i],"rb")) == NULL)
+			return -1;
+		if (!save_index||load_grib_index(anc[0]->filename[i],&msgs,&nmsg)) {
+			if (index_grib(fd,&msgs,&nmsg)) {
+				fprintf(stderr,"ERROR: indexing %s\n",anc[0]->filename[i]);
+				fclose(fd);
+				return -1;
+			}
+			if (save_index)
+				save_grib_index(anc[0]->filename[i],msgs,nmsg);
+		}
+
+		for (k=0;k<nbanc;k++) {
+			grib_tag(datatype[k],tag,where);
+			for (m=0;m<nmsg;m++)
+				if (!strcmp(msgs[m].what,tag)&&!strcmp(msgs[m].where,where))
+					break;
+			if (m==nmsg) {
+				fprintf(stderr,"ERROR: no %s %s data in %s\n",tag,where,anc[0]->filename[i]);
+				free(msgs);
+				fclose(fd);
+				return -1;
+			}
+			printf("date=%s\n",msgs[m].date);
+			sscanf(msgs[m].date,"%4hd-%2hd-%2hdT%2hd:%2hd:%f",&year,&month,&day,&hour,&minute,&sec);
+			if (anc[k]->year == -1)
+				anc[k]->year=year;
+			else if (anc[k]->year != year) {
+				fprintf(stderr,"ERROR: inconsistent year in %s\n",anc[0]->filename[i]);
+				free(msgs);
+				fclose(fd);
 				return (-1);
 			}
 			doy=getdoy(year,month,day);
-			if (anc->doy==-1)
-				anc->doy=doy;
-			else if (anc->doy != doy) {
-				fprintf(stderr,"ERROR: inconsistent day in %s\n",anc->filename[i]);
+			if (anc[k]->doy==-1)
+				anc[k]->doy=doy;
+			else if (anc[k]->doy != doy) {
+				fprintf(stderr,"ERROR: inconsistent day in %s\n",anc[0]->filename[i]);
+				free(msgs);
+				fclose(fd);
 				return (-1);
 			}
-			anc->time[i]=sec/3600.+ (float)minute/60.+(float)hour;
-			printf("date=%04d-%02d-%02dT%02d:%02d:%09.6f   %03d %09.6f\n",year,month,day,hour,minute,sec,anc->doy,anc->time[i]);
+			anc[k]->time[i]=sec/3600.+ (float)minute/60.+(float)hour;
+			printf("date=%04d-%02d-%02dT%02d:%02d:%09.6f   %03d %09.6f\n",year,month,day,hour,minute,sec,anc[k]->doy,anc[k]->time[i]);
 			
-			grib_ret=read_grib_array(fd, tag, where, &ny, &nx, &(anc->data[i]));
-			if (anc->nbrows == -1)
-				anc->nbrows = ny;
-			else if (anc->nbrows != ny) {
-				fprintf(stderr,"ERROR: inconsistent nbrows in %s\n",anc->filename[i]);
+			if (decode_grib(fd, &msgs[m], &ny, &nx, &(anc[k]->data[i]))) {
+				fprintf(stderr,"ERROR: decoding %s %s data in %s\n",tag,where,anc[0]->filename[i]);
+				free(msgs);
+				fclose(fd);
+				return -1;
+			}
+			if (anc[k]->nbrows == -1)
+				anc[k]->nbrows = ny;
+			else if (anc[k]->nbrows != ny) {
+				fprintf(stderr,"ERROR: inconsistent nbrows in %s\n",anc[0]->filename[i]);
+				free(msgs);
+				fclose(fd);
 				return (-1);
 			}
-			if (anc->nbcols == -1)
-				anc->nbcols = nx;
-			else if (anc->nbcols != nx) {
-				fprintf(stderr,"ERROR: inconsistent ncols in %s\n",anc->filename[i]);
+			if (anc[k]->nbcols == -1)
+				anc[k]->nbcols = nx;
+			else if (anc[k]->nbcols != nx) {
+				fprintf(stderr,"ERROR: inconsistent ncols in %s\n",anc[0]->filename[i]);
+				free(msgs);
+				fclose(fd);
 				return (-1);
 			}
-			fclose(fd);
-		} else
-			return -1;
+		}
+		free(msgs);
+		fclose(fd);
 	}
 	
 	return 0;
@@ -188,6 +324,50 @@ printf ("    DEBUG: LR line/samp: %d %d\n", p[3].l, p[3].s);
   return 0;
 }
 
+/* single layer ancillary field (anc_t) interpolated in time at gmt (hours)
+   from the layers of anc, with the same layer pair and weights as the
+   per-point interpolations; since the spatial interpolation is linear in the
+   layer values, interpol_spatial_anc() of anc_t gives the same value as the
+   spatial then temporal interpolation of anc */
+int time_interpol_anc(t_ncep_ancillary *anc,float gmt,t_ncep_ancillary *anc_t) {
+	int i,j,n;
+	double coef;
+
+	*anc_t=*anc;
+	anc_t->nblayers=1;
+	anc_t->time[0]=gmt;
+	for (j=1;j<MAX_NB_LAYERS;j++)
+		anc_t->data[j]=NULL;
+	n=anc->nbrows*anc->nbcols;
+	if ((anc_t->data[0]=(float *)malloc(n*sizeof(float)))==NULL) {
+		fprintf(stderr,"ERROR: allocating time interpolated ancillary data\n");
+		return -1;
+	}
+	if (anc->nblayers<2) {
+		memcpy(anc_t->data[0],anc->data[0],n*sizeof(float));
+		return 0;
+	}
+	i=(int)(gmt/anc->timeres);
+	if (i>=(anc->nblayers-1))
+		i=anc->nblayers-2;
+	coef=(double)(gmt-anc->time[i])/anc->timeres;
+	for (j=0;j<n;j++)
+		anc_t->data[0][j]=(1.-coef)*anc->data[i][j]+coef*anc->data[i+1][j];
+	return 0;
+}
+
+/* values of the first layer of anc at the n points lat[], lon[] */
+int regrid_anc(t_ncep_ancillary *anc,float *lat,float *lon,int n,float *value) {
+	int i;
+	float tmp[MAX_NB_LAYERS];
+
+	for (i=0;i<n;i++) {
+		interpol_spatial_anc(anc,lat[i],lon[i],tmp);
+		value[i]=tmp[0];
+	}
+	return 0;
+}
+
 /***
 int interpol_spatial_anc(t_ncep_ancillary *anc,float lat, float lon,float *value) {
 	int i,iline,isamp;
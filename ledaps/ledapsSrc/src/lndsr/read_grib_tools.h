@@ -38,8 +38,22 @@ typedef struct {
 	int nbrows,nbcols;
 } t_ncep_ancillary;
 
+/* GRIB message index entry (index_grib() in grib.c) */
+typedef struct {
+	char what[16];		/* parameter, e.g. "PWAT" */
+	char where[130];	/* level, e.g. "atmos col" */
+	char date[32];		/* reference date (ASCII time code A) */
+	long pos;		/* position of the message in the file */
+	long len_grib;		/* length of the message */
+} t_grib_msg;
+
+#define GRIB_INDEX_EXT ".idx"	/* index file saved next to a GRIB file */
+
 int read_grib_anc(t_ncep_ancillary *anc,int datatype);
+int read_grib_anc_all(t_ncep_ancillary **anc,int *datatype,int nbanc,int save_index);
 int interpol_spatial_anc(t_ncep_ancillary *anc,float lat, float lon,float *value);
+int time_interpol_anc(t_ncep_ancillary *anc,float gmt,t_ncep_ancillary *anc_t);
+int regrid_anc(t_ncep_ancillary *anc,float *lat,float *lon,int n,float *value);
 int free_anc_data(t_ncep_ancillary *anc);
 void print_anc_data(t_ncep_ancillary *anc, char* ancftype);
 
@@ -0,0 +1,166 @@
+/*
+!C****************************************************************************
+
+!File: sixs_lut.c
+
+!Description: Functions reading and writing the precomputed 6S LUT of
+ sixs_lut_gen, and interpolating the 6S tables of a scene from it.
+
+!Revision History:
+ Revision 1.0 2015/11/05
+ Original Version.
+
+!Design Notes:
+   1. The LUT file is the sixs_lut_t structure in native byte order, after a
+      magic string and its size, so it is only read on the platform it was
+      generated on.
+   2. The scattering terms are interpolated in solar zenith angle, and the
+      gaseous transmittances in solar zenith angle and water vapor/ozone.
+
+!END****************************************************************************
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sixs_lut.h"
+
+#define SIXS_LUT_MAGIC "LEDAPS 6S LUT v1\n"
+
+int write_6S_lut(char *filename, sixs_lut_t *sixs_lut) {
+	FILE *fd;
+	int size=(int)sizeof(sixs_lut_t);
+
+	if ((fd=fopen(filename,"wb"))==NULL) {
+		fprintf(stderr,"ERROR: creating 6S LUT file %s\n",filename);
+		return -1;
+	}
+	if ((fwrite(SIXS_LUT_MAGIC,1,strlen(SIXS_LUT_MAGIC),fd)!=strlen(SIXS_LUT_MAGIC))||
+	  (fwrite(&size,sizeof(int),1,fd)!=1)||
+	  (fwrite(sixs_lut,sizeof(sixs_lut_t),1,fd)!=1)) {
+		fclose(fd);
+		fprintf(stderr,"ERROR: writing 6S LUT file %s\n",filename);
+		return -1;
+	}
+	if (fclose(fd)) {
+		fprintf(stderr,"ERROR: writing 6S LUT file %s\n",filename);
+		return -1;
+	}
+	return 0;
+}
+
+sixs_lut_t *read_6S_lut(char *filename) {
+	FILE *fd;
+	sixs_lut_t *sixs_lut;
+	char magic[sizeof(SIXS_LUT_MAGIC)];
+	int size;
+
+	if ((fd=fopen(filename,"rb"))==NULL) {
+		fprintf(stderr,"ERROR: opening 6S LUT file %s\n",filename);
+		return NULL;
+	}
+	if ((sixs_lut=(sixs_lut_t *)malloc(sizeof(sixs_lut_t)))==NULL) {
+		fclose(fd);
+		fprintf(stderr,"ERROR: allocating 6S LUT\n");
+		return NULL;
+	}
+	if ((fread(magic,1,strlen(SIXS_LUT_MAGIC),fd)!=strlen(SIXS_LUT_MAGIC))||
+	  memcmp(magic,SIXS_LUT_MAGIC,strlen(SIXS_LUT_MAGIC))||
+	  (fread(&size,sizeof(int),1,fd)!=1)||(size!=(int)sizeof(sixs_lut_t))||
+	  (fread(sixs_lut,sizeof(sixs_lut_t),1,fd)!=1)) {
+		fclose(fd);
+		free(sixs_lut);
+		fprintf(stderr,"ERROR: %s is not a 6S LUT file of this version\n",filename);
+		return NULL;
+	}
+	fclose(fd);
+
+	if ((sixs_lut->nb_sza<2)||(sixs_lut->nb_sza>SIXS_LUT_MAX_SZA)||
+	  (sixs_lut->nb_uwv<2)||(sixs_lut->nb_uwv>SIXS_LUT_MAX_UWV)||
+	  (sixs_lut->nb_uoz<2)||(sixs_lut->nb_uoz>SIXS_LUT_MAX_UOZ)) {
+		free(sixs_lut);
+		fprintf(stderr,"ERROR: invalid grid in 6S LUT file %s\n",filename);
+		return NULL;
+	}
+	return sixs_lut;
+}
+
+/* Find the grid cell of x: x lies between nodes[*i] and nodes[*i+1] with
+   weight *w for nodes[*i+1].  Returns 1 if x is outside of the grid. */
+static int locate_6S_lut(float *nodes, int nb_nodes, float x, int *i, float *w) {
+	int k;
+
+	if ((x<nodes[0])||(x>nodes[nb_nodes-1]))
+		return 1;
+	for (k=0;k<nb_nodes-2;k++)
+		if (x<nodes[k+1])
+			break;
+	*i=k;
+	*w=(x-nodes[k])/(nodes[k+1]-nodes[k]);
+	return 0;
+}
+
+#define LERP(f) sixs_tables->f=(1.-w)*s0->f+w*s1->f
+
+/* Build the 6S tables for the inputs of sixs_tables by interpolating the
+   LUT.  Returns 1, leaving the tables untouched, if the inputs are not
+   covered by the LUT (then 6S has to be run). */
+int interp_6S_tables(sixs_lut_t *sixs_lut, sixs_tables_t *sixs_tables) {
+	int i,j,isza,iuwv,iuoz;
+	float w,wuwv,wuoz;
+	float T_g_wv0,T_g_wv1,T_g_og0,T_g_og1,T_g_ref;
+	sixs_tables_t *s0,*s1;
+
+	if ((sixs_tables->Inst!=sixs_lut->Inst)||
+	  (sixs_tables->month!=sixs_lut->month)||(sixs_tables->day!=sixs_lut->day)||
+	  (fabs(sixs_tables->vza-sixs_lut->vza)>0.005)||
+	  (fabs(sixs_tables->target_alt-sixs_lut->target_alt)>0.0005))
+		return 1;
+	if (locate_6S_lut(sixs_lut->sza,sixs_lut->nb_sza,sixs_tables->sza,&isza,&w)||
+	  locate_6S_lut(sixs_lut->uwv,sixs_lut->nb_uwv,sixs_tables->uwv,&iuwv,&wuwv)||
+	  locate_6S_lut(sixs_lut->uoz,sixs_lut->nb_uoz,sixs_tables->uoz,&iuoz,&wuoz))
+		return 1;
+
+	s0=&sixs_lut->scat[isza];
+	s1=&sixs_lut->scat[isza+1];
+	for (j=0;j<SIXS_NB_AOT;j++)
+		sixs_tables->aot[j]=s0->aot[j];
+	for (i=0;i<SIXS_NB_BANDS;i++) {
+		LERP(S_r[i]);
+		LERP(T_r_up[i]);
+		LERP(T_r_down[i]);
+		LERP(T_r[i]);
+		LERP(rho_r[i]);
+		for (j=0;j<SIXS_NB_AOT;j++) {
+			LERP(aot_wavelength[i][j]);
+			LERP(T_a_up[i][j]);
+			LERP(T_a_down[i][j]);
+			LERP(T_a[i][j]);
+			LERP(rho_ra[i][j]);
+			LERP(rho_a[i][j]);
+			LERP(S_ra[i][j]);
+			LERP(T_ra_up[i][j]);
+			LERP(T_ra_down[i][j]);
+			LERP(T_ra[i][j]);
+			LERP(rho_toa[i][j]);
+		}
+
+		T_g_wv0=(1.-wuwv)*sixs_lut->T_g_wv[isza][iuwv][i]+wuwv*sixs_lut->T_g_wv[isza][iuwv+1][i];
+		T_g_wv1=(1.-wuwv)*sixs_lut->T_g_wv[isza+1][iuwv][i]+wuwv*sixs_lut->T_g_wv[isza+1][iuwv+1][i];
+		sixs_tables->T_g_wv[i]=(1.-w)*T_g_wv0+w*T_g_wv1;
+		T_g_og0=(1.-wuoz)*sixs_lut->T_g_og[isza][iuoz][i]+wuoz*sixs_lut->T_g_og[isza][iuoz+1][i];
+		T_g_og1=(1.-wuoz)*sixs_lut->T_g_og[isza+1][iuoz][i]+wuoz*sixs_lut->T_g_og[isza+1][iuoz+1][i];
+		sixs_tables->T_g_og[i]=(1.-w)*T_g_og0+w*T_g_og1;
+
+		/* the apparent reflectance was computed with the reference gases
+		   of the LUT; rescale it to the actual gases (it is not used by
+		   the surface reflectance correction) */
+		T_g_ref=((1.-w)*s0->T_g_wv[i]+w*s1->T_g_wv[i])*
+			((1.-w)*s0->T_g_og[i]+w*s1->T_g_og[i]);
+		if (T_g_ref>0.)
+			for (j=0;j<SIXS_NB_AOT;j++)
+				sixs_tables->rho_toa[i][j]*=sixs_tables->T_g_wv[i]*sixs_tables->T_g_og[i]/T_g_ref;
+	}
+	return 0;
+}
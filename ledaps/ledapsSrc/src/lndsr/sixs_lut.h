@@ -0,0 +1,32 @@
+#ifndef SIXS_LUT_H
+#define SIXS_LUT_H
+#include "sixs_runs.h"
+
+#define SIXS_LUT_MAX_SZA 64
+#define SIXS_LUT_MAX_UWV 32
+#define SIXS_LUT_MAX_UOZ 32
+
+/* 6S tables precomputed by sixs_lut_gen for one instrument.  At nadir view
+   the scattering terms only depend on the solar zenith angle, the water
+   vapor transmittance on the solar zenith angle and the water vapor, and
+   the other gases transmittance on the solar zenith angle and the ozone,
+   so each is tabulated on its own grid. */
+typedef struct {
+	Sixs_Inst_t Inst;
+	int month,day;
+	float vza,srefl,target_alt;		/* fixed inputs of all the 6S runs */
+	float uwv_ref,uoz_ref;			/* water vapor/ozone of the scat runs */
+	int nb_sza,nb_uwv,nb_uoz;
+	float sza[SIXS_LUT_MAX_SZA];	/* grid nodes, in increasing order */
+	float uwv[SIXS_LUT_MAX_UWV];
+	float uoz[SIXS_LUT_MAX_UOZ];
+	sixs_tables_t scat[SIXS_LUT_MAX_SZA];	/* tables for each sza node */
+	float T_g_wv[SIXS_LUT_MAX_SZA][SIXS_LUT_MAX_UWV][SIXS_NB_BANDS];
+	float T_g_og[SIXS_LUT_MAX_SZA][SIXS_LUT_MAX_UOZ][SIXS_NB_BANDS];
+} sixs_lut_t;
+
+int write_6S_lut(char *filename, sixs_lut_t *sixs_lut);
+sixs_lut_t *read_6S_lut(char *filename);
+int interp_6S_tables(sixs_lut_t *sixs_lut, sixs_tables_t *sixs_tables);
+
+#endif
@@ -0,0 +1,112 @@
+/**************************************************************************
+  sixs_lut_gen: run 6S once over a grid of solar zenith angle, water vapor
+  and ozone and save the tables as a binary LUT for the SIXS_LUT_FILE
+  parameter of lndsr.
+
+  Usage: sixs_lut_gen <TM|ETM> <lut_file> [num_workers]
+
+  The fixed 6S inputs (nadir view, date, surface reflectance and target
+  altitude) are the ones lndsr uses for the scene center.
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sixs_lut.h"
+
+/* Grids of the LUT */
+static float sza_nodes[]={0.0,2.5,5.0,7.5,10.0,12.5,15.0,17.5,20.0,22.5,
+	25.0,27.5,30.0,32.5,35.0,37.5,40.0,42.5,45.0,47.5,50.0,52.5,55.0,57.5,
+	60.0,62.5,65.0,67.5,70.0,72.5,75.0,77.5,80.0,82.5,85.0};
+static float uwv_nodes[]={0.0,0.25,0.5,0.75,1.0,1.5,2.0,2.5,3.0,3.5,4.0,
+	5.0,6.0,7.0,8.0};
+static float uoz_nodes[]={0.15,0.20,0.25,0.30,0.35,0.40,0.45,0.50,0.55,0.60};
+
+/* Water vapor and ozone of the scattering runs (the scattering terms do
+   not depend on them) */
+#define UWV_REF 2.0
+#define UOZ_REF 0.3
+
+static void init_6S_tables(sixs_tables_t *sixs_tables, Sixs_Inst_t inst, float sza) {
+	memset(sixs_tables,0,sizeof(sixs_tables_t));
+	sixs_tables->Inst=inst;
+	sixs_tables->target_alt=0.;
+	sixs_tables->sza=sza;
+	sixs_tables->phi=0.;
+	sixs_tables->vza=0.;
+	sixs_tables->month=9;
+	sixs_tables->day=15;
+	sixs_tables->srefl=0.14;
+	sixs_tables->uwv=UWV_REF;
+	sixs_tables->uoz=UOZ_REF;
+}
+
+int main(int argc, char *argv[]) {
+	sixs_lut_t *sixs_lut;
+	sixs_tables_t sixs_tables;
+	Sixs_Inst_t inst;
+	int i,k,nb_gas,nworkers=0;
+
+	if ((argc<3)||(argc>4)) {
+		fprintf(stderr,"usage: %s <TM|ETM> <lut_file> [num_workers]\n",argv[0]);
+		exit(-1);
+	}
+	if (!strcmp(argv[1],"TM"))
+		inst=SIXS_INST_TM;
+	else if (!strcmp(argv[1],"ETM"))
+		inst=SIXS_INST_ETM;
+	else {
+		fprintf(stderr,"ERROR: unknown instrument %s\n",argv[1]);
+		exit(-1);
+	}
+	if ((argc==4)&&((sscanf(argv[3],"%d",&nworkers)!=1)||(nworkers<0))) {
+		fprintf(stderr,"ERROR: invalid number of 6S workers %s\n",argv[3]);
+		exit(-1);
+	}
+
+	if ((sixs_lut=(sixs_lut_t *)calloc(1,sizeof(sixs_lut_t)))==NULL) {
+		fprintf(stderr,"ERROR: allocating 6S LUT\n");
+		exit(-1);
+	}
+	init_6S_tables(&sixs_tables,inst,0.);
+	sixs_lut->Inst=inst;
+	sixs_lut->month=sixs_tables.month;
+	sixs_lut->day=sixs_tables.day;
+	sixs_lut->vza=sixs_tables.vza;
+	sixs_lut->srefl=sixs_tables.srefl;
+	sixs_lut->target_alt=sixs_tables.target_alt;
+	sixs_lut->uwv_ref=UWV_REF;
+	sixs_lut->uoz_ref=UOZ_REF;
+	sixs_lut->nb_sza=sizeof(sza_nodes)/sizeof(float);
+	sixs_lut->nb_uwv=sizeof(uwv_nodes)/sizeof(float);
+	sixs_lut->nb_uoz=sizeof(uoz_nodes)/sizeof(float);
+	memcpy(sixs_lut->sza,sza_nodes,sizeof(sza_nodes));
+	memcpy(sixs_lut->uwv,uwv_nodes,sizeof(uwv_nodes));
+	memcpy(sixs_lut->uoz,uoz_nodes,sizeof(uoz_nodes));
+
+	nb_gas=(sixs_lut->nb_uwv>sixs_lut->nb_uoz)?sixs_lut->nb_uwv:sixs_lut->nb_uoz;
+	for (i=0;i<sixs_lut->nb_sza;i++) {
+		printf("Solar zenith %5.2f (%d of %d)\n",sza_nodes[i],i+1,sixs_lut->nb_sza);
+		init_6S_tables(&sixs_lut->scat[i],inst,sza_nodes[i]);
+		create_6S_tables(&sixs_lut->scat[i],nworkers,NULL);
+
+		/* the water vapor and ozone grids are swept together */
+		for (k=0;k<nb_gas;k++) {
+			init_6S_tables(&sixs_tables,inst,sza_nodes[i]);
+			if (k<sixs_lut->nb_uwv)
+				sixs_tables.uwv=uwv_nodes[k];
+			if (k<sixs_lut->nb_uoz)
+				sixs_tables.uoz=uoz_nodes[k];
+			create_6S_gas_tables(&sixs_tables,nworkers);
+			if (k<sixs_lut->nb_uwv)
+				memcpy(sixs_lut->T_g_wv[i][k],sixs_tables.T_g_wv,sizeof(sixs_tables.T_g_wv));
+			if (k<sixs_lut->nb_uoz)
+				memcpy(sixs_lut->T_g_og[i][k],sixs_tables.T_g_og,sizeof(sixs_tables.T_g_og));
+		}
+	}
+
+	if (write_6S_lut(argv[2],sixs_lut))
+		exit(-1);
+	free(sixs_lut);
+	return 0;
+}
@@ -1,9 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
 #include "sixs_runs.h"
-#include "external_pgm.h"
+#include "sixs_lib.h"
 
 struct etm_spectral_function_t {
 	int nbvals[SIXS_NB_BANDS];
@@ -12,33 +16,44 @@ struct etm_spectral_function_t {
 	float response[SIXS_NB_BANDS][155];
 } etm_spectral_function_t;
 
-int create_6S_tables(sixs_tables_t *sixs_tables, Input_meta_t *meta) {
-	char cmd[128],sixs_cmd_filename[1024],sixs_out_filename[1024],line_in[256];
-    /* char tmp_file[1024], cmd_string[1024]; */
-	int i,j,k;
-	FILE *fd;
-	float tgoz,tgco2,tgo2,tgno2,tgch4,tgco;
-	int tm_band[SIXS_NB_BANDS]={25,26,27,28,29,30};
-    char short_name[1024];
-    char local_granule_id[1024];
-    char acq_date_string[MAX_DATE_LEN + 1];
-    const char *sat_names[SAT_MAX] = {"1", "2", "3", "4", "5", "7"};
-    const char *inst_names[INST_MAX] = {"M", "T", "E"};
-    const char *wrs_names[WRS_MAX] = {"1", "2"};
-	
-	struct etm_spectral_function_t etm_spectral_function = {
-		{54,61,65,81,131,155},
-		{0.420,0.500,0.580,0.730,1.501,2.0},
-		{0.550,0.650,0.740,0.930,1.825,2.386},
-		{
-			{0.000,0.000,0.000,0.000,0.000,0.000,0.016,0.071,0.287,0.666,0.792,0.857,0.839,0.806,0.779,0.846,0.901,0.900,0.890,0.851,0.875,0.893,0.884,0.930,0.958,0.954,0.980,0.975,0.965,0.962,0.995,0.990,0.990,0.979,0.983,0.969,0.960,0.768,0.293,0.054,0.009,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
-			{0.001,0.002,0.003,0.012,0.026,0.074,0.174,0.348,0.552,0.696,0.759,0.785,0.822,0.870,0.905,0.929,0.947,0.952,0.952,0.951,0.953,0.950,0.954,0.967,0.959,0.941,0.933,0.938,0.951,0.956,0.955,0.956,0.973,0.992,1.000,0.976,0.942,0.930,0.912,0.799,0.574,0.340,0.185,0.105,0.062,0.038,0.021,0.011,0.005,0.002,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
-			{0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.001,0.002,0.010,0.047,0.174,0.419,0.731,0.921,0.942,0.937,0.937,0.949,0.965,0.973,0.970,0.958,0.955,0.962,0.980,0.993,0.998,1.000,0.995,0.992,0.988,0.977,0.954,0.932,0.880,0.729,0.444,0.183,0.066,0.025,0.012,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
-			{0.000,0.000,0.000,0.000,0.000,0.002,0.004,0.002,0.001,0.020,0.032,0.052,0.069,0.110,0.175,0.271,0.402,0.556,0.705,0.812,0.871,0.896,0.908,0.918,0.926,0.928,0.930,0.926,0.925,0.928,0.923,0.916,0.908,0.903,0.909,0.924,0.946,0.954,0.971,0.969,0.967,0.965,0.967,0.961,0.949,0.931,0.925,0.929,0.943,0.961,0.985,0.992,0.998,0.992,0.994,0.997,0.998,1.000,0.991,0.988,0.969,0.926,0.868,0.817,0.819,0.880,0.854,0.572,0.256,0.104,0.044,0.022,0.011,0.007,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
-			{0.000,0.003,0.000,0.001,0.007,0.008,0.008,0.012,0.012,0.028,0.041,0.062,0.087,0.114,0.176,0.230,0.306,0.410,0.481,0.543,0.598,0.642,0.686,0.719,0.750,0.785,0.817,0.845,0.867,0.881,0.902,0.900,0.896,0.892,0.899,0.882,0.872,0.872,0.872,0.878,0.868,0.860,0.877,0.884,0.897,0.895,0.898,0.912,0.921,0.927,0.937,0.947,0.948,0.954,0.961,0.962,0.962,0.964,0.969,0.956,0.952,0.951,0.952,0.953,0.939,0.934,0.928,0.943,0.945,0.935,0.944,0.947,0.944,0.949,0.960,0.966,0.971,0.978,0.993,0.998,0.996,0.996,0.997,0.986,0.990,0.988,0.992,0.985,0.982,0.978,0.970,0.966,0.952,0.927,0.883,0.832,0.751,0.656,0.577,0.483,0.393,0.310,0.239,0.184,0.142,0.104,0.080,0.063,0.049,0.041,0.036,0.023,0.021,0.019,0.012,0.006,0.008,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
-			{0.004,0.001,0.003,0.000,0.002,0.001,0.002,0.002,0.012,0.008,0.009,0.018,0.017,0.031,0.037,0.046,0.058,0.076,0.088,0.110,0.149,0.196,0.242,0.303,0.367,0.437,0.519,0.610,0.677,0.718,0.756,0.774,0.784,0.775,0.789,0.782,0.778,0.766,0.762,0.768,0.775,0.769,0.788,0.808,0.794,0.823,0.811,0.819,0.836,0.837,0.836,0.851,0.859,0.855,0.871,0.873,0.875,0.859,0.872,0.859,0.872,0.863,0.865,0.868,0.877,0.873,0.869,0.876,0.868,0.879,0.873,0.876,0.880,0.874,0.870,0.858,0.863,0.859,0.844,0.859,0.854,0.863,0.868,0.856,0.847,0.861,0.851,0.852,0.838,0.847,0.840,0.831,0.836,0.838,0.822,0.838,0.839,0.842,0.854,0.862,0.873,0.868,0.879,0.891,0.898,0.919,0.920,0.926,0.928,0.934,0.936,0.953,0.954,0.952,0.960,0.973,0.985,0.972,0.970,0.994,0.989,0.975,1.000,0.991,0.968,0.966,0.956,0.929,0.929,0.926,0.903,0.924,0.929,0.928,0.920,0.853,0.775,0.659,0.531,0.403,0.275,0.218,0.131,0.104,0.075,0.052,0.029,0.028,0.014,0.019,0.013,0.007,0.015,0.000,0.004}
-		}
-	};
+static struct etm_spectral_function_t etm_spectral_function = {
+	{54,61,65,81,131,155},
+	{0.420,0.500,0.580,0.730,1.501,2.0},
+	{0.550,0.650,0.740,0.930,1.825,2.386},
+	{
+		{0.000,0.000,0.000,0.000,0.000,0.000,0.016,0.071,0.287,0.666,0.792,0.857,0.839,0.806,0.779,0.846,0.901,0.900,0.890,0.851,0.875,0.893,0.884,0.930,0.958,0.954,0.980,0.975,0.965,0.962,0.995,0.990,0.990,0.979,0.983,0.969,0.960,0.768,0.293,0.054,0.009,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
+		{0.001,0.002,0.003,0.012,0.026,0.074,0.174,0.348,0.552,0.696,0.759,0.785,0.822,0.870,0.905,0.929,0.947,0.952,0.952,0.951,0.953,0.950,0.954,0.967,0.959,0.941,0.933,0.938,0.951,0.956,0.955,0.956,0.973,0.992,1.000,0.976,0.942,0.930,0.912,0.799,0.574,0.340,0.185,0.105,0.062,0.038,0.021,0.011,0.005,0.002,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
+		{0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.001,0.002,0.010,0.047,0.174,0.419,0.731,0.921,0.942,0.937,0.937,0.949,0.965,0.973,0.970,0.958,0.955,0.962,0.980,0.993,0.998,1.000,0.995,0.992,0.988,0.977,0.954,0.932,0.880,0.729,0.444,0.183,0.066,0.025,0.012,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
+		{0.000,0.000,0.000,0.000,0.000,0.002,0.004,0.002,0.001,0.020,0.032,0.052,0.069,0.110,0.175,0.271,0.402,0.556,0.705,0.812,0.871,0.896,0.908,0.918,0.926,0.928,0.930,0.926,0.925,0.928,0.923,0.916,0.908,0.903,0.909,0.924,0.946,0.954,0.971,0.969,0.967,0.965,0.967,0.961,0.949,0.931,0.925,0.929,0.943,0.961,0.985,0.992,0.998,0.992,0.994,0.997,0.998,1.000,0.991,0.988,0.969,0.926,0.868,0.817,0.819,0.880,0.854,0.572,0.256,0.104,0.044,0.022,0.011,0.007,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
+		{0.000,0.003,0.000,0.001,0.007,0.008,0.008,0.012,0.012,0.028,0.041,0.062,0.087,0.114,0.176,0.230,0.306,0.410,0.481,0.543,0.598,0.642,0.686,0.719,0.750,0.785,0.817,0.845,0.867,0.881,0.902,0.900,0.896,0.892,0.899,0.882,0.872,0.872,0.872,0.878,0.868,0.860,0.877,0.884,0.897,0.895,0.898,0.912,0.921,0.927,0.937,0.947,0.948,0.954,0.961,0.962,0.962,0.964,0.969,0.956,0.952,0.951,0.952,0.953,0.939,0.934,0.928,0.943,0.945,0.935,0.944,0.947,0.944,0.949,0.960,0.966,0.971,0.978,0.993,0.998,0.996,0.996,0.997,0.986,0.990,0.988,0.992,0.985,0.982,0.978,0.970,0.966,0.952,0.927,0.883,0.832,0.751,0.656,0.577,0.483,0.393,0.310,0.239,0.184,0.142,0.104,0.080,0.063,0.049,0.041,0.036,0.023,0.021,0.019,0.012,0.006,0.008,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
+		{0.004,0.001,0.003,0.000,0.002,0.001,0.002,0.002,0.012,0.008,0.009,0.018,0.017,0.031,0.037,0.046,0.058,0.076,0.088,0.110,0.149,0.196,0.242,0.303,0.367,0.437,0.519,0.610,0.677,0.718,0.756,0.774,0.784,0.775,0.789,0.782,0.778,0.766,0.762,0.768,0.775,0.769,0.788,0.808,0.794,0.823,0.811,0.819,0.836,0.837,0.836,0.851,0.859,0.855,0.871,0.873,0.875,0.859,0.872,0.859,0.872,0.863,0.865,0.868,0.877,0.873,0.869,0.876,0.868,0.879,0.873,0.876,0.880,0.874,0.870,0.858,0.863,0.859,0.844,0.859,0.854,0.863,0.868,0.856,0.847,0.861,0.851,0.852,0.838,0.847,0.840,0.831,0.836,0.838,0.822,0.838,0.839,0.842,0.854,0.862,0.873,0.868,0.879,0.891,0.898,0.919,0.920,0.926,0.928,0.934,0.936,0.953,0.954,0.952,0.960,0.973,0.985,0.972,0.970,0.994,0.989,0.975,1.000,0.991,0.968,0.966,0.956,0.929,0.929,0.926,0.903,0.924,0.929,0.928,0.920,0.853,0.775,0.659,0.531,0.403,0.275,0.218,0.131,0.104,0.075,0.052,0.029,0.028,0.014,0.019,0.013,0.007,0.015,0.000,0.004}
+	}
+};
+
+/* Book-keeping for one band/AOT 6S run of run_6S_tables */
+typedef struct {
+	int band,iaot;		/* band and AOT indices of the run */
+	pid_t pid;			/* process running 6S (0 = not running) */
+	int fd;				/* pipe the 6S results are read from */
+} sixs_job_t;
+
+/* Resolution of the 6S inputs.  These are the precisions the inputs used
+   to be written with in the 6S input card; the 6S tables cache is keyed
+   on inputs rounded to the same values. */
+#define SIXS_ANGLE_STEP 0.01		/* sza, phi, vza (degrees) */
+#define SIXS_GAS_STEP 0.01			/* uwv (g/cm2), uoz (cm-atm) */
+#define SIXS_REFL_STEP 0.001		/* srefl, aot550 */
+#define SIXS_ALT_STEP 0.001			/* target altitude (km) */
+
+#define SIXS_CACHE_VERSION 1		/* bump when the 6S tables change */
+#define SIXS_CACHE_KEY_LEN 512
+#define SIXS_CACHE_NAME_LEN 1024
+
+static float round_6S(float val, float step) {
+	return (float)(floor(val/step+0.5)*step);
+}
+
+static void set_6S_aot(sixs_tables_t *sixs_tables) {
 	sixs_tables->aot[0]=0.01;
 	sixs_tables->aot[1]=0.05;
 	sixs_tables->aot[2]=0.10;
@@ -54,814 +69,393 @@ int create_6S_tables(sixs_tables_t *sixs_tables, Input_meta_t *meta) {
 	sixs_tables->aot[12]=1.60;
 	sixs_tables->aot[13]=1.80;
 	sixs_tables->aot[14]=2.00;
-	
-    /* Determine the 6s command and output filenames */
-    if (sprintf(short_name, "L%s%s%s", sat_names[meta->sat], 
-        inst_names[meta->inst], "SR") < 0) {
-        fprintf(stderr, "ERROR:creating short name\n");
-        exit(-1);
-    }
-
-    if (!FormatDate(&meta->acq_date, DATE_FORMAT_DATEB, acq_date_string)) {
-        fprintf(stderr, "ERROR:formatting acquisition date\n");
-        exit(-1);
-    }
-    acq_date_string[4] = '\0';
-
-    sprintf(local_granule_id, "%s.a%4s%3s.w%1sp%03dr%03d",
-        short_name, acq_date_string, &acq_date_string[5],
-        wrs_names[meta->wrs_sys], meta->ipath, meta->irow);
-    sprintf (sixs_cmd_filename, "sixs_cmd_%s", local_granule_id);
-    sprintf (sixs_out_filename, "sixs_output_%s", local_granule_id);
-	
-	/* Run 6s */
-	for (i=0;i<SIXS_NB_BANDS;i++) {
-		for (j=0;j<SIXS_NB_AOT;j++) {
-			printf("Processing 6s for band %d  AOT %2d\r",i+1,j+1);
-            fflush(stdout);
-			if ((fd=fopen(sixs_cmd_filename,"w"))==NULL) {
-				fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_cmd_filename);
-				exit(-1);
+}
+
+/* Set the 6S inputs for band i and AOT j of the tables */
+static void set_6S_input(sixs_input_t *sixs_input, sixs_tables_t *sixs_tables, Sixs_Aerosol_t aer_model, Sixs_Ground_t ground, int i, int j) {
+	int tm_band[SIXS_NB_BANDS]={25,26,27,28,29,30};
+
+	memset(sixs_input,0,sizeof(sixs_input_t));
+	sixs_input->sza=round_6S(sixs_tables->sza,SIXS_ANGLE_STEP);
+	sixs_input->saz=round_6S(sixs_tables->phi,SIXS_ANGLE_STEP);
+	sixs_input->vza=round_6S(sixs_tables->vza,SIXS_ANGLE_STEP);
+	sixs_input->vaz=0.;
+	sixs_input->month=sixs_tables->month;
+	sixs_input->day=sixs_tables->day;
+	sixs_input->uwv=round_6S(sixs_tables->uwv,SIXS_GAS_STEP);
+	sixs_input->uoz=round_6S(sixs_tables->uoz,SIXS_GAS_STEP);
+	sixs_input->aer_model=aer_model;
+	sixs_input->aot550=round_6S(sixs_tables->aot[j],SIXS_REFL_STEP);
+	sixs_input->target_alt=round_6S(sixs_tables->target_alt,SIXS_ALT_STEP);
+	switch (sixs_tables->Inst) {
+		case SIXS_INST_TM:
+			sixs_input->iwave=tm_band[i];
+		break;
+		case SIXS_INST_ETM:
+			sixs_input->iwave=SIXS_FILTER_USER;
+			sixs_input->wlinf=etm_spectral_function.wlinf[i];
+			sixs_input->wlsup=etm_spectral_function.wlsup[i];
+			sixs_input->nfilter=etm_spectral_function.nbvals[i];
+			sixs_input->filter=etm_spectral_function.response[i];
+		break;
+		default:
+			fprintf(stderr,"ERROR: Unknown Instrument in six_run parameters\n");
+			exit(-1);
+	}
+	sixs_input->ground=ground;
+	sixs_input->rho=round_6S(sixs_tables->srefl,SIXS_REFL_STEP);
+	/* wind speed(m/s) wind azimuth(deg) salinity(deg) pigment concentration(mg/m3) */
+	sixs_input->wind_speed=2.0;
+	sixs_input->wind_azimuth=0.0;
+	sixs_input->salinity=0.0;
+	sixs_input->pigment=0.10;
+}
+
+/* Store the 6S results for band i and AOT j in the tables */
+static void store_6S_output(sixs_output_t *sixs_output, sixs_tables_t *sixs_tables, int i, int j) {
+	if (j==0) {
+		sixs_tables->T_r_down[i]=sixs_output->T_sca[SIXS_RAYLEIGH][SIXS_DOWNWARD];
+		sixs_tables->T_r_up[i]=sixs_output->T_sca[SIXS_RAYLEIGH][SIXS_UPWARD];
+		sixs_tables->T_r[i]=sixs_output->T_sca[SIXS_RAYLEIGH][SIXS_TOTAL];
+		sixs_tables->T_g_wv[i]=sixs_output->T_g[SIXS_GAS_WATER][SIXS_TOTAL];
+		sixs_tables->T_g_og[i]=sixs_output->T_g[SIXS_GAS_OZONE][SIXS_TOTAL]*
+			sixs_output->T_g[SIXS_GAS_CO2][SIXS_TOTAL]*
+			sixs_output->T_g[SIXS_GAS_OXYG][SIXS_TOTAL]*
+			sixs_output->T_g[SIXS_GAS_NO2][SIXS_TOTAL]*
+			sixs_output->T_g[SIXS_GAS_NO2][SIXS_TOTAL]*
+			sixs_output->T_g[SIXS_GAS_CH4][SIXS_TOTAL]*
+			sixs_output->T_g[SIXS_GAS_CO][SIXS_TOTAL];
+		sixs_tables->S_r[i]=sixs_output->S[SIXS_RAYLEIGH];
+		sixs_tables->rho_r[i]=sixs_output->rho[SIXS_RAYLEIGH];
+	}
+	sixs_tables->S_ra[i][j]=sixs_output->S[SIXS_RAY_AER];
+	sixs_tables->aot_wavelength[i][j]=sixs_output->tau[SIXS_AEROSOLS];
+	sixs_tables->T_a_down[i][j]=sixs_output->T_sca[SIXS_AEROSOLS][SIXS_DOWNWARD];
+	sixs_tables->T_a_up[i][j]=sixs_output->T_sca[SIXS_AEROSOLS][SIXS_UPWARD];
+	sixs_tables->T_a[i][j]=sixs_output->T_sca[SIXS_AEROSOLS][SIXS_TOTAL];
+	sixs_tables->T_ra_down[i][j]=sixs_output->T_sca[SIXS_RAY_AER][SIXS_DOWNWARD];
+	sixs_tables->T_ra_up[i][j]=sixs_output->T_sca[SIXS_RAY_AER][SIXS_UPWARD];
+	sixs_tables->T_ra[i][j]=sixs_output->T_sca[SIXS_RAY_AER][SIXS_TOTAL];
+	sixs_tables->rho_a[i][j]=sixs_output->rho[SIXS_AEROSOLS];
+	sixs_tables->rho_ra[i][j]=sixs_output->rho[SIXS_RAY_AER];
+	sixs_tables->rho_toa[i][j]=sixs_output->rho_toa;
+}
+
+static void run_6S(sixs_input_t *sixs_input, sixs_output_t *sixs_output) {
+	if (sixs_run(sixs_input,sixs_output)) {
+		fprintf(stderr,"ERROR: Can't run 6S \n");
+		exit(-1);
+	}
+}
+
+static void start_6S_job(sixs_job_t *job, sixs_tables_t *sixs_tables, Sixs_Aerosol_t aer_model, Sixs_Ground_t ground) {
+	int fd[2];
+	sixs_input_t sixs_input;
+	sixs_output_t sixs_output;
+
+	if (pipe(fd) < 0) {
+		fprintf(stderr,"ERROR: Can't start 6S \n");
+		exit(-1);
+	}
+	fflush(stdout);
+	if ((job->pid=fork()) < 0) {
+		fprintf(stderr,"ERROR: Can't start 6S \n");
+		exit(-1);
+	}
+	if (job->pid == 0) {
+		/* the results are smaller than PIPE_BUF, so the write does not
+		   block on the parent */
+		close(fd[0]);
+		set_6S_input(&sixs_input,sixs_tables,aer_model,ground,job->band,job->iaot);
+		if (sixs_run(&sixs_input,&sixs_output))
+			_exit(1);
+		if (write(fd[1],&sixs_output,sizeof(sixs_output_t)) != sizeof(sixs_output_t))
+			_exit(1);
+		_exit(0);
+	}
+	close(fd[1]);
+	job->fd=fd[0];
+}
+
+static void finish_6S_job(sixs_job_t *job, sixs_tables_t *sixs_tables) {
+	sixs_output_t sixs_output;
+
+	if (read(job->fd,&sixs_output,sizeof(sixs_output_t)) != sizeof(sixs_output_t)) {
+		fprintf(stderr,"ERROR: reading 6S results\n");
+		exit(-1);
+	}
+	close(job->fd);
+	store_6S_output(&sixs_output,sixs_tables,job->band,job->iaot);
+	job->pid=0;
+}
+
+/* Run 6S for every band and the first nb_aot AOTs of the tables.  6S keeps
+   its state in Fortran COMMON blocks, so concurrent runs are done in forked
+   worker processes that send their results back through a pipe; with a
+   single worker everything runs in this process. */
+static void run_6S_tables(sixs_tables_t *sixs_tables, Sixs_Aerosol_t aer_model, Sixs_Ground_t ground, int nb_aot, int nworkers) {
+	int i,j,k,status;
+	int nb_jobs,next_job,nb_running,nb_done;
+	pid_t pid;
+	sixs_job_t jobs[SIXS_NB_BANDS*SIXS_NB_AOT],*job;
+	sixs_input_t sixs_input;
+	sixs_output_t sixs_output;
+
+	/* Determine the number of 6S runs to keep active at the same time */
+	nb_jobs=SIXS_NB_BANDS*nb_aot;
+	if (nworkers < 1)
+		nworkers=(int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (nworkers < 1)
+		nworkers=1;
+	if (nworkers > nb_jobs)
+		nworkers=nb_jobs;
+
+	printf("Running 6s with %d worker(s)\n",nworkers);
+	if (nworkers == 1) {
+		for (i=0;i<SIXS_NB_BANDS;i++) {
+			for (j=0;j<nb_aot;j++) {
+				printf("Processing 6s for band %d  AOT %2d\r",i+1,j+1);
+				fflush(stdout);
+				set_6S_input(&sixs_input,sixs_tables,aer_model,ground,i,j);
+				run_6S(&sixs_input,&sixs_output);
+				store_6S_output(&sixs_output,sixs_tables,i,j);
 			}
+		}
+		printf ("\n");
+		return;
+	}
 
-			fprintf(fd,"%s <<+ >%s\n",get_sixs_path(),sixs_out_filename);
-			fprintf(fd,"0 (user defined)\n");
-			fprintf(fd,"%.2f %.2f %.2f %.2f %d %d (geometrical conditions sza saz vza vaz month day)\n",sixs_tables->sza,sixs_tables->phi,sixs_tables->vza,0.,sixs_tables->month,sixs_tables->day);
-			fprintf(fd,"8 (option for water vapor and ozone)\n");
-			fprintf(fd,"%.2f %.2f (water vapor and ozone)\n",sixs_tables->uwv,sixs_tables->uoz);
-			fprintf(fd,"1 (continental model)\n");
-			fprintf(fd,"0 (option for optical thickness at 550 nm)\n");
-			fprintf(fd,"%.3f (value of aot550\n",sixs_tables->aot[j]);
-			fprintf(fd,"%f (target level)\n",sixs_tables->target_alt);
-			fprintf(fd,"-1000 (sensor level : -1000=satellite level)\n");
-			switch (sixs_tables->Inst) {
-				case SIXS_INST_TM:
-					fprintf(fd,"%d (predefined band)\n",tm_band[i]);
-				break;
-				case SIXS_INST_ETM:
-					fprintf(fd,"1 (user defined filter function)\n");
-					fprintf(fd,"%05.3f %05.3f (wlinf wlsup)\n",etm_spectral_function.wlinf[i],etm_spectral_function.wlsup[i]);
-					for (k=0;k<etm_spectral_function.nbvals[i];k++) {
-						fprintf(fd,"%05.3f ",etm_spectral_function.response[i][k]);
-						if (!((k+1)%10))
-							fprintf(fd,"\n");
-					}
-					if (k%10)
-						fprintf(fd,"\n");
+	for (k=0;k<nb_jobs;k++) {
+		jobs[k].band=k/nb_aot;
+		jobs[k].iaot=k%nb_aot;
+		jobs[k].pid=0;
+	}
+	next_job=0;
+	nb_running=0;
+	nb_done=0;
+	while (nb_done < nb_jobs) {
+		while ((nb_running < nworkers) && (next_job < nb_jobs)) {
+			start_6S_job(&jobs[next_job],sixs_tables,aer_model,ground);
+			next_job++;
+			nb_running++;
+		}
+
+		if ((pid=waitpid(-1,&status,0)) < 0) {
+			fprintf(stderr,"ERROR: waiting for 6S \n");
+			exit(-1);
+		}
+		job=NULL;
+		for (k=0;k<next_job;k++)
+			if (jobs[k].pid == pid) {
+				job=&jobs[k];
 				break;
-				default:
-					fprintf(stderr,"ERROR: Unknown Instrument in six_run parameters\n");
-					exit(-1);
-			}
-			fprintf(fd,"0 (homogeneous surface)\n");
-			fprintf(fd,"0 (no directional effects)\n");
-			fprintf(fd,"0 (constant value for rho)\n");
-			fprintf(fd,"%.3f (value of rho)\n",sixs_tables->srefl);
-			fprintf(fd,"-1 (no atmospheric correction)\n");
-			fprintf(fd,"0\n");
-			fprintf(fd,"+\n");
-			fclose(fd);
-	
-            /* Modified 9/26/2014 to run bash shell vs. sh */
-			sprintf(cmd,"bash %s",sixs_cmd_filename);
-			if (system(cmd)) {
-				fprintf(stderr,"ERROR: Can't run 6S \n");
-				exit(-1);
-			}
-	
-			if ((fd=fopen(sixs_out_filename,"r"))==NULL) {
-				fprintf(stderr,"ERROR: reading temporary file %s\n",sixs_out_filename);
-				exit(-1);
-			}
-			while (fgets(line_in,256,fd)) {
-				line_in[strlen(line_in)-1]='\0';
-				if (j==0) {
-					if (!strncmp(line_in,"*      rayl.  sca. trans. :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r_down[i]);
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r_up[i]);
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r[i]);
-					}
-					if (!strncmp(line_in,"*      water   \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_g_wv[i]);
-					}
-					if (!strncmp(line_in,"*      ozone   \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgoz);
-					}
-					if (!strncmp(line_in,"*      co2     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgco2);
-					}
-					if (!strncmp(line_in,"*      oxyg    \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgo2);
-					}
-					if (!strncmp(line_in,"*      no2     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgno2);
-					}
-					if (!strncmp(line_in,"*      ch4     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgch4);
-					}
-					if (!strncmp(line_in,"*      co      \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgco);
-					}
-					sixs_tables->T_g_og[i]=tgoz*tgco2*tgo2*tgno2*tgno2*tgch4*tgco;
-				}
-				if (!strncmp(line_in,"*      spherical albedo   :",27)) {
-					k=27;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					if (j==0)
-						sscanf(&line_in[k],"%f",&sixs_tables->S_r[i]);
-					while (line_in[k]!=' ')			/* Rayleigh */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					while (line_in[k]!=' ')			/* Aerosol */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->S_ra[i][j]);
-				}
-				if (!strncmp(line_in,"*      optical depth total:",27)) {
-					k=27;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					while (line_in[k]!=' ')			/* Rayleigh */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->aot_wavelength[i][j]);
-				}
-				if (!strncmp(line_in,"*      aeros. sca.   \"    :",27)) {
-					k=27;
-					while (line_in[k]==' ')
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a_down[i][j]);
-					while (line_in[k]!=' ')		/* downward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a_up[i][j]);
-					while (line_in[k]!=' ')		/* upward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a[i][j]);
-				}
-				if (!strncmp(line_in,"*      total  sca.   \"    :",27)) {
-					k=27;
-					while (line_in[k]==' ')
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra_down[i][j]);
-					while (line_in[k]!=' ')		/* downward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra_up[i][j]);
-					while (line_in[k]!=' ')		/* upward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra[i][j]);
-				}
-				if (!strncmp(line_in,"*      reflectance I      :",27)) {
-					k=27;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					if (j==0)
-						sscanf(&line_in[k],"%f",&sixs_tables->rho_r[i]);
-					while (line_in[k]!=' ')		/* rayleigh */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->rho_a[i][j]);
-					while (line_in[k]!=' ')		/* aerosols */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->rho_ra[i][j]);
-				}
 			}
-			fclose(fd);
-/* For OZONE debugging:
-	        sprintf (tmp_file, "%s_b%d_aot%02d", sixs_cmd_filename, i, j);
-            sprintf (cmd_string, "cp %s %s", sixs_cmd_filename, tmp_file);
-            system (cmd_string);
-	        sprintf (tmp_file, "%s_b%d_aot%02d", sixs_out_filename, i, j);
-            sprintf (cmd_string, "cp %s %s", sixs_out_filename, tmp_file);
-            system (cmd_string);
-*/
-		}  /* for j */
-	}  /* for i */
+		if (job == NULL)
+			continue;
+		if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+			fprintf(stderr,"ERROR: Can't run 6S \n");
+			exit(-1);
+		}
+
+		finish_6S_job(job,sixs_tables);
+		nb_running--;
+		nb_done++;
+		printf("Processing 6s run %2d of %d\r",nb_done,nb_jobs);
+		fflush(stdout);
+	}
 	printf ("\n");
-	unlink(sixs_cmd_filename);
-	unlink(sixs_out_filename);
+}
+
+/* Build the text identifying the 6S tables computed for the (rounded)
+   inputs of sixs_tables; it is both hashed into the cache file name and
+   stored in the cache file to guard against hash collisions. */
+static void cache_key_6S(sixs_tables_t *sixs_tables, char *key, size_t size) {
+	int j;
+	size_t len;
+
+	len=snprintf(key,size,"LEDAPS 6S tables v%d\n%d %zu\n%d %d %d\n"
+		"%.2f %.2f %.2f\n%.2f %.2f %.3f %.3f\n",SIXS_CACHE_VERSION,
+		(int)sizeof(float),sizeof(sixs_tables_t),(int)sixs_tables->Inst,
+		sixs_tables->month,sixs_tables->day,
+		round_6S(sixs_tables->sza,SIXS_ANGLE_STEP),
+		round_6S(sixs_tables->phi,SIXS_ANGLE_STEP),
+		round_6S(sixs_tables->vza,SIXS_ANGLE_STEP),
+		round_6S(sixs_tables->uwv,SIXS_GAS_STEP),
+		round_6S(sixs_tables->uoz,SIXS_GAS_STEP),
+		round_6S(sixs_tables->target_alt,SIXS_ALT_STEP),
+		round_6S(sixs_tables->srefl,SIXS_REFL_STEP));
+	for (j=0;(j<SIXS_NB_AOT)&&(len<size);j++)
+		len+=snprintf(&key[len],size-len,"%.3f\n",
+			round_6S(sixs_tables->aot[j],SIXS_REFL_STEP));
+}
+
+/* 64-bit FNV-1a hash of the cache key */
+static unsigned long long hash_6S(const char *key) {
+	unsigned long long hash=14695981039346656037ULL;
+
+	for (;*key;key++) {
+		hash^=(unsigned char)*key;
+		hash*=1099511628211ULL;
+	}
+	return hash;
+}
+
+/* Read the 6S tables for the inputs of sixs_tables from the cache file.
+   Returns 0 if the tables were found, 1 otherwise. */
+static int read_6S_cache(char *filename, char *key, sixs_tables_t *sixs_tables) {
+	FILE *fd;
+	sixs_tables_t cached;
+	char cached_key[SIXS_CACHE_KEY_LEN];
+	size_t len;
+
+	if ((fd=fopen(filename,"rb"))==NULL)
+		return 1;
+	len=strlen(key)+1;
+	if ((fread(cached_key,1,len,fd)!=len)||memcmp(cached_key,key,len)||
+	  (fread(&cached,sizeof(sixs_tables_t),1,fd)!=1)) {
+		fclose(fd);
+		return 1;
+	}
+	fclose(fd);
+
+	/* keep the exact inputs of the caller */
+	cached.Inst=sixs_tables->Inst;
+	cached.month=sixs_tables->month;
+	cached.day=sixs_tables->day;
+	cached.sza=sixs_tables->sza;
+	cached.vza=sixs_tables->vza;
+	cached.phi=sixs_tables->phi;
+	cached.uwv=sixs_tables->uwv;
+	cached.uoz=sixs_tables->uoz;
+	cached.srefl=sixs_tables->srefl;
+	cached.target_alt=sixs_tables->target_alt;
+	*sixs_tables=cached;
 	return 0;
 }
 
-/* This function is not actually used in lndsr processing */
-int create_6S_tables_water(sixs_tables_t *sixs_tables) {
-	char cmd[128],sixs_cmd_filename[128],sixs_out_filename[128],line_in[256];
-	int i,j,k;
+/* Publish the 6S tables in the cache.  The tables are written to a
+   temporary file in the cache directory which is then renamed, so other
+   processes never see a partial file.  Failures only cost the reuse. */
+static void write_6S_cache(char *cache_dir, char *filename, char *key, sixs_tables_t *sixs_tables) {
+	char tmp_filename[SIXS_CACHE_NAME_LEN];
 	FILE *fd;
-	float tgoz,tgco2,tgo2,tgno2,tgch4,tgco;
-	int tm_band[SIXS_NB_BANDS]={25,26,27,28,29,30};
-    char *tmpstr;
-	
-	struct etm_spectral_function_t etm_spectral_function = {
-		{54,61,65,81,131,155},
-		{0.420,0.500,0.580,0.730,1.501,2.0},
-		{0.550,0.650,0.740,0.930,1.825,2.386},
-		{
-			{0.000,0.000,0.000,0.000,0.000,0.000,0.016,0.071,0.287,0.666,0.792,0.857,0.839,0.806,0.779,0.846,0.901,0.900,0.890,0.851,0.875,0.893,0.884,0.930,0.958,0.954,0.980,0.975,0.965,0.962,0.995,0.990,0.990,0.979,0.983,0.969,0.960,0.768,0.293,0.054,0.009,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
-			{0.001,0.002,0.003,0.012,0.026,0.074,0.174,0.348,0.552,0.696,0.759,0.785,0.822,0.870,0.905,0.929,0.947,0.952,0.952,0.951,0.953,0.950,0.954,0.967,0.959,0.941,0.933,0.938,0.951,0.956,0.955,0.956,0.973,0.992,1.000,0.976,0.942,0.930,0.912,0.799,0.574,0.340,0.185,0.105,0.062,0.038,0.021,0.011,0.005,0.002,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
-			{0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.001,0.002,0.010,0.047,0.174,0.419,0.731,0.921,0.942,0.937,0.937,0.949,0.965,0.973,0.970,0.958,0.955,0.962,0.980,0.993,0.998,1.000,0.995,0.992,0.988,0.977,0.954,0.932,0.880,0.729,0.444,0.183,0.066,0.025,0.012,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
-			{0.000,0.000,0.000,0.000,0.000,0.002,0.004,0.002,0.001,0.020,0.032,0.052,0.069,0.110,0.175,0.271,0.402,0.556,0.705,0.812,0.871,0.896,0.908,0.918,0.926,0.928,0.930,0.926,0.925,0.928,0.923,0.916,0.908,0.903,0.909,0.924,0.946,0.954,0.971,0.969,0.967,0.965,0.967,0.961,0.949,0.931,0.925,0.929,0.943,0.961,0.985,0.992,0.998,0.992,0.994,0.997,0.998,1.000,0.991,0.988,0.969,0.926,0.868,0.817,0.819,0.880,0.854,0.572,0.256,0.104,0.044,0.022,0.011,0.007,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
-			{0.000,0.003,0.000,0.001,0.007,0.008,0.008,0.012,0.012,0.028,0.041,0.062,0.087,0.114,0.176,0.230,0.306,0.410,0.481,0.543,0.598,0.642,0.686,0.719,0.750,0.785,0.817,0.845,0.867,0.881,0.902,0.900,0.896,0.892,0.899,0.882,0.872,0.872,0.872,0.878,0.868,0.860,0.877,0.884,0.897,0.895,0.898,0.912,0.921,0.927,0.937,0.947,0.948,0.954,0.961,0.962,0.962,0.964,0.969,0.956,0.952,0.951,0.952,0.953,0.939,0.934,0.928,0.943,0.945,0.935,0.944,0.947,0.944,0.949,0.960,0.966,0.971,0.978,0.993,0.998,0.996,0.996,0.997,0.986,0.990,0.988,0.992,0.985,0.982,0.978,0.970,0.966,0.952,0.927,0.883,0.832,0.751,0.656,0.577,0.483,0.393,0.310,0.239,0.184,0.142,0.104,0.080,0.063,0.049,0.041,0.036,0.023,0.021,0.019,0.012,0.006,0.008,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
-			{0.004,0.001,0.003,0.000,0.002,0.001,0.002,0.002,0.012,0.008,0.009,0.018,0.017,0.031,0.037,0.046,0.058,0.076,0.088,0.110,0.149,0.196,0.242,0.303,0.367,0.437,0.519,0.610,0.677,0.718,0.756,0.774,0.784,0.775,0.789,0.782,0.778,0.766,0.762,0.768,0.775,0.769,0.788,0.808,0.794,0.823,0.811,0.819,0.836,0.837,0.836,0.851,0.859,0.855,0.871,0.873,0.875,0.859,0.872,0.859,0.872,0.863,0.865,0.868,0.877,0.873,0.869,0.876,0.868,0.879,0.873,0.876,0.880,0.874,0.870,0.858,0.863,0.859,0.844,0.859,0.854,0.863,0.868,0.856,0.847,0.861,0.851,0.852,0.838,0.847,0.840,0.831,0.836,0.838,0.822,0.838,0.839,0.842,0.854,0.862,0.873,0.868,0.879,0.891,0.898,0.919,0.920,0.926,0.928,0.934,0.936,0.953,0.954,0.952,0.960,0.973,0.985,0.972,0.970,0.994,0.989,0.975,1.000,0.991,0.968,0.966,0.956,0.929,0.929,0.926,0.903,0.924,0.929,0.928,0.920,0.853,0.775,0.659,0.531,0.403,0.275,0.218,0.131,0.104,0.075,0.052,0.029,0.028,0.014,0.019,0.013,0.007,0.015,0.000,0.004}
-		}
-	};
-	sixs_tables->aot[0]=0.01;
-	sixs_tables->aot[1]=0.05;
-	sixs_tables->aot[2]=0.10;
-	sixs_tables->aot[3]=0.15;
-	sixs_tables->aot[4]=0.20;
-	sixs_tables->aot[5]=0.30;
-	sixs_tables->aot[6]=0.40;
-	sixs_tables->aot[7]=0.60;
-	sixs_tables->aot[8]=0.80;
-	sixs_tables->aot[9]=1.00;
-	sixs_tables->aot[10]=1.20;
-	sixs_tables->aot[11]=1.40;
-	sixs_tables->aot[12]=1.60;
-	sixs_tables->aot[13]=1.80;
-	sixs_tables->aot[14]=2.00;
-	printf ("DEBUG: in compute_6S_tables_water -- shouldn't be here!\n");
-	
-	if ((tmpstr = tmpnam(sixs_cmd_filename)) == NULL) {
-      fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_cmd_filename);
-      exit(-1);
-    }
-	if ((tmpstr = tmpnam(sixs_out_filename)) == NULL) {
-      fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_out_filename);
-      exit(-1);
-    }
-	
-	for (i=0;i<SIXS_NB_BANDS;i++) {
-		for (j=0;j<SIXS_NB_AOT;j++) {
-			printf("Processing Band %d  AOT %d\n",i+1,j+1);
-			if ((fd=fopen(sixs_cmd_filename,"w"))==NULL) {
-				fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_cmd_filename);
-				exit(-1);
-			}
+	int tmp_fd;
+	size_t len;
 
-			fprintf(fd,"%s <<+ >%s\n",get_sixs_path(),sixs_out_filename);
-			fprintf(fd,"0 (user defined)\n");
-			fprintf(fd,"%.2f %.2f %.2f %.2f %d %d (geometrical conditions sza saz vza vaz month day)\n",sixs_tables->sza,sixs_tables->phi,sixs_tables->vza,0.,sixs_tables->month,sixs_tables->day);
-			fprintf(fd,"8 (option for water vapor and ozone)\n");
-			fprintf(fd,"%.2f %.2f (water vapor and ozone)\n",sixs_tables->uwv,sixs_tables->uoz);
-			fprintf(fd,"2 (maritime model)\n");
-			fprintf(fd,"0 (option for optical thickness at 550 nm)\n");
-			fprintf(fd,"%.3f (value of aot550\n",sixs_tables->aot[j]);
-			fprintf(fd,"%f (target level)\n",sixs_tables->target_alt);
-			fprintf(fd,"-1000 (sensor level : -1000=satellite level)\n");
-			switch (sixs_tables->Inst) {
-				case SIXS_INST_TM:
-					fprintf(fd,"%d (predefined band)\n",tm_band[i]);
-				break;
-				case SIXS_INST_ETM:
-					fprintf(fd,"1 (user defined filter function)\n");
-					fprintf(fd,"%05.3f %05.3f (wlinf wlsup)\n",etm_spectral_function.wlinf[i],etm_spectral_function.wlsup[i]);
-					for (k=0;k<etm_spectral_function.nbvals[i];k++) {
-						fprintf(fd,"%05.3f ",etm_spectral_function.response[i][k]);
-						if (!((k+1)%10))
-							fprintf(fd,"\n");
-					}
-					if (k%10)
-						fprintf(fd,"\n");
-				break;
-				default:
-					fprintf(stderr,"ERROR: Unknown Instrument in six_run parameters\n");
-					exit(-1);
-			}
-			fprintf(fd,"0 (homogeneous surface)\n");
-			fprintf(fd,"1 (directional effects)\n");
-			fprintf(fd,"6 (Ocean)\n");
-			fprintf(fd,"2.0 0.0 0.0 .10 (wind speed(m/s) wind azimuth(deg) salinity(deg) pigment concentration(mg/m3))\n");
-			fprintf(fd,"%.3f (value of rho)\n",sixs_tables->srefl);
-			fprintf(fd,"-1 (no atmospheric correction)\n");
-			fprintf(fd,"+\n");
-			fclose(fd);
-	
-            /* Modified 9/26/2014 to run bash shell vs. sh */
-			sprintf(cmd,"bash %s",sixs_cmd_filename);
-			if (system(cmd)) {
-				fprintf(stderr,"ERROR: Can't run 6S \n");
-				exit(-1);
-			}
-	
-			if ((fd=fopen(sixs_out_filename,"r"))==NULL) {
-				fprintf(stderr,"ERROR: reading temporary file %s\n",sixs_out_filename);
-				exit(-1);
-			}
-			while (fgets(line_in,256,fd)) {
-				line_in[strlen(line_in)-1]='\0';
-				if (j==0) {
-					if (!strncmp(line_in,"*      rayl.  sca. trans. :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r_down[i]);
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r_up[i]);
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r[i]);
-					}
-					if (!strncmp(line_in,"*      water   \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_g_wv[i]);
-					}
-					if (!strncmp(line_in,"*      ozone   \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgoz);
-					}
-					if (!strncmp(line_in,"*      co2     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgco2);
-					}
-					if (!strncmp(line_in,"*      oxyg    \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgo2);
-					}
-					if (!strncmp(line_in,"*      no2     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgno2);
-					}
-					if (!strncmp(line_in,"*      ch4     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgch4);
-					}
-					if (!strncmp(line_in,"*      co      \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgco);
-					}
-					sixs_tables->T_g_og[i]=tgoz*tgco2*tgo2*tgno2*tgno2*tgch4*tgco;
-				}
-				if (!strncmp(line_in,"*      spherical albedo   :",27)) {
-					k=27;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					if (j==0)
-						sscanf(&line_in[k],"%f",&sixs_tables->S_r[i]);
-					while (line_in[k]!=' ')			/* Rayleigh */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					while (line_in[k]!=' ')			/* Aerosol */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->S_ra[i][j]);
-				}
-				if (!strncmp(line_in,"*      optical depth total:",27)) {
-					k=27;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					while (line_in[k]!=' ')			/* Rayleigh */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->aot_wavelength[i][j]);
-				}
-				if (!strncmp(line_in,"*      aeros. sca.   \"    :",27)) {
-					k=27;
-					while (line_in[k]==' ')
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a_down[i][j]);
-					while (line_in[k]!=' ')		/* downward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a_up[i][j]);
-					while (line_in[k]!=' ')		/* upward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a[i][j]);
-				}
-				if (!strncmp(line_in,"*      total  sca.   \"    :",27)) {
-					k=27;
-					while (line_in[k]==' ')
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra_down[i][j]);
-					while (line_in[k]!=' ')		/* downward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra_up[i][j]);
-					while (line_in[k]!=' ')		/* upward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra[i][j]);
-				}
-				if (!strncmp(line_in,"*      reflectance I      :",27)) {
-					k=27;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					if (j==0)
-						sscanf(&line_in[k],"%f",&sixs_tables->rho_r[i]);
-					while (line_in[k]!=' ')		/* rayleigh */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->rho_a[i][j]);
-					while (line_in[k]!=' ')		/* aerosols */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->rho_ra[i][j]);
-				}
-				if (!strncmp(line_in,"*       apparent reflectance",28)) { 
-					k=28;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->rho_toa[i][j]);
-				}
-			}
-			fclose(fd);
+	snprintf(tmp_filename,sizeof(tmp_filename),"%s/.sixs_XXXXXX",cache_dir);
+	if ((tmp_fd=mkstemp(tmp_filename))<0) {
+		printf("WARNING: unable to create 6S cache file in %s\n",cache_dir);
+		return;
+	}
+	if ((fd=fdopen(tmp_fd,"wb"))==NULL) {
+		close(tmp_fd);
+		unlink(tmp_filename);
+		printf("WARNING: unable to create 6S cache file in %s\n",cache_dir);
+		return;
+	}
+	len=strlen(key)+1;
+	if ((fwrite(key,1,len,fd)!=len)||
+	  (fwrite(sixs_tables,sizeof(sixs_tables_t),1,fd)!=1)||
+	  fflush(fd)||fsync(fileno(fd))) {
+		fclose(fd);
+		unlink(tmp_filename);
+		printf("WARNING: unable to write 6S cache file %s\n",tmp_filename);
+		return;
+	}
+	fclose(fd);
+	chmod(tmp_filename,0644);
+	if (rename(tmp_filename,filename)) {
+		unlink(tmp_filename);
+		printf("WARNING: unable to publish 6S cache file %s\n",filename);
+	}
+}
+
+/* Compute the 6S tables, reusing the tables from cache_dir (if not NULL)
+   when they were already computed for the same rounded inputs.  Processes
+   sharing cache_dir may both compute the same tables; the last one to
+   finish replaces the file with identical content. */
+int create_6S_tables(sixs_tables_t *sixs_tables, int nworkers, char *cache_dir) {
+	char key[SIXS_CACHE_KEY_LEN];
+	char filename[SIXS_CACHE_NAME_LEN];
+
+	set_6S_aot(sixs_tables);
+	if (cache_dir != NULL) {
+		cache_key_6S(sixs_tables,key,sizeof(key));
+		snprintf(filename,sizeof(filename),"%s/sixs_%016llx.tbl",cache_dir,
+			hash_6S(key));
+		if (!read_6S_cache(filename,key,sixs_tables)) {
+			printf("Using 6s tables from %s\n",filename);
+			return 0;
 		}
 	}
-	unlink(sixs_cmd_filename);
-	unlink(sixs_out_filename);
+
+	run_6S_tables(sixs_tables,SIXS_AER_CONTINENTAL,SIXS_GROUND_LAMBERTIAN,SIXS_NB_AOT,nworkers);
+
+	if (cache_dir != NULL)
+		write_6S_cache(cache_dir,filename,key,sixs_tables);
+	return 0;
+}
+
+/* Compute only the values of the tables that do not depend on the AOT
+   (Rayleigh terms and gaseous transmittances) and the first AOT column,
+   with one 6S run per band. */
+int create_6S_gas_tables(sixs_tables_t *sixs_tables, int nworkers) {
+	set_6S_aot(sixs_tables);
+	run_6S_tables(sixs_tables,SIXS_AER_CONTINENTAL,SIXS_GROUND_LAMBERTIAN,1,nworkers);
+	return 0;
+}
+
+/* This function is not actually used in lndsr processing */
+int create_6S_tables_water(sixs_tables_t *sixs_tables) {
+	set_6S_aot(sixs_tables);
+	printf ("DEBUG: in compute_6S_tables_water -- shouldn't be here!\n");
+	run_6S_tables(sixs_tables,SIXS_AER_MARITIME,SIXS_GROUND_OCEAN,SIXS_NB_AOT,1);
 	return 0;
 }
 
 /* This function is not actually used in lndsr processing */
 int compute_atmos_params_6S(sixs_atmos_params_t *sixs_atmos_params) {
-	char cmd[128],sixs_cmd_filename[128],sixs_out_filename[128],line_in[256];
-	int k;
-	float tgoz,tgco2,tgo2,tgno2,tgch4,tgco;
 	int tm_band[SIXS_NB_BANDS]={25,26,27,28,29,30};
-    char *tmpstr;
-	FILE *fd;
+	sixs_input_t sixs_input;
+	sixs_output_t sixs_output;
 	printf ("DEBUG: in compute_atmos_params_6S -- shouldn't be here!\n");
-	
-	if ((tmpstr = tmpnam(sixs_cmd_filename)) == NULL) {
-      fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_cmd_filename);
-      exit(-1);
-    }
-	if ((tmpstr = tmpnam(sixs_out_filename)) == NULL) {
-      fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_out_filename);
-      exit(-1);
-    }
-
-	if ((fd=fopen(sixs_cmd_filename,"w"))==NULL) {
-		fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_cmd_filename);
-		exit(-1);
-	}
-	fprintf(fd,"%s <<+ >%s\n",get_sixs_path(),sixs_out_filename);
-	fprintf(fd,"0\n");
-	fprintf(fd,"%.2f %.2f %.2f %.2f %d %d\n",sixs_atmos_params->sza,sixs_atmos_params->phi,sixs_atmos_params->vza,0.,sixs_atmos_params->month,sixs_atmos_params->day);
-	fprintf(fd,"8\n");
-	fprintf(fd,"%.2f %.2f\n",sixs_atmos_params->uwv,sixs_atmos_params->uoz);
+
+	memset(&sixs_input,0,sizeof(sixs_input_t));
+	sixs_input.sza=sixs_atmos_params->sza;
+	sixs_input.saz=sixs_atmos_params->phi;
+	sixs_input.vza=sixs_atmos_params->vza;
+	sixs_input.vaz=0.;
+	sixs_input.month=sixs_atmos_params->month;
+	sixs_input.day=sixs_atmos_params->day;
+	sixs_input.uwv=sixs_atmos_params->uwv;
+	sixs_input.uoz=sixs_atmos_params->uoz;
 	if (sixs_atmos_params->aot > 0) {
-		fprintf(fd,"1\n");
-		fprintf(fd,"0\n");
-		fprintf(fd,"%.3f\n",sixs_atmos_params->aot);
+		sixs_input.aer_model=SIXS_AER_CONTINENTAL;
+		sixs_input.aot550=sixs_atmos_params->aot;
 	} else {
-		fprintf(fd,"0\n");
-		fprintf(fd,"-1\n");
-	}
-	fprintf(fd,"0\n");
-	fprintf(fd,"-1000\n");
-	fprintf(fd,"%d\n",tm_band[sixs_atmos_params->band]);
-	fprintf(fd,"0\n");
-	fprintf(fd,"0\n");
-	fprintf(fd,"0\n");
-	fprintf(fd,"%.3f\n",sixs_atmos_params->srefl);
-	fprintf(fd,"-1\n");
-	fprintf(fd,"0\n");
-	fprintf(fd,"+\n");
-	fclose(fd);
-	
-	sprintf(cmd,"bash %s",sixs_cmd_filename);
-	if (system(cmd)) {
-		fprintf(stderr,"ERROR: Can't run 6S \n");
-		exit(-1);
+		sixs_input.aer_model=SIXS_AER_NONE;
 	}
-	
-	if ((fd=fopen(sixs_out_filename,"r"))==NULL) {
-		fprintf(stderr,"ERROR: reading temporary file %s\n",sixs_out_filename);
-		exit(-1);
-	}
-	while (fgets(line_in,256,fd)) {
-		line_in[strlen(line_in)-1]='\0';
-		if (!strncmp(line_in,"*      spherical albedo   :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->S_r);
-		}
-		if (!strncmp(line_in,"*      rayl.  sca. trans. :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->T_r_down);
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->T_r_up);
-		}
-		if (!strncmp(line_in,"*      aeros. sca.   \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->T_a_down);
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->T_a_up);
-		}
-		if (!strncmp(line_in,"*      reflectance I      :",27)) {
-			k=27;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->rho_r);
-			while (line_in[k]!=' ')		/* rayleigh */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->rho_a);
-		}
-		if (!strncmp(line_in,"*      water   \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->T_g_wv);
-		}
-		if (!strncmp(line_in,"*      ozone   \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgoz);
-		}
-		if (!strncmp(line_in,"*      co2     \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgco2);
-		}
-		if (!strncmp(line_in,"*      oxyg    \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgo2);
-		}
-		if (!strncmp(line_in,"*      no2     \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgno2);
-		}
-		if (!strncmp(line_in,"*      ch4     \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgch4);
-		}
-		if (!strncmp(line_in,"*      co      \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgco);
-		}
-	}
-	fclose(fd);
-	sixs_atmos_params->T_g_og=tgoz*tgco2*tgo2*tgno2*tgno2*tgch4*tgco;
-	
-	unlink(sixs_cmd_filename);
-	unlink(sixs_out_filename);
+	sixs_input.target_alt=0.;
+	sixs_input.iwave=tm_band[sixs_atmos_params->band];
+	sixs_input.ground=SIXS_GROUND_LAMBERTIAN;
+	sixs_input.rho=sixs_atmos_params->srefl;
+	run_6S(&sixs_input,&sixs_output);
+
+	sixs_atmos_params->S_r=sixs_output.S[SIXS_RAYLEIGH];
+	sixs_atmos_params->T_r_down=sixs_output.T_sca[SIXS_RAYLEIGH][SIXS_DOWNWARD];
+	sixs_atmos_params->T_r_up=sixs_output.T_sca[SIXS_RAYLEIGH][SIXS_UPWARD];
+	sixs_atmos_params->T_a_down=sixs_output.T_sca[SIXS_AEROSOLS][SIXS_DOWNWARD];
+	sixs_atmos_params->T_a_up=sixs_output.T_sca[SIXS_AEROSOLS][SIXS_UPWARD];
+	sixs_atmos_params->rho_r=sixs_output.rho[SIXS_RAYLEIGH];
+	sixs_atmos_params->rho_a=sixs_output.rho[SIXS_AEROSOLS];
+	sixs_atmos_params->T_g_wv=sixs_output.T_g[SIXS_GAS_WATER][SIXS_TOTAL];
+	sixs_atmos_params->T_g_og=sixs_output.T_g[SIXS_GAS_OZONE][SIXS_TOTAL]*
+		sixs_output.T_g[SIXS_GAS_CO2][SIXS_TOTAL]*
+		sixs_output.T_g[SIXS_GAS_OXYG][SIXS_TOTAL]*
+		sixs_output.T_g[SIXS_GAS_NO2][SIXS_TOTAL]*
+		sixs_output.T_g[SIXS_GAS_NO2][SIXS_TOTAL]*
+		sixs_output.T_g[SIXS_GAS_CH4][SIXS_TOTAL]*
+		sixs_output.T_g[SIXS_GAS_CO][SIXS_TOTAL];
 	return 0;
 }
 
@@ -53,7 +53,8 @@ typedef struct {
 	float rho_a;  /* aerosol reflectance */
 } sixs_atmos_params_t;
 
-int create_6S_tables(sixs_tables_t *sixs_tables, Input_meta_t *meta);
+int create_6S_tables(sixs_tables_t *sixs_tables, int nworkers, char *cache_dir);
+int create_6S_gas_tables(sixs_tables_t *sixs_tables, int nworkers);
 int compute_atmos_params_6S(sixs_atmos_params_t *sixs_atmos_params);
 
 #endif
@@ -2,6 +2,9 @@
 #include "ar.h"
 #include "const.h"
 #include "sixs_runs.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 /* !Revision:
  *
@@ -10,86 +13,380 @@
  *   ascending scenes or scenes where the image is flipped North to South
  * revision 8/11/2015  Gail Schmidt, USGS
  * - input saturated pixels are flagged as such and output as saturated
+ * revision 11/11/2015
+ * - the atmospheric coefficients of Sr are interpolated for runs of samples
+ *   (SrInterpAtmCoefLine) instead of per pixel with per-line allocations
+ * - the surface reflectance of a band is computed 4 samples at a time with
+ *   SSE2 (SrBandSse2) when available, SrBand being the scalar version
  */
 
 extern atmos_t atmos_coef;
 int SrInterpAtmCoef(Lut_t *lut, Img_coord_int_t *input_loc, atmos_t *atmos_coef,atmos_t *interpol_atmos_coef); 
 
-bool Sr(Lut_t *lut, int nsamp, int il, int16 **line_in, int16 **line_out,
-        Sr_stats_t *sr_stats) 
+#define SR_COEF_NSAMP (256)   /* samples interpolated at a time */
+
+/* Atmospheric coefficients used by Sr, interpolated for SR_COEF_NSAMP
+   consecutive samples of a line (one array per band and coefficient) */
+typedef struct {
+  float tgOG[NBAND_REFL_MAX][SR_COEF_NSAMP];
+  float tgH2O[NBAND_REFL_MAX][SR_COEF_NSAMP];
+  float td_ra[NBAND_REFL_MAX][SR_COEF_NSAMP];
+  float tu_ra[NBAND_REFL_MAX][SR_COEF_NSAMP];
+  float rho_ra[NBAND_REFL_MAX][SR_COEF_NSAMP];
+  float S_ra[NBAND_REFL_MAX][SR_COEF_NSAMP];
+} Sr_coef_t;
+
+static void SrInterpAtmCoefLine(Lut_t *lut, int il, int is0, int ns,
+  atmos_t *atmos_coef, Sr_coef_t *coef);
+
+/* Surface reflectance of samples k0 to ns-1 of band ib of a run of samples
+   (scalar version).  skip_stats is set (-1) for the fill and saturated
+   pixels, which are not included in the min/max statistics of this and the
+   following bands. */
+static void SrBand(Lut_t *lut, int ib, int k0, int ns, int16 *line_in,
+  int16 *line_out, Sr_coef_t *coef, int *skip_stats, Sr_stats_t *sr_stats)
 {
-  int is;
-  bool is_fill;      /* is the pixel fill */
-  bool is_satu;      /* is the pixel saturated */
-  int ib;
-  Img_coord_int_t loc;
+  int k;
   float rho,tmpflt;
-  atmos_t interpol_atmos_coef;
 
-  allocate_mem_atmos_coeff(1,&interpol_atmos_coef);
-  loc.l = il;
+  for (k = k0; k < ns; k++) {
+    if (line_in[k] == lut->in_fill) {
+      /* fill pixel */
+      skip_stats[k] = -1;
+      line_out[k] = lut->output_fill;
+      sr_stats->nfill[ib]++;
+    }
+    else if (line_in[k] == lut->in_satu) {
+      /* saturated pixel */
+      skip_stats[k] = -1;
+      line_out[k] = lut->output_satu;
+      sr_stats->nsatu[ib]++;
+    }
+    else {
+      rho=(float)line_in[k]/10000.;
+      rho=(rho/coef->tgOG[ib][k]-coef->rho_ra[ib][k]);
+      tmpflt=(coef->tgH2O[ib][k]*coef->td_ra[ib][k]*coef->tu_ra[ib][k]);
+      rho /= tmpflt;
+      rho /= (1.+coef->S_ra[ib][k]*rho);
+
+      line_out[k] = (short)(rho*10000.);  /* scale for output */
+
+      if (line_out[k] < lut->min_valid_sr) {
+        sr_stats->nout_range[ib]++;
+        line_out[k] = lut->min_valid_sr;
+      }
+      if (line_out[k] > lut->max_valid_sr) {
+        sr_stats->nout_range[ib]++;
+        line_out[k] = lut->max_valid_sr;
+      }
+    }
+
+    if (skip_stats[k]) continue;
+
+    if (sr_stats->first[ib]) {
+      sr_stats->sr_min[ib] = sr_stats->sr_max[ib] = line_out[k];
+      sr_stats->first[ib] = false;
+    } else {
+      if (line_out[k] < sr_stats->sr_min[ib])
+        sr_stats->sr_min[ib] = line_out[k];
+
+      if (line_out[k] > sr_stats->sr_max[ib])
+        sr_stats->sr_max[ib] = line_out[k];
+    } 
+  }
+}
+
+#ifdef __SSE2__
+#define SSE2_BLEND(m,a,b) _mm_or_si128(_mm_and_si128(m,a),_mm_andnot_si128(m,b))
+
+/* Same as SrBand, 4 samples at a time with SSE2; the samples left over are
+   done by SrBand.  The steps done in double precision by SrBand are done in
+   double precision here too, so the results are identical. */
+static void SrBandSse2(Lut_t *lut, int ib, int ns, int16 *line_in,
+  int16 *line_out, Sr_coef_t *coef, int *skip_stats, Sr_stats_t *sr_stats)
+{
+  int k, nmask, cnt[4];
+  int vmin[4], vmax[4];
+  long nfill = 0, nsatu = 0, nout_range = 0;
+  bool any = false;
+  __m128i x, o, m_fill, m_satu, m_lo, m_hi, m_skip;
+  __m128i in_fill = _mm_set1_epi32(lut->in_fill);
+  __m128i in_satu = _mm_set1_epi32(lut->in_satu);
+  __m128i out_fill = _mm_set1_epi32(lut->output_fill);
+  __m128i out_satu = _mm_set1_epi32(lut->output_satu);
+  __m128i min_sr = _mm_set1_epi32(lut->min_valid_sr);
+  __m128i max_sr = _mm_set1_epi32(lut->max_valid_sr);
+  __m128i v_min = _mm_set1_epi32(0x7fffffff);
+  __m128i v_max = _mm_set1_epi32(-0x7fffffff - 1);
+  __m128i m_any = _mm_setzero_si128();
+  __m128 rho, tmpflt;
+  __m128d scale = _mm_set1_pd(10000.), one = _mm_set1_pd(1.);
+  __m128d d_lo, d_hi;
+
+  for (k = 0; k + 4 <= ns; k += 4) {
+    /* input and fill/saturated masks */
+    x = _mm_loadl_epi64((__m128i *)&line_in[k]);
+    x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+    m_fill = _mm_cmpeq_epi32(x, in_fill);
+    m_satu = _mm_andnot_si128(m_fill, _mm_cmpeq_epi32(x, in_satu));
+
+    /* rho=(float)line_in/10000. */
+    d_lo = _mm_div_pd(_mm_cvtepi32_pd(x), scale);
+    d_hi = _mm_div_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(x, 0x4e)), scale);
+    rho = _mm_movelh_ps(_mm_cvtpd_ps(d_lo), _mm_cvtpd_ps(d_hi));
+
+    /* rho=(rho/tgOG-rho_ra); rho /= (tgH2O*td_ra*tu_ra) */
+    rho = _mm_sub_ps(_mm_div_ps(rho, _mm_loadu_ps(&coef->tgOG[ib][k])),
+      _mm_loadu_ps(&coef->rho_ra[ib][k]));
+    tmpflt = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(&coef->tgH2O[ib][k]),
+      _mm_loadu_ps(&coef->td_ra[ib][k])), _mm_loadu_ps(&coef->tu_ra[ib][k]));
+    rho = _mm_div_ps(rho, tmpflt);
+
+    /* rho /= (1.+S_ra*rho) */
+    tmpflt = _mm_mul_ps(_mm_loadu_ps(&coef->S_ra[ib][k]), rho);
+    d_lo = _mm_div_pd(_mm_cvtps_pd(rho),
+      _mm_add_pd(one, _mm_cvtps_pd(tmpflt)));
+    d_hi = _mm_div_pd(_mm_cvtps_pd(_mm_movehl_ps(rho, rho)),
+      _mm_add_pd(one, _mm_cvtps_pd(_mm_movehl_ps(tmpflt, tmpflt))));
+    rho = _mm_movelh_ps(_mm_cvtpd_ps(d_lo), _mm_cvtpd_ps(d_hi));
+
+    /* (short)(rho*10000.) */
+    d_lo = _mm_mul_pd(_mm_cvtps_pd(rho), scale);
+    d_hi = _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(rho, rho)), scale);
+    o = _mm_unpacklo_epi64(_mm_cvttpd_epi32(d_lo), _mm_cvttpd_epi32(d_hi));
+    o = _mm_srai_epi32(_mm_slli_epi32(o, 16), 16);
+
+    /* clamp to the valid range */
+    m_lo = _mm_cmplt_epi32(o, min_sr);
+    o = SSE2_BLEND(m_lo, min_sr, o);
+    m_hi = _mm_cmpgt_epi32(o, max_sr);
+    o = SSE2_BLEND(m_hi, max_sr, o);
+
+    /* fill and saturated pixels */
+    o = SSE2_BLEND(m_fill, out_fill, o);
+    o = SSE2_BLEND(m_satu, out_satu, o);
+    _mm_storel_epi64((__m128i *)&line_out[k], _mm_packs_epi32(o, o));
+
+    nmask = _mm_movemask_ps(_mm_castsi128_ps(m_fill));
+    nfill += __builtin_popcount(nmask);
+    nmask = _mm_movemask_ps(_mm_castsi128_ps(m_satu));
+    nsatu += __builtin_popcount(nmask);
+    nmask = _mm_movemask_ps(_mm_castsi128_ps(_mm_andnot_si128(
+      _mm_or_si128(m_fill, m_satu), _mm_or_si128(m_lo, m_hi))));
+    nout_range += __builtin_popcount(nmask);
+
+    /* min/max of the pixels not fill or saturated in this or a previous
+       band */
+    m_skip = _mm_or_si128(_mm_loadu_si128((__m128i *)&skip_stats[k]),
+      _mm_or_si128(m_fill, m_satu));
+    _mm_storeu_si128((__m128i *)&skip_stats[k], m_skip);
+    m_lo = _mm_cmplt_epi32(o, v_min);
+    v_min = SSE2_BLEND(_mm_andnot_si128(m_skip, m_lo), o, v_min);
+    m_hi = _mm_cmpgt_epi32(o, v_max);
+    v_max = SSE2_BLEND(_mm_andnot_si128(m_skip, m_hi), o, v_max);
+    m_any = _mm_or_si128(m_any, _mm_andnot_si128(m_skip,
+      _mm_cmpeq_epi32(o, o)));
+  }
+
+  sr_stats->nfill[ib] += nfill;
+  sr_stats->nsatu[ib] += nsatu;
+  sr_stats->nout_range[ib] += nout_range;
+
+  /* reduce the min/max */
+  _mm_storeu_si128((__m128i *)vmin, v_min);
+  _mm_storeu_si128((__m128i *)vmax, v_max);
+  _mm_storeu_si128((__m128i *)cnt, m_any);
+  for (nmask = 0; nmask < 4; nmask++) {
+    if (!cnt[nmask]) continue;
+    if (!any || vmin[nmask] < vmin[0]) vmin[0] = vmin[nmask];
+    if (!any || vmax[nmask] > vmax[0]) vmax[0] = vmax[nmask];
+    any = true;
+  }
+  if (any) {
+    if (sr_stats->first[ib]) {
+      sr_stats->sr_min[ib] = vmin[0];
+      sr_stats->sr_max[ib] = vmax[0];
+      sr_stats->first[ib] = false;
+    } else {
+      if (vmin[0] < sr_stats->sr_min[ib])
+        sr_stats->sr_min[ib] = vmin[0];
+      if (vmax[0] > sr_stats->sr_max[ib])
+        sr_stats->sr_max[ib] = vmax[0];
+    }
+  }
+
+  SrBand(lut, ib, k, ns, line_in, line_out, coef, skip_stats, sr_stats);
+}
+#endif
 
-  for (is = 0; is < nsamp; is++) {
-    loc.s = is;
-    is_fill = false;
-    is_satu = false;
+bool Sr(Lut_t *lut, int nsamp, int il, int16 **line_in, int16 **line_out,
+        Sr_stats_t *sr_stats) 
+{
+  int is0, ns, k;
+  int skip_stats[SR_COEF_NSAMP]; /* is the pixel fill or saturated in this
+                                    or a previous band (-1) */
+  int ib;
+  Sr_coef_t coef;
 
 /*
 NAZMI 6/2/04 : correct even cloudy pixels
 
 */
-	 SrInterpAtmCoef(lut, &loc, &atmos_coef,&interpol_atmos_coef);
+  for (is0 = 0; is0 < nsamp; is0 += SR_COEF_NSAMP) {
+    ns = nsamp - is0;
+    if (ns > SR_COEF_NSAMP) ns = SR_COEF_NSAMP;
+
+    SrInterpAtmCoefLine(lut, il, is0, ns, &atmos_coef, &coef);
+
+    for (k = 0; k < ns; k++)
+      skip_stats[k] = 0;
 
     for (ib = 0; ib < lut->nband; ib++) {
-      if (line_in[ib][is] == lut->in_fill) {
-        /* fill pixel */
-        is_fill = true;
-        line_out[ib][is] = lut->output_fill;
-        sr_stats->nfill[ib]++;
-      }
-      else if (line_in[ib][is] == lut->in_satu) {
-        /* saturated pixel */
-        is_satu = true;
-        line_out[ib][is] = lut->output_satu;
-        sr_stats->nsatu[ib]++;
-      }
-      else {
-        rho=(float)line_in[ib][is]/10000.;
-        rho=(rho/interpol_atmos_coef.tgOG[ib][0]-interpol_atmos_coef.rho_ra[ib][0]);
-        tmpflt=(interpol_atmos_coef.tgH2O[ib][0]*interpol_atmos_coef.td_ra[ib][0]*interpol_atmos_coef.tu_ra[ib][0]);
-        rho /= tmpflt;
-        rho /= (1.+interpol_atmos_coef.S_ra[ib][0]*rho);
-
-        line_out[ib][is] = (short)(rho*10000.);  /* scale for output */
-
-        if (line_out[ib][is] < lut->min_valid_sr) {
-          sr_stats->nout_range[ib]++;
-          line_out[ib][is] = lut->min_valid_sr;
-        }
-        if (line_out[ib][is] > lut->max_valid_sr) {
-          sr_stats->nout_range[ib]++;
-          line_out[ib][is] = lut->max_valid_sr;
-        }
-      }
+#ifdef __SSE2__
+      SrBandSse2(lut, ib, ns, &line_in[ib][is0], &line_out[ib][is0], &coef,
+        skip_stats, sr_stats);
+#else
+      SrBand(lut, ib, 0, ns, &line_in[ib][is0], &line_out[ib][is0], &coef,
+        skip_stats, sr_stats);
+#endif
+    }
+  }
 
-      if (is_fill || is_satu) continue;
+  return true;
+}
 
-      if (sr_stats->first[ib]) {
-        sr_stats->sr_min[ib] = sr_stats->sr_max[ib] = line_out[ib][is];
-        sr_stats->first[ib] = false;
-      } else {
-        if (line_out[ib][is] < sr_stats->sr_min[ib])
-          sr_stats->sr_min[ib] = line_out[ib][is];
 
-        if (line_out[ib][is] > sr_stats->sr_max[ib])
-          sr_stats->sr_max[ib] = line_out[ib][is];
-      } 
-    }  /* end for */
+static void SrInterpAtmCoefLine(Lut_t *lut, int il, int is0, int ns,
+  atmos_t *atmos_coef, Sr_coef_t *coef)
+/* 
+  Same interpolation as SrInterpAtmCoef, for the coefficients used by Sr
+  and the samples is0 to is0+ns-1 of line il.  coef must hold the previous
+  run of the line (if is0 > 0), whose last coefficients are carried over
+  where no grid cell is available.  The grid cells and line
+  weights are only computed once per line and the cells once per run of
+  samples between aerosol grid columns, and the sums are done in the same
+  order so the results are identical.
 
+  Point order:
+
+    0 ---- 1    +--> sample
+    |      |    |
+    |      |    v
+    2 ---- 3   line
+
+ */
+{
+  Img_coord_int_t p[4];
+  int i, n, ib, is, is_end, k, kp;
+  int ipt[4];
+  bool valid[4];
+  double dl[4], ds0, ds1, w[4], sum_w;
+  double s_tgOG, s_tgH2O, s_td_ra, s_tu_ra, s_rho_ra, s_S_ra;
+  Img_coord_int_t ar_region_half;
+
+  ar_region_half.l = (lut->ar_region_size.l + 1) / 2;
+  ar_region_half.s = (lut->ar_region_size.s + 1) / 2;
+
+  /* Lines of the grid cells and line weights */
+  p[0].l = (il - ar_region_half.l) / lut->ar_region_size.l;
+
+  p[2].l = p[0].l + 1;
+  if (p[2].l >= lut->ar_size.l) {
+    p[2].l = lut->ar_size.l - 1;
+    if (p[0].l > 0) p[0].l--;
+  }    
+      
+  p[1].l = p[0].l;
+  p[3].l = p[2].l;
+
+  for (i = 0; i < 4; i++) {
+    dl[i] = (il - ar_region_half.l) - (p[i].l * lut->ar_region_size.l);
+    dl[i] = fabs(dl[i]) / lut->ar_region_size.l;
   }
 
-  free_mem_atmos_coeff(&interpol_atmos_coef);
-  return true;
+  for (is = is0; is < is0 + ns; is = is_end) {
+
+    /* Samples of the grid cells, constant up to is_end */
+    p[0].s = (is - ar_region_half.s) / lut->ar_region_size.s;
+    is_end = ar_region_half.s + (p[0].s + 1) * lut->ar_region_size.s;
+    if (is_end > is0 + ns) is_end = is0 + ns;
+    p[1].s = p[0].s + 1;
+
+    if (p[1].s >= lut->ar_size.s) {
+      p[1].s = lut->ar_size.s - 1;
+      if (p[0].s > 0) p[0].s--;
+    }    
+
+    p[2].s = p[0].s;
+    p[3].s = p[1].s;
+
+    n = 0;
+    for (i = 0; i < 4; i++) {
+      ipt[i] = p[i].l * lut->ar_size.s + p[i].s;
+      valid[i] = p[i].l != -1  &&  p[i].s != -1  &&  atmos_coef->computed[ipt[i]];
+      if (valid[i]) n++;
+    }
+
+    for (k = is - is0; k < is_end - is0; k++) {
+      ds0 = (is0 + k - ar_region_half.s) - (p[0].s * lut->ar_region_size.s);
+      ds0 = fabs(ds0) / lut->ar_region_size.s;
+      ds1 = (is0 + k - ar_region_half.s) - (p[1].s * lut->ar_region_size.s);
+      ds1 = fabs(ds1) / lut->ar_region_size.s;
+      w[0] = (1.0 - dl[0]) * (1.0 - ds0);
+      w[1] = (1.0 - dl[1]) * (1.0 - ds1);
+      w[2] = (1.0 - dl[2]) * (1.0 - ds0);
+      w[3] = (1.0 - dl[3]) * (1.0 - ds1);
+
+      if (n == 0) {
+        /* no coefficients: keep the ones of the previous sample, which for
+           the first sample of a run is the last one of the previous (full)
+           run, still in coef; the defaults are only used at the start of
+           the line */
+        kp = (k > 0) ? k - 1 : SR_COEF_NSAMP - 1;
+        for (ib = 0; ib < lut->nband; ib++) {
+          if (k > 0 || is0 > 0) {
+            coef->tgOG[ib][k] = coef->tgOG[ib][kp];
+            coef->tgH2O[ib][k] = coef->tgH2O[ib][kp];
+            coef->td_ra[ib][k] = coef->td_ra[ib][kp];
+            coef->tu_ra[ib][k] = coef->tu_ra[ib][kp];
+            coef->rho_ra[ib][k] = coef->rho_ra[ib][kp];
+            coef->S_ra[ib][k] = coef->S_ra[ib][kp];
+          } else {
+            coef->tgOG[ib][k] = 1.;
+            coef->tgH2O[ib][k] = 1.;
+            coef->td_ra[ib][k] = 1.;
+            coef->tu_ra[ib][k] = 1.;
+            coef->rho_ra[ib][k] = 0.;
+            coef->S_ra[ib][k] = 0.;
+          }
+        }
+        continue;
+      }
+
+      sum_w = 0.0;
+      for (i = 0; i < 4; i++)
+        if (valid[i]) sum_w += w[i];
+
+      for (ib = 0; ib < lut->nband; ib++) {
+        s_tgOG = s_tgH2O = s_td_ra = s_tu_ra = s_rho_ra = s_S_ra = 0.0;
+        for (i = 0; i < 4; i++) {
+          if (!valid[i]) continue;
+          s_tgOG += (atmos_coef->tgOG[ib][ipt[i]] * w[i]);
+          s_tgH2O += (atmos_coef->tgH2O[ib][ipt[i]] * w[i]);
+          s_td_ra += (atmos_coef->td_ra[ib][ipt[i]] * w[i]);
+          s_tu_ra += (atmos_coef->tu_ra[ib][ipt[i]] * w[i]);
+          s_rho_ra += (atmos_coef->rho_ra[ib][ipt[i]] * w[i]);
+          s_S_ra += (atmos_coef->S_ra[ib][ipt[i]] * w[i]);
+        }
+        coef->tgOG[ib][k] = s_tgOG / sum_w;
+        coef->tgH2O[ib][k] = s_tgH2O / sum_w;
+        coef->td_ra[ib][k] = s_td_ra / sum_w;
+        coef->tu_ra[ib][k] = s_tu_ra / sum_w;
+        coef->rho_ra[ib][k] = s_rho_ra / sum_w;
+        coef->S_ra[ib][k] = s_S_ra / sum_w;
+      }
+    }
+  }
 }
 
 
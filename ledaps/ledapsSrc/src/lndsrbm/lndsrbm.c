@@ -14,6 +14,14 @@ Date         Programmer       Reason
 ----------   --------------   -------------------------------------
 2/10/2014    Gail Schmidt     Original development (based on FORTRAN and ksh
                               code from original lndsrbm application)
+11/18/2015                    The scene center temperature and the delta x/y
+                              for the northern adjustment are computed here
+                              from the XML and PRWV files when they are not
+                              given, instead of by lndsrbm.ksh with dump_meta,
+                              SDSreader3.0, comptemp, xy2geo and geo2xy
+11/18/2015                    The bands are streamed line by line and the
+                              QA is kept in bit masks, with the memory of the
+                              shadow search window bounded by --max_mem
 
 NOTES:
   1. The XML metadata format read by this application follows the ESPA internal
@@ -28,9 +36,30 @@ NOTES:
 #include "espa_metadata.h"
 #include "parse_metadata.h"
 #include "raw_binary_io.h"
+#include "mfhdf.h"
+#include "morph.h"
 
-typedef signed short int16;
-typedef unsigned char uint8;
+#define D2R 1.745329251994328e-2
+
+/* Name of the air temperature SDS of the PRWV file and number of its time
+   samples for the day (0 hr, 6 hr, 12 hr and 18 hr) */
+#define PRWV_AIR_SDS "air"
+#define PRWV_NTIME 4
+
+/* Band 5 value of the shadow search window for the pixels which can't be a
+   cloud shadow; no candidate band 5 value reaches it */
+#define NO_SHADOW 9999
+
+/* Bytes in a megabyte, for the --max_mem memory cap */
+#define MBYTE 1048576.0
+
+/* Projection routines from the GCTP package (LS_geoloc.c) */
+int LSsphdz (char *projection, float coordinates[8], double *parm,
+    double *radius, double corner[2]);
+int LSutminv (double s, double l, double *lon, double *lat);
+int LSutmfor (double *s, double *l, double lon, double lat);
+int LSpsinv (double s, double l, double *lon, double *lat);
+int LSpsfor (double *s, double *l, double lon, double lat);
 
 /******************************************************************************
 MODULE: usage
@@ -53,16 +82,29 @@ void usage ()
             "product, using the already computed and available surface "
             "reflectance and brightness temperature values.\n\n");
     printf ("usage: lndsrbm "
-            "--temp_center=scene_center_temperature_in_kelvin "
-            "--dx=deltax --dy=deltay "
-            "--xml=input_xml_filename\n");
+            "--xml=input_xml_filename "
+            "[--prwv=input_prwv_filename] "
+            "[--center_temp=scene_center_temperature_in_kelvin] "
+            "[--dx=deltax --dy=deltay] "
+            "[--max_mem=memory_cap_in_mbytes]\n");
     printf ("\nwhere the following parameters are required:\n");
-    printf ("    -temp_center: temperature at the scene center (Kelvin)\n");
-    printf ("    -dx: delta x (for northern adjustment)\n");
-    printf ("    -dy: delta y (for northern adjustment)\n");
     printf ("    -xml: name of the input XML metadata file which follows "
             "the ESPA internal raw binary schema\n");
+    printf ("\nand the following parameters are optional:\n");
+    printf ("    -prwv: name of the PRWV auxiliary file, required if "
+            "center_temp is not given\n");
+    printf ("    -center_temp: temperature at the scene center (Kelvin); "
+            "interpolated from the PRWV air temperature if not given\n");
+    printf ("    -dx: delta x (for northern adjustment)\n");
+    printf ("    -dy: delta y (for northern adjustment); dx and dy are "
+            "computed from the scene projection if not given\n");
+    printf ("    -max_mem: approximate memory cap (MB) of the cloud shadow "
+            "search; the bands are streamed through a window of lines sized "
+            "to fit it (default 0, no cap: the whole scene)\n");
     printf ("\nExample: lndsrbm "
+            "--xml=LE70230282011250EDC00.xml "
+            "--prwv=REANALYSIS_2011250.hdf\n");
+    printf ("Example: lndsrbm "
             "--center_temp=250.037186 --dx=-27.5052 --dy=91.7454 "
             "--xml=LE70230282011250EDC00.xml\n");
 }
@@ -89,41 +131,53 @@ Date         Programmer       Reason
 2/11/2014    Gail Schmidt     northern adjustment is now calculated from delta
                               x and y values; computation is borrowed from
                               compadjn.f
+11/18/2015                    The PRWV file was added and the scene center
+                              temp and delta x/y were made optional; the
+                              northern adjustment is computed by the caller
+11/18/2015                    Added the max_mem option
 
 NOTES:
-  1. Memory is allocated for the xml file.  This should be a character pointer
-     set to NULL on input.  The caller is responsible for freeing the allocated
-     memory upon successful return.
+  1. Memory is allocated for the xml and PRWV files.  These should be
+     character pointers set to NULL on input.  The caller is responsible for
+     freeing the allocated memory upon successful return.
+  2. The scene center temp and delta x/y are set to -9999.0 if they are not
+     specified.  The memory cap is set to 0 (no cap) if not specified.
 ******************************************************************************/
 short get_args
 (
     int argc,             /* I: number of cmd-line args */
     char *argv[],         /* I: string of cmd-line args */
     float *center_temp,   /* O: address of the scene center temp (Kelvin) */
-    float *north_adj,     /* O: addr of adjustment for true north (degrees) */
-    char **xml_infile     /* O: address of input XML filename */
+    float *dx,            /* O: address of the delta x value for northern
+                                adjustment computation */
+    float *dy,            /* O: address of the delta y value for northern
+                                adjustment computation */
+    char **xml_infile,    /* O: address of input XML filename */
+    char **prwv_infile,   /* O: address of input PRWV filename */
+    int *max_mem          /* O: address of the memory cap (MB) */
 )
 {
     int c;                           /* current argument index */
     int option_index;                /* index for the command-line option */
-    float dx, dy;                    /* delta x and y values for northern
-                                        adjustment computation */
-    float fac;                       /* adjustment factor */
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static struct option long_options[] =
     {
         {"xml", required_argument, 0, 'i'},
+        {"prwv", required_argument, 0, 'p'},
         {"center_temp", required_argument, 0, 't'},
         {"dx", required_argument, 0, 'x'},
         {"dy", required_argument, 0, 'y'},
+        {"max_mem", required_argument, 0, 'm'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
 
     /* Loop through all the cmd-line options */
-    dx = -9999.0;
-    dy = -9999.0;
+    *center_temp = -9999.0;
+    *dx = -9999.0;
+    *dy = -9999.0;
+    *max_mem = 0;
     opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
     while (1)
     {
@@ -150,17 +204,25 @@ short get_args
             case 'i':  /* XML infile */
                 *xml_infile = strdup (optarg);
                 break;
+
+            case 'p':  /* PRWV infile */
+                *prwv_infile = strdup (optarg);
+                break;
      
             case 't':  /* scene center temperature */
                 *center_temp = atof (optarg);
                 break;
      
             case 'x':  /* delta x */
-                dx = atof (optarg);
+                *dx = atof (optarg);
                 break;
      
             case 'y':  /* delta y */
-                dy = atof (optarg);
+                *dy = atof (optarg);
+                break;
+     
+            case 'm':  /* memory cap */
+                *max_mem = atoi (optarg);
                 break;
      
             case '?':
@@ -182,10 +244,402 @@ short get_args
         return (ERROR);
     }
 
-    /* Compute the northern adjustment */
-    fac = atan (1.0) / 45.0;
-    *north_adj = atan (dx / dy) / fac;
+    /* Make sure the PRWV file was specified if the scene center temp was not */
+    if (*center_temp == -9999.0 && *prwv_infile == NULL)
+    {
+        sprintf (errmsg, "PRWV input file is a required argument if the "
+            "scene center temperature is not specified");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the memory cap is valid */
+    if (*max_mem < 0)
+    {
+        sprintf (errmsg, "Invalid memory cap: %d", *max_mem);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_scene_center_temp
+
+PURPOSE:  Computes the air temperature at the scene center and time, from the
+air temperatures of the PRWV auxiliary file for the acquisition date (0 hr,
+6 hr, 12 hr, and 18 hr) at the grid cell of the scene center.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the PRWV file
+SUCCESS         Successfully computed the scene center temp
+
+HISTORY:
+Date         Programmer       Reason
+----------   --------------   -------------------------------------
+11/18/2015                    Original development (from lndsrbm.ksh and
+                              comptemp.c)
+
+NOTES:
+  1. The scene center is the center of the bounding coordinates.  If the
+     scene center time is not available (00:00:00), it is estimated from the
+     longitude as 10:30 local time.
+******************************************************************************/
+int get_scene_center_temp
+(
+    Espa_global_meta_t *gmeta,  /* I: global metadata */
+    char *prwv_infile,          /* I: name of the PRWV file */
+    float *center_temp          /* O: scene center temp (Kelvin) */
+)
+{
+    char errmsg[STR_SIZE];                  /* error message */
+    char FUNC_NAME[] = "get_scene_center_temp";   /* function name */
+    char sds_name[STR_SIZE];  /* name of the air temp SDS */
+    double lonc, latc;     /* longitude and latitude of the scene center */
+    float temp[PRWV_NTIME+1];   /* air temps plus one 24 hours after first */
+    float time[PRWV_NTIME+1];   /* times of the air temps (hours) */
+    float sc_time;         /* scene center time (decimal hours) */
+    float slp;             /* slope of the temps */
+    int hour, min;         /* scene center time hour and minutes */
+    int xgrib, ygrib;      /* PRWV grid cell of the scene center */
+    int i;                 /* looping variable */
+    int32 sd_id;           /* PRWV file id */
+    int32 sds_index;       /* index of the air temp SDS */
+    int32 sds_id;          /* air temp SDS id */
+    int32 rank;            /* rank of the air temp SDS */
+    int32 dims[MAX_VAR_DIMS];   /* dimensions of the air temp SDS */
+    int32 data_type;       /* data type of the air temp SDS */
+    int32 nattrs;          /* number of attributes of the air temp SDS */
+    int32 start[3];        /* start of the air temps to be read */
+    int32 edge[3];         /* number of air temps to be read */
+
+    /* Compute the lat/long of the center of the scene and its PRWV grid
+       cell */
+    lonc = (gmeta->bounding_coords[ESPA_WEST] +
+        gmeta->bounding_coords[ESPA_EAST]) * 0.5;
+    latc = (gmeta->bounding_coords[ESPA_NORTH] +
+        gmeta->bounding_coords[ESPA_SOUTH]) * 0.5;
+    ygrib = (int) ((90.0 - latc) * 73.0 / 180.0);
+    xgrib = (int) ((180.0 + lonc) * 144.0 / 360.0);
+    printf ("Center long: %f Center lat: %f\n", lonc, latc);
+    printf ("ygrib: %d xgrib: %d\n", ygrib, xgrib);
+
+    /* Read the air temps of the grid cell for the acquisition date */
+    sd_id = SDstart (prwv_infile, DFACC_READ);
+    if (sd_id == FAIL)
+    {
+        sprintf (errmsg, "Error opening the PRWV file: %s", prwv_infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    sds_index = SDnametoindex (sd_id, PRWV_AIR_SDS);
+    sds_id = (sds_index == FAIL) ? FAIL :
+        SDselect (sd_id, sds_index);
+    if (sds_id == FAIL)
+    {
+        sprintf (errmsg, "Error accessing the %s SDS of the PRWV file",
+            PRWV_AIR_SDS);
+        error_handler (true, FUNC_NAME, errmsg);
+        SDend (sd_id);
+        return (ERROR);
+    }
+
+    if (SDgetinfo (sds_id, sds_name, &rank, dims, &data_type, &nattrs) ==
+        FAIL || rank != 3 || dims[0] < PRWV_NTIME ||
+        data_type != DFNT_FLOAT32)
+    {
+        sprintf (errmsg, "Invalid %s SDS in the PRWV file; expected 3D float "
+            "data with %d time samples", PRWV_AIR_SDS, PRWV_NTIME);
+        error_handler (true, FUNC_NAME, errmsg);
+        SDendaccess (sds_id);
+        SDend (sd_id);
+        return (ERROR);
+    }
+
+    /* Stay in the grid; the longitudes wrap around */
+    if (ygrib < 0)
+        ygrib = 0;
+    if (ygrib >= dims[1])
+        ygrib = dims[1] - 1;
+    xgrib = ((xgrib % dims[2]) + dims[2]) % dims[2];
+
+    start[0] = 0;
+    start[1] = ygrib;
+    start[2] = xgrib;
+    edge[0] = PRWV_NTIME;
+    edge[1] = 1;
+    edge[2] = 1;
+    if (SDreaddata (sds_id, start, NULL, edge, temp) == FAIL)
+    {
+        sprintf (errmsg, "Error reading the %s SDS of the PRWV file",
+            PRWV_AIR_SDS);
+        error_handler (true, FUNC_NAME, errmsg);
+        SDendaccess (sds_id);
+        SDend (sd_id);
+        return (ERROR);
+    }
+    SDendaccess (sds_id);
+    SDend (sd_id);
+    for (i = 0; i < PRWV_NTIME; i++)
+        printf ("air temp %d hr: %f\n", i * 6, temp[i]);
+
+    /* Determine the scene center time (decimal hours, GMT) */
+    if (strncmp (gmeta->scene_center_time, "00:00:00", 8) &&
+        sscanf (gmeta->scene_center_time, "%d:%d", &hour, &min) == 2)
+        sc_time = hour + min / 60.0;
+    else
+        sc_time = 10.5 - lonc / 15.0;
+    sc_time = (int) (sc_time * 100000) / 100000.0;
+    if (sc_time < 0.0)
+    {
+        sc_time += 24.0;
+        printf ("WARNING WE ASSUME THE DATE IS GMT IS IT?\n");
+    }
+    printf ("Scene time: %f\n", sc_time);
+
+    /* Interpolate the air temp at the scene center time, using the temp 24
+       hours after the first one for the times after the last one */
+    for (i = 0; i < PRWV_NTIME; i++)
+        time[i] = i * 6.0;
+    temp[PRWV_NTIME] = temp[0];
+    time[PRWV_NTIME] = 24.0;
+    if (sc_time < 0.01)
+        sc_time = 0.01;
+    if (sc_time > time[PRWV_NTIME])
+        sc_time = time[PRWV_NTIME];
+
+    i = 0;
+    while (sc_time > time[i])
+        i++;
+    slp = (temp[i] - temp[i-1]) / 6.0;
+    *center_temp = temp[i-1] + slp * (sc_time - time[i-1]);
+    printf ("tclear: %f\n", *center_temp);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_scene_orientation
+
+PURPOSE:  Computes the delta x and y used for the northern adjustment: the
+deviation, in pixels, of the point 100 lines north of the scene center once
+moved back to the longitude of the scene center.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error with the projection of the scene
+SUCCESS         Successfully computed the delta x and y
+
+HISTORY:
+Date         Programmer       Reason
+----------   --------------   -------------------------------------
+11/18/2015                    Original development (from lndsrbm.ksh and
+                              LS_geoloc_driver.c)
+
+NOTES:
+  1. Only the UTM and polar stereographic projections with the WGS84 datum
+     are supported.
+******************************************************************************/
+int get_scene_orientation
+(
+    Espa_global_meta_t *gmeta,  /* I: global metadata */
+    Espa_band_meta_t *bmeta,    /* I: metadata of the representative band */
+    float *dx,                  /* O: delta x */
+    float *dy                   /* O: delta y */
+)
+{
+    char errmsg[STR_SIZE];                  /* error message */
+    char FUNC_NAME[] = "get_scene_orientation";   /* function name */
+    char projection[STR_SIZE];  /* GCTP projection name */
+    float coordinates[8];  /* zone, spheroid, orientation and pixel size */
+    float upperleftx, upperlefty;   /* UL corner of the UL pixel (meters) */
+    double parm[13];       /* projection parameters */
+    double radius;         /* radius of the spheroid */
+    double corner[2];      /* UL corner of the UL pixel (meters) */
+    double ccol, crow;     /* sample and line of the scene center */
+    double clon, clat;     /* longitude and latitude of the scene center */
+    double cplon, cplat;   /* longitude and latitude 100 lines north */
+    double cscol, csrow;   /* sample and line of the point 100 lines north
+                              moved to the center longitude */
+    int i;                 /* looping variable */
+    int ret;               /* return value of the projection routines */
+
+    /* Set up the projection, as done by LS_geoloc_driver.c */
+    for (i = 0; i < 13; i++)
+        parm[i] = 0.0;
+    if (gmeta->proj_info.datum_type != ESPA_WGS84)
+    {
+        strcpy (errmsg, "Error in datum type. Only ESPA_WGS84 is expected and "
+            "supported for the LPGS products.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    coordinates[5] = 12;   /* WGS84 spheroid */
+    if (gmeta->proj_info.proj_type == GCTP_UTM_PROJ)
+    {
+        strcpy (projection, "GCTP_UTM");
+        coordinates[4] = gmeta->proj_info.utm_zone;
+    }
+    else if (gmeta->proj_info.proj_type == GCTP_PS_PROJ)
+    {
+        strcpy (projection, "GCTP_PS");
+        coordinates[4] = -1;
+        parm[4] = gmeta->proj_info.longitude_pole * D2R;
+        parm[5] = gmeta->proj_info.latitude_true_scale * D2R;
+        parm[6] = gmeta->proj_info.false_easting;
+        parm[7] = gmeta->proj_info.false_northing;
+    }
+    else
+    {
+        strcpy (errmsg, "Error in projection code. Only GCTP_UTM and GCTP_PS "
+            "are currently supported for the LPGS products.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    coordinates[6] = gmeta->orientation_angle;
+    coordinates[7] = bmeta->pixel_size[0];
+    upperleftx = gmeta->proj_info.ul_corner[0];
+    upperlefty = gmeta->proj_info.ul_corner[1];
+    if (!strcmp (gmeta->proj_info.grid_origin, "center"))
+    { /* adjust by pixel size */
+        upperleftx -= bmeta->pixel_size[0];
+        upperlefty += bmeta->pixel_size[1];
+    }
+    corner[0] = upperleftx;
+    corner[1] = upperlefty;
+    if (LSsphdz (projection, coordinates, parm, &radius, corner) != 0)
+    {
+        strcpy (errmsg, "Error initializing the projection.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Compute the lat/long of the center and of the point 100 lines north of
+       the center, then the line/sample of the latter moved to the longitude
+       of the center */
+    ccol = bmeta->nsamps * 0.5;
+    crow = bmeta->nlines * 0.5;
+    if (!strcmp (projection, "GCTP_UTM"))
+    {
+        ret = LSutminv (ccol, crow, &clon, &clat);
+        if (ret == 0)
+            ret = LSutminv (ccol, crow - 100.0, &cplon, &cplat);
+        if (ret == 0)
+            ret = LSutmfor (&cscol, &csrow, clon, cplat);
+    }
+    else
+    {
+        ret = LSpsinv (ccol, crow, &clon, &clat);
+        if (ret == 0)
+            ret = LSpsinv (ccol, crow - 100.0, &cplon, &cplat);
+        if (ret == 0)
+            ret = LSpsfor (&cscol, &csrow, clon, cplat);
+    }
+    if (ret != 0)
+    {
+        strcpy (errmsg, "Error computing the scene orientation.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    printf ("Center col/row: %f %f\n", ccol, crow);
+    printf ("Center lat/long: %f %f\n", clat, clon);
+    printf ("cscol/csrow: %f %f\n", cscol, csrow);
+
+    *dy = crow - csrow;
+    *dx = cscol - ccol;
+    printf ("delta x/y: %f %f\n", *dx, *dy);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_shadow_line
+
+PURPOSE:  Reads the next line of bands 2, 3, and 5 and computes the line of
+the cloud shadow search window: the band 5 value of the pixels which can be a
+cloud shadow (band 5 < 800, band 2 - band 3 < 100, and not cloud, adjacent
+cloud, or fill), NO_SHADOW for the others.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the band lines
+SUCCESS         Successfully read the line
+
+HISTORY:
+Date         Programmer       Reason
+----------   --------------   -------------------------------------
+11/18/2015                    Original development (from the cloud shadow
+                              loop of main)
+
+NOTES:
+  1. Whether the pixel is already a cloud shadow is not tested here, as it
+     changes during the search.
+******************************************************************************/
+int read_shadow_line
+(
+    FILE *band2_fp,            /* I: band 2 file */
+    FILE *band3_fp,            /* I: band 3 file */
+    FILE *band5_fp,            /* I: band 5 file */
+    morph_mask_t *cloud_mask,  /* I: cloud mask */
+    morph_mask_t *adja_mask,   /* I: adjacent cloud mask */
+    morph_mask_t *fill_mask,   /* I: fill mask */
+    int il,                    /* I: line to be read */
+    int16 *band2,              /* I/O: band 2 line buffer (nsamps) */
+    int16 *band3,              /* I/O: band 3 line buffer (nsamps) */
+    int16 *band5               /* O: search window line (nsamps) */
+)
+{
+    char errmsg[STR_SIZE];                  /* error message */
+    char FUNC_NAME[] = "read_shadow_line";  /* function name */
+    int nsamps = cloud_mask->nsamps;   /* number of samples */
+    int is;                            /* looping variable for samples */
+
+    if (read_raw_binary (band2_fp, 1, nsamps, sizeof (int16), band2) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Reading band 2 line %d.", il);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
+    if (read_raw_binary (band3_fp, 1, nsamps, sizeof (int16), band3) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Reading band 3 line %d.", il);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (read_raw_binary (band5_fp, 1, nsamps, sizeof (int16), band5) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Reading band 5 line %d.", il);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (is = 0; is < nsamps; is++)
+    {
+        if (!((band5[is] < 800.0) && (band2[is] - band3[is] < 100.0)) ||
+            morph_test (adja_mask, il, is) ||
+            morph_test (cloud_mask, il, is) ||
+            morph_test (fill_mask, il, is))
+            band5[is] = NO_SHADOW;
+    }
 
     return (SUCCESS);
 }
@@ -193,10 +647,10 @@ short get_args
 
 /*****************************************************************************
 MODULE: lndsrbm
-  
+
 PURPOSE: Reads in surface reflectance bands 1, 2, 3, 5, and 6 along with QA
-bands for cloud, cloud shadow, adjacent cloud, snow, and fill.  Recomputes and
-overwrites the cloud, cloud shadow, and adjacent cloud QA bands.
+bands for snow and fill.  Recomputes and overwrites the cloud, cloud shadow,
+and adjacent cloud QA bands.
 
 RETURN VALUE:
 Type = int
@@ -214,18 +668,37 @@ Date         Programmer       Reason
                               Modified to address the fact that TOA band 6
                               (temperature) data is now in Kelvin vs. degrees
                               Celsius
+11/17/2015                    The adjacent cloud and cloud shadow dilations
+                              are done on bit masks with libmorph
+11/18/2015                    The bands are streamed line by line instead of
+                              being read for the whole scene.  The cloud,
+                              adjacent cloud, cloud shadow and fill QA are
+                              kept in bit masks, and the cloud shadow search
+                              reads bands 2, 3 and 5 through a window of
+                              lines sized by the memory cap.
 
 NOTES:
+  1. The cloud mask and the clear temperature are computed in a first pass
+     through bands 1, 3, 5, 6, snow, and fill.  The cloud shadow search then
+     streams bands 2, 3, 5 and 6 a second time.  A cloud shadow is at most
+     'halo' lines from its cloud, halo being computed from the coldest cloud,
+     so only the lines within halo of the current line need to be held.
+  2. The cloud and cloud shadow pixels are still visited in the same order as
+     when the whole scene was held, so the QA is unchanged.
+  3. The masks never hold fill pixels, so the fill QA needs no cleanup.
 *****************************************************************************/
 int main (int argc, char **argv)
 {
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "lndsrbm";    /* function name */
     char *xml_infile = NULL; /* input XML filename */
+    char *prwv_infile = NULL; /* input PRWV filename */
     float center_temp;       /* scene center temp (Kelvin) */
     float tclear;            /* clear temperature (Celcius) */
     float t6;                /* band 6 temperature (Celcius) */
     float anom;              /* band 1 and 3 combination */
+    float dx, dy;            /* delta x and y values for northern
+                                adjustment computation */
     float north_adj;         /* adjustment for true north (degrees) */
     float pclear;            /* percentage of pixels which are clear pixels */
     float cfac;              /* cloud factor */
@@ -233,35 +706,44 @@ int main (int argc, char **argv)
     float facj;              /* cloud height factor in the line direction */
     float fack;              /* cloud height factor in the sample direction */
     float tcloud;   /* temperature of the current pixel (celsius) */
+    float tcloud_min;  /* temperature of the coldest cloud pixel (celsius) */
     float cldh;     /* cloud height (based on temperature of the cloud) */
     double mclear;           /* average/mean temp of the clear pixels */
-    uint8 *cloud_qa = NULL;       /* cloud QA data */
-    uint8 *cloud_shad_qa = NULL;  /* cloud shadow QA data */
-    uint8 *cloud_adja_qa = NULL;  /* adjacent cloud QA data */
-    uint8 *snow_qa = NULL;        /* snow QA data */
-    uint8 *fill_qa = NULL;        /* fill QA data */
-    uint8 *tmpbit_qa = NULL;      /* temporary bit for QA data */
+    double mem;              /* memory of the masks and line buffers (bytes) */
+    uint8 *cloud_qa = NULL;       /* cloud QA line */
+    uint8 *snow_qa = NULL;        /* snow QA line */
+    uint8 *fill_qa = NULL;        /* fill QA line */
     uint8 QA_OFF = 0;        /* value for QA turned off */
     uint8 QA_ON = 255;       /* value for QA turned on */
-    int16 *band1 = NULL;     /* band 1 data */
-    int16 *band2 = NULL;     /* band 2 data */
-    int16 *band3 = NULL;     /* band 3 data */
-    int16 *band5 = NULL;     /* band 5 data */
-    int16 *band6 = NULL;     /* temperature (band6) data (Kelvin) */
+    int16 *band1 = NULL;     /* band 1 line */
+    int16 *band2 = NULL;     /* band 2 line */
+    int16 *band3 = NULL;     /* band 3 line */
+    int16 *band5 = NULL;     /* band 5 line */
+    int16 *band6 = NULL;     /* temperature (band6) line (Kelvin) */
+    int16 *win_band5 = NULL; /* cloud shadow search window: band 5 of the
+                                candidate pixels, NO_SHADOW for the others */
     int mband5;         /* storage for the band 5 value */
-    int mband5_pix;     /* storage for the pixel location of band 5 value */
+    int mband5_line;    /* storage for the line of the band 5 value */
+    int mband5_samp;    /* storage for the sample of the band 5 value */
     int rep_indx=-1;    /* band index in XML file for the current product */
     int cldhmin;        /* minimum bound of the cloud height */
     int cldhmax;        /* maximum bound of the cloud height */
     int icldh;          /* looping variable for cloud height */
     int ib;             /* looping variable for bands */
-    int i;              /* looping variable for pixels */
     int il, is;         /* looping variables for lines and samples */
-    int j, k;           /* looping variables for 3x3 and 5x5 blocks */
-    int pix;            /* location of current pixel */
+    int j, k;           /* line and sample of the cloud shadow */
+    int k_word;         /* looping variable for the mask words */
+    int max_mem;        /* memory cap (MB), 0 for no cap */
+    int halo;           /* maximum distance (lines) of a cloud shadow from
+                           its cloud */
+    int win_size;       /* number of lines of the search window */
+    int win_first;      /* first line held in the search window */
+    int win_next;       /* line after the last one held in the window */
+    int win_lo, win_hi; /* lines needed in the window for the current line */
     long nbcloud;       /* count of the cloud pixels */
     long nbclear;       /* count of the clear (non-cloud) pixels */
     long nbval;         /* count of the non-fill pixels */
+    size_t mask_size;   /* size of the words of a mask (bytes) */
     FILE *cloud_fp = NULL;       /* cloud QA file */
     FILE *cloud_shad_fp = NULL;  /* cloud shadow QA file */
     FILE *cloud_adja_fp = NULL;  /* adjacent cloud QA file */
@@ -277,13 +759,24 @@ int main (int argc, char **argv)
     Espa_global_meta_t *gmeta = NULL;   /* pointer to global metadata */
     Espa_band_meta_t *bmeta = NULL;     /* pointer to the band metadata array
                                            within the output structure */
+    morph_mask_t *cloud_mask = NULL;  /* cloud mask */
+    morph_mask_t *adja_mask = NULL;   /* adjacent cloud mask */
+    morph_mask_t *shad_mask = NULL;   /* cloud shadow mask */
+    morph_mask_t *fill_mask = NULL;   /* fill mask */
+    morph_mask_t *mask = NULL;  /* bit mask for the cloud and cloud shadow
+                                   dilations */
+    morph_word_t *cloud_words;  /* words of a line of the cloud mask */
+    morph_word_t *adja_words;   /* words of a line of the adjacent cloud mask */
+    morph_word_t *shad_words;   /* words of a line of the cloud shadow mask */
+    morph_word_t *fill_words;   /* words of a line of the fill mask */
+    morph_word_t *mask_words;   /* words of a line of the dilation mask */
 
     /* Read the command-line arguments */
-    if (get_args (argc, argv, &center_temp, &north_adj, &xml_infile) != SUCCESS)
+    if (get_args (argc, argv, &center_temp, &dx, &dy, &xml_infile,
+        &prwv_infile, &max_mem) != SUCCESS)
     {   /* get_args already printed the error message */
         exit (ERROR);
     }
-    printf ("north_adj: %f\n", north_adj);
 
     /* Validate the input metadata file */
     if (validate_xml_file (xml_infile) != SUCCESS)
@@ -323,100 +816,73 @@ int main (int argc, char **argv)
     }
     bmeta = &xml_metadata.band[rep_indx];
 
-    /* Initialize the QA and band arrays to hold all the band data at a time */
-    printf ("Allocating memory ...\n");
-    cloud_qa = calloc (bmeta->nlines * bmeta->nsamps, sizeof (uint8));
-    if (cloud_qa == NULL)
-    {
-        strcpy (errmsg, "Error allocating memory for cloud QA band.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    cloud_shad_qa = calloc (bmeta->nlines * bmeta->nsamps,
-        sizeof (uint8));
-    if (cloud_shad_qa == NULL)
-    {
-        strcpy (errmsg, "Error allocating memory for cloud shadow QA band.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    cloud_adja_qa = calloc (bmeta->nlines * bmeta->nsamps,
-        sizeof (uint8));
-    if (cloud_adja_qa == NULL)
-    {
-        strcpy (errmsg, "Error allocating memory for adjacent cloud QA band.");
-        error_handler (true, FUNC_NAME, errmsg);
-    }
-
-    snow_qa = calloc (bmeta->nlines * bmeta->nsamps, sizeof (uint8));
-    if (snow_qa == NULL)
-    {
-        strcpy (errmsg, "Error allocating memory for snow QA band.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    fill_qa = calloc (bmeta->nlines * bmeta->nsamps, sizeof (uint8));
-    if (fill_qa == NULL)
-    {
-        strcpy (errmsg, "Error allocating memory for fill QA band.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    tmpbit_qa = calloc (bmeta->nlines * bmeta->nsamps, sizeof (uint8));
-    if (tmpbit_qa == NULL)
+    /* Compute the scene center temp and the delta x/y if they were not
+       specified */
+    if (center_temp == -9999.0)
     {
-        strcpy (errmsg, "Error allocating memory for tmpbit QA band.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        printf ("using ancillary data '%s'\n", prwv_infile);
+        if (get_scene_center_temp (gmeta, prwv_infile, &center_temp) !=
+            SUCCESS)
+        {  /* Error messages already written */
+            exit (ERROR);
+        }
     }
-
-    band1 = calloc (bmeta->nlines * bmeta->nsamps, sizeof (int16));
-    if (band1 == NULL)
+    if (dx == -9999.0 || dy == -9999.0)
     {
-        strcpy (errmsg, "Error allocating memory for band 1 band.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        if (get_scene_orientation (gmeta, bmeta, &dx, &dy) != SUCCESS)
+        {  /* Error messages already written */
+            exit (ERROR);
+        }
     }
 
-    band2 = calloc (bmeta->nlines * bmeta->nsamps, sizeof (int16));
-    if (band2 == NULL)
-    {
-        strcpy (errmsg, "Error allocating memory for band 2 band.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
+    /* Compute the northern adjustment */
+    dtr = atan (1.0) / 45.0;
+    north_adj = atan (dx / dy) / dtr;
+    printf ("north_adj: %f\n", north_adj);
 
-    band3 = calloc (bmeta->nlines * bmeta->nsamps, sizeof (int16));
-    if (band3 == NULL)
+    /* Initialize the QA and band line buffers and the QA bit masks */
+    printf ("Allocating memory ...\n");
+    cloud_qa = calloc (bmeta->nsamps, sizeof (uint8));
+    snow_qa = calloc (bmeta->nsamps, sizeof (uint8));
+    fill_qa = calloc (bmeta->nsamps, sizeof (uint8));
+    if (cloud_qa == NULL || snow_qa == NULL || fill_qa == NULL)
     {
-        strcpy (errmsg, "Error allocating memory for band 3 band.");
+        strcpy (errmsg, "Error allocating memory for the QA lines.");
         error_handler (true, FUNC_NAME, errmsg);
         exit (ERROR);
     }
 
-    band5 = calloc (bmeta->nlines * bmeta->nsamps, sizeof (int16));
-    if (band5 == NULL)
+    band1 = calloc (bmeta->nsamps, sizeof (int16));
+    band2 = calloc (bmeta->nsamps, sizeof (int16));
+    band3 = calloc (bmeta->nsamps, sizeof (int16));
+    band5 = calloc (bmeta->nsamps, sizeof (int16));
+    band6 = calloc (bmeta->nsamps, sizeof (int16));
+    if (band1 == NULL || band2 == NULL || band3 == NULL || band5 == NULL ||
+        band6 == NULL)
     {
-        strcpy (errmsg, "Error allocating memory for band 5 band.");
+        strcpy (errmsg, "Error allocating memory for the band lines.");
         error_handler (true, FUNC_NAME, errmsg);
         exit (ERROR);
     }
 
-    band6 = calloc (bmeta->nlines * bmeta->nsamps, sizeof (int16));
-    if (band6 == NULL)
+    cloud_mask = morph_alloc (bmeta->nlines, bmeta->nsamps);
+    adja_mask = morph_alloc (bmeta->nlines, bmeta->nsamps);
+    shad_mask = morph_alloc (bmeta->nlines, bmeta->nsamps);
+    fill_mask = morph_alloc (bmeta->nlines, bmeta->nsamps);
+    if (cloud_mask == NULL || adja_mask == NULL || shad_mask == NULL ||
+        fill_mask == NULL)
     {
-        strcpy (errmsg, "Error allocating memory for band 6 band.");
+        strcpy (errmsg, "Error allocating memory for the QA masks.");
         error_handler (true, FUNC_NAME, errmsg);
         exit (ERROR);
     }
+    mask_size = (size_t) bmeta->nlines * cloud_mask->nwords *
+        sizeof (morph_word_t);
 
     /* Open the raw binary file for each of these QA, surface reflectance,
-       and brightness temp bands.  The cloud-related files need to be open for
-       reading and writing.  All other bands for read only. */
+       and brightness temp bands.  The cloud-related files are only written,
+       but are opened for update so they are not truncated.  All other bands
+       for read only. */
     printf ("Opening the input data ...\n");
     for (ib = 0; ib < xml_metadata.nbands; ib++)
     {
@@ -540,140 +1006,67 @@ int main (int argc, char **argv)
         exit (ERROR);
     }
 
-    /* Read the band and QA files */
-    printf ("Reading the input data ...\n");
-    if (read_raw_binary (band1_fp, bmeta->nlines, bmeta->nsamps,
-        sizeof (int16), band1) != SUCCESS)
-    {
-        strcpy (errmsg, "Reading band 1 image data.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    if (read_raw_binary (band2_fp, bmeta->nlines, bmeta->nsamps,
-        sizeof (int16), band2) != SUCCESS)
-    {
-        strcpy (errmsg, "Reading band 2 image data.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    if (read_raw_binary (band3_fp, bmeta->nlines, bmeta->nsamps,
-        sizeof (int16), band3) != SUCCESS)
-    {
-        strcpy (errmsg, "Reading band 3 image data.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    if (read_raw_binary (band5_fp, bmeta->nlines, bmeta->nsamps,
-        sizeof (int16), band5) != SUCCESS)
-    {
-        strcpy (errmsg, "Reading band 5 image data.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    if (read_raw_binary (band6_fp, bmeta->nlines, bmeta->nsamps,
-        sizeof (int16), band6) != SUCCESS)
-    {
-        strcpy (errmsg, "Reading band 6 image data.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    if (read_raw_binary (cloud_fp, bmeta->nlines, bmeta->nsamps,
-        sizeof (uint8), cloud_qa) != SUCCESS)
-    {
-        strcpy (errmsg, "Reading cloud QA data.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    if (read_raw_binary (cloud_shad_fp, bmeta->nlines, bmeta->nsamps,
-        sizeof (uint8), cloud_shad_qa) != SUCCESS)
-    {
-        strcpy (errmsg, "Reading cloud shadow QA data.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    if (read_raw_binary (cloud_adja_fp, bmeta->nlines, bmeta->nsamps,
-        sizeof (uint8), cloud_adja_qa) != SUCCESS)
-    {
-        strcpy (errmsg, "Reading adjacent cloud QA data.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    if (read_raw_binary (snow_fp, bmeta->nlines, bmeta->nsamps,
-        sizeof (uint8), snow_qa) != SUCCESS)
-    {
-        strcpy (errmsg, "Reading snow QA data.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    if (read_raw_binary (fill_fp, bmeta->nlines, bmeta->nsamps,
-        sizeof (uint8), fill_qa) != SUCCESS)
-    {
-        strcpy (errmsg, "Reading fill QA data.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Close the non-cloud file pointers */
-    close_raw_binary (snow_fp);
-    close_raw_binary (fill_fp);
-    close_raw_binary (band1_fp);
-    close_raw_binary (band2_fp);
-    close_raw_binary (band3_fp);
-    close_raw_binary (band5_fp);
-    close_raw_binary (band6_fp);
-
     /* Convert the center temp to celcius */
     tclear = center_temp - 273.15;
 
-    /* Reset the cloud, cloud shadow, and adjacent cloud bits */
-    for (i = 0; i < bmeta->nlines * bmeta-> nsamps; i++)
-    {
-       cloud_qa[i] = QA_OFF;
-       cloud_adja_qa[i] = QA_OFF;
-       cloud_shad_qa[i] = QA_OFF;
-       tmpbit_qa[i] = QA_OFF;
-    }
-
     /* Update the cloud mask */
     printf ("Updating cloud mask ...\n");
     nbclear = 0;
     mclear = 0.0;
     nbval = 0;
     nbcloud = 0;
-      
-    /* Compute the average temperature of the clear data (celsius) */
-    for (i = 0; i < bmeta->nlines * bmeta-> nsamps; i++)
+    tcloud_min = tclear;
+
+    /* Compute the average temperature of the clear data (celsius), reading
+       the bands one line at a time */
+    for (il = 0; il < bmeta->nlines; il++)
     {
-        /* Only use the non-fill pixels for this average */
-        if (fill_qa[i] == QA_OFF)
+        if (read_raw_binary (band1_fp, 1, bmeta->nsamps, sizeof (int16),
+            band1) != SUCCESS ||
+            read_raw_binary (band3_fp, 1, bmeta->nsamps, sizeof (int16),
+            band3) != SUCCESS ||
+            read_raw_binary (band5_fp, 1, bmeta->nsamps, sizeof (int16),
+            band5) != SUCCESS ||
+            read_raw_binary (band6_fp, 1, bmeta->nsamps, sizeof (int16),
+            band6) != SUCCESS)
         {
-            nbval++;
-            anom = band1[i] - band3[i] * 0.5;
-            t6 = band6[i] * 0.1 - 273.15;   /* convert to celsius */
-            if (snow_qa[i] == QA_ON)
-                continue;
-            else
-            {  /* not snow */
-                if ((anom > 300.0) && (band5[i] > 300.0) && (t6 < tclear))
-                {  /* cloud */
-                    cloud_qa[i] = QA_ON;
-                    nbcloud++;
-                }
+            sprintf (errmsg, "Reading bands 1, 3, 5, and 6 line %d.", il);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+
+        if (read_raw_binary (snow_fp, 1, bmeta->nsamps, sizeof (uint8),
+            snow_qa) != SUCCESS ||
+            read_raw_binary (fill_fp, 1, bmeta->nsamps, sizeof (uint8),
+            fill_qa) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading snow and fill QA line %d.", il);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+
+        for (is = 0; is < bmeta->nsamps; is++)
+        {
+            cloud_qa[is] = QA_OFF;
+
+            /* Only use the non-fill pixels for this average */
+            if (fill_qa[is] == QA_OFF)
+            {
+                nbval++;
+                anom = band1[is] - band3[is] * 0.5;
+                t6 = band6[is] * 0.1 - 273.15;   /* convert to celsius */
+                if (snow_qa[is] == QA_ON)
+                    continue;
                 else
-                {
-                    if ((band1[i] > 3000.0) && (t6 < tclear))
+                {  /* not snow */
+                    if (((anom > 300.0) && (band5[is] > 300.0) &&
+                         (t6 < tclear)) ||
+                        ((band1[is] > 3000.0) && (t6 < tclear)))
                     {  /* cloud */
-                        cloud_qa[i] = QA_ON;
+                        cloud_qa[is] = QA_ON;
                         nbcloud++;
+                        if (t6 < tcloud_min)
+                            tcloud_min = t6;
                     }
                     else
                     {  /* not cloud (clear) */
@@ -683,8 +1076,20 @@ int main (int argc, char **argv)
                 }
             }
         }
+
+        morph_set_line_value (cloud_mask, il, cloud_qa, QA_ON);
+        morph_set_line_value (fill_mask, il, fill_qa, QA_ON);
     }
 
+    /* Close the snow, fill, and band 1 file pointers; bands 3, 5, and 6 are
+       read again for the cloud shadow */
+    close_raw_binary (snow_fp);
+    close_raw_binary (fill_fp);
+    close_raw_binary (band1_fp);
+    rewind (band3_fp);
+    rewind (band5_fp);
+    rewind (band6_fp);
+
     /* Determine the average/mean temp of the clear pixels and the percentage */
     if (nbclear > 0)
         mclear = mclear * 10000.0 / nbclear;
@@ -701,44 +1106,28 @@ int main (int argc, char **argv)
     /* Reset the clear temp if greater than 5% of the pixels are clear */
     if (pclear > 5.0)
         tclear = mclear;
-             
-    /* Update the adjacent cloud bit; only set for non-fill pixels */
+
+    /* Update the adjacent cloud bit; only set for non-fill pixels.  The
+       cloud mask is dilated by 5 pixels (11x11 window) as a bit mask. */
     printf ("Updating adjacent cloud bit ...\n");
+    memcpy (adja_mask->bits, cloud_mask->bits, mask_size);
+    if (morph_dilate (adja_mask, 5, 5, 5, 5) != 0)
+    {
+        strcpy (errmsg, "Error dilating the cloud mask.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
     for (il = 0; il < bmeta->nlines; il++)
     {
-        for (is = 0; is < bmeta->nsamps; is++)
-        {
-            /* Look for adjacent clouds of cloud pixels */
-            pix = il * bmeta->nsamps + is;
-            if (cloud_qa[pix] == QA_ON)
-            {
-                /* Look at the adjacent 5x5 block for adjacent clouds */
-                for (j = il-5; j <= il+5; j++)
-                {
-                    /* Make sure the current line is within the bounds of the
-                       image */
-                    if (j >= 0 && j < bmeta->nlines)
-                    {
-                        pix = j * bmeta->nsamps + (is-5);
-                        for (k = is-5; k <= is+5; k++, pix++)
-                        {
-                            /* Make sure the current sample is within the
-                               bounds of the image */
-                            if (k >= 0 && k < bmeta->nsamps)
-                            {
-                                /* If this pixel is not cloud or fill then set
-                                   it to adjacent cloud */
-                                if (cloud_qa[pix] != QA_ON &&
-                                    fill_qa[pix] != QA_ON)
-                                    cloud_adja_qa[pix] = QA_ON;
-                            }
-                        }  /* end for k */
-                    }
-                }  /* end for j */
-            }
-        }  /* end for is */
+        /* If this pixel is adjacent to a cloud and is not cloud or fill
+           then set it to adjacent cloud */
+        cloud_words = morph_line (cloud_mask, il);
+        adja_words = morph_line (adja_mask, il);
+        fill_words = morph_line (fill_mask, il);
+        for (k_word = 0; k_word < cloud_mask->nwords; k_word++)
+            adja_words[k_word] &= ~(cloud_words[k_word] | fill_words[k_word]);
     }  /* end for il */
-       
+
     /* Compute the cloud shadow (using temp in degrees Celsius) */
     mband5 = 9999;
     cfac = 6.0;
@@ -748,23 +1137,105 @@ int main (int argc, char **argv)
         bmeta->pixel_size[0];
     fack = sin (gmeta->solar_azimuth * dtr) * tan (gmeta->solar_zenith * dtr) /
         bmeta->pixel_size[0];
+
+    /* The cloud heights searched go from 1000 m below to 1000 m above the
+       height of the cloud, the highest being the one of the coldest cloud,
+       so the cloud shadows are at most halo lines from their cloud (plus
+       rounding) */
+    cldh = (tclear - tcloud_min) * 1000.0 / cfac;
+    if (cldh < 0.0)
+        cldh = 0.0;
+    halo = (int) ceil (fabs (facj) * (cldh + 1010.0)) + 2;
+    if (halo > bmeta->nlines)
+        halo = bmeta->nlines;
+
+    /* Size the search window from the memory cap: it must at least hold
+       the lines within halo of the current line */
+    win_size = bmeta->nlines;
+    if (max_mem > 0)
+    {
+        mem = 4.0 * mask_size + 12.0 * bmeta->nsamps;
+        win_size = (int) ((max_mem * MBYTE - mem) /
+            (bmeta->nsamps * sizeof (int16)));
+        if (win_size < 2 * halo + 2)
+        {
+            sprintf (errmsg, "Memory cap of %d MB is too small for the cloud "
+                "shadow search window of %d lines; using the minimum window",
+                max_mem, 2 * halo + 2);
+            error_handler (false, FUNC_NAME, errmsg);
+            win_size = 2 * halo + 2;
+        }
+        if (win_size > bmeta->nlines)
+            win_size = bmeta->nlines;
+    }
+    printf ("cloud shadow halo: %d lines, search window: %d lines\n", halo,
+        win_size);
+
+    win_band5 = calloc ((size_t) win_size * bmeta->nsamps, sizeof (int16));
+    if (win_band5 == NULL)
+    {
+        strcpy (errmsg, "Error allocating memory for the cloud shadow search "
+            "window.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    win_first = 0;
+    win_next = 0;
     for (il = 0; il < bmeta->nlines; il++)
     {
+        /* Slide the window so it holds the lines within halo of this line,
+           dropping the lines before them and reading as many lines as fit
+           after them */
+        win_lo = il - halo;
+        if (win_lo < 0)
+            win_lo = 0;
+        win_hi = il + halo;
+        if (win_hi > bmeta->nlines - 1)
+            win_hi = bmeta->nlines - 1;
+        if (win_hi >= win_next)
+        {
+            memmove (win_band5, &win_band5[(size_t) (win_lo - win_first) *
+                bmeta->nsamps], (size_t) (win_next - win_lo) * bmeta->nsamps *
+                sizeof (int16));
+            win_first = win_lo;
+            while (win_next < bmeta->nlines &&
+                win_next - win_first < win_size)
+            {
+                if (read_shadow_line (band2_fp, band3_fp, band5_fp,
+                    cloud_mask, adja_mask, fill_mask, win_next, band2, band3,
+                    &win_band5[(size_t) (win_next - win_first) *
+                    bmeta->nsamps]) != SUCCESS)
+                {  /* Error messages already written */
+                    exit (ERROR);
+                }
+                win_next++;
+            }
+        }
+
+        if (read_raw_binary (band6_fp, 1, bmeta->nsamps, sizeof (int16),
+            band6) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading band 6 line %d.", il);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+
         for (is = 0; is < bmeta->nsamps; is++)
         {
-            pix = il * bmeta->nsamps + is;
-            if (cloud_qa[pix] == QA_ON)
+            if (morph_test (cloud_mask, il, is))
             {
                 /* Convert the temperature to celsius and use that to compute
                    the cloud height */
-                tcloud = band6[pix] * 0.1 - 273.15;
+                tcloud = band6[is] * 0.1 - 273.15;
                 cldh = (tclear - tcloud) * 1000.0 / cfac;
                 if (cldh < 0.0)
                     cldh = 0.0;
                 cldhmin = (int) (cldh - 1000.0);
                 cldhmax = (int) (cldh + 1000.0);
                 mband5 = 9999.0;
-                mband5_pix = 9999;
+                mband5_line = -1;
+                mband5_samp = -1;
 
                 /* Loop through the min to max cloud height values and
                    determine the cloud shadows from the height and sun
@@ -776,130 +1247,103 @@ int main (int argc, char **argv)
                     k = (int) (is - fack * cldh);
 
                     /* Make sure the current pixel is within the bounds
-                       of the image */
+                       of the image; the pixels which aren't a candidate
+                       hold NO_SHADOW in the window */
                     if ((j >= 0) && (j < bmeta->nlines) &&
                         (k >= 0) && (k < bmeta->nsamps))
                     {
-                        pix = j * bmeta->nsamps + k;
-                        if ((band5[pix] < 800.0) &&
-                            (band2[pix] - band3[pix] < 100.0))
+                        /* Store the value of band5 as well as the
+                           pixel location */
+                        if ((win_band5[(size_t) (j - win_first) *
+                            bmeta->nsamps + k] < mband5) &&
+                            !morph_test (shad_mask, j, k))
                         {
-                            if ((cloud_adja_qa[pix] != QA_ON) &&
-                                (cloud_qa[pix] != QA_ON) &&
-                                (cloud_shad_qa[pix] != QA_ON) &&
-                                (fill_qa[pix] != QA_ON))
-                            {
-                                /* Store the value of band5 as well as the
-                                   pixel location */
-                                if (band5[pix] < mband5)
-                                {
-                                    mband5 = band5[pix];
-                                    mband5_pix = pix;
-                                }
-                            }
+                            mband5 = win_band5[(size_t) (j - win_first) *
+                                bmeta->nsamps + k];
+                            mband5_line = j;
+                            mband5_samp = k;
                         }
                     }
                 }  /* end for icldh */
 
                 if (mband5 < 9999)
-                {
-                    pix = mband5_pix;
-                    cloud_shad_qa[pix] = QA_ON;
-                }
+                    morph_set (shad_mask, mband5_line, mband5_samp);
             }
         }  /* end for is */
     }  /* end for il */
 
-    /* Dilate the cloud shadow */
+    /* Close the band file pointers and free the search window */
+    close_raw_binary (band2_fp);
+    close_raw_binary (band3_fp);
+    close_raw_binary (band5_fp);
+    close_raw_binary (band6_fp);
+    free (win_band5);
+
+    /* Dilate the cloud shadow; the window of a cloud shadow pixel goes from
+       3 pixels before to 2 pixels after it (6x6 window) */
     printf ("Dilating cloud shadow ...\n");
+    mask = morph_alloc (bmeta->nlines, bmeta->nsamps);
+    if (mask == NULL)
+    {
+        strcpy (errmsg, "Error allocating memory for the dilation mask.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+    memcpy (mask->bits, shad_mask->bits, mask_size);
+    if (morph_dilate (mask, 2, 3, 2, 3) != 0)
+    {
+        strcpy (errmsg, "Error dilating the cloud shadow mask.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* If this pixel is near a cloud shadow and is not cloud, adjacent
+       cloud, or fill then set it to cloud shadow */
+    printf ("Updating cloud shadow ...\n");
     for (il = 0; il < bmeta->nlines; il++)
     {
-        for (is = 0; is < bmeta->nsamps; is++)
-        {
-            /* Look for cloud shadows of cloud pixels */
-            pix = il * bmeta->nsamps + is;
-            if (cloud_shad_qa[pix] == QA_ON)
-            {
-                /* Look at the adjacent 3x3 block for adjacent clouds */
-                for (j = il-3; j < il+3; j++)
-                {
-                    /* Make sure the current line is within the bounds of the
-                       image */
-                    if (j >= 0 && j < bmeta->nlines)
-                    {
-                        pix = j * bmeta->nsamps + (is-3);
-                        for (k = is-3; k < is+3; k++, pix++)
-                        {
-                            /* Make sure the current pixel is within the bounds
-                               of the image */
-                            if (k >= 0 && k < bmeta->nsamps)
-                            {
-                                /* If this pixel is not cloud, adjacent cloud,
-                                   cloud shadow, or fill then set the tmpbit
-                                   to on */
-                                if ((cloud_adja_qa[pix] != QA_ON) &&
-                                    (cloud_qa[pix] != QA_ON) &&
-                                    (cloud_shad_qa[pix] != QA_ON) &&
-                                    (fill_qa[pix] != QA_ON))
-                                    tmpbit_qa[pix] = QA_ON;
-                            }
-                        }  /* end for k */
-                    }
-                }  /* end for j */
-            }
-        }  /* end for is */
+        cloud_words = morph_line (cloud_mask, il);
+        adja_words = morph_line (adja_mask, il);
+        shad_words = morph_line (shad_mask, il);
+        fill_words = morph_line (fill_mask, il);
+        mask_words = morph_line (mask, il);
+        for (k_word = 0; k_word < mask->nwords; k_word++)
+            shad_words[k_word] |= mask_words[k_word] &
+                ~(adja_words[k_word] | cloud_words[k_word] |
+                fill_words[k_word]);
     }  /* end for il */
+    morph_free (mask);
 
-    /* Update the cloud shadow and clear QA for fill pixels */
-    printf ("Updating cloud shadow ...\n");
-    for (i = 0; i < bmeta->nlines * bmeta-> nsamps; i++)
+    /* Write the updated cloud, cloud shadow, and adjacent cloud QA values back
+       to the file */
+    for (il = 0; il < bmeta->nlines; il++)
     {
-        /* Update the cloud shadow */
-        if (tmpbit_qa[i] == QA_ON)
+        morph_get_line (cloud_mask, il, cloud_qa, QA_ON, QA_OFF);
+        if (write_raw_binary (cloud_fp, 1, bmeta->nsamps, sizeof (uint8),
+            cloud_qa) != SUCCESS)
         {
-            cloud_shad_qa[i] = QA_ON;
-            tmpbit_qa[i] = QA_OFF;
+            strcpy (errmsg, "Updating cloud QA file.");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
         }
 
-        /* Clear the QA info for the fill pixels */
-        if (fill_qa[i] == QA_ON)
+        morph_get_line (shad_mask, il, cloud_qa, QA_ON, QA_OFF);
+        if (write_raw_binary (cloud_shad_fp, 1, bmeta->nsamps, sizeof (uint8),
+            cloud_qa) != SUCCESS)
         {
-            cloud_qa[i] = QA_OFF;
-            cloud_adja_qa[i] = QA_OFF;
-            cloud_shad_qa[i] = QA_OFF;
+            strcpy (errmsg, "Updating cloud shadow QA file.");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
         }
-    }
-
-    /* Reset the cloud file pointers so they are reading for updating with
-       the new QA values */
-    rewind (cloud_fp);
-    rewind (cloud_shad_fp);
-    rewind (cloud_adja_fp);
-
-    /* Write the updated cloud, cloud shadow, and adjacent cloud QA values back
-       to the file */
-    if (write_raw_binary (cloud_fp, bmeta->nlines, bmeta->nsamps,
-        sizeof (uint8), cloud_qa) != SUCCESS)
-    {
-        strcpy (errmsg, "Updating cloud QA file.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
 
-    if (write_raw_binary (cloud_shad_fp, bmeta->nlines, bmeta->nsamps,
-        sizeof (uint8), cloud_shad_qa) != SUCCESS)
-    {
-        strcpy (errmsg, "Updating cloud shadow QA file.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    if (write_raw_binary (cloud_adja_fp, bmeta->nlines, bmeta->nsamps,
-        sizeof (uint8), cloud_adja_qa) != SUCCESS)
-    {
-        strcpy (errmsg, "Updating adjacent cloud QA file.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        morph_get_line (adja_mask, il, cloud_qa, QA_ON, QA_OFF);
+        if (write_raw_binary (cloud_adja_fp, 1, bmeta->nsamps, sizeof (uint8),
+            cloud_qa) != SUCCESS)
+        {
+            strcpy (errmsg, "Updating adjacent cloud QA file.");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
     }
 
     /* Close the cloud file pointers */
@@ -908,12 +1352,13 @@ int main (int argc, char **argv)
     close_raw_binary (cloud_adja_fp);
 
     /* Free the data pointers */
+    morph_free (cloud_mask);
+    morph_free (adja_mask);
+    morph_free (shad_mask);
+    morph_free (fill_mask);
     free (cloud_qa);
-    free (cloud_shad_qa);
-    free (cloud_adja_qa);
     free (snow_qa);
     free (fill_qa);
-    free (tmpbit_qa);
     free (band1);
     free (band2);
     free (band3);
@@ -923,8 +1368,8 @@ int main (int argc, char **argv)
     /* Free the metadata structure */
     free_metadata (&xml_metadata);
     free (xml_infile);
+    free (prwv_infile);
 
     /* Successful completion */
     exit (SUCCESS);
 }
-
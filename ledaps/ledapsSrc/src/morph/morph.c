@@ -0,0 +1,231 @@
+/*
+!C****************************************************************************
+
+!File: morph.c
+
+!Description: Binary morphology on bit-packed masks (libmorph.a), shared by the
+ cloud/shadow dilations of lndsr, lndcsm and lndsrbm.
+
+!Revision History:
+ Revision 1.0 2015/11/17
+ Original Version.
+
+!Design Notes:
+   1. A mask holds one bit per pixel, 64 pixels per word (see morph.h).
+   2. morph_dilate dilates the lines with the van Herk/Gil-Werman algorithm,
+      streamed in blocks of the rectangle height, and the samples with shifts
+      of whole words.
+   3. Masks are not locked; use one mask per thread.
+
+!END****************************************************************************
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "morph.h"
+
+morph_mask_t *morph_alloc(int nlines, int nsamps) {
+	morph_mask_t *mask;
+
+	if (nlines <= 0 || nsamps <= 0)
+		return NULL;
+	if ((mask=(morph_mask_t *)malloc(sizeof(morph_mask_t))) == NULL)
+		return NULL;
+	mask->nlines=nlines;
+	mask->nsamps=nsamps;
+	mask->nwords=(nsamps+MORPH_WORD_BITS-1)/MORPH_WORD_BITS;
+	mask->bits=(morph_word_t *)calloc((size_t)nlines*mask->nwords,
+		sizeof(morph_word_t));
+	if (mask->bits == NULL) {
+		free(mask);
+		return NULL;
+	}
+	return mask;
+}
+
+void morph_free(morph_mask_t *mask) {
+	if (mask == NULL)
+		return;
+	free(mask->bits);
+	free(mask);
+}
+
+void morph_clear(morph_mask_t *mask) {
+	memset(mask->bits,0,(size_t)mask->nlines*mask->nwords*
+		sizeof(morph_word_t));
+}
+
+void morph_set_line(morph_mask_t *mask, int il, const unsigned char *line,
+	unsigned char bits) {
+	morph_word_t *words=morph_line(mask,il);
+	morph_word_t w;
+	int k,is,ns;
+
+	for (k=0;k<mask->nwords;k++) {
+		ns=mask->nsamps-k*MORPH_WORD_BITS;
+		if (ns > MORPH_WORD_BITS)
+			ns=MORPH_WORD_BITS;
+		w=0;
+		for (is=0;is<ns;is++)
+			if (line[is] & bits)
+				w |= (morph_word_t)1 << is;
+		words[k]=w;
+		line += ns;
+	}
+}
+
+void morph_set_line_value(morph_mask_t *mask, int il,
+	const unsigned char *line, unsigned char value) {
+	morph_word_t *words=morph_line(mask,il);
+	morph_word_t w;
+	int k,is,ns;
+
+	for (k=0;k<mask->nwords;k++) {
+		ns=mask->nsamps-k*MORPH_WORD_BITS;
+		if (ns > MORPH_WORD_BITS)
+			ns=MORPH_WORD_BITS;
+		w=0;
+		for (is=0;is<ns;is++)
+			if (line[is] == value)
+				w |= (morph_word_t)1 << is;
+		words[k]=w;
+		line += ns;
+	}
+}
+
+void morph_get_line(const morph_mask_t *mask, int il, unsigned char *line,
+	unsigned char on, unsigned char off) {
+	const morph_word_t *words=morph_line(mask,il);
+	int is;
+
+	for (is=0;is<mask->nsamps;is++)
+		line[is]=((words[is/MORPH_WORD_BITS] >> (is%MORPH_WORD_BITS)) & 1) ?
+			on : off;
+}
+
+/* words[s] |= words[s+d] for every sample s, d > 0; in place, in increasing
+   word order so that only words not yet updated are read */
+static void shift_or_down(morph_word_t *words, int nwords, int d) {
+	int q=d/MORPH_WORD_BITS,r=d%MORPH_WORD_BITS;
+	int k;
+	morph_word_t lo,hi;
+
+	for (k=0;k+q<nwords;k++) {
+		lo=words[k+q] >> r;
+		hi=(r != 0 && k+q+1 < nwords) ?
+			words[k+q+1] << (MORPH_WORD_BITS-r) : 0;
+		words[k] |= lo | hi;
+	}
+}
+
+/* words[s] |= words[s-d] for every sample s, d > 0; in place, in decreasing
+   word order */
+static void shift_or_up(morph_word_t *words, int nwords, int d) {
+	int q=d/MORPH_WORD_BITS,r=d%MORPH_WORD_BITS;
+	int k;
+	morph_word_t lo,hi;
+
+	for (k=nwords-1;k-q>=0;k--) {
+		hi=words[k-q] << r;
+		lo=(r != 0 && k-q-1 >= 0) ?
+			words[k-q-1] >> (MORPH_WORD_BITS-r) : 0;
+		words[k] |= hi | lo;
+	}
+}
+
+/* Dilate one line along the samples: OR over the 'after' samples to the
+   right and then over the 'before' samples to the left of each sample, each
+   by doubling the span covered */
+static void dilate_samps(morph_mask_t *mask, morph_word_t *words, int before,
+	int after) {
+	int span,r;
+
+	for (span=1;2*span <= after+1;span *= 2)
+		shift_or_down(words,mask->nwords,span);
+	if (span < after+1)
+		shift_or_down(words,mask->nwords,after+1-span);
+	for (span=1;2*span <= before+1;span *= 2)
+		shift_or_up(words,mask->nwords,span);
+	if (span < before+1)
+		shift_or_up(words,mask->nwords,before+1-span);
+
+	r=mask->nsamps%MORPH_WORD_BITS;
+	if (r != 0)
+		words[mask->nwords-1] &= ((morph_word_t)1 << r)-1;
+}
+
+/* Copy the 'height' lines of block j0 of the lines padded with 'before'
+   empty lines above and empty lines below */
+static void load_block(morph_mask_t *mask, morph_word_t *block, int j0,
+	int height, int before) {
+	size_t line_size=mask->nwords*sizeof(morph_word_t);
+	int i,il;
+
+	for (i=0;i<height;i++) {
+		il=j0+i-before;
+		if (il >= 0 && il < mask->nlines)
+			memcpy(&block[(size_t)i*mask->nwords],morph_line(mask,il),
+				line_size);
+		else
+			memset(&block[(size_t)i*mask->nwords],0,line_size);
+	}
+}
+
+int morph_dilate(morph_mask_t *mask, int lines_before, int lines_after,
+	int samps_before, int samps_after) {
+	int height=lines_before+lines_after+1;
+	int nwords=mask->nwords;
+	morph_word_t *buf,*cur,*next,*prefix,*tmp,*out;
+	int il,i,k,j0;
+
+	if (lines_before < 0 || lines_after < 0 || samps_before < 0 ||
+		samps_after < 0)
+		return -1;
+
+	if (height > 1) {
+		if ((buf=(morph_word_t *)malloc(3*(size_t)height*nwords*
+			sizeof(morph_word_t))) == NULL)
+			return -1;
+		cur=buf;
+		next=&buf[(size_t)height*nwords];
+		prefix=&buf[2*(size_t)height*nwords];
+
+		/* van Herk/Gil-Werman along the lines: with the lines padded by
+		   'lines_before' empty lines, output line j is the OR of padded lines
+		   j to j+height-1, that is the suffix OR of the block of j and the
+		   prefix OR of the next block.  Each block is read before any line
+		   it holds is written, so the dilation can be done in place. */
+		load_block(mask,cur,0,height,lines_before);
+		for (j0=0;j0<mask->nlines;j0 += height) {
+			load_block(mask,next,j0+height,height,lines_before);
+
+			for (i=height-2;i>=0;i--)
+				for (k=0;k<nwords;k++)
+					cur[i*nwords+k] |= cur[(i+1)*nwords+k];
+			memcpy(prefix,next,nwords*sizeof(morph_word_t));
+			for (i=1;i<height-1;i++)
+				for (k=0;k<nwords;k++)
+					prefix[i*nwords+k]=prefix[(i-1)*nwords+k] | next[i*nwords+k];
+
+			for (i=0;i<height && j0+i<mask->nlines;i++) {
+				out=morph_line(mask,j0+i);
+				if (i == 0)
+					memcpy(out,cur,nwords*sizeof(morph_word_t));
+				else
+					for (k=0;k<nwords;k++)
+						out[k]=cur[i*nwords+k] | prefix[(i-1)*nwords+k];
+			}
+
+			tmp=cur;
+			cur=next;
+			next=tmp;
+		}
+		free(buf);
+	}
+
+	if (samps_before > 0 || samps_after > 0)
+		for (il=0;il<mask->nlines;il++)
+			dilate_samps(mask,morph_line(mask,il),samps_before,samps_after);
+
+	return 0;
+}
@@ -0,0 +1,62 @@
+#ifndef MORPH_H
+#define MORPH_H
+
+/* Binary morphology on bit-packed masks (morph.c, libmorph.a), shared by
+   the cloud/shadow dilations of lndsr, lndcsm and lndsrbm.
+
+   A mask holds one bit per pixel, 64 pixels per word, sample 'is' of a
+   line being bit is%64 of word is/64.  The bits past the last sample of a
+   line are kept at zero.  Masks are not locked; use one mask per thread. */
+
+#include <stdint.h>
+
+typedef uint64_t morph_word_t;
+
+#define MORPH_WORD_BITS 64
+
+typedef struct {
+	int nlines,nsamps;
+	int nwords;				/* words per line */
+	morph_word_t *bits;		/* nlines*nwords words */
+} morph_mask_t;
+
+/* Pointer to the words of line il, value of pixel (il,is) (0 or 1), and
+   setting of pixel (il,is) */
+#define morph_line(m,il) (&(m)->bits[(size_t)(il)*(m)->nwords])
+#define morph_test(m,il,is) \
+	((int)((morph_line(m,il)[(is)/MORPH_WORD_BITS] >> \
+	((is)%MORPH_WORD_BITS)) & 1))
+#define morph_set(m,il,is) \
+	(morph_line(m,il)[(is)/MORPH_WORD_BITS] |= \
+	(morph_word_t)1 << ((is)%MORPH_WORD_BITS))
+
+morph_mask_t *morph_alloc(int nlines, int nsamps);
+void morph_free(morph_mask_t *mask);
+void morph_clear(morph_mask_t *mask);
+
+/* Set line il of the mask from a line of byte flags: a pixel is set where
+   line[is] has any of 'bits' (morph_set_line) or equals 'value'
+   (morph_set_line_value); the other pixels are cleared. */
+void morph_set_line(morph_mask_t *mask, int il, const unsigned char *line,
+	unsigned char bits);
+void morph_set_line_value(morph_mask_t *mask, int il,
+	const unsigned char *line, unsigned char value);
+
+/* Expand line il of the mask to a line of bytes, 'on' for the set pixels and
+   'off' for the others */
+void morph_get_line(const morph_mask_t *mask, int il, unsigned char *line,
+	unsigned char on, unsigned char off);
+
+/* Dilate the mask in place by a rectangle: a pixel is set if any pixel from
+   'lines_before' lines above to 'lines_after' lines below, and from
+   'samps_before' samples left to 'samps_after' samples right of it was set.
+   The rectangle is clipped at the mask edges.  The lines are dilated with
+   the van Herk/Gil-Werman algorithm, streamed in blocks of the rectangle
+   height, and the samples with shifts of whole words, so the cost does not
+   grow with the number of lines and only with the log of the number of
+   samples of the rectangle.  Returns 0 on success, -1 if the work buffers
+   cannot be allocated (the mask is then unchanged). */
+int morph_dilate(morph_mask_t *mask, int lines_before, int lines_after,
+	int samps_before, int samps_after);
+
+#endif
@@ -275,6 +275,16 @@ Date          Programmer       Reason
                                land/water mask array
                                Fixed a bug accessing the CMG arrays for line+1
                                and sample+1
+11/19/2015                     The pixel lat/long for the auxiliary data are
+                               interpolated from a geolocation grid of
+                               projected control points vs. calling from_space
+                               for every pixel
+11/20/2015                     Only the CMG window covered by the scene is
+                               read from the auxiliary files.  Added the
+                               shared auxiliary cache of the static grids.
+11/20/2015                     Added the binary LUT file
+11/20/2015                     The rolutt, transt, sphalbt and normext LUTs
+                               are flat arrays (see ROLUTT_IDX)
 
 NOTES:
 1. Initializes the variables and data arrays from the lookup table and
@@ -305,7 +315,13 @@ int compute_sr_refl
     char *spheranm,     /* I: spherical albedo filename */
     char *cmgdemnm,     /* I: climate modeling grid DEM filename */
     char *rationm,      /* I: ratio averages filename */
-    char *auxnm         /* I: auxiliary filename for ozone and water vapor */
+    char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
+    char *aux_cache,    /* I: shared cache file of the static auxiliary grids,
+                              NULL if not used */
+    char *lut_bin,      /* I: binary LUT file to map in place of the LUT
+                              files, NULL if not used */
+    float geogrid_max_err  /* I: error bound (deg) of the interpolated pixel
+                                 lat/long; 0 maps every pixel exactly */
 )
 {
     char errmsg[STR_SIZE];                   /* error message */
@@ -397,8 +413,7 @@ int compute_sr_refl
     /* Vars for forward/inverse mapping space */
     Geoloc_t *space = NULL;       /* structure for geolocation information */
     Space_def_t space_def;        /* structure to define the space mapping */
-    Img_coord_float_t img;        /* coordinate in line/sample space */
-    Geo_coord_t geo;              /* coordinate in lat/long space */
+    Geogrid_t *geogrid = NULL;    /* geolocation grid of the pixel centers */
 
     /* Lookup table variables */
     float xtv;           /* observation zenith angle (deg) -- NOTE: set to 0.0
@@ -411,14 +426,14 @@ int compute_sr_refl
     float xtsmin;        /* minimum solar zenith value */
     float xtvstep;       /* observation step value */
     float xtvmin;        /* minimum observation value */
-    float ****rolutt = NULL;    /* intrinsic reflectance table
-                                   [NSR_BANDS][7][22][8000] */
-    float ****transt = NULL;    /* transmission table
-                                   [NSR_BANDS][7][22][22] */
-    float ***sphalbt = NULL;    /* spherical albedo table [NSR_BANDS][7][22] */
-    float ***normext = NULL;    /* aerosol extinction coefficient at the
+    float *rolutt = NULL;       /* intrinsic reflectance table
+                                   [NSR_BANDS][8000][22][7] */
+    float *transt = NULL;       /* transmission table
+                                   [NSR_BANDS][22][22][7] */
+    float *sphalbt = NULL;      /* spherical albedo table [NSR_BANDS][22][7] */
+    float *normext = NULL;      /* aerosol extinction coefficient at the
                                    current wavelength (normalized at 550nm)
-                                   [NSR_BANDS][7][22] */
+                                   [NSR_BANDS][22][7] */
     float **tsmax = NULL;       /* maximum scattering angle table [20][22] */
     float **tsmin = NULL;       /* minimum scattering angle table [20][22] */
     float **nbfi = NULL;        /* number of azimuth angles [20][22] */
@@ -450,6 +465,8 @@ int compute_sr_refl
     uint16 **wv = NULL;       /* water vapor values [CMG_NBLAT][CMG_NBLON] */
     uint8 **oz = NULL;        /* ozone values [CMG_NBLAT][CMG_NBLON] */
     uint8 *lw_mask = NULL;    /* land/water mask, nlines x nsamps */
+    Aux_window_t aux_win;     /* CMG window read from the auxiliary files */
+    Lut_map_t lut_map;        /* mapping of the binary LUT file */
     float raot550nm;    /* nearest input value of AOT */
     float uoz;          /* total column ozone */
     float uwv;          /* total column water vapor (precipital water vapor) */
@@ -500,8 +517,7 @@ int compute_sr_refl
         &aerob5, &aerob7, &cloud, &twvi, &tozi, &tp, &tresi, &taero, &lw_mask,
         &dem, &andwi, &sndwi, &ratiob1, &ratiob2, &ratiob7, &intratiob1,
         &intratiob2, &intratiob7, &slpratiob1, &slpratiob2, &slpratiob7, &wv,
-        &oz, &rolutt, &transt, &sphalbt, &normext, &tsmax, &tsmin, &nbfic,
-        &nbfi, &ttv);
+        &oz, &tsmax, &tsmin, &nbfic, &nbfi, &ttv);
     if (retval != SUCCESS)
     {
         sprintf (errmsg, "Error allocating memory for the data arrays needed "
@@ -528,12 +544,12 @@ int compute_sr_refl
 
     /* Initialize the look up tables and atmospheric correction variables */
     retval = init_sr_refl (nlines, nsamps, input, space, anglehdf, intrefnm,
-        transmnm, spheranm, cmgdemnm, rationm, auxnm, &xtv, &xmuv, &xfi,
-        &cosxfi, &raot550nm, &pres, &uoz, &uwv, &xtsstep, &xtsmin, &xtvstep,
-        &xtvmin, tsmax, tsmin, tts, ttv, indts, rolutt, transt, sphalbt,
-        normext, nbfic, nbfi, dem, andwi, sndwi, ratiob1, ratiob2, ratiob7,
-        intratiob1, intratiob2, intratiob7, slpratiob1, slpratiob2, slpratiob7,
-        wv, oz);
+        transmnm, spheranm, cmgdemnm, rationm, auxnm, aux_cache, lut_bin,
+        &xtv, &xmuv, &xfi, &cosxfi, &raot550nm, &pres, &uoz, &uwv, &xtsstep,
+        &xtsmin, &xtvstep, &xtvmin, tsmax, tsmin, tts, ttv, indts, &rolutt,
+        &transt, &sphalbt, &normext, nbfic, nbfi, dem, andwi, sndwi, ratiob1,
+        ratiob2, ratiob7, intratiob1, intratiob2, intratiob7, slpratiob1,
+        slpratiob2, slpratiob7, wv, oz, &aux_win, &lut_map);
     if (retval != SUCCESS)
     {
         sprintf (errmsg, "Error initializing the lookup tables and "
@@ -624,10 +640,25 @@ int compute_sr_refl
         troatm[ib] = 0.0;
     }
 
+    /* Set up the geolocation grid for the center of the pixels */
+    geogrid = create_geogrid (space, nlines, nsamps, -0.5, 0.5,
+        geogrid_max_err);
+    if (geogrid == NULL)
+    {
+        sprintf (errmsg, "Creating the geolocation grid");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+    if (geogrid->step > 0)
+        printf ("Geolocation grid step %d, max error %g deg (%ld points "
+            "projected)\n", geogrid->step, geogrid->err, geogrid->nproj);
+    else
+        printf ("Geolocation grid disabled, every pixel is projected\n");
+
     /* Interpolate the auxiliary data for each pixel location */
     printf ("Interpolating the auxiliary data ...\n");
     tmp_percent = 0;
-    #pragma omp parallel for private (i, j, curr_pix, img, geo, lat, lon, xcmg, ycmg, lcmg, scmg, u, v, uoz11, uoz12, uoz21, uoz22, pres11, pres12, pres21, pres22, xndwi, th1, th2, fndvi, iband, iband1, iband3, retval, corf, raot, residual, next, rotoa, raot550nm, roslamb, tgo, roatm, ttatmg, satm, xrorayp, ros5, ros4) firstprivate(erelc, troatm)
+    #pragma omp parallel for private (i, j, curr_pix, lat, lon, xcmg, ycmg, lcmg, scmg, u, v, uoz11, uoz12, uoz21, uoz22, pres11, pres12, pres21, pres22, xndwi, th1, th2, fndvi, iband, iband1, iband3, retval, corf, raot, residual, next, rotoa, raot550nm, roslamb, tgo, roatm, ttatmg, satm, xrorayp, ros5, ros4) firstprivate(erelc, troatm)
     for (i = 0; i < nlines; i++)
     {
 #ifndef _OPENMP
@@ -653,40 +684,40 @@ int compute_sr_refl
 
             /* Get the lat/long for the current pixel, for the center of
                the pixel */
-            img.l = i - 0.5;
-            img.s = j + 0.5;
-            img.is_fill = false;
-            if (!from_space (space, &img, &geo))
+            if (geogrid_latlon (geogrid, i, j, &lat, &lon) != SUCCESS)
             {
                 sprintf (errmsg, "Mapping line/sample (%d, %d) to "
                     "geolocation coords", i, j);
                 error_handler (true, FUNC_NAME, errmsg);
                 exit (ERROR);
             }
-            lat = geo.lat * RAD2DEG;
-            lon = geo.lon * RAD2DEG;
 
             /* Use that lat/long to determine the line/sample in the
                CMG-related lookup tables, using the center of the UL
                pixel. Note, we are basically making sure the line/sample
-               combination falls within -90, 90 and -180, 180 global climate
-               data boundaries.  However, the source code below uses lcmg+1
+               combination falls within the CMG window read for the scene
+               (itself within -90, 90 and -180, 180 global climate data
+               boundaries).  However, the source code below uses lcmg+1
                and scmg+1.  Thus we need to stop one line/samp short in the CMG
-               data so we don't access an invalid portion of the CMG data
+               window so we don't access an invalid portion of the CMG data
                arrays. */
             ycmg = (89.975 - lat) * 20.0;   /* vs / 0.05 */
             xcmg = (179.975 + lon) * 20.0;  /* vs / 0.05 */
             lcmg = (int) (ycmg);
             scmg = (int) (xcmg);
-            if ((lcmg < 0 || lcmg >= CMG_NBLAT-1) ||
-                (scmg < 0 || scmg >= CMG_NBLON-1))
+            if ((lcmg < aux_win.line0 ||
+                 lcmg >= aux_win.line0 + aux_win.nlines - 1) ||
+                (scmg < aux_win.samp0 ||
+                 scmg >= aux_win.samp0 + aux_win.nsamps - 1))
             {
                 sprintf (errmsg, "Invalid line/sample combination for the "
                     "CMG-related lookup tables - line %d, sample %d "
-                    "(0-based). CMG-based tables are %d lines x %d "
-                    "samples. We need to stop one line and sample short of "
-                    "the CMG data to make sure we access value memory within "
-                    "the CMG data arrays.", lcmg, scmg, CMG_NBLAT, CMG_NBLON);
+                    "(0-based). The CMG window read for the scene is lines "
+                    "%d-%d, samples %d-%d. We need to stop one line and "
+                    "sample short of the CMG window to make sure we access "
+                    "value memory within the CMG data arrays.", lcmg, scmg,
+                    aux_win.line0, aux_win.line0 + aux_win.nlines - 1,
+                    aux_win.samp0, aux_win.samp0 + aux_win.nsamps - 1);
                 error_handler (true, FUNC_NAME, errmsg);
                 exit (ERROR);
             }
@@ -951,9 +982,13 @@ int compute_sr_refl
     free (aerob7);  aerob7 = NULL;
     free (lw_mask); lw_mask = NULL;
 
-    /* Done with the DEM array */
-    for (i = 0; i < DEM_NBLAT; i++)
-        free (dem[i]);
+    /* Done with the DEM array; its rows point into the auxiliary cache if it
+       was mapped */
+    if (aux_win.cache == NULL)
+    {
+        for (i = 0; i < DEM_NBLAT; i++)
+            free (dem[i]);
+    }
     free (dem);  dem = NULL;
 
     /* Refine the cloud mask */
@@ -1487,11 +1522,13 @@ fclose (tmpfile);
     close_output (sr_output, false /*sr products*/);
     free_output (sr_output);
 
-    /* Free the spatial mapping pointer */
+    /* Free the geolocation grid and the spatial mapping pointer */
+    free_geogrid (geogrid);
     free (space);
 
-    /* Done with the ratiob* arrays */
-    for (i = 0; i < RATIO_NBLAT; i++)
+    /* Done with the ratiob* arrays; their rows point into the auxiliary cache
+       if it was mapped */
+    for (i = 0; i < RATIO_NBLAT && aux_win.cache == NULL; i++)
     {
         free (andwi[i]);
         free (sndwi[i]);
@@ -1516,6 +1553,7 @@ fclose (tmpfile);
     free (slpratiob1);  slpratiob1 = NULL;
     free (slpratiob2);  slpratiob2 = NULL;
     free (slpratiob7);  slpratiob7 = NULL;
+    free_aux_cache (&aux_win);
 
     /* Free the data arrays */
     for (i = 0; i < CMG_NBLAT; i++)
@@ -1526,42 +1564,8 @@ fclose (tmpfile);
     free (wv);
     free (oz);
 
-    for (i = 0; i < NSR_BANDS; i++)
-    {
-        for (j = 0; j < 7; j++)
-        {
-            for (k = 0; k < 22; k++)
-            {
-                free (rolutt[i][j][k]);
-                free (transt[i][j][k]);
-            }
-            free (rolutt[i][j]);
-            free (transt[i][j]);
-            free (sphalbt[i][j]);
-        }
-        free (rolutt[i]);
-        free (transt[i]);
-        free (sphalbt[i]);
-    }
-    free (rolutt);
-    free (transt);
-    free (sphalbt);
-
-    /* tsmax[20][22] and float tsmin[20][22] and float nbfic[20][22] and
-       nbfi[20][22] and float ttv[20][22] */
-    for (i = 0; i < 20; i++)
-    {
-        free (tsmax[i]);
-        free (tsmin[i]);
-        free (nbfic[i]);
-        free (nbfi[i]);
-        free (ttv[i]);
-    }
-    free (tsmax);
-    free (tsmin);
-    free (nbfic);
-    free (nbfi);
-    free (ttv);
+    free_lut (rolutt, transt, sphalbt, normext, tsmax, tsmin, nbfic, nbfi,
+        ttv, &lut_map);
 
     /* Successful completion */
     return (SUCCESS);
@@ -1590,6 +1594,10 @@ Date          Programmer       Reason
 ----------    ---------------  -------------------------------------
 12/15/2014    Gail Schmidt     Broke the source code into a function to
                                modularize the source code in the main routine
+11/20/2015                     Added the auxiliary cache and the CMG window
+11/20/2015                     Added the binary LUT file
+11/20/2015                     rolutt, transt, sphalbt and normext are
+                               returned by readluts or map_lut_bin
 
 NOTES:
 1. The view angle is set to 0.0 and this never changes.
@@ -1608,6 +1616,10 @@ int init_sr_refl
     char *cmgdemnm,     /* I: climate modeling grid DEM filename */
     char *rationm,      /* I: ratio averages filename */
     char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
+    char *aux_cache,    /* I: shared cache file of the static auxiliary grids,
+                              NULL if not used */
+    char *lut_bin,      /* I: binary LUT file to map in place of the LUT
+                              files, NULL if not used */
     float *xtv,         /* O: observation zenith angle (deg) */
     float *xmuv,        /* O: cosine of observation zenith angle */
     float *xfi,         /* O: azimuthal difference between sun and
@@ -1627,13 +1639,13 @@ int init_sr_refl
     float tts[22],      /* O: sun angle table */
     float **ttv,        /* O: view angle table [20][22] */
     int32 indts[22],    /* O: index for the sun angle table */
-    float ****rolutt,   /* O: intrinsic reflectance table
-                              [NSR_BANDS][7][22][8000] */
-    float ****transt,   /* O: transmission table [NSR_BANDS][7][22][22] */
-    float ***sphalbt,   /* O: spherical albedo table [NSR_BANDS][7][22] */
-    float ***normext,   /* O: aerosol extinction coefficient at the current
+    float **rolutt,     /* O: intrinsic reflectance table
+                              [NSR_BANDS][8000][22][7] */
+    float **transt,     /* O: transmission table [NSR_BANDS][22][22][7] */
+    float **sphalbt,    /* O: spherical albedo table [NSR_BANDS][22][7] */
+    float **normext,    /* O: aerosol extinction coefficient at the current
                               wavelength (normalized at 550nm)
-                              [NSR_BANDS][7][22] */
+                              [NSR_BANDS][22][7] */
     float **nbfic,      /* O: communitive number of azimuth angles [20][22] */
     float **nbfi,       /* O: number of azimuth angles [20][22] */
     int16 **dem,        /* O: CMG DEM data array [DEM_NBLAT][DEM_NBLON] */
@@ -1649,7 +1661,9 @@ int init_sr_refl
     int16 **slpratiob2, /* O: slope band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
     int16 **slpratiob7, /* O: slope band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
     uint16 **wv,        /* O: water vapor values [CMG_NBLAT][CMG_NBLON] */
-    uint8 **oz          /* O: ozone values [CMG_NBLAT][CMG_NBLON] */
+    uint8 **oz,         /* O: ozone values [CMG_NBLAT][CMG_NBLON] */
+    Aux_window_t *aux_win, /* O: CMG window read from the auxiliary files */
+    Lut_map_t *lut_map     /* O: mapping of the binary LUT file */
 )
 {
     char errmsg[STR_SIZE];                   /* error message */
@@ -1668,18 +1682,35 @@ int init_sr_refl
     *xmuv = cos (*xtv * DEG2RAD);
     *xfi = 0.0;
     *cosxfi = cos (*xfi * DEG2RAD);
-    *xtsmin = 0;
-    *xtsstep = 4.0;
+    *xtsmin = LUT_XTSMIN;
+    *xtsstep = LUT_XTSSTEP;
     *xtvmin = 2.84090;
     *xtvstep = 6.52107 - *xtvmin;
-    retval = readluts (tsmax, tsmin, ttv, tts, nbfi, nbfic, indts, rolutt,
-        transt, sphalbt, normext, *xtsstep, *xtsmin, anglehdf, intrefnm,
-        transmnm, spheranm);
-    if (retval != SUCCESS)
+    if (lut_bin != NULL)
     {
-        sprintf (errmsg, "Reading the LUTs");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        retval = map_lut_bin (lut_bin, *xtsstep, *xtsmin, tsmax, tsmin, ttv,
+            tts, nbfic, nbfi, indts, rolutt, transt, sphalbt, normext, false,
+            lut_map);
+        if (retval != SUCCESS)
+        {
+            sprintf (errmsg, "Mapping the binary LUT file");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+    }
+    else
+    {
+        lut_map->map = NULL;
+        lut_map->map_len = 0;
+        retval = readluts (tsmax, tsmin, ttv, tts, nbfi, nbfic, indts, rolutt,
+            transt, sphalbt, normext, *xtsstep, *xtsmin, anglehdf, intrefnm,
+            transmnm, spheranm);
+        if (retval != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the LUTs");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
     }
     printf ("The LUTs for urban clean case v2.0 have been read.  We can "
         "now perform atmospheric correction.\n");
@@ -1687,9 +1718,9 @@ int init_sr_refl
     /* Read the auxiliary data files used as input to the reflectance
        calculations */
     retval = read_auxiliary_files (anglehdf, intrefnm, transmnm, spheranm,
-        cmgdemnm, rationm, auxnm, dem, andwi, sndwi, ratiob1, ratiob2,
-        ratiob7, intratiob1, intratiob2, intratiob7, slpratiob1,
-        slpratiob2, slpratiob7, wv, oz);
+        cmgdemnm, rationm, auxnm, aux_cache, space, nlines, nsamps, dem,
+        andwi, sndwi, ratiob1, ratiob2, ratiob7, intratiob1, intratiob2,
+        intratiob7, slpratiob1, slpratiob2, slpratiob7, wv, oz, aux_win);
     if (retval != SUCCESS)
     {
         sprintf (errmsg, "Reading the auxiliary files");
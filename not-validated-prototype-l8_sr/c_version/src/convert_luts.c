@@ -0,0 +1,252 @@
+/*****************************************************************************
+FILE: convert_luts.c
+
+PURPOSE: Contains the convert_l8sr_luts application, which converts the L8 SR
+look-up tables to the binary LUT file mapped by l8_sr --lut_bin.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+HISTORY:
+Date         Programmer       Reason
+----------   --------------   -------------------------------------
+11/20/2015                    Original development
+
+NOTES:
+  1. The binary LUT file is written and validated by write_lut_bin and
+     map_lut_bin in lut_subr.c.
+*****************************************************************************/
+#include <getopt.h>
+#include "lut_subr.h"
+
+void convert_luts_usage ();
+
+/******************************************************************************
+MODULE:  convert_l8sr_luts
+
+PURPOSE:  Converts the L8 SR look-up tables (angle HDF, intrinsic reflectance
+HDF, transmission and spherical albedo ASCII files) to the binary LUT file
+mapped by l8_sr --lut_bin.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An error occurred converting the look-up tables
+SUCCESS         Processing was successful
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+HISTORY:
+Date          Programmer       Reason
+----------    ---------------  -------------------------------------
+11/20/2015                     Original development
+
+NOTES:
+1. The look-up tables are read from $L8_AUX_DIR/LDCMLUT, or from the local
+   directory if L8_AUX_DIR isn't defined, the same as l8_sr.
+2. The binary LUT file must be recreated when the look-up tables change;
+   l8_sr validates its header and table layout but not its source files.
+3. The checksum of the tables is verified by mapping the file back after
+   writing it, or on its own with --verify.  l8_sr doesn't verify it, since
+   that would read the whole file on every run.
+******************************************************************************/
+int main (int argc, char *argv[])
+{
+    char FUNC_NAME[] = "main"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *aux_path = NULL;   /* path for Landsat auxiliary data */
+    char *lut_bin = NULL;    /* output binary LUT filename */
+    char anglehdf[STR_SIZE]; /* angle HDF filename */
+    char intrefnm[STR_SIZE]; /* intrinsic reflectance filename */
+    char transmnm[STR_SIZE]; /* transmission filename */
+    char spheranm[STR_SIZE]; /* spherical albedo filename */
+    int c;                   /* current argument index */
+    int option_index;        /* index for the command-line option */
+    int retval;              /* return status */
+    static int verify_flag=0;  /* only verify an existing binary LUT file */
+    float tts[22];           /* sun angle table */
+    int32 indts[22];         /* index for the sun angle table */
+    float *rolutt = NULL;    /* intrinsic reflectance table
+                                [NSR_BANDS][8000][22][7] */
+    float *transt = NULL;    /* transmission table [NSR_BANDS][22][22][7] */
+    float *sphalbt = NULL;   /* spherical albedo table [NSR_BANDS][22][7] */
+    float *normext = NULL;   /* aerosol extinction coefficient at the current
+                                wavelength (normalized at 550nm)
+                                [NSR_BANDS][22][7] */
+    float **tsmax = NULL;    /* maximum scattering angle table [20][22] */
+    float **tsmin = NULL;    /* minimum scattering angle table [20][22] */
+    float **nbfic = NULL;    /* communitive number of azimuth angles [20][22] */
+    float **nbfi = NULL;     /* number of azimuth angles [20][22] */
+    float **ttv = NULL;      /* view angle table [20][22] */
+    Lut_map_t lut_map;       /* mapping of the binary LUT file */
+    static struct option long_options[] =
+    {
+        {"verify", no_argument, &verify_flag, 1},
+        {"lut_bin", required_argument, 0, 'l'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Read the command-line arguments */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                convert_luts_usage ();
+                exit (ERROR);
+                break;
+
+            case 'l':  /* binary LUT file */
+                lut_bin = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                convert_luts_usage ();
+                exit (ERROR);
+                break;
+        }
+    }
+    if (lut_bin == NULL)
+    {
+        sprintf (errmsg, "Output binary LUT file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        convert_luts_usage ();
+        exit (ERROR);
+    }
+
+    if (!verify_flag)
+    {
+        /* Set up the look-up table files the same as l8_sr */
+        aux_path = getenv ("L8_AUX_DIR");
+        if (aux_path == NULL)
+        {
+            aux_path = ".";
+            sprintf (errmsg, "L8_AUX_DIR environment variable isn't defined. "
+                "It is assumed the look-up tables will be available from the "
+                "local directory.");
+            error_handler (false, FUNC_NAME, errmsg);
+        }
+        sprintf (anglehdf, "%s/LDCMLUT/ANGLE_NEW.hdf", aux_path);
+        sprintf (intrefnm, "%s/LDCMLUT/RES_LUT_V3.0-URBANCLEAN-V2.0.hdf",
+            aux_path);
+        sprintf (transmnm, "%s/LDCMLUT/TRANS_LUT_V3.0-URBANCLEAN-V2.0.ASCII",
+            aux_path);
+        sprintf (spheranm, "%s/LDCMLUT/AERO_LUT_V3.0-URBANCLEAN-V2.0.ASCII",
+            aux_path);
+
+        /* Read the look-up tables */
+        retval = memory_allocation_lut (&tsmax, &tsmin, &nbfic, &nbfi, &ttv);
+        if (retval != SUCCESS)
+        {
+            sprintf (errmsg, "Error allocating memory for the look-up tables");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+
+        retval = readluts (tsmax, tsmin, ttv, tts, nbfi, nbfic, indts,
+            &rolutt, &transt, &sphalbt, &normext, LUT_XTSSTEP, LUT_XTSMIN,
+            anglehdf, intrefnm, transmnm, spheranm);
+        if (retval != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the LUTs");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+
+        /* Write the binary LUT file */
+        retval = write_lut_bin (lut_bin, LUT_XTSSTEP, LUT_XTSMIN, tsmax,
+            tsmin, ttv, tts, nbfic, nbfi, indts, rolutt, transt, sphalbt,
+            normext);
+        if (retval != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the binary LUT file");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        printf ("The LUTs have been written to %s\n", lut_bin);
+
+        free_lut (rolutt, transt, sphalbt, normext, tsmax, tsmin, nbfic, nbfi,
+            ttv, NULL);
+    }
+
+    /* Map the binary LUT file back and verify its checksum */
+    retval = memory_allocation_lut (&tsmax, &tsmin, &nbfic, &nbfi, &ttv);
+    if (retval != SUCCESS)
+    {
+        sprintf (errmsg, "Error allocating memory for the look-up tables");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    retval = map_lut_bin (lut_bin, LUT_XTSSTEP, LUT_XTSMIN, tsmax, tsmin, ttv,
+        tts, nbfic, nbfi, indts, &rolutt, &transt, &sphalbt, &normext, true,
+        &lut_map);
+    if (retval != SUCCESS)
+    {
+        sprintf (errmsg, "Verifying the binary LUT file");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+    printf ("The binary LUT file %s has been verified\n", lut_bin);
+
+    free_lut (rolutt, transt, sphalbt, normext, tsmax, tsmin, nbfic, nbfi, ttv,
+        &lut_map);
+    free (lut_bin);
+    exit (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  convert_luts_usage
+
+PURPOSE:  Prints the usage information for convert_l8sr_luts.
+
+RETURN VALUE:
+Type = None
+
+HISTORY:
+Date          Programmer       Reason
+----------    ---------------  -------------------------------------
+11/20/2015                     Original development
+
+NOTES:
+******************************************************************************/
+void convert_luts_usage ()
+{
+    printf ("convert_l8sr_luts converts the L8 SR look-up tables in "
+            "$L8_AUX_DIR/LDCMLUT to a binary LUT file, which l8_sr maps "
+            "read-only with --lut_bin in place of reading and parsing the "
+            "look-up tables for every scene.\n\n");
+    printf ("usage: convert_l8sr_luts --lut_bin=binary_lut_filename "
+            "[--verify]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -lut_bin: name of the output binary LUT file\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -verify: only verify the checksum of an existing binary "
+            "LUT file, instead of converting the look-up tables\n");
+
+    printf ("\nExample: convert_l8sr_luts --lut_bin=$L8_AUX_DIR/LDCMLUT/"
+            "l8sr_luts.bin\n");
+}
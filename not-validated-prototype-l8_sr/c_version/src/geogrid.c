@@ -0,0 +1,351 @@
+/*****************************************************************************
+FILE: geogrid.c
+
+PURPOSE: Contains functions for serving the lat/long of the scene pixels from
+a coarse grid of projected control points instead of projecting every pixel.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+HISTORY:
+Date         Programmer       Reason
+----------   --------------   -------------------------------------
+11/19/2015                    Original development
+
+NOTES:
+  1. The control points are every GEOGRID_STEP lines/samples, plus the last
+     line/sample of the scene.  The spacing is halved until the bilinear
+     interpolation error, checked at the middle of the cells and of their
+     edges, is within the error bound.  If that needs a spacing smaller than
+     GEOGRID_MIN_STEP, or if a control point can't be mapped, every pixel is
+     mapped exactly with from_space.
+*****************************************************************************/
+#include "geogrid.h"
+
+/* Line (or sample) of control point k of a grid of n points spread over
+   size pixels; the last point is on the last pixel */
+static double grid_pos (int k, int n, int size, int step)
+{
+    if (k < n-1)
+        return (double) k * step;
+    if (size-1 > (n-2) * step)
+        return (double) (size-1);
+    return (double) ((n-2) * step + 1);
+}
+
+/* Longitude brought back in the -180, 180 range */
+static double wrap_lon (double lon)
+{
+    while (lon >= 180.0)
+        lon -= 360.0;
+    while (lon < -180.0)
+        lon += 360.0;
+    return lon;
+}
+
+/* Exact lat/long (deg) of line/sample; returns false if it can't be mapped */
+static bool map_exact (Geogrid_t *grid, double line, double samp, double *lat,
+    double *lon)
+{
+    Img_coord_float_t img;        /* coordinate in line/sample space */
+    Geo_coord_t geo;              /* coordinate in lat/long space */
+
+    img.l = line + grid->off_line;
+    img.s = samp + grid->off_samp;
+    img.is_fill = false;
+    if (!from_space (grid->space, &img, &geo))
+        return false;
+    *lat = geo.lat * RAD2DEG;
+    *lon = geo.lon * RAD2DEG;
+    return true;
+}
+
+/* Bilinear interpolation of the lat/long (deg) of line/sample */
+static void interp_grid (Geogrid_t *grid, double line, double samp,
+    double *lat, double *lon)
+{
+    int r, c;                     /* row/column of the grid cell */
+    int k;                        /* index of the upper left control point */
+    int n = grid->nsamps_grid;    /* number of control points in a row */
+    double l0, l1, s0, s1;        /* line/sample extent of the grid cell */
+    double u, v;                  /* fractional position in the grid cell */
+
+    r = (int) (line / grid->step);
+    if (r > grid->nlines_grid - 2)
+        r = grid->nlines_grid - 2;
+    if (r < 0)
+        r = 0;
+    c = (int) (samp / grid->step);
+    if (c > grid->nsamps_grid - 2)
+        c = grid->nsamps_grid - 2;
+    if (c < 0)
+        c = 0;
+    l0 = grid_pos (r, grid->nlines_grid, grid->nlines, grid->step);
+    l1 = grid_pos (r+1, grid->nlines_grid, grid->nlines, grid->step);
+    s0 = grid_pos (c, grid->nsamps_grid, grid->nsamps, grid->step);
+    s1 = grid_pos (c+1, grid->nsamps_grid, grid->nsamps, grid->step);
+    u = (line - l0) / (l1 - l0);
+    v = (samp - s0) / (s1 - s0);
+
+    k = r * n + c;
+    *lat = grid->lat[k] * (1.0 - u) * (1.0 - v) +
+           grid->lat[k+1] * (1.0 - u) * v +
+           grid->lat[k+n] * u * (1.0 - v) +
+           grid->lat[k+n+1] * u * v;
+    *lon = grid->lon[k] * (1.0 - u) * (1.0 - v) +
+           grid->lon[k+1] * (1.0 - u) * v +
+           grid->lon[k+n] * u * (1.0 - v) +
+           grid->lon[k+n+1] * u * v;
+    *lon = wrap_lon (*lon);
+}
+
+
+/******************************************************************************
+MODULE:  build_geogrid
+
+PURPOSE:  Projects the control points for the current grid spacing and
+measures the interpolation error within the grid cells.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the grid or mapping a control point
+SUCCESS         The grid was built; grid->err holds the error found (the
+                check stops as soon as it exceeds grid->max_err)
+
+HISTORY:
+Date         Programmer       Reason
+----------   --------------   -------------------------------------
+11/19/2015                    Original development
+
+NOTES:
+  1. The middle of each cell and of its top and left edges are checked.  The
+     bottom and right edges are checked by the next cells, but for the last
+     row/column of cells.
+******************************************************************************/
+static int build_geogrid
+(
+    Geogrid_t *grid     /* I/O: geolocation grid */
+)
+{
+    int r, c, k;                  /* looping variables */
+    double line, samp;            /* line/sample of a point */
+    double l0, l1, s0, s1;        /* line/sample extent of a grid cell */
+    double ref;                   /* longitude of the previous control point */
+    double lat, lon;              /* exact lat/long of a point */
+    double glat, glon;            /* interpolated lat/long of a point */
+    double err;                   /* interpolation error of a point */
+
+    grid->nlines_grid = (grid->nlines - 1 + grid->step - 1) / grid->step + 1;
+    if (grid->nlines_grid < 2)
+        grid->nlines_grid = 2;
+    grid->nsamps_grid = (grid->nsamps - 1 + grid->step - 1) / grid->step + 1;
+    if (grid->nsamps_grid < 2)
+        grid->nsamps_grid = 2;
+    grid->lat = calloc (grid->nlines_grid * grid->nsamps_grid,
+        sizeof (double));
+    grid->lon = calloc (grid->nlines_grid * grid->nsamps_grid,
+        sizeof (double));
+    if (grid->lat == NULL || grid->lon == NULL)
+        return (ERROR);
+
+    /* Project the control points, unwrapping the longitudes across the
+       dateline from the previous point */
+    for (r = 0; r < grid->nlines_grid; r++)
+    {
+        line = grid_pos (r, grid->nlines_grid, grid->nlines, grid->step);
+        for (c = 0; c < grid->nsamps_grid; c++)
+        {
+            k = r * grid->nsamps_grid + c;
+            samp = grid_pos (c, grid->nsamps_grid, grid->nsamps, grid->step);
+            grid->nproj++;
+            if (!map_exact (grid, line, samp, &grid->lat[k], &grid->lon[k]))
+                return (ERROR);
+            if (r > 0 || c > 0)
+            {
+                ref = (c > 0) ? grid->lon[k-1] : grid->lon[k-grid->nsamps_grid];
+                while (grid->lon[k] - ref > 180.0)
+                    grid->lon[k] -= 360.0;
+                while (grid->lon[k] - ref < -180.0)
+                    grid->lon[k] += 360.0;
+            }
+        }
+    }
+
+    /* Measure the interpolation error */
+    grid->err = 0.0;
+    for (r = 0; r < grid->nlines_grid - 1; r++)
+    {
+        l0 = grid_pos (r, grid->nlines_grid, grid->nlines, grid->step);
+        l1 = grid_pos (r+1, grid->nlines_grid, grid->nlines, grid->step);
+        for (c = 0; c < grid->nsamps_grid - 1; c++)
+        {
+            s0 = grid_pos (c, grid->nsamps_grid, grid->nsamps, grid->step);
+            s1 = grid_pos (c+1, grid->nsamps_grid, grid->nsamps, grid->step);
+            for (k = 0; k < 3; k++)
+            {
+                line = (k == 1) ? l0 : (l0 + l1) * 0.5;
+                samp = (k == 2) ? s0 : (s0 + s1) * 0.5;
+                grid->nproj++;
+                if (!map_exact (grid, line, samp, &lat, &lon))
+                    return (ERROR);
+                interp_grid (grid, line, samp, &glat, &glon);
+                err = fabs (wrap_lon (glon - lon));
+                if (fabs (glat - lat) > err)
+                    err = fabs (glat - lat);
+                if (err > grid->err)
+                    grid->err = err;
+                if (grid->err > grid->max_err)
+                    return (SUCCESS);
+            }
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  create_geogrid
+
+PURPOSE:  Creates the geolocation grid of the scene, with the largest control
+point spacing for which the interpolation error is within the error bound.
+
+RETURN VALUE:
+Type = Geogrid_t *
+Value           Description
+-----           -----------
+NULL            Error allocating the geolocation grid
+non-NULL        The geolocation grid (step 0 if every pixel is to be mapped
+                exactly)
+
+HISTORY:
+Date         Programmer       Reason
+----------   --------------   -------------------------------------
+11/19/2015                    Original development
+
+NOTES:
+  1. The caller is responsible for freeing the grid with free_geogrid.
+******************************************************************************/
+Geogrid_t *create_geogrid
+(
+    Geoloc_t *space,    /* I: geolocation information of the scene */
+    int nlines,         /* I: number of lines in the scene */
+    int nsamps,         /* I: number of samples in the scene */
+    double off_line,    /* I: offset added to the line of a pixel */
+    double off_samp,    /* I: offset added to the sample of a pixel */
+    double max_err      /* I: interpolation error bound (deg); 0 to map
+                              every pixel exactly */
+)
+{
+    char errmsg[STR_SIZE];                   /* error message */
+    char FUNC_NAME[] = "create_geogrid";     /* function name */
+    Geogrid_t *grid = NULL;                  /* geolocation grid */
+
+    grid = calloc (1, sizeof (Geogrid_t));
+    if (grid == NULL)
+    {
+        sprintf (errmsg, "Allocating the geolocation grid");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    grid->space = space;
+    grid->nlines = nlines;
+    grid->nsamps = nsamps;
+    grid->off_line = off_line;
+    grid->off_samp = off_samp;
+    grid->max_err = max_err;
+
+    /* Halve the control point spacing until the error is within bounds */
+    for (grid->step = GEOGRID_STEP;
+         max_err > 0.0 && grid->step >= GEOGRID_MIN_STEP; grid->step /= 2)
+    {
+        if (build_geogrid (grid) == SUCCESS && grid->err <= max_err)
+            return (grid);
+        free (grid->lat);
+        free (grid->lon);
+        grid->lat = NULL;
+        grid->lon = NULL;
+    }
+
+    /* Fall back to the exact mapping of every pixel */
+    grid->step = 0;
+    grid->err = 0.0;
+    return (grid);
+}
+
+
+/******************************************************************************
+MODULE:  geogrid_latlon
+
+PURPOSE:  Gets the lat/long of a pixel from the geolocation grid.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error mapping the pixel (exact mapping only)
+SUCCESS         No errors encountered
+
+HISTORY:
+Date         Programmer       Reason
+----------   --------------   -------------------------------------
+11/19/2015                    Original development
+
+NOTES:
+  1. The grid is only read, so this can be called from several threads.
+******************************************************************************/
+int geogrid_latlon
+(
+    Geogrid_t *grid,    /* I: geolocation grid */
+    int line,           /* I: line of the pixel */
+    int samp,           /* I: sample of the pixel */
+    float *lat,         /* O: latitude of the pixel (deg) */
+    float *lon          /* O: longitude of the pixel (deg) */
+)
+{
+    double dlat, dlon;            /* lat/long of the pixel */
+
+    if (grid->step == 0)
+    {
+        if (!map_exact (grid, (double) line, (double) samp, &dlat, &dlon))
+            return (ERROR);
+    }
+    else
+        interp_grid (grid, (double) line, (double) samp, &dlat, &dlon);
+
+    *lat = (float) dlat;
+    *lon = (float) dlon;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  free_geogrid
+
+PURPOSE:  Frees the geolocation grid.
+
+RETURN VALUE:
+Type = None
+
+HISTORY:
+Date         Programmer       Reason
+----------   --------------   -------------------------------------
+11/19/2015                    Original development
+
+NOTES:
+******************************************************************************/
+void free_geogrid
+(
+    Geogrid_t *grid     /* I: geolocation grid to be freed */
+)
+{
+    if (grid == NULL)
+        return;
+    free (grid->lat);
+    free (grid->lon);
+    free (grid);
+}
@@ -0,0 +1,64 @@
+#ifndef _GEOGRID_H_
+#define _GEOGRID_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <stdbool.h>
+#include "common.h"
+#include "espa_geoloc.h"
+#include "error_handler.h"
+
+/* Geolocation grid definitions */
+#define GEOGRID_STEP 32         /* initial control point spacing (pixels) */
+#define GEOGRID_MIN_STEP 4      /* below this every pixel is mapped exactly */
+#define GEOGRID_MAX_ERROR 0.0001  /* default interpolation error bound (deg) */
+
+/* Lat/long of the scene served by bilinear interpolation of a coarse grid
+   of control points, each projected once with from_space.  A step of 0
+   means every pixel is mapped exactly. */
+typedef struct
+{
+    Geoloc_t *space;    /* geolocation information of the scene */
+    int nlines;         /* number of lines in the scene */
+    int nsamps;         /* number of samples in the scene */
+    double off_line;    /* offset added to the line of a pixel */
+    double off_samp;    /* offset added to the sample of a pixel */
+    int step;           /* control point spacing (pixels), 0 = exact */
+    int nlines_grid;    /* number of control point rows */
+    int nsamps_grid;    /* number of control point columns */
+    double *lat;        /* latitude of the control points (deg) */
+    double *lon;        /* longitude of the control points (deg), unwrapped
+                           across the dateline */
+    double max_err;     /* interpolation error bound (deg) */
+    double err;         /* max interpolation error found in the cells (deg) */
+    long nproj;         /* number of from_space calls for the grid */
+} Geogrid_t;
+
+/* Prototypes */
+Geogrid_t *create_geogrid
+(
+    Geoloc_t *space,    /* I: geolocation information of the scene */
+    int nlines,         /* I: number of lines in the scene */
+    int nsamps,         /* I: number of samples in the scene */
+    double off_line,    /* I: offset added to the line of a pixel */
+    double off_samp,    /* I: offset added to the sample of a pixel */
+    double max_err      /* I: interpolation error bound (deg); 0 to map
+                              every pixel exactly */
+);
+
+int geogrid_latlon
+(
+    Geogrid_t *grid,    /* I: geolocation grid */
+    int line,           /* I: line of the pixel */
+    int samp,           /* I: sample of the pixel */
+    float *lat,         /* O: latitude of the pixel (deg) */
+    float *lon          /* O: longitude of the pixel (deg) */
+);
+
+void free_geogrid
+(
+    Geogrid_t *grid     /* I: geolocation grid to be freed */
+);
+
+#endif
@@ -22,6 +22,9 @@ HISTORY:
 Date          Programmer       Reason
 ----------    ---------------  -------------------------------------
 7/1/2014      Gail Schmidt     Original Development
+11/19/2015                     Added the geogrid_max_err option
+11/20/2015                     Added the aux_cache option
+11/20/2015                     Added the lut_bin option
 
 NOTES:
   1. The input files should be character a pointer set to NULL on input. Memory
@@ -37,6 +40,11 @@ int get_args
                                 water vapor and ozone */
     bool *process_sr,     /* O: process the surface reflectance products */
     bool *write_toa,      /* O: write intermediate TOA products flag */
+    float *geogrid_max_err,  /* O: error bound (deg) of the interpolated
+                                   pixel lat/long */
+    char **aux_cache,     /* O: address of the shared cache file of the
+                                static auxiliary grids */
+    char **lut_bin,       /* O: address of the binary LUT file */
     bool *verbose         /* O: verbose flag */
 )
 {
@@ -44,6 +52,8 @@ int get_args
     int option_index;                /* index for the command-line option */
     static int verbose_flag=0;       /* verbose flag */
     static int write_toa_flag=0;     /* write TOA flag */
+    double max_err;                  /* geolocation grid error bound */
+    char *endptr = NULL;             /* end of the parsed error bound */
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static struct option long_options[] =
@@ -53,6 +63,9 @@ int get_args
         {"xml", required_argument, 0, 'i'},
         {"aux", required_argument, 0, 'a'},
         {"process_sr", required_argument, 0, 'p'},
+        {"geogrid_max_err", required_argument, 0, 'g'},
+        {"aux_cache", required_argument, 0, 'c'},
+        {"lut_bin", required_argument, 0, 'l'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -61,6 +74,7 @@ int get_args
     *verbose = false;
     *write_toa = false;
     *process_sr = true;    /* default is to process SR products */
+    *geogrid_max_err = GEOGRID_MAX_ERROR;
 
     /* Loop through all the cmd-line options */
     opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
@@ -109,6 +123,27 @@ int get_args
                 }
                 break;
      
+            case 'g':  /* geolocation grid error bound */
+                max_err = strtod (optarg, &endptr);
+                if (endptr == optarg || *endptr != '\0' || !(max_err >= 0.0))
+                {
+                    sprintf (errmsg, "Invalid value for geogrid_max_err: %s",
+                        optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                *geogrid_max_err = max_err;
+                break;
+     
+            case 'c':  /* shared cache of the static auxiliary grids */
+                *aux_cache = strdup (optarg);
+                break;
+     
+            case 'l':  /* binary LUT file */
+                *lut_bin = strdup (optarg);
+                break;
+     
             case '?':
             default:
                 sprintf (errmsg, "Unknown option %s", argv[optind-1]);
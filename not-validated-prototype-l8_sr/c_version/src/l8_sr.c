@@ -66,6 +66,12 @@ Date          Programmer       Reason
 12/10/2014    Gail Schmidt     If this is an OLI-only scene and process_sr is
                                true, then exit with an error.  Only TOA and BT
                                corrections can be made.
+11/19/2015                     Added the geogrid_max_err option for the error
+                               bound of the interpolated pixel lat/long
+11/20/2015                     Added the aux_cache option for the shared cache
+                               of the static auxiliary grids
+11/20/2015                     Added the lut_bin option for the binary LUT
+                               file written by convert_l8sr_luts
 
 NOTES:
 1. Bands 1-7 are corrected to surface reflectance.  Band 8 (pand band) is not
@@ -92,6 +98,10 @@ int main (int argc, char *argv[])
     char *xml_infile = NULL; /* input XML filename */
     char *aux_infile = NULL; /* input auxiliary filename for water vapor
                                 and ozone*/
+    char *aux_cache = NULL;  /* shared cache file of the static auxiliary
+                                grids (DEM and ratios), NULL if not used */
+    char *lut_bin = NULL;    /* binary LUT file, NULL if the LUT files are
+                                read */
     char *cptr = NULL;       /* pointer to the file extension */
     char aux_year[5];        /* string to contain the year of auxiliary file */
 
@@ -120,6 +130,8 @@ int main (int argc, char *argv[])
                                 done */
     bool write_toa = false;  /* this is set to true if the user specifies
                                 TOA products should be output for delivery */
+    float geogrid_max_err;   /* error bound (deg) of the pixel lat/long
+                                interpolated from the geolocation grid */
     float pixsize;      /* pixel size for the reflectance bands */
     int nlines, nsamps; /* number of lines and samples in the reflectance and
                            thermal bands */
@@ -141,7 +153,8 @@ int main (int argc, char *argv[])
 
     /* Read the command-line arguments */
     retval = get_args (argc, argv, &xml_infile, &aux_infile, &process_sr,
-        &write_toa, &verbose);
+        &write_toa, &geogrid_max_err, &aux_cache, &lut_bin,
+        &verbose);
     if (retval != SUCCESS)
     {   /* get_args already printed the error message */
         exit (ERROR);
@@ -310,36 +323,40 @@ int main (int argc, char *argv[])
         sprintf (rationm, "%s/ratiomapndwiexp.hdf", aux_path);
         sprintf (auxnm, "%s/LADS/%s/%s", aux_path, aux_year, aux_infile);
 
-        if (stat (anglehdf, &statbuf) == -1)
+        /* The LUT files aren't needed if the binary LUT file is mapped */
+        if (lut_bin == NULL)
         {
-            sprintf (errmsg, "Could not find anglehdf data file: %s\n  Check "
-                "L8_AUX_DIR environment variable.", anglehdf);
-            error_handler (false, FUNC_NAME, errmsg);
-            exit (ERROR);
-        }
+            if (stat (anglehdf, &statbuf) == -1)
+            {
+                sprintf (errmsg, "Could not find anglehdf data file: %s\n  "
+                    "Check L8_AUX_DIR environment variable.", anglehdf);
+                error_handler (false, FUNC_NAME, errmsg);
+                exit (ERROR);
+            }
 
-        if (stat (intrefnm, &statbuf) == -1)
-        {
-            sprintf (errmsg, "Could not find intrefnm data file: %s\n  Check "
-                "L8_AUX_DIR environment variable.", intrefnm);
-            error_handler (false, FUNC_NAME, errmsg);
-            exit (ERROR);
-        }
+            if (stat (intrefnm, &statbuf) == -1)
+            {
+                sprintf (errmsg, "Could not find intrefnm data file: %s\n  "
+                    "Check L8_AUX_DIR environment variable.", intrefnm);
+                error_handler (false, FUNC_NAME, errmsg);
+                exit (ERROR);
+            }
 
-        if (stat (transmnm, &statbuf) == -1)
-        {
-            sprintf (errmsg, "Could not find transmnm data file: %s\n  Check "
-                "L8_AUX_DIR environment variable.", transmnm);
-            error_handler (false, FUNC_NAME, errmsg);
-            exit (ERROR);
-        }
+            if (stat (transmnm, &statbuf) == -1)
+            {
+                sprintf (errmsg, "Could not find transmnm data file: %s\n  "
+                    "Check L8_AUX_DIR environment variable.", transmnm);
+                error_handler (false, FUNC_NAME, errmsg);
+                exit (ERROR);
+            }
 
-        if (stat (spheranm, &statbuf) == -1)
-        {
-            sprintf (errmsg, "Could not find spheranm data file: %s\n  Check "
-                "L8_AUX_DIR environment variable.", spheranm);
-            error_handler (false, FUNC_NAME, errmsg);
-            exit (ERROR);
+            if (stat (spheranm, &statbuf) == -1)
+            {
+                sprintf (errmsg, "Could not find spheranm data file: %s\n  "
+                    "Check L8_AUX_DIR environment variable.", spheranm);
+                error_handler (false, FUNC_NAME, errmsg);
+                exit (ERROR);
+            }
         }
 
         if (stat (cmgdemnm, &statbuf) == -1)
@@ -507,7 +524,8 @@ int main (int argc, char *argv[])
             "band ...\n");
         retval = compute_sr_refl (input, &xml_metadata, xml_infile, qaband,
             nlines, nsamps, pixsize, sband, xts, xfs, xmus, anglehdf,
-            intrefnm, transmnm, spheranm, cmgdemnm, rationm, auxnm);
+            intrefnm, transmnm, spheranm, cmgdemnm, rationm, auxnm,
+            aux_cache, lut_bin, geogrid_max_err);
         if (retval != SUCCESS)
         {
             sprintf (errmsg, "Error computing surface reflectance");
@@ -527,6 +545,8 @@ int main (int argc, char *argv[])
     /* Free the filename pointers */
     free (xml_infile);
     free (aux_infile);
+    free (aux_cache);
+    free (lut_bin);
 
     /* Free memory for band data */
     free (qaband);
@@ -554,6 +574,9 @@ Date        Programmer       Reason
 7/6/2014    Gail Schmidt     Original Development
 7/31/2014   Gail Schmidt     Added flag to write the TOA and process option
                              for surface reflectance
+11/19/2015                   Added the geogrid_max_err option
+11/20/2015                   Added the aux_cache option
+11/20/2015                   Added the lut_bin option
 
 NOTES:
 ******************************************************************************/
@@ -570,7 +593,9 @@ void usage ()
     printf ("usage: l8_sr "
             "--xml=input_xml_filename "
             "--aux=input_auxiliary_filename "
-            "--process_sr=true:false --write_toa [--verbose]\n");
+            "--process_sr=true:false --write_toa "
+            "[--geogrid_max_err=degrees] [--aux_cache=cache_filename] "
+            "[--lut_bin=binary_lut_filename] [--verbose]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML file to be processed\n");
@@ -586,6 +611,20 @@ void usage ()
             "done.\n");
     printf ("    -write_toa: the intermediate TOA reflectance products "
             "for bands 1-7 are written to the output file\n");
+    printf ("    -geogrid_max_err: error bound (in degrees) of the pixel "
+            "lat/long interpolated from a grid of projected control points "
+            "to look up the auxiliary data.  0 projects every pixel.  "
+            "(default is %g)\n", GEOGRID_MAX_ERROR);
+    printf ("    -aux_cache: shared cache file of the static auxiliary "
+            "grids (DEM and ratios) for batch processing.  If it exists it "
+            "is memory mapped read-only and shared by the concurrent runs, "
+            "otherwise it is created.  It must be removed when the DEM or "
+            "ratio files change.  (default is to read the scene window of "
+            "the static grids)\n");
+    printf ("    -lut_bin: binary LUT file written by convert_l8sr_luts from "
+            "the LUT files in $L8_AUX_DIR/LDCMLUT.  It is memory mapped "
+            "read-only in place of reading and parsing the LUT files.  "
+            "(default is to read the LUT files)\n");
     printf ("    -verbose: should intermediate messages be printed? (default "
             "is false)\n");
 
@@ -10,6 +10,7 @@
 #include "input.h"
 #include "output.h"
 #include "lut_subr.h"
+#include "geogrid.h"
 #include "espa_metadata.h"
 #include "espa_geoloc.h"
 #include "parse_metadata.h"
@@ -29,6 +30,11 @@ int get_args
                                 water vapor and ozone */
     bool *process_sr,     /* O: process the surface reflectance products */
     bool *write_toa,      /* O: write intermediate TOA products flag */
+    float *geogrid_max_err,  /* O: error bound (deg) of the interpolated
+                                   pixel lat/long */
+    char **aux_cache,     /* O: address of the shared cache file of the
+                                static auxiliary grids */
+    char **lut_bin,       /* O: address of the binary LUT file */
     bool *verbose         /* O: verbose flag */
 );
 
@@ -72,7 +78,13 @@ int compute_sr_refl
     char *spheranm,     /* I: spherical albedo filename */
     char *cmgdemnm,     /* I: climate modeling grid DEM filename */
     char *rationm,      /* I: ratio averages filename */
-    char *auxnm         /* I: auxiliary filename for ozone and water vapor */
+    char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
+    char *aux_cache,    /* I: shared cache file of the static auxiliary grids,
+                              NULL if not used */
+    char *lut_bin,      /* I: binary LUT file to map in place of the LUT
+                              files, NULL if not used */
+    float geogrid_max_err  /* I: error bound (deg) of the interpolated pixel
+                                 lat/long; 0 maps every pixel exactly */
 );
 
 int init_sr_refl
@@ -88,6 +100,10 @@ int init_sr_refl
     char *cmgdemnm,     /* I: climate modeling grid DEM filename */
     char *rationm,      /* I: ratio averages filename */
     char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
+    char *aux_cache,    /* I: shared cache file of the static auxiliary grids,
+                              NULL if not used */
+    char *lut_bin,      /* I: binary LUT file to map in place of the LUT
+                              files, NULL if not used */
     float *xtv,         /* O: observation zenith angle (deg) */
     float *xmuv,        /* O: cosine of observation zenith angle */
     float *xfi,         /* O: azimuthal difference between sun and
@@ -107,13 +123,13 @@ int init_sr_refl
     float tts[22],      /* O: sun angle table */
     float **ttv,        /* O: view angle table [20][22] */
     int32 indts[22],    /* O: index for the sun angle table */
-    float ****rolutt,   /* O: intrinsic reflectance table
-                              [NSR_BANDS][7][22][8000] */
-    float ****transt,   /* O: transmission table [NSR_BANDS][7][22][22] */
-    float ***sphalbt,   /* O: spherical albedo table [NSR_BANDS][7][22] */
-    float ***normext,   /* O: aerosol extinction coefficient at the current
+    float **rolutt,     /* O: intrinsic reflectance table
+                              [NSR_BANDS][8000][22][7] */
+    float **transt,     /* O: transmission table [NSR_BANDS][22][22][7] */
+    float **sphalbt,    /* O: spherical albedo table [NSR_BANDS][22][7] */
+    float **normext,    /* O: aerosol extinction coefficient at the current
                               wavelength (normalized at 550nm)
-                              [NSR_BANDS][7][22] */
+                              [NSR_BANDS][22][7] */
     float **nbfic,      /* O: communitive number of azimuth angles [20][22] */
     float **nbfi,       /* O: number of azimuth angles [20][22] */
     int16 **dem,        /* O: CMG DEM data array [DEM_NBLAT][DEM_NBLON] */
@@ -129,7 +145,9 @@ int init_sr_refl
     int16 **slpratiob2, /* O: slope band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
     int16 **slpratiob7, /* O: slope band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
     uint16 **wv,        /* O: water vapor values [CMG_NBLAT][CMG_NBLON] */
-    uint8 **oz          /* O: ozone values [CMG_NBLAT][CMG_NBLON] */
+    uint8 **oz,         /* O: ozone values [CMG_NBLAT][CMG_NBLON] */
+    Aux_window_t *aux_win, /* O: CMG window read from the auxiliary files */
+    Lut_map_t *lut_map     /* O: mapping of the binary LUT file */
 );
 
 #endif
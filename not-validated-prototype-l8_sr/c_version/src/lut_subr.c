@@ -48,6 +48,11 @@ Date         Programmer       Reason
 
 NOTES:
 *****************************************************************************/
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "lut_subr.h"
 #include "hdf.h"
 #include "mfhdf.h"
@@ -87,19 +92,19 @@ int atmcorlamb2
     float pres,                      /* I: surface pressure */
     float tpres[7],                  /* I: surface pressure table */
     float aot550nm[22],              /* I: AOT look-up table */
-    float ****rolutt,                /* I: intrinsic reflectance table
-                                           [NSR_BANDS][7][22][8000] */
-    float ****transt,                /* I: transmission table
-                                           [NSR_BANDS][7][22][22] */
+    float *rolutt,                   /* I: intrinsic reflectance table
+                                           [NSR_BANDS][8000][22][7] */
+    float *transt,                   /* I: transmission table
+                                           [NSR_BANDS][22][22][7] */
     float xtsstep,                   /* I: solar zenith step value */
     float xtsmin,                    /* I: minimum solar zenith value */
     float xtvstep,                   /* I: observation step value */
     float xtvmin,                    /* I: minimum observation value */
-    float ***sphalbt,                /* I: spherical albedo table
-                                           [NSR_BANDS][7][22] */
-    float ***normext,                /* I: aerosol extinction coefficient at
+    float *sphalbt,                  /* I: spherical albedo table
+                                           [NSR_BANDS][22][7] */
+    float *normext,                  /* I: aerosol extinction coefficient at
                                            the current wavelength (normalized
-                                           at 550nm) [NSR_BANDS][7][22] */
+                                           at 550nm) [NSR_BANDS][22][7] */
     float **tsmax,                   /* I: maximum scattering angle table
                                            [20][22] */
     float **tsmin,                   /* I: minimum scattering angle table
@@ -451,10 +456,10 @@ void compsalb
     float pres,         /* I: surface pressure */
     float tpres[7],     /* I: surface pressure table */
     float aot550nm[22], /* I: AOT look-up table */
-    float ***sphalbt,   /* I: spherical albedo table [NSR_BANDS][7][22] */
-    float ***normext,   /* I: aerosol extinction coefficient at the current
+    float *sphalbt,     /* I: spherical albedo table [NSR_BANDS][22][7] */
+    float *normext,     /* I: aerosol extinction coefficient at the current
                               wavelength (normalized at 550nm)
-                              [NSR_BANDS][7][22] */
+                              [NSR_BANDS][22][7] */
     float *satm,        /* O: spherical albedo */
     float *next         /* O: */
 )
@@ -470,24 +475,24 @@ void compsalb
     deltaaot /= aot550nm[iaot2] - aot550nm[iaot1];
 
     /* Compute the spherical albedo */
-    xtiaot1 = sphalbt[iband][ip1][iaot1];
-    xtiaot2 = sphalbt[iband][ip1][iaot2];
+    xtiaot1 = sphalbt[SPHALBT_IDX (iband, iaot1, ip1)];
+    xtiaot2 = sphalbt[SPHALBT_IDX (iband, iaot2, ip1)];
     satm1 = xtiaot1 + (xtiaot2 - xtiaot1) * deltaaot;
 
-    xtiaot1 = sphalbt[iband][ip2][iaot1];
-    xtiaot2 = sphalbt[iband][ip2][iaot2];
+    xtiaot1 = sphalbt[SPHALBT_IDX (iband, iaot1, ip2)];
+    xtiaot2 = sphalbt[SPHALBT_IDX (iband, iaot2, ip2)];
     satm2 = xtiaot1 + (xtiaot2 - xtiaot1) * deltaaot;
 
     dpres = (pres - tpres[ip1]) / (tpres[ip2] - tpres[ip1]);
     *satm = satm1 + (satm2 - satm1) * dpres;
 
     /* Compute the normalized?? spherical albedo */
-    xtiaot1 = normext[iband][ip1][iaot1];
-    xtiaot2 = normext[iband][ip1][iaot2];
+    xtiaot1 = normext[SPHALBT_IDX (iband, iaot1, ip1)];
+    xtiaot2 = normext[SPHALBT_IDX (iband, iaot2, ip1)];
     next1 = xtiaot1 + (xtiaot2 - xtiaot1) * deltaaot;
 
-    xtiaot1 = normext[iband][ip2][iaot1];
-    xtiaot2 = normext[iband][ip2][iaot2];
+    xtiaot1 = normext[SPHALBT_IDX (iband, iaot1, ip2)];
+    xtiaot2 = normext[SPHALBT_IDX (iband, iaot2, ip2)];
     next2 = xtiaot1 + (xtiaot2 - xtiaot1) * deltaaot;
 
     dpres = (pres - tpres[ip1]) / (tpres[ip2] - tpres[ip1]);
@@ -533,8 +538,8 @@ void comptrans
     float pres,         /* I: surface pressure */
     float tpres[7],     /* I: surface pressure table */
     float aot550nm[22], /* I: AOT look-up table */
-    float ****transt,   /* I: transmission table
-                              [NSR_BANDS][7][22][22] */
+    float *transt,      /* I: transmission table
+                              [NSR_BANDS][22][22][7] */
     float xtsstep,      /* I: zenith angle step value */
     float xtsmin,       /* I: minimum zenith angle value */
     float tts[22],      /* I: sun angle table */
@@ -563,21 +568,25 @@ void comptrans
     }
 
     xmts = (xts - tts[its]) * 0.25;
-    xtranst = transt[iband][ip1][iaot1][its];
-    xtiaot1 = xtranst + (transt[iband][ip1][iaot1][its+1] - xtranst) * xmts;
+    xtranst = transt[TRANST_IDX (iband, its, iaot1, ip1)];
+    xtiaot1 = xtranst + (transt[TRANST_IDX (iband, its+1, iaot1, ip1)] -
+        xtranst) * xmts;
 
-    xtranst = transt[iband][ip1][iaot2][its];
-    xtiaot2 = xtranst + (transt[iband][ip1][iaot2][its+1] - xtranst) * xmts;
+    xtranst = transt[TRANST_IDX (iband, its, iaot2, ip1)];
+    xtiaot2 = xtranst + (transt[TRANST_IDX (iband, its+1, iaot2, ip1)] -
+        xtranst) * xmts;
 
     deltaaot = raot550nm - aot550nm[iaot1];
     deltaaot /= aot550nm[iaot2] - aot550nm[iaot1];
     xtts1 = xtiaot1 + (xtiaot2 - xtiaot1) * deltaaot;
 
-    xtranst = transt[iband][ip2][iaot1][its];
-    xtiaot1 = xtranst + (transt[iband][ip2][iaot1][its+1] - xtranst) * xmts;
+    xtranst = transt[TRANST_IDX (iband, its, iaot1, ip2)];
+    xtiaot1 = xtranst + (transt[TRANST_IDX (iband, its+1, iaot1, ip2)] -
+        xtranst) * xmts;
 
-    xtranst = transt[iband][ip2][iaot2][its];
-    xtiaot2 = xtranst + (transt[iband][ip2][iaot2][its+1] - xtranst) * xmts;
+    xtranst = transt[TRANST_IDX (iband, its, iaot2, ip2)];
+    xtiaot2 = xtranst + (transt[TRANST_IDX (iband, its+1, iaot2, ip2)] -
+        xtranst) * xmts;
     xtts2 = xtiaot1 + (xtiaot2 - xtiaot1) * deltaaot;
 
     dpres = (pres - tpres[ip1]) / (tpres[ip2] - tpres[ip1]);
@@ -631,8 +640,8 @@ void comproatm
     float pres,         /* I: surface pressure */
     float tpres[7],     /* I: surface pressure table */
     float aot550nm[22], /* I: AOT look-up table */
-    float ****rolutt,   /* I: intrinsic reflectance table
-                              [NSR_BANDS][7][22][8000] */
+    float *rolutt,      /* I: intrinsic reflectance table
+                              [NSR_BANDS][8000][22][7] */
     float **tsmax,      /* I: maximum scattering angle table [20][22] */
     float **tsmin,      /* I: minimum scattering angle table [20][22] */
     float **nbfic,      /* I: communitive number of azimuth angles [20][22] */
@@ -710,8 +719,8 @@ void comproatm
         }
 
         iindex = indts[its] + nbfic1 - nbfi1 + isca - 1;
-        roinf = rolutt[iband][ip1][iaot1][iindex];
-        rosup = rolutt[iband][ip1][iaot1][iindex+1];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot1, ip1)];
+        rosup = rolutt[ROLUTT_IDX (iband, iindex+1, iaot1, ip1)];
         ro1 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
@@ -719,7 +728,7 @@ void comproatm
         sca1 = xtsmax;
         sca2 = xtsmax;
         iindex = indts[its] + nbfic1 - nbfi1;
-        roinf = rolutt[iband][ip1][iaot1][iindex];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot1, ip1)];
         rosup = roinf;
         ro1 = roinf;
     }
@@ -744,8 +753,8 @@ void comproatm
         }
 
         iindex = indts[its+1] + nbfic2 - nbfi2 + isca - 1;
-        roinf = rolutt[iband][ip1][iaot1][iindex];
-        rosup = rolutt[iband][ip1][iaot1][iindex+1];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot1, ip1)];
+        rosup = rolutt[ROLUTT_IDX (iband, iindex+1, iaot1, ip1)];
         ro2 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
@@ -753,7 +762,7 @@ void comproatm
         sca1 = xtsmax;
         sca2 = xtsmax;
         iindex = indts[its+1] + nbfic2 - nbfi2;
-        roinf = rolutt[iband][ip1][iaot1][iindex];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot1, ip1)];
         rosup = roinf;
         ro2 = roinf;
     }
@@ -778,8 +787,8 @@ void comproatm
         }
 
         iindex = indts[its] + nbfic3 - nbfi3 + isca - 1;
-        roinf = rolutt[iband][ip1][iaot1][iindex];
-        rosup = rolutt[iband][ip1][iaot1][iindex+1];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot1, ip1)];
+        rosup = rolutt[ROLUTT_IDX (iband, iindex+1, iaot1, ip1)];
         ro3 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
@@ -787,7 +796,7 @@ void comproatm
         sca1 = xtsmax;
         sca2 = xtsmax;
         iindex = indts[its] + nbfic3 - nbfi3;
-        roinf = rolutt[iband][ip1][iaot1][iindex];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot1, ip1)];
         rosup = roinf;
         ro3 = roinf;
     }
@@ -810,8 +819,8 @@ void comproatm
     }
 
     iindex = indts[its+1] + nbfic4 - nbfi4 + isca - 1;
-    roinf = rolutt[iband][ip1][iaot1][iindex];
-    rosup = rolutt[iband][ip1][iaot1][iindex+1];
+    roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot1, ip1)];
+    rosup = rolutt[ROLUTT_IDX (iband, iindex+1, iaot1, ip1)];
     ro4 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
 
     /* Note: t and u are used elsewhere through this function */
@@ -841,8 +850,8 @@ void comproatm
         }
 
         iindex = indts[its] + nbfic1 - nbfi1 + isca - 1;
-        roinf = rolutt[iband][ip1][iaot2][iindex];
-        rosup = rolutt[iband][ip1][iaot2][iindex+1];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot2, ip1)];
+        rosup = rolutt[ROLUTT_IDX (iband, iindex+1, iaot2, ip1)];
         ro1 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
@@ -850,7 +859,7 @@ void comproatm
         sca1 = xtsmax;
         sca2 = xtsmax;
         iindex = indts[its] + nbfic1 - nbfi1;
-        roinf = rolutt[iband][ip1][iaot2][iindex];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot2, ip1)];
         rosup = roinf;
         ro1 = roinf;
     }
@@ -875,8 +884,8 @@ void comproatm
         }
 
         iindex = indts[its+1] + nbfic2 - nbfi2 + isca - 1;
-        roinf = rolutt[iband][ip1][iaot2][iindex];
-        rosup = rolutt[iband][ip1][iaot2][iindex+1];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot2, ip1)];
+        rosup = rolutt[ROLUTT_IDX (iband, iindex+1, iaot2, ip1)];
         ro2 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
@@ -884,7 +893,7 @@ void comproatm
         sca1 = xtsmax;
         sca2 = xtsmax;
         iindex = indts[its+1] + nbfic2 - nbfi2;
-        roinf = rolutt[iband][ip1][iaot2][iindex];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot2, ip1)];
         rosup = roinf;
         ro2 = roinf;
     }
@@ -909,8 +918,8 @@ void comproatm
         }
 
         iindex = indts[its] + nbfic3 - nbfi3 + isca - 1;
-        roinf = rolutt[iband][ip1][iaot2][iindex];
-        rosup = rolutt[iband][ip1][iaot2][iindex+1];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot2, ip1)];
+        rosup = rolutt[ROLUTT_IDX (iband, iindex+1, iaot2, ip1)];
         ro3 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
@@ -918,7 +927,7 @@ void comproatm
         sca1 = xtsmax;
         sca2 = xtsmax;
         iindex = indts[its] + nbfic3 - nbfi3;
-        roinf = rolutt[iband][ip1][iaot2][iindex];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot2, ip1)];
         rosup = roinf;
         ro3 = roinf;
     }
@@ -941,8 +950,8 @@ void comproatm
     }
 
     iindex = indts[its+1] + nbfic4 - nbfi4 + isca - 1;
-    roinf = rolutt[iband][ip1][iaot2][iindex];
-    rosup = rolutt[iband][ip1][iaot2][iindex+1];
+    roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot2, ip1)];
+    rosup = rolutt[ROLUTT_IDX (iband, iindex+1, iaot2, ip1)];
     ro4 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
 
     roiaot2 = ro1 * t * u + ro2 * u * (1.0 - t) + ro3 * (1.0 - u) * t +
@@ -976,8 +985,8 @@ void comproatm
         }
 
         iindex = indts[its] + nbfic1 - nbfi1 + isca - 1;
-        roinf = rolutt[iband][ip2][iaot1][iindex];
-        rosup = rolutt[iband][ip2][iaot1][iindex+1];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot1, ip2)];
+        rosup = rolutt[ROLUTT_IDX (iband, iindex+1, iaot1, ip2)];
         ro1 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
@@ -985,7 +994,7 @@ void comproatm
         sca1 = xtsmax;
         sca2 = xtsmax;
         iindex = indts[its] + nbfic1 - nbfi1;
-        roinf = rolutt[iband][ip2][iaot1][iindex];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot1, ip2)];
         rosup = roinf;
         ro1 = roinf;
     }
@@ -1010,8 +1019,8 @@ void comproatm
         }
 
         iindex = indts[its+1] + nbfic2 - nbfi2 + isca - 1;
-        roinf = rolutt[iband][ip2][iaot1][iindex];
-        rosup = rolutt[iband][ip2][iaot1][iindex+1];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot1, ip2)];
+        rosup = rolutt[ROLUTT_IDX (iband, iindex+1, iaot1, ip2)];
         ro2 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
@@ -1019,7 +1028,7 @@ void comproatm
         sca1 = xtsmax;
         sca2 = xtsmax;
         iindex = indts[its+1] + nbfic2 - nbfi2;
-        roinf = rolutt[iband][ip2][iaot1][iindex];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot1, ip2)];
         rosup = roinf;
         ro2 = roinf;
     }
@@ -1044,8 +1053,8 @@ void comproatm
         }
 
         iindex = indts[its] + nbfic3 - nbfi3 + isca - 1;
-        roinf = rolutt[iband][ip2][iaot1][iindex];
-        rosup = rolutt[iband][ip2][iaot1][iindex+1];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot1, ip2)];
+        rosup = rolutt[ROLUTT_IDX (iband, iindex+1, iaot1, ip2)];
         ro3 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
@@ -1053,7 +1062,7 @@ void comproatm
         sca1 = xtsmax;
         sca2 = xtsmax;
         iindex = indts[its] + nbfic3 - nbfi3;
-        roinf = rolutt[iband][ip2][iaot1][iindex];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot1, ip2)];
         rosup = roinf;
         ro3 = roinf;
     }
@@ -1076,8 +1085,8 @@ void comproatm
     }
 
     iindex = indts[its+1] + nbfic4 - nbfi4 + isca - 1;
-    roinf = rolutt[iband][ip2][iaot1][iindex];
-    rosup = rolutt[iband][ip2][iaot1][iindex+1];
+    roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot1, ip2)];
+    rosup = rolutt[ROLUTT_IDX (iband, iindex+1, iaot1, ip2)];
     ro4 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
 
     roiaot1 = ro1 * t * u + ro2 * u * (1.0 - t) + ro3 * (1.0 - u) * t +
@@ -1104,8 +1113,8 @@ void comproatm
         }
 
         iindex = indts[its] + nbfic1 - nbfi1 + isca - 1;
-        roinf = rolutt[iband][ip2][iaot2][iindex];
-        rosup = rolutt[iband][ip2][iaot2][iindex+1];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot2, ip2)];
+        rosup = rolutt[ROLUTT_IDX (iband, iindex+1, iaot2, ip2)];
         ro1 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
@@ -1113,7 +1122,7 @@ void comproatm
         sca1 = xtsmax;
         sca2 = xtsmax;
         iindex = indts[its] + nbfic1 - nbfi1;
-        roinf = rolutt[iband][ip2][iaot2][iindex];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot2, ip2)];
         rosup = roinf;
         ro1 = roinf;
     }
@@ -1138,8 +1147,8 @@ void comproatm
         }
 
         iindex = indts[its+1] + nbfic2 - nbfi2 + isca - 1;
-        roinf = rolutt[iband][ip2][iaot2][iindex];
-        rosup = rolutt[iband][ip2][iaot2][iindex+1];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot2, ip2)];
+        rosup = rolutt[ROLUTT_IDX (iband, iindex+1, iaot2, ip2)];
         ro2 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
@@ -1147,7 +1156,7 @@ void comproatm
         sca1 = xtsmax;
         sca2 = xtsmax;
         iindex = indts[its+1] + nbfic2 - nbfi2;
-        roinf = rolutt[iband][ip2][iaot2][iindex];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot2, ip2)];
         rosup = roinf;
         ro2 = roinf;
     }
@@ -1172,8 +1181,8 @@ void comproatm
         }
 
         iindex = indts[its] + nbfic3 - nbfi3 + isca - 1;
-        roinf = rolutt[iband][ip2][iaot2][iindex];
-        rosup = rolutt[iband][ip2][iaot2][iindex+1];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot2, ip2)];
+        rosup = rolutt[ROLUTT_IDX (iband, iindex+1, iaot2, ip2)];
         ro3 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
@@ -1181,7 +1190,7 @@ void comproatm
         sca1 = xtsmax;
         sca2 = xtsmax;
         iindex = indts[its] + nbfic3 - nbfi3;
-        roinf = rolutt[iband][ip2][iaot2][iindex];
+        roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot2, ip2)];
         rosup = roinf;
         ro3 = roinf;
     }
@@ -1204,8 +1213,8 @@ void comproatm
     }
 
     iindex = indts[its+1] + nbfic4 - nbfi4 + isca - 1;
-    roinf = rolutt[iband][ip2][iaot2][iindex];
-    rosup = rolutt[iband][ip2][iaot2][iindex+1];
+    roinf = rolutt[ROLUTT_IDX (iband, iindex, iaot2, ip2)];
+    rosup = rolutt[ROLUTT_IDX (iband, iindex+1, iaot2, ip2)];
     ro4 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
 
     roiaot2 = ro1 * t * u + ro2 * u * (1.0 - t) + ro3 * (1.0 - u) * t +
@@ -1245,8 +1254,17 @@ Date         Programmer       Reason
                               hard-coded array in the main function.  Ditto for
                               the gaseous transmission coefficient file.
 8/14/2014    Gail Schmidt     Updated for v1.3 delivered by Eric Vermote
+11/20/2015                    The rolutt, transt, sphalbt and normext tables
+                              are each stored in one contiguous array
+11/20/2015                    The rolutt, transt, sphalbt and normext tables
+                              are flat arrays with the pressure index varying
+                              fastest, then the AOT index (see ROLUTT_IDX)
 
 NOTES:
+  1. rolutt, transt, sphalbt and normext are allocated here and are freed by
+     free_lut.  The other tables are allocated by memory_allocation_lut.
+  2. The intrinsic reflectance is stored in HDF file order, 8000 x 22 x 7 per
+     band, so it is read directly into rolutt.
 ******************************************************************************/
 int readluts
 (
@@ -1258,15 +1276,15 @@ int readluts
                                       [20][22] */
     float **nbfi,               /* O: number of azimuth angles [20][22] */
     int32 indts[22],            /* O: */
-    float ****rolutt,           /* O: intrinsic reflectance table
-                                      [NSR_BANDS][7][22][8000] */
-    float ****transt,           /* O: transmission table
-                                      [NSR_BANDS][7][22][22] */
-    float ***sphalbt,           /* O: spherical albedo table
-                                      [NSR_BANDS][7][22] */
-    float ***normext,           /* O: aerosol extinction coefficient at the
+    float **rolutt,             /* O: intrinsic reflectance table
+                                      [NSR_BANDS][8000][22][7] */
+    float **transt,             /* O: transmission table
+                                      [NSR_BANDS][22][22][7] */
+    float **sphalbt,            /* O: spherical albedo table
+                                      [NSR_BANDS][22][7] */
+    float **normext,            /* O: aerosol extinction coefficient at the
                                       current wavelength (normalized at 550nm)
-                                      [NSR_BANDS][7][22] */
+                                      [NSR_BANDS][22][7] */
     float xtsstep,              /* I: solar zenith step value */
     float xtsmin,               /* I: minimum solar zenith value */
     char anglehdf[STR_SIZE],    /* I: angle HDF filename */
@@ -1282,14 +1300,10 @@ int readluts
     int iband;              /* band looping variable */
     int iaot;               /* aerosol optical thickness (AOT) index */
     int ipres;              /* looping variable for pressure */
-    int itau;               /* looping variable for molecular optical thick */
-    int ival;               /* looping variable for LUT */
     int status;             /* return status of the HDF function */
     int start[3];           /* starting point to read SDS data */
     int edges[3];           /* number of values to read in SDS data */
     char fname[STR_SIZE];   /* filename to be read */
-    float *rolut = NULL;    /* intrinsic reflectance read from HDF file
-                               [8000*22*7] */
     float ttsr[22];        /* GAIL - should this be 21 instead?? */
     float xx;               /* temporary float values, not used */
     int sd_id;              /* file ID for the HDF file */
@@ -1297,6 +1311,19 @@ int readluts
     int sds_index;          /* index for the current SDS */
     FILE *fp = NULL;        /* file pointer for reading ascii files */
 
+    /* Allocate the rolutt, transt, sphalbt and normext tables */
+    *rolutt = calloc (ROLUTT_SIZE, sizeof (float));
+    *transt = calloc (TRANST_SIZE, sizeof (float));
+    *sphalbt = calloc (SPHALBT_SIZE, sizeof (float));
+    *normext = calloc (SPHALBT_SIZE, sizeof (float));
+    if (*rolutt == NULL || *transt == NULL || *sphalbt == NULL ||
+        *normext == NULL)
+    {
+        sprintf (errmsg, "Error allocating memory for the LUTs");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
     /* Initialize some variables */
     for (i = 0; i < 20; i++)
     {
@@ -1609,15 +1636,6 @@ int readluts
         return (ERROR);
     }
 
-    /* rolutt[8000][22][7] */
-    rolut = calloc (8000*22*7, sizeof (float));
-    if (rolut == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for rolut");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
     /* Begin read look up table (intrinsic reflectance) */
     /* Open as HDF file for reading */
     sd_id = SDstart (intrefnm, DFACC_RDONLY);
@@ -1658,8 +1676,10 @@ int readluts
             return (ERROR);
         }
     
-        /* Read the whole band, as-is, then rearrange the order later */
-        status = SDreaddata (sds_id, start, NULL, edges, rolut);
+        /* Read the whole band, as-is, since the HDF file order (8000 x 22 x
+           7) is the rolutt order */
+        status = SDreaddata (sds_id, start, NULL, edges,
+            *rolutt + ROLUTT_IDX (iband, 0, 0, 0));
         if (status == -1)
         {
             sprintf (errmsg, "Reading data from the %s SDS", fname);
@@ -1676,21 +1696,8 @@ int readluts
             return (ERROR);
         }
 
-        /* Flip the look-up table value to allow the index values to be in
-           the fastest-changing dimension and the band values to be in the
-           slowest-changing dimension.  This allows the access for the data
-           in the application to be most efficient.  rolut is read from the
-           HDF file (per band) as 8000 x 22 x 7. */
-        for (ipres = 0; ipres < 7; ipres++)
-            for (itau = 0; itau < 22; itau++)
-                for (ival = 0; ival < 8000; ival++)
-                    rolutt[iband][ipres][itau][ival] =
-                        rolut[ival*22*7 + itau*7 + ipres];
     }  /* for iband */
 
-    /* Free the temporary rolut array */
-    free (rolut);
-
     /* Close the HDF file */
     status = SDend (sd_id);
     if (status == -1)
@@ -1762,7 +1769,8 @@ int readluts
                    for reading. */
                 for (iaot = 0; iaot < 22; iaot++)
                 {
-                    if (fscanf (fp, "%f", &transt[iband][ipres][iaot][i]) != 1)
+                    if (fscanf (fp, "%f",
+                        &(*transt)[TRANST_IDX (iband, i, iaot, ipres)]) != 1)
                     {
                         sprintf (errmsg, "Reading transmission values from "
                             "transmission coefficient file: %s", transmnm);
@@ -1825,8 +1833,9 @@ int readluts
             /* 22 lines of spherical albedo information */
             for (iaot = 0; iaot < 22; iaot++)
             {
-                if (fscanf (fp, "%f %f %f\n", &xx, &sphalbt[iband][ipres][iaot],
-                    &normext[iband][ipres][iaot]) != 3)
+                if (fscanf (fp, "%f %f %f\n", &xx,
+                    &(*sphalbt)[SPHALBT_IDX (iband, iaot, ipres)],
+                    &(*normext)[SPHALBT_IDX (iband, iaot, ipres)]) != 3)
                 {
                     sprintf (errmsg, "Reading spherical albedo values from "
                         "spherical albedo coefficient file: %s", spheranm);
@@ -1845,6 +1854,364 @@ int readluts
 }
 
 
+/* Sizes and offsets of the tables of the binary LUT file; the header takes
+   the first LUT_BIN_ALIGN bytes */
+static void lut_bin_layout
+(
+    Lut_bin_header_t *hdr   /* O: header of the binary LUT file */
+)
+{
+    int t;                  /* looping variable */
+
+    hdr->size[LUT_TSMAX] = 20 * 22 * sizeof (float);
+    hdr->size[LUT_TSMIN] = 20 * 22 * sizeof (float);
+    hdr->size[LUT_TTV] = 20 * 22 * sizeof (float);
+    hdr->size[LUT_NBFI] = 20 * 22 * sizeof (float);
+    hdr->size[LUT_NBFIC] = 20 * 22 * sizeof (float);
+    hdr->size[LUT_TTS] = 22 * sizeof (float);
+    hdr->size[LUT_INDTS] = 22 * sizeof (int32);
+    hdr->size[LUT_ROLUTT] = (uint64_t) ROLUTT_SIZE * sizeof (float);
+    hdr->size[LUT_TRANST] = TRANST_SIZE * sizeof (float);
+    hdr->size[LUT_SPHALBT] = SPHALBT_SIZE * sizeof (float);
+    hdr->size[LUT_NORMEXT] = SPHALBT_SIZE * sizeof (float);
+
+    hdr->offset[0] = LUT_BIN_ALIGN;
+    for (t = 1; t < LUT_NTABLES; t++)
+        hdr->offset[t] = (hdr->offset[t-1] + hdr->size[t-1] +
+            LUT_BIN_ALIGN - 1) / LUT_BIN_ALIGN * LUT_BIN_ALIGN;
+    hdr->file_size = hdr->offset[LUT_NTABLES-1] + hdr->size[LUT_NTABLES-1];
+}
+
+
+/* Fletcher-64 checksum of the tables of the binary LUT file */
+static uint64_t lut_bin_checksum
+(
+    const char *lut,              /* I: binary LUT file contents */
+    const Lut_bin_header_t *hdr   /* I: header of the binary LUT file */
+)
+{
+    int t;                  /* looping variable */
+    size_t i, n;            /* current and number of 32-bit words */
+    const uint32_t *data;   /* data of the current table */
+    uint64_t sum1 = 0;      /* sum of the words */
+    uint64_t sum2 = 0;      /* sum of the sums */
+
+    for (t = 0; t < LUT_NTABLES; t++)
+    {
+        data = (const uint32_t *) (lut + hdr->offset[t]);
+        n = hdr->size[t] / sizeof (uint32_t);
+        for (i = 0; i < n; i++)
+        {
+            sum1 = (sum1 + data[i]) % 0xffffffff;
+            sum2 = (sum2 + sum1) % 0xffffffff;
+        }
+    }
+    return ((sum2 << 32) | sum1);
+}
+
+
+/******************************************************************************
+MODULE:  write_lut_bin
+
+PURPOSE:  Writes the look-up tables loaded by readluts as a binary LUT file,
+which map_lut_bin maps back without any parsing.
+
+RETURN VALUE:
+Type = int
+Value          Description
+-----          -----------
+ERROR          Error occurred writing the binary LUT file
+SUCCESS        Successful completion
+
+HISTORY:
+Date         Programmer       Reason
+---------    ---------------  -------------------------------------
+11/20/2015                    Original development
+
+NOTES:
+  1. The file is written to a temporary file renamed at the end, so that
+     concurrent runs never map a partial file.
+******************************************************************************/
+int write_lut_bin
+(
+    char *lut_bin,              /* I: binary LUT filename */
+    float xtsstep,              /* I: solar zenith step value */
+    float xtsmin,               /* I: minimum solar zenith value */
+    float **tsmax,              /* I: maximum scattering angle table [20][22] */
+    float **tsmin,              /* I: minimum scattering angle table [20][22] */
+    float **ttv,                /* I: view angle table [20][22] */
+    float tts[22],              /* I: sun angle table */
+    float **nbfic,              /* I: communitive number of azimuth angles
+                                      [20][22] */
+    float **nbfi,               /* I: number of azimuth angles [20][22] */
+    int32 indts[22],            /* I: index for the sun angle table */
+    float *rolutt,              /* I: intrinsic reflectance table
+                                      [NSR_BANDS][8000][22][7] */
+    float *transt,              /* I: transmission table
+                                      [NSR_BANDS][22][22][7] */
+    float *sphalbt,             /* I: spherical albedo table
+                                      [NSR_BANDS][22][7] */
+    float *normext              /* I: aerosol extinction coefficient
+                                      [NSR_BANDS][22][7] */
+)
+{
+    char FUNC_NAME[] = "write_lut_bin";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char tmpname[STR_SIZE];  /* temporary binary LUT filename */
+    int i;                   /* looping variable */
+    size_t nw;               /* number of bytes written */
+    char *lut = NULL;        /* binary LUT file contents */
+    Lut_bin_header_t hdr;    /* header of the binary LUT file */
+    FILE *fptr = NULL;       /* file pointer of the binary LUT file */
+
+    /* Set up the header */
+    memset (&hdr, 0, sizeof (hdr));
+    strcpy (hdr.magic, LUT_BIN_MAGIC);
+    hdr.version = LUT_BIN_VERSION;
+    hdr.byte_order = LUT_BIN_BYTE_ORDER;
+    hdr.dims[0] = NSR_BANDS;
+    hdr.dims[1] = LUT_NPRES;
+    hdr.dims[2] = LUT_NAOT;
+    hdr.dims[3] = LUT_NSCA;
+    hdr.xtsstep = xtsstep;
+    hdr.xtsmin = xtsmin;
+    lut_bin_layout (&hdr);
+
+    /* Lay the tables out in the file contents */
+    lut = calloc (hdr.file_size, 1);
+    if (lut == NULL)
+    {
+        sprintf (errmsg, "Error allocating memory for the binary LUT");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (i = 0; i < 20; i++)
+    {
+        memcpy (lut + hdr.offset[LUT_TSMAX] + i * 22 * sizeof (float),
+            tsmax[i], 22 * sizeof (float));
+        memcpy (lut + hdr.offset[LUT_TSMIN] + i * 22 * sizeof (float),
+            tsmin[i], 22 * sizeof (float));
+        memcpy (lut + hdr.offset[LUT_TTV] + i * 22 * sizeof (float),
+            ttv[i], 22 * sizeof (float));
+        memcpy (lut + hdr.offset[LUT_NBFI] + i * 22 * sizeof (float),
+            nbfi[i], 22 * sizeof (float));
+        memcpy (lut + hdr.offset[LUT_NBFIC] + i * 22 * sizeof (float),
+            nbfic[i], 22 * sizeof (float));
+    }
+    memcpy (lut + hdr.offset[LUT_TTS], tts, hdr.size[LUT_TTS]);
+    memcpy (lut + hdr.offset[LUT_INDTS], indts, hdr.size[LUT_INDTS]);
+    memcpy (lut + hdr.offset[LUT_ROLUTT], rolutt, hdr.size[LUT_ROLUTT]);
+    memcpy (lut + hdr.offset[LUT_TRANST], transt, hdr.size[LUT_TRANST]);
+    memcpy (lut + hdr.offset[LUT_SPHALBT], sphalbt, hdr.size[LUT_SPHALBT]);
+    memcpy (lut + hdr.offset[LUT_NORMEXT], normext, hdr.size[LUT_NORMEXT]);
+    hdr.checksum = lut_bin_checksum (lut, &hdr);
+    memcpy (lut, &hdr, sizeof (hdr));
+
+    /* Write the file */
+    snprintf (tmpname, sizeof (tmpname), "%s.%d", lut_bin, (int) getpid ());
+    fptr = fopen (tmpname, "wb");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Unable to create the binary LUT file %s", tmpname);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (lut);
+        return (ERROR);
+    }
+    nw = fwrite (lut, 1, hdr.file_size, fptr);
+    free (lut);
+    if (fclose (fptr) != 0 || nw != hdr.file_size ||
+        rename (tmpname, lut_bin) != 0)
+    {
+        sprintf (errmsg, "Writing the binary LUT file %s", lut_bin);
+        error_handler (true, FUNC_NAME, errmsg);
+        remove (tmpname);
+        return (ERROR);
+    }
+
+    /* Successful completion */
+    return (SUCCESS);
+}
+
+
+/* Unmaps the binary LUT file of lut_map, on a validation failure */
+static void unmap_lut_bin
+(
+    Lut_map_t *lut_map   /* I/O: mapping of the binary LUT file */
+)
+{
+    munmap (lut_map->map, lut_map->map_len);
+    lut_map->map = NULL;
+    lut_map->map_len = 0;
+}
+
+
+/******************************************************************************
+MODULE:  map_lut_bin
+
+PURPOSE:  Maps a binary LUT file written by write_lut_bin, in place of
+readluts.
+
+RETURN VALUE:
+Type = int
+Value          Description
+-----          -----------
+ERROR          Error occurred mapping or validating the binary LUT file
+SUCCESS        Successful completion
+
+HISTORY:
+Date         Programmer       Reason
+---------    ---------------  -------------------------------------
+11/20/2015                    Original development
+
+NOTES:
+  1. The file is mapped read-only and shared, so concurrent runs share its
+     pages.  rolutt, transt, sphalbt and normext point into the mapping; the
+     small angle tables are copied.
+  2. The header and the table layout are validated, as well as the solar
+     zenith step and minimum the tts table was built with.
+  3. The checksum of the tables is only verified if verify is set
+     (convert_l8sr_luts), since it reads every page of the file and l8_sr
+     only needs the pages its scene looks up.
+  4. free_lut unmaps the file.  It's unmapped here if it isn't valid.
+******************************************************************************/
+int map_lut_bin
+(
+    char *lut_bin,              /* I: binary LUT filename */
+    float xtsstep,              /* I: solar zenith step value */
+    float xtsmin,               /* I: minimum solar zenith value */
+    float **tsmax,              /* O: maximum scattering angle table [20][22] */
+    float **tsmin,              /* O: minimum scattering angle table [20][22] */
+    float **ttv,                /* O: view angle table [20][22] */
+    float tts[22],              /* O: sun angle table */
+    float **nbfic,              /* O: communitive number of azimuth angles
+                                      [20][22] */
+    float **nbfi,               /* O: number of azimuth angles [20][22] */
+    int32 indts[22],            /* O: index for the sun angle table */
+    float **rolutt,             /* O: intrinsic reflectance table
+                                      [NSR_BANDS][8000][22][7] */
+    float **transt,             /* O: transmission table
+                                      [NSR_BANDS][22][22][7] */
+    float **sphalbt,            /* O: spherical albedo table
+                                      [NSR_BANDS][22][7] */
+    float **normext,            /* O: aerosol extinction coefficient
+                                      [NSR_BANDS][22][7] */
+    bool verify,                /* I: verify the checksum of the tables */
+    Lut_map_t *lut_map          /* O: mapping of the binary LUT file */
+)
+{
+    char FUNC_NAME[] = "map_lut_bin";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable */
+    int t;                   /* looping variable for the tables */
+    int fd;                  /* file descriptor of the binary LUT file */
+    struct stat statbuf;     /* buffer for the file stat function */
+    char *lut = NULL;        /* mapping of the binary LUT file */
+    Lut_bin_header_t hdr;    /* header of the binary LUT file */
+    Lut_bin_header_t layout; /* expected layout of the tables */
+
+    lut_map->map = NULL;
+    lut_map->map_len = 0;
+
+    /* Map the file */
+    fd = open (lut_bin, O_RDONLY);
+    if (fd < 0)
+    {
+        sprintf (errmsg, "Unable to open the binary LUT file %s", lut_bin);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (fstat (fd, &statbuf) != 0 ||
+        (size_t) statbuf.st_size < sizeof (Lut_bin_header_t))
+    {
+        sprintf (errmsg, "Invalid binary LUT file %s", lut_bin);
+        error_handler (true, FUNC_NAME, errmsg);
+        close (fd);
+        return (ERROR);
+    }
+    lut = mmap (NULL, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (lut == MAP_FAILED)
+    {
+        sprintf (errmsg, "Unable to map the binary LUT file %s", lut_bin);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    lut_map->map = lut;
+    lut_map->map_len = statbuf.st_size;
+
+    /* Validate the header against the layout this application expects */
+    memcpy (&hdr, lut, sizeof (hdr));
+    lut_bin_layout (&layout);
+    if (strncmp (hdr.magic, LUT_BIN_MAGIC, sizeof (hdr.magic)) ||
+        hdr.version != LUT_BIN_VERSION ||
+        hdr.byte_order != LUT_BIN_BYTE_ORDER ||
+        hdr.dims[0] != NSR_BANDS || hdr.dims[1] != LUT_NPRES ||
+        hdr.dims[2] != LUT_NAOT || hdr.dims[3] != LUT_NSCA ||
+        hdr.file_size != (uint64_t) statbuf.st_size ||
+        hdr.file_size != layout.file_size)
+    {
+        sprintf (errmsg, "Invalid or incompatible binary LUT file %s; "
+            "recreate it with convert_l8sr_luts", lut_bin);
+        error_handler (true, FUNC_NAME, errmsg);
+        unmap_lut_bin (lut_map);
+        return (ERROR);
+    }
+    for (t = 0; t < LUT_NTABLES; t++)
+    {
+        if (hdr.offset[t] != layout.offset[t] || hdr.size[t] != layout.size[t])
+        {
+            sprintf (errmsg, "Invalid table layout in the binary LUT file %s",
+                lut_bin);
+            error_handler (true, FUNC_NAME, errmsg);
+            unmap_lut_bin (lut_map);
+            return (ERROR);
+        }
+    }
+    if (hdr.xtsstep != xtsstep || hdr.xtsmin != xtsmin)
+    {
+        sprintf (errmsg, "The binary LUT file %s has a sun angle table for a "
+            "solar zenith step of %f and minimum of %f vs. %f and %f", lut_bin,
+            hdr.xtsstep, hdr.xtsmin, xtsstep, xtsmin);
+        error_handler (true, FUNC_NAME, errmsg);
+        unmap_lut_bin (lut_map);
+        return (ERROR);
+    }
+    if (verify && lut_bin_checksum (lut, &hdr) != hdr.checksum)
+    {
+        sprintf (errmsg, "Checksum mismatch in the binary LUT file %s",
+            lut_bin);
+        error_handler (true, FUNC_NAME, errmsg);
+        unmap_lut_bin (lut_map);
+        return (ERROR);
+    }
+
+    /* Copy the small angle tables and point the large tables into the
+       mapping */
+    for (i = 0; i < 20; i++)
+    {
+        memcpy (tsmax[i], lut + hdr.offset[LUT_TSMAX] + i * 22 *
+            sizeof (float), 22 * sizeof (float));
+        memcpy (tsmin[i], lut + hdr.offset[LUT_TSMIN] + i * 22 *
+            sizeof (float), 22 * sizeof (float));
+        memcpy (ttv[i], lut + hdr.offset[LUT_TTV] + i * 22 * sizeof (float),
+            22 * sizeof (float));
+        memcpy (nbfi[i], lut + hdr.offset[LUT_NBFI] + i * 22 *
+            sizeof (float), 22 * sizeof (float));
+        memcpy (nbfic[i], lut + hdr.offset[LUT_NBFIC] + i * 22 *
+            sizeof (float), 22 * sizeof (float));
+    }
+    memcpy (tts, lut + hdr.offset[LUT_TTS], hdr.size[LUT_TTS]);
+    memcpy (indts, lut + hdr.offset[LUT_INDTS], hdr.size[LUT_INDTS]);
+    *rolutt = (float *) (lut + hdr.offset[LUT_ROLUTT]);
+    *transt = (float *) (lut + hdr.offset[LUT_TRANST]);
+    *sphalbt = (float *) (lut + hdr.offset[LUT_SPHALBT]);
+    *normext = (float *) (lut + hdr.offset[LUT_NORMEXT]);
+
+    /* Successful completion */
+    return (SUCCESS);
+}
+
+
 /******************************************************************************
 MODULE:  memory_allocation_main
 
@@ -1937,6 +2304,13 @@ Date         Programmer       Reason
 12/9/2014    Gail Schmidt     Removed the uband allocation since it's handled
                               in a different function (compute_refl)
 4/9/2015     Gail Schmidt     Added support for land/water mask
+11/20/2015                    Only the row pointers of the CMG grids are
+                              allocated; read_auxiliary_files allocates the
+                              rows of the scene window
+11/20/2015                    Moved the look-up tables to
+                              memory_allocation_lut
+11/20/2015                    The rolutt, transt, sphalbt and normext tables
+                              are allocated by readluts
 
 NOTES:
   1. Memory is allocated for each of the input variables, so it is up to the
@@ -1981,14 +2355,6 @@ int memory_allocation_sr
     int16 ***slpratiob7, /* O: slope band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
     uint16 ***wv,        /* O: water vapor values [CMG_NBLAT][CMG_NBLON] */
     uint8 ***oz,         /* O: ozone values [CMG_NBLAT][CMG_NBLON] */
-    float *****rolutt,   /* O: intrinsic reflectance table
-                               [NSR_BANDS][7][22][8000] */
-    float *****transt,   /* O: transmission table
-                               [NSR_BANDS][7][22][22] */
-    float ****sphalbt,   /* O: spherical albedo table [NSR_BANDS][7][22] */
-    float ****normext,   /* O: aerosol extinction coefficient at the current
-                               wavelength (normalized at 550nm)
-                               [NSR_BANDS][7][22] */
     float ***tsmax,      /* O: maximum scattering angle table [20][22] */
     float ***tsmin,      /* O: minimum scattering angle table [20][22] */
     float ***nbfic,      /* O: communitive number of azimuth angles [20][22] */
@@ -1998,7 +2364,6 @@ int memory_allocation_sr
 {
     char FUNC_NAME[] = "memory_allocation_sr"; /* function name */
     char errmsg[STR_SIZE];   /* error message */
-    int i, j, k;             /* looping variables */
 
     *aerob1 = calloc (nlines*nsamps, sizeof (int16));
     if (*aerob1 == NULL)
@@ -2096,7 +2461,8 @@ int memory_allocation_sr
         return (ERROR);
     }
 
-    /* Allocate memory for all the climate modeling grid files */
+    /* Allocate the row pointers for all the climate modeling grid files; the
+       rows are allocated (or mapped) by read_auxiliary_files */
     *dem = calloc (DEM_NBLAT, sizeof (int16*));
     if (*dem == NULL)
     {
@@ -2104,17 +2470,6 @@ int memory_allocation_sr
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-    for (i = 0; i < DEM_NBLAT; i++)
-    {
-        (*dem)[i] = calloc (DEM_NBLON, sizeof (int16));
-        if ((*dem)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for the DEM");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }
-
     *andwi = calloc (RATIO_NBLAT, sizeof (int16*));
     if (*andwi == NULL)
     {
@@ -2203,97 +2558,6 @@ int memory_allocation_sr
         return (ERROR);
     }
 
-    for (i = 0; i < RATIO_NBLAT; i++)
-    {
-        (*andwi)[i] = calloc (RATIO_NBLON, sizeof (int16));
-        if ((*andwi)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for the andwi");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        (*sndwi)[i] = calloc (RATIO_NBLON, sizeof (int16));
-        if ((*sndwi)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for the sndwi");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        (*ratiob1)[i] = calloc (RATIO_NBLON, sizeof (int16));
-        if ((*ratiob1)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for the ratiob1");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        (*ratiob2)[i] = calloc (RATIO_NBLON, sizeof (int16));
-        if ((*ratiob2)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for the ratiob2");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        (*ratiob7)[i] = calloc (RATIO_NBLON, sizeof (int16));
-        if ((*ratiob7)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for the ratiob7");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        (*intratiob1)[i] = calloc (RATIO_NBLON, sizeof (int16));
-        if ((*intratiob1)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for the intratiob1");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        (*intratiob2)[i] = calloc (RATIO_NBLON, sizeof (int16));
-        if ((*intratiob2)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for the intratiob2");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        (*intratiob7)[i] = calloc (RATIO_NBLON, sizeof (int16));
-        if ((*intratiob7)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for the intratiob7");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        (*slpratiob1)[i] = calloc (RATIO_NBLON, sizeof (int16));
-        if ((*slpratiob1)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for the slpratiob1");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        (*slpratiob2)[i] = calloc (RATIO_NBLON, sizeof (int16));
-        if ((*slpratiob2)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for the slpratiob2");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        (*slpratiob7)[i] = calloc (RATIO_NBLON, sizeof (int16));
-        if ((*slpratiob7)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for the slpratiob7");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }
-
     *wv = calloc (CMG_NBLAT, sizeof (int16*));
     if (*wv == NULL)
     {
@@ -2310,147 +2574,54 @@ int memory_allocation_sr
         return (ERROR);
     }
 
-    for (i = 0; i < CMG_NBLAT; i++)
-    {
-        (*wv)[i] = calloc (CMG_NBLON, sizeof (int16));
-        if ((*wv)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for the wv");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        (*oz)[i] = calloc (CMG_NBLON, sizeof (uint8));
-        if ((*oz)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for the oz");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }
-
-    /* rolutt[NSR_BANDS][7][22][8000] and transt[NSR_BANDS][7][22][22] and
-       sphalbt[NSR_BANDS][7][22] and normext[NSR_BANDS][7][22] */
-    *rolutt = calloc (NSR_BANDS, sizeof (float***));
-    if (*rolutt == NULL)
+    /* Look-up tables */
+    if (memory_allocation_lut (tsmax, tsmin, nbfic, nbfi, ttv) != SUCCESS)
     {
-        sprintf (errmsg, "Error allocating memory for rolutt");
+        sprintf (errmsg, "Error allocating memory for the look-up tables");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    *transt = calloc (NSR_BANDS, sizeof (float***));
-    if (*transt == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for transt");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+    /* Successful completion */
+    return (SUCCESS);
+}
 
-    *sphalbt = calloc (NSR_BANDS, sizeof (float**));
-    if (*sphalbt == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for sphalbt");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
 
-    *normext = calloc (NSR_BANDS, sizeof (float**));
-    if (*normext == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for normext");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+/******************************************************************************
+MODULE:  memory_allocation_lut
 
-    for (i = 0; i < NSR_BANDS; i++)
-    {
-        (*rolutt)[i] = calloc (7, sizeof (float**));
-        if ((*rolutt)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for rolutt");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+PURPOSE:  Allocates memory for the look-up tables of the L8 surface
+reflectance corrections.
 
-        (*transt)[i] = calloc (7, sizeof (float**));
-        if ((*transt)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for transt");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+RETURN VALUE:
+Type = int
+Value          Description
+-----          -----------
+ERROR          Error occurred allocating memory
+SUCCESS        Successful completion
 
-        (*sphalbt)[i] = calloc (7, sizeof (float*));
-        if ((*sphalbt)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for sphalbt");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        (*normext)[i] = calloc (7, sizeof (float*));
-        if ((*normext)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for normext");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        for (j = 0; j < 7; j++)
-        {
-            (*rolutt)[i][j] = calloc (22, sizeof (float*));
-            if ((*rolutt)[i][j] == NULL)
-            {
-                sprintf (errmsg, "Error allocating memory for rolutt");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-
-            (*transt)[i][j] = calloc (22, sizeof (float*));
-            if ((*transt)[i][j] == NULL)
-            {
-                sprintf (errmsg, "Error allocating memory for transt");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-
-            (*sphalbt)[i][j] = calloc (22, sizeof (float));
-            if ((*sphalbt)[i][j] == NULL)
-            {
-                sprintf (errmsg, "Error allocating memory for sphalbt");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-
-            (*normext)[i][j] = calloc (22, sizeof (float));
-            if ((*normext)[i][j] == NULL)
-            {
-                sprintf (errmsg, "Error allocating memory for normext");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-
-            for (k = 0; k < 22; k++)
-            {
-                (*rolutt)[i][j][k] = calloc (8000, sizeof (float));
-                if ((*rolutt)[i][j][k] == NULL)
-                {
-                    sprintf (errmsg, "Error allocating memory for rolutt");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
+HISTORY:
+Date         Programmer       Reason
+---------    ---------------  -------------------------------------
+11/20/2015                    Original development, from memory_allocation_sr
 
-                (*transt)[i][j][k] = calloc (22, sizeof (float));
-                if ((*transt)[i][j][k] == NULL)
-                {
-                    sprintf (errmsg, "Error allocating memory for transt");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-            }  /* for k */
-        }  /* for j */
-    }  /* for i */
+NOTES:
+  1. The rolutt, transt, sphalbt and normext tables are allocated by readluts
+     or point into the binary LUT file mapped by map_lut_bin.
+  2. Use free_lut to free the look-up tables.
+******************************************************************************/
+int memory_allocation_lut
+(
+    float ***tsmax,      /* O: maximum scattering angle table [20][22] */
+    float ***tsmin,      /* O: minimum scattering angle table [20][22] */
+    float ***nbfic,      /* O: communitive number of azimuth angles [20][22] */
+    float ***nbfi,       /* O: number of azimuth angles [20][22] */
+    float ***ttv         /* O: view angle table [20][22] */
+)
+{
+    char FUNC_NAME[] = "memory_allocation_lut"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable */
 
     /* tsmax[20][22] and float tsmin[20][22] and float nbfic[20][22] and
        nbfi[20][22] and float ttv[20][22] */
@@ -2543,186 +2714,259 @@ int memory_allocation_sr
 
 
 /******************************************************************************
-MODULE:  read_auxiliary_files
+MODULE:  free_lut
 
-PURPOSE:  Reads the auxiliary files required for this application.
+PURPOSE:  Frees the look-up tables allocated by memory_allocation_lut and
+loaded by readluts or map_lut_bin.
 
 RETURN VALUE:
-Type = int
-Value          Description
------          -----------
-ERROR          Error occurred reading one of the auxiliary files
-SUCCESS        Successful completion
+Type = None
 
 HISTORY:
 Date         Programmer       Reason
 ---------    ---------------  -------------------------------------
-8/25/2014    Gail Schmidt     Original development
+11/20/2015                    Original development
 
 NOTES:
-  1. It is assumed that memory has already been allocated for the input data
-     arrays.
+  1. If lut_map is NULL or holds no mapping, rolutt, transt, sphalbt and
+     normext were allocated by readluts.
 ******************************************************************************/
-int read_auxiliary_files
+void free_lut
 (
-    char *anglehdf,     /* I: angle HDF filename */
-    char *intrefnm,     /* I: intrinsic reflectance filename */
-    char *transmnm,     /* I: transmission filename */
-    char *spheranm,     /* I: spherical albedo filename */
-    char *cmgdemnm,     /* I: climate modeling grid DEM filename */
-    char *rationm,      /* I: ratio averages filename */
-    char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
-    int16 **dem,        /* O: CMG DEM data array [DEM_NBLAT][DEM_NBLON] */
-    int16 **andwi,      /* O: avg NDWI [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **sndwi,      /* O: standard NDWI [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob1,    /* O: mean band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob2,    /* O: mean band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob7,    /* O: mean band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **intratiob1, /* O: band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **intratiob2, /* O: band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **intratiob7, /* O: band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **slpratiob1, /* O: slope band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **slpratiob2, /* O: slope band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **slpratiob7, /* O: slope band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    uint16 **wv,        /* O: water vapor values [CMG_NBLAT][CMG_NBLON] */
-    uint8 **oz          /* O: ozone values [CMG_NBLAT][CMG_NBLON] */
+    float *rolutt,       /* I: intrinsic reflectance table
+                               [NSR_BANDS][8000][22][7] */
+    float *transt,       /* I: transmission table
+                               [NSR_BANDS][22][22][7] */
+    float *sphalbt,      /* I: spherical albedo table [NSR_BANDS][22][7] */
+    float *normext,      /* I: aerosol extinction coefficient
+                               [NSR_BANDS][22][7] */
+    float **tsmax,       /* I: maximum scattering angle table [20][22] */
+    float **tsmin,       /* I: minimum scattering angle table [20][22] */
+    float **nbfic,       /* I: communitive number of azimuth angles [20][22] */
+    float **nbfi,        /* I: number of azimuth angles [20][22] */
+    float **ttv,         /* I: view angle table [20][22] */
+    Lut_map_t *lut_map   /* I: mapping of the binary LUT file, or NULL */
 )
 {
-    char FUNC_NAME[] = "read_auxiliary_files"; /* function name */
-    char errmsg[STR_SIZE];   /* error message */
-    char sds_name[STR_SIZE]; /* name of the SDS being read */
-    int i, j;            /* looping variables */
-    int status;          /* return status of the HDF function */
-    int start[5];        /* starting point to read SDS data; handles up to
-                            4D dataset */
-    int edges[5];        /* number of values to read in SDS data; handles up to
-                            4D dataset */
-    int sd_id;           /* file ID for the HDF file */
-    int sds_id;          /* ID for the current SDS */
-    int sds_index;       /* index for the current SDS */
+    int i;               /* looping variable */
 
-    /* Read the DEM */
-    sd_id = SDstart (cmgdemnm, DFACC_RDONLY);
-    if (sd_id < 0)
+    /* Unmap the binary LUT file or free the tables read by readluts */
+    if (lut_map != NULL && lut_map->map != NULL)
     {
-        sprintf (errmsg, "Unable to open %s for reading as SDS", cmgdemnm);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        munmap (lut_map->map, lut_map->map_len);
+        lut_map->map = NULL;
     }
-
-    /* Find the SDS name */
-    strcpy (sds_name, "averaged elevation");
-    sds_index = SDnametoindex (sd_id, sds_name);
-    if (sds_index == -1)
+    else
     {
-        sprintf (errmsg, "Unable to find %s in the DEM file %s", sds_name,
-            cmgdemnm);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        free (rolutt);
+        free (transt);
+        free (sphalbt);
+        free (normext);
     }
 
-    /* Open the current band as an SDS */
-    sds_id = SDselect (sd_id, sds_index);
-    if (sds_id < 0)
+    for (i = 0; i < 20; i++)
     {
-        sprintf (errmsg, "Unable to access %s for reading", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+        free (tsmax[i]);
+        free (tsmin[i]);
+        free (nbfic[i]);
+        free (nbfi[i]);
+        free (ttv[i]);
+    }
+    free (tsmax);
+    free (tsmin);
+    free (nbfic);
+    free (nbfi);
+    free (ttv);
+}
 
-    /* Read the data one line at a time */
-    for (i = 0; i < DEM_NBLAT; i++)
-    {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = DEM_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, dem[i]);
-        if (status == -1)
-        {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }
 
-    /* Close the SDS */
-    status = SDendaccess (sds_id);
-    if (status < 0)
-    {
-        sprintf (errmsg, "Ending access to %s", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+/* CMG lines/samples of the points along the scene edges, plus
+   CMG_WINDOW_MARGIN degrees and the next line/sample used by the bilinear
+   interpolation in compute_sr_refl; the whole grid if the points can't all
+   be mapped.  A scene across the dateline gets all the samples. */
+static void cmg_scene_window
+(
+    Geoloc_t *space,    /* I: geolocation information of the scene */
+    int nlines,         /* I: number of lines in the scene */
+    int nsamps,         /* I: number of samples in the scene */
+    Aux_window_t *win   /* O: CMG window covering the scene */
+)
+{
+    int i, k;                     /* looping variables */
+    int line1, samp1;             /* last CMG line/sample of the window */
+    double lat, lon;              /* lat/long of the current point (deg) */
+    double latmin = 90.0, latmax = -90.0;     /* latitude range (deg) */
+    double lonmin = 180.0, lonmax = -180.0;   /* longitude range (deg) */
+    Img_coord_float_t img;        /* coordinate in line/sample space */
+    Geo_coord_t geo;              /* coordinate in lat/long space */
+
+    win->line0 = 0;
+    win->nlines = CMG_NBLAT;
+    win->samp0 = 0;
+    win->nsamps = CMG_NBLON;
+
+    /* Use the center of the pixels, as compute_sr_refl does */
+    img.is_fill = false;
+    for (k = 0; k < 4; k++)
+    {
+        for (i = 0; i <= CMG_NB_EDGE_PTS; i++)
+        {
+            if (k < 2)
+            {
+                img.l = ((k == 0) ? 0.0 : (double) (nlines - 1)) - 0.5;
+                img.s = (double) i * (nsamps - 1) / CMG_NB_EDGE_PTS + 0.5;
+            }
+            else
+            {
+                img.l = (double) i * (nlines - 1) / CMG_NB_EDGE_PTS - 0.5;
+                img.s = ((k == 2) ? 0.0 : (double) (nsamps - 1)) + 0.5;
+            }
+            if (!from_space (space, &img, &geo))
+                return;
+            lat = geo.lat * RAD2DEG;
+            lon = geo.lon * RAD2DEG;
+            if (lat < latmin)
+                latmin = lat;
+            if (lat > latmax)
+                latmax = lat;
+            if (lon < lonmin)
+                lonmin = lon;
+            if (lon > lonmax)
+                lonmax = lon;
+        }
+    }
+
+    win->line0 = (int) floor ((89.975 - (latmax + CMG_WINDOW_MARGIN)) * 20.0);
+    if (win->line0 < 0)
+        win->line0 = 0;
+    line1 = (int) floor ((89.975 - (latmin - CMG_WINDOW_MARGIN)) * 20.0) + 1;
+    if (line1 > CMG_NBLAT - 1)
+        line1 = CMG_NBLAT - 1;
+    win->nlines = line1 - win->line0 + 1;
+
+    if (lonmax - lonmin > 180.0)
+        return;
+    win->samp0 = (int) floor ((179.975 + lonmin - CMG_WINDOW_MARGIN) * 20.0);
+    if (win->samp0 < 0)
+        win->samp0 = 0;
+    samp1 = (int) floor ((179.975 + lonmax + CMG_WINDOW_MARGIN) * 20.0) + 1;
+    if (samp1 > CMG_NBLON - 1)
+        samp1 = CMG_NBLON - 1;
+    win->nsamps = samp1 - win->samp0 + 1;
+}
 
-    /* Close the DEM file */
-    status = SDend (sd_id);
-    if (status != 0)
-    {
-        sprintf (errmsg, "Closing DEM file.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
 
-    /* Read the RATIO file */
-    sd_id = SDstart (rationm, DFACC_RDONLY);
-    if (sd_id < 0)
-    {
-        sprintf (errmsg, "Unable to open %s for reading as SDS", rationm);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+/* Maps the auxiliary cache read-only and shared, so that concurrent runs
+   share its pages, and points the rows of the static grids into it; returns
+   false if it doesn't exist or can't be mapped */
+static bool map_aux_cache
+(
+    char *aux_cache,    /* I: auxiliary cache filename */
+    int16 **grids[AUX_CACHE_NGRIDS],  /* O: static grids */
+    Aux_window_t *win   /* O: mapping of the cache */
+)
+{
+    char FUNC_NAME[] = "map_aux_cache"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int g, i;                /* looping variables */
+    int fd;                  /* file descriptor of the cache */
+    size_t len;              /* expected size of the cache */
+    struct stat statbuf;     /* buffer for the file stat function */
+    void *map = NULL;        /* mapping of the cache */
+
+    len = (size_t) AUX_CACHE_NGRIDS * CMG_NBLAT * CMG_NBLON * sizeof (int16);
+    fd = open (aux_cache, O_RDONLY);
+    if (fd < 0)
+        return (false);
+    if (fstat (fd, &statbuf) != 0 || (size_t) statbuf.st_size != len)
+    {
+        sprintf (errmsg, "Unexpected size of the auxiliary cache %s; it "
+            "will not be used", aux_cache);
+        error_handler (false, FUNC_NAME, errmsg);
+        close (fd);
+        return (false);
+    }
+    map = mmap (NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED)
+        return (false);
+
+    for (g = 0; g < AUX_CACHE_NGRIDS; g++)
+        for (i = 0; i < CMG_NBLAT; i++)
+            grids[g][i] = (int16 *) map + ((size_t) g * CMG_NBLAT + i) *
+                CMG_NBLON;
+    win->cache = map;
+    win->cache_len = len;
+    return (true);
+}
 
-    /* Find the SDS name (SDS 6) */
-    strcpy (sds_name, "average ndvi");
-    sds_index = SDnametoindex (sd_id, sds_name);
-    if (sds_index == -1)
-    {
-        sprintf (errmsg, "Unable to find %s in the RATIO file", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
 
-    /* Open the current band as an SDS */
-    sds_id = SDselect (sd_id, sds_index);
-    if (sds_id < 0)
-    {
-        sprintf (errmsg, "Unable to access %s for reading", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+/* Writes the static grids, read in full, as the auxiliary cache for the next
+   runs.  The cache is written to a temporary file renamed at the end, so
+   concurrent runs never map a partial cache.  A failure is only reported. */
+static void save_aux_cache
+(
+    char *aux_cache,    /* I: auxiliary cache filename */
+    int16 **grids[AUX_CACHE_NGRIDS]   /* I: static grids */
+)
+{
+    char FUNC_NAME[] = "save_aux_cache"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char tmpname[STR_SIZE];  /* temporary cache filename */
+    int g, i;                /* looping variables */
+    bool ok = true;          /* were all the rows written? */
+    FILE *fptr = NULL;       /* file pointer of the cache */
 
-    /* Read the data one line at a time */
-    for (i = 0; i < RATIO_NBLAT; i++)
+    snprintf (tmpname, sizeof (tmpname), "%s.%d", aux_cache, (int) getpid ());
+    fptr = fopen (tmpname, "wb");
+    if (fptr == NULL)
     {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = RATIO_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, andwi[i]);
-        if (status == -1)
-        {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        sprintf (errmsg, "Unable to create the auxiliary cache %s", aux_cache);
+        error_handler (false, FUNC_NAME, errmsg);
+        return;
     }
-
-    /* Close the SDS */
-    status = SDendaccess (sds_id);
-    if (status < 0)
+    for (g = 0; g < AUX_CACHE_NGRIDS && ok; g++)
+        for (i = 0; i < CMG_NBLAT && ok; i++)
+            ok = (fwrite (grids[g][i], sizeof (int16), CMG_NBLON, fptr) ==
+                CMG_NBLON);
+    if (fclose (fptr) != 0 || !ok || rename (tmpname, aux_cache) != 0)
     {
-        sprintf (errmsg, "Ending access to %s", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        sprintf (errmsg, "Unable to create the auxiliary cache %s", aux_cache);
+        error_handler (false, FUNC_NAME, errmsg);
+        remove (tmpname);
+        return;
     }
+    printf ("Saved the auxiliary cache %s\n", aux_cache);
+}
+
+
+/* Reads the window of an SDS of a CMG-based auxiliary file into the rows of
+   the window, which are allocated [CMG_NBLON] */
+static int read_cmg_sds
+(
+    int32 sd_id,        /* I: file ID for the HDF file */
+    char *sds_name,     /* I: name of the SDS to be read */
+    char *file_type,    /* I: type of the file, for the error messages */
+    Aux_window_t *win,  /* I: CMG window to be read */
+    size_t data_size,   /* I: size of the SDS data type */
+    void **rows         /* O: rows of the grid [CMG_NBLAT] */
+)
+{
+    char FUNC_NAME[] = "read_cmg_sds"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable */
+    int status;              /* return status of the HDF function */
+    int start[2];            /* starting point to read SDS data */
+    int edges[2];            /* number of values to read in SDS data */
+    int sds_id;              /* ID for the current SDS */
+    int sds_index;           /* index for the current SDS */
 
-    /* Find the SDS name (SDS 14) */
-    strcpy (sds_name, "standard ndvi");
+    /* Find the SDS name */
     sds_index = SDnametoindex (sd_id, sds_name);
     if (sds_index == -1)
     {
-        sprintf (errmsg, "Unable to find %s in the RATIO file", sds_name);
+        sprintf (errmsg, "Unable to find %s in the %s file", sds_name,
+            file_type);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
@@ -2736,58 +2980,24 @@ int read_auxiliary_files
         return (ERROR);
     }
 
-    /* Read the data one line at a time */
-    for (i = 0; i < RATIO_NBLAT; i++)
+    /* Read the window one line at a time, into the same samples of the
+       full-width rows */
+    for (i = win->line0; i < win->line0 + win->nlines; i++)
     {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = RATIO_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, sndwi[i]);
-        if (status == -1)
+        rows[i] = calloc (CMG_NBLON, data_size);
+        if (rows[i] == NULL)
         {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
+            sprintf (errmsg, "Error allocating memory for the %s", sds_name);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
-    }
-
-    /* Close the SDS */
-    status = SDendaccess (sds_id);
-    if (status < 0)
-    {
-        sprintf (errmsg, "Ending access to %s", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Find the SDS name (SDS 21) */
-    strcpy (sds_name, "slope ratiob9");
-    sds_index = SDnametoindex (sd_id, sds_name);
-    if (sds_index == -1)
-    {
-        sprintf (errmsg, "Unable to find %s in the RATIO file", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Open the current band as an SDS */
-    sds_id = SDselect (sd_id, sds_index);
-    if (sds_id < 0)
-    {
-        sprintf (errmsg, "Unable to access %s for reading", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
 
-    /* Read the data one line at a time */
-    for (i = 0; i < RATIO_NBLAT; i++)
-    {
         start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
+        start[1] = win->samp0;  /* sample */
         edges[0] = 1;
-        edges[1] = RATIO_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, slpratiob1[i]);
+        edges[1] = win->nsamps;
+        status = SDreaddata (sds_id, start, NULL, edges,
+            (char *) rows[i] + win->samp0 * data_size);
         if (status == -1)
         {
             sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
@@ -2805,343 +3015,222 @@ int read_auxiliary_files
         return (ERROR);
     }
 
-    /* Find the SDS name (SDS 22) */
-    strcpy (sds_name, "inter ratiob9");
-    sds_index = SDnametoindex (sd_id, sds_name);
-    if (sds_index == -1)
-    {
-        sprintf (errmsg, "Unable to find %s in the RATIO file", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+    return (SUCCESS);
+}
 
-    /* Open the current band as an SDS */
-    sds_id = SDselect (sd_id, sds_index);
-    if (sds_id < 0)
-    {
-        sprintf (errmsg, "Unable to access %s for reading", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
 
-    /* Read the data one line at a time */
-    for (i = 0; i < RATIO_NBLAT; i++)
-    {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = RATIO_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, intratiob1[i]);
-        if (status == -1)
-        {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }
+/******************************************************************************
+MODULE:  read_auxiliary_files
 
-    /* Close the SDS */
-    status = SDendaccess (sds_id);
-    if (status < 0)
-    {
-        sprintf (errmsg, "Ending access to %s", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+PURPOSE:  Reads the auxiliary files required for this application.
 
-    /* Find the SDS name (SDS 15) */
-    strcpy (sds_name, "slope ratiob3");
-    sds_index = SDnametoindex (sd_id, sds_name);
-    if (sds_index == -1)
-    {
-        sprintf (errmsg, "Unable to find %s in the RATIO file", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+RETURN VALUE:
+Type = int
+Value          Description
+-----          -----------
+ERROR          Error occurred reading one of the auxiliary files
+SUCCESS        Successful completion
 
-    /* Open the current band as an SDS */
-    sds_id = SDselect (sd_id, sds_index);
-    if (sds_id < 0)
-    {
-        sprintf (errmsg, "Unable to access %s for reading", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+HISTORY:
+Date         Programmer       Reason
+---------    ---------------  -------------------------------------
+8/25/2014    Gail Schmidt     Original development
+11/20/2015                    Only read the window of the CMG grids covered
+                              by the scene.  Added the shared auxiliary cache
+                              of the static grids.
 
-    /* Read the data one line at a time */
-    for (i = 0; i < RATIO_NBLAT; i++)
-    {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = RATIO_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, slpratiob2[i]);
-        if (status == -1)
+NOTES:
+  1. It is assumed that memory has already been allocated for the row
+     pointers of the input data arrays.  The rows of the CMG window covered
+     by the scene are allocated here; the other rows are left NULL.
+  2. If aux_cache is specified and exists, the static grids (DEM and ratios)
+     are served from it mapped read-only and shared, so concurrent runs share
+     its pages.  If it doesn't exist, the static grids are read in full and
+     saved as aux_cache for the next runs.  The cache isn't checked against
+     the DEM and ratio files; remove it when they change.
+  3. The water vapor and ozone grids change with the scene date, so they are
+     always read from the auxiliary file.
+  4. free_aux_cache unmaps the auxiliary cache.
+******************************************************************************/
+int read_auxiliary_files
+(
+    char *anglehdf,     /* I: angle HDF filename */
+    char *intrefnm,     /* I: intrinsic reflectance filename */
+    char *transmnm,     /* I: transmission filename */
+    char *spheranm,     /* I: spherical albedo filename */
+    char *cmgdemnm,     /* I: climate modeling grid DEM filename */
+    char *rationm,      /* I: ratio averages filename */
+    char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
+    char *aux_cache,    /* I: shared cache file of the static grids, NULL if
+                              not used */
+    Geoloc_t *space,    /* I: geolocation information of the scene */
+    int nlines,         /* I: number of lines in the scene */
+    int nsamps,         /* I: number of samples in the scene */
+    int16 **dem,        /* O: CMG DEM data array [DEM_NBLAT][DEM_NBLON] */
+    int16 **andwi,      /* O: avg NDWI [RATIO_NBLAT][RATIO_NBLON] */
+    int16 **sndwi,      /* O: standard NDWI [RATIO_NBLAT][RATIO_NBLON] */
+    int16 **ratiob1,    /* O: mean band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
+    int16 **ratiob2,    /* O: mean band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
+    int16 **ratiob7,    /* O: mean band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
+    int16 **intratiob1, /* O: band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
+    int16 **intratiob2, /* O: band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
+    int16 **intratiob7, /* O: band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
+    int16 **slpratiob1, /* O: slope band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
+    int16 **slpratiob2, /* O: slope band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
+    int16 **slpratiob7, /* O: slope band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
+    uint16 **wv,        /* O: water vapor values [CMG_NBLAT][CMG_NBLON] */
+    uint8 **oz,         /* O: ozone values [CMG_NBLAT][CMG_NBLON] */
+    Aux_window_t *win   /* O: CMG window read for the scene */
+)
+{
+    char FUNC_NAME[] = "read_auxiliary_files"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i, j;            /* looping variables */
+    int status;          /* return status of the HDF function */
+    int sd_id;           /* file ID for the HDF file */
+    Aux_window_t static_win;  /* window read for the static grids */
+    int16 **grids[AUX_CACHE_NGRIDS] =  /* static grids, in the cache order */
+        {dem, andwi, sndwi, ratiob1, ratiob2, ratiob7, intratiob1, intratiob2,
+         intratiob7, slpratiob1, slpratiob2, slpratiob7};
+
+    /* Determine the CMG window covered by the scene */
+    cmg_scene_window (space, nlines, nsamps, win);
+    win->cache = NULL;
+    win->cache_len = 0;
+    printf ("CMG window: lines %d-%d, samples %d-%d\n", win->line0,
+        win->line0 + win->nlines - 1, win->samp0,
+        win->samp0 + win->nsamps - 1);
+
+    /* Serve the static grids from the auxiliary cache if it's available,
+       otherwise read them in full to create it */
+    static_win = *win;
+    if (aux_cache != NULL)
+    {
+        if (map_aux_cache (aux_cache, grids, win))
+            printf ("Mapped the auxiliary cache %s\n", aux_cache);
+        else
         {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            static_win.line0 = 0;
+            static_win.nlines = CMG_NBLAT;
+            static_win.samp0 = 0;
+            static_win.nsamps = CMG_NBLON;
         }
     }
 
-    /* Close the SDS */
-    status = SDendaccess (sds_id);
-    if (status < 0)
-    {
-        sprintf (errmsg, "Ending access to %s", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Find the SDS name (SDS 16) */
-    strcpy (sds_name, "inter ratiob3");
-    sds_index = SDnametoindex (sd_id, sds_name);
-    if (sds_index == -1)
+    if (win->cache == NULL)
     {
-        sprintf (errmsg, "Unable to find %s in the RATIO file", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Open the current band as an SDS */
-    sds_id = SDselect (sd_id, sds_index);
-    if (sds_id < 0)
-    {
-        sprintf (errmsg, "Unable to access %s for reading", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Read the data one line at a time */
-    for (i = 0; i < RATIO_NBLAT; i++)
-    {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = RATIO_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, intratiob2[i]);
-        if (status == -1)
+        /* Read the DEM */
+        sd_id = SDstart (cmgdemnm, DFACC_RDONLY);
+        if (sd_id < 0)
         {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
+            sprintf (errmsg, "Unable to open %s for reading as SDS", cmgdemnm);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
-    }
 
-    /* Close the SDS */
-    status = SDendaccess (sds_id);
-    if (status < 0)
-    {
-        sprintf (errmsg, "Ending access to %s", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Find the SDS name (SDS 27) */
-    strcpy (sds_name, "slope ratiob7");
-    sds_index = SDnametoindex (sd_id, sds_name);
-    if (sds_index == -1)
-    {
-        sprintf (errmsg, "Unable to find %s in the RATIO file", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Open the current band as an SDS */
-    sds_id = SDselect (sd_id, sds_index);
-    if (sds_id < 0)
-    {
-        sprintf (errmsg, "Unable to access %s for reading", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Read the data one line at a time */
-    for (i = 0; i < RATIO_NBLAT; i++)
-    {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = RATIO_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, slpratiob7[i]);
-        if (status == -1)
+        if (read_cmg_sds (sd_id, "averaged elevation", "DEM", &static_win,
+            sizeof (int16), (void **) dem) != SUCCESS)
         {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
+            sprintf (errmsg, "Reading the DEM file %s", cmgdemnm);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
-    }
-
-    /* Close the SDS */
-    status = SDendaccess (sds_id);
-    if (status < 0)
-    {
-        sprintf (errmsg, "Ending access to %s", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Find the SDS name (SDS 28) */
-    strcpy (sds_name, "inter ratiob7");
-    sds_index = SDnametoindex (sd_id, sds_name);
-    if (sds_index == -1)
-    {
-        sprintf (errmsg, "Unable to find %s in the RATIO file", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Open the current band as an SDS */
-    sds_id = SDselect (sd_id, sds_index);
-    if (sds_id < 0)
-    {
-        sprintf (errmsg, "Unable to access %s for reading", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
 
-    /* Read the data one line at a time */
-    for (i = 0; i < RATIO_NBLAT; i++)
-    {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = RATIO_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, intratiob7[i]);
-        if (status == -1)
+        /* Close the DEM file */
+        status = SDend (sd_id);
+        if (status != 0)
         {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
+            sprintf (errmsg, "Closing DEM file.");
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
-    }
-
-    /* Close the SDS */
-    status = SDendaccess (sds_id);
-    if (status < 0)
-    {
-        sprintf (errmsg, "Ending access to %s", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Close the RATIO file */
-    status = SDend (sd_id);
-    if (status != 0)
-    {
-        sprintf (errmsg, "Closing RATIO file.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
 
-    /* Compute the band ratios based on the averaged NDWI */
-    for (i = 0; i < RATIO_NBLAT; i++)
-    {
-        for (j = 0; j < RATIO_NBLON; j++)
+        /* Read the RATIO file (SDS 6, 14, 21, 22, 15, 16, 27 and 28) */
+        sd_id = SDstart (rationm, DFACC_RDONLY);
+        if (sd_id < 0)
         {
-            ratiob1[i][j] = (int16) (andwi[i][j] * slpratiob1[i][j] * 0.001 +
-                intratiob1[i][j]);
-            ratiob2[i][j] = (int16) (andwi[i][j] * slpratiob2[i][j] * 0.001 +
-                intratiob2[i][j]);
-            ratiob7[i][j] = (int16) (andwi[i][j] * slpratiob7[i][j] * 0.001 +
-                intratiob7[i][j]);
+            sprintf (errmsg, "Unable to open %s for reading as SDS", rationm);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
         }
-    }
-
-    /* Read ozone and water vapor from the user-specified auxiliary file */
-    sd_id = SDstart (auxnm, DFACC_RDONLY);
-    if (sd_id < 0)
-    {
-        sprintf (errmsg, "Unable to open %s for reading as SDS", auxnm);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
 
-    /* Find the SDS name */
-    strcpy (sds_name, "Coarse Resolution Ozone");
-    sds_index = SDnametoindex (sd_id, sds_name);
-    if (sds_index == -1)
-    {
-        sprintf (errmsg, "Unable to find %s in the AUX file %s", sds_name,
-            auxnm);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Open the current band as an SDS */
-    sds_id = SDselect (sd_id, sds_index);
-    if (sds_id < 0)
-    {
-        sprintf (errmsg, "Unable to access %s for reading", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+        if (read_cmg_sds (sd_id, "average ndvi", "RATIO", &static_win,
+                sizeof (int16), (void **) andwi) != SUCCESS ||
+            read_cmg_sds (sd_id, "standard ndvi", "RATIO", &static_win,
+                sizeof (int16), (void **) sndwi) != SUCCESS ||
+            read_cmg_sds (sd_id, "slope ratiob9", "RATIO", &static_win,
+                sizeof (int16), (void **) slpratiob1) != SUCCESS ||
+            read_cmg_sds (sd_id, "inter ratiob9", "RATIO", &static_win,
+                sizeof (int16), (void **) intratiob1) != SUCCESS ||
+            read_cmg_sds (sd_id, "slope ratiob3", "RATIO", &static_win,
+                sizeof (int16), (void **) slpratiob2) != SUCCESS ||
+            read_cmg_sds (sd_id, "inter ratiob3", "RATIO", &static_win,
+                sizeof (int16), (void **) intratiob2) != SUCCESS ||
+            read_cmg_sds (sd_id, "slope ratiob7", "RATIO", &static_win,
+                sizeof (int16), (void **) slpratiob7) != SUCCESS ||
+            read_cmg_sds (sd_id, "inter ratiob7", "RATIO", &static_win,
+                sizeof (int16), (void **) intratiob7) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the RATIO file %s", rationm);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
 
-    /* Read the data one line at a time */
-    for (i = 0; i < CMG_NBLAT; i++)
-    {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = CMG_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, oz[i]);
-        if (status == -1)
+        /* Close the RATIO file */
+        status = SDend (sd_id);
+        if (status != 0)
         {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
+            sprintf (errmsg, "Closing RATIO file.");
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
-    }
 
-    /* Close the SDS */
-    status = SDendaccess (sds_id);
-    if (status < 0)
-    {
-        sprintf (errmsg, "Ending access to %s", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+        /* Compute the band ratios based on the averaged NDWI */
+        for (i = static_win.line0; i < static_win.line0 + static_win.nlines;
+             i++)
+        {
+            ratiob1[i] = calloc (RATIO_NBLON, sizeof (int16));
+            ratiob2[i] = calloc (RATIO_NBLON, sizeof (int16));
+            ratiob7[i] = calloc (RATIO_NBLON, sizeof (int16));
+            if (ratiob1[i] == NULL || ratiob2[i] == NULL || ratiob7[i] == NULL)
+            {
+                sprintf (errmsg, "Error allocating memory for the band "
+                    "ratios");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
 
-    /* Find the SDS name */
-    strcpy (sds_name, "Coarse Resolution Water Vapor");
-    sds_index = SDnametoindex (sd_id, sds_name);
-    if (sds_index == -1)
-    {
-        sprintf (errmsg, "Unable to find %s in the AUX file", sds_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+            for (j = static_win.samp0;
+                 j < static_win.samp0 + static_win.nsamps; j++)
+            {
+                ratiob1[i][j] = (int16) (andwi[i][j] * slpratiob1[i][j] *
+                    0.001 + intratiob1[i][j]);
+                ratiob2[i][j] = (int16) (andwi[i][j] * slpratiob2[i][j] *
+                    0.001 + intratiob2[i][j]);
+                ratiob7[i][j] = (int16) (andwi[i][j] * slpratiob7[i][j] *
+                    0.001 + intratiob7[i][j]);
+            }
+        }
+
+        if (aux_cache != NULL)
+            save_aux_cache (aux_cache, grids);
     }
 
-    /* Open the current band as an SDS */
-    sds_id = SDselect (sd_id, sds_index);
-    if (sds_id < 0)
+    /* Read ozone and water vapor from the user-specified auxiliary file */
+    sd_id = SDstart (auxnm, DFACC_RDONLY);
+    if (sd_id < 0)
     {
-        sprintf (errmsg, "Unable to access %s for reading", sds_name);
+        sprintf (errmsg, "Unable to open %s for reading as SDS", auxnm);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Read the data one line at a time */
-    for (i = 0; i < CMG_NBLAT; i++)
+    if (read_cmg_sds (sd_id, "Coarse Resolution Ozone", "AUX", win,
+            sizeof (uint8), (void **) oz) != SUCCESS ||
+        read_cmg_sds (sd_id, "Coarse Resolution Water Vapor", "AUX", win,
+            sizeof (uint16), (void **) wv) != SUCCESS)
     {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = CMG_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, wv[i]);
-        if (status == -1)
-        {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }
-
-    /* Close the SDS */
-    status = SDendaccess (sds_id);
-    if (status < 0)
-    {
-        sprintf (errmsg, "Ending access to %s", sds_name);
+        sprintf (errmsg, "Reading the AUX file %s", auxnm);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
@@ -3159,3 +3248,33 @@ int read_auxiliary_files
     return (SUCCESS);
 }
 
+
+/******************************************************************************
+MODULE:  free_aux_cache
+
+PURPOSE:  Unmaps the auxiliary cache of the static grids, if it was used.
+
+RETURN VALUE:
+Type = None
+
+HISTORY:
+Date         Programmer       Reason
+---------    ---------------  -------------------------------------
+11/20/2015                    Original development
+
+NOTES:
+  1. The rows of the static grids point into the mapping, so they must not
+     be freed or used after this call.  Only their row pointer arrays are
+     left to be freed by the caller.
+******************************************************************************/
+void free_aux_cache
+(
+    Aux_window_t *win   /* I: CMG window read for the scene */
+)
+{
+    if (win->cache == NULL)
+        return;
+    munmap (win->cache, win->cache_len);
+    win->cache = NULL;
+    win->cache_len = 0;
+}
@@ -6,10 +6,100 @@
 #include <string.h>
 #include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "common.h"
 #include "espa_metadata.h"
+#include "espa_geoloc.h"
 #include "error_handler.h"
 
+/* CMG window definitions; the DEM, ratio, water vapor and ozone grids all
+   share the same 0.05 deg CMG geometry */
+#define CMG_WINDOW_MARGIN 0.5   /* margin (deg) around the scene */
+#define CMG_NB_EDGE_PTS 8       /* points mapped along each scene edge */
+#define AUX_CACHE_NGRIDS 12     /* DEM and the 11 ratio grids in the cache */
+
+/* Window of the CMG-based auxiliary grids read for the scene.  Only the rows
+   of the window are allocated ([CMG_NBLON] each, the other rows are NULL),
+   and only the samples of the window are read.  If the static grids (DEM and
+   ratios) come from a shared auxiliary cache, all their rows point into the
+   read-only mapping. */
+typedef struct
+{
+    int line0;          /* first CMG line covered by the scene */
+    int nlines;         /* number of CMG lines covered by the scene */
+    int samp0;          /* first CMG sample covered by the scene */
+    int nsamps;         /* number of CMG samples covered by the scene */
+    void *cache;        /* mapping of the auxiliary cache, NULL if the static
+                           grids were read from the HDF files */
+    size_t cache_len;   /* size (bytes) of the mapping */
+} Aux_window_t;
+
+/* Solar zenith angles of the LUTs */
+#define LUT_XTSSTEP 4.0         /* solar zenith step value (deg) */
+#define LUT_XTSMIN 0.0          /* minimum solar zenith value (deg) */
+
+/* Flat layouts of the intrinsic reflectance (rolutt), transmission (transt),
+   spherical albedo (sphalbt) and normalized extinction (normext) tables.
+   The surface pressure index varies fastest, then the AOT index, so the four
+   pressure/AOT bracket values (ip1/ip2 x iaot1/iaot2) interpolated for a
+   pixel are within 9 floats of each other. */
+#define LUT_NPRES 7             /* number of surface pressures */
+#define LUT_NAOT 22             /* number of AOTs */
+#define LUT_NSCA 8000           /* number of intrinsic reflectance values per
+                                   pressure and AOT */
+#define LUT_NTRANS 22           /* number of transmission zenith angles */
+#define ROLUTT_SIZE ((size_t) NSR_BANDS * LUT_NSCA * LUT_NAOT * LUT_NPRES)
+#define TRANST_SIZE ((size_t) NSR_BANDS * LUT_NTRANS * LUT_NAOT * LUT_NPRES)
+#define SPHALBT_SIZE ((size_t) NSR_BANDS * LUT_NAOT * LUT_NPRES)
+#define ROLUTT_IDX(iband, isca, iaot, ip) \
+    ((((size_t) (iband) * LUT_NSCA + (isca)) * LUT_NAOT + (iaot)) * \
+     LUT_NPRES + (ip))
+#define TRANST_IDX(iband, its, iaot, ip) \
+    ((((size_t) (iband) * LUT_NTRANS + (its)) * LUT_NAOT + (iaot)) * \
+     LUT_NPRES + (ip))
+#define SPHALBT_IDX(iband, iaot, ip) \
+    (((size_t) (iband) * LUT_NAOT + (iaot)) * LUT_NPRES + (ip))
+
+/* Binary LUT file definitions */
+#define LUT_BIN_MAGIC "L8SRLUT"
+#define LUT_BIN_VERSION 2       /* 2: flat rolutt, transt, sphalbt and normext
+                                   layouts */
+#define LUT_BIN_BYTE_ORDER 0x01020304
+#define LUT_BIN_ALIGN 4096      /* alignment (bytes) of the tables */
+
+/* Tables of the binary LUT file, in the file order */
+typedef enum {LUT_TSMAX=0, LUT_TSMIN, LUT_TTV, LUT_NBFI, LUT_NBFIC, LUT_TTS,
+    LUT_INDTS, LUT_ROLUTT, LUT_TRANST, LUT_SPHALBT, LUT_NORMEXT, LUT_NTABLES}
+    Lut_table_t;
+
+/* Header of the binary LUT file written by convert_l8sr_luts.  It's followed
+   by the tables, as loaded by readluts, in native byte order and each aligned
+   on LUT_BIN_ALIGN bytes: tsmax, tsmin, ttv, nbfi, nbfic [20][22], tts [22],
+   indts [22], rolutt [NSR_BANDS][8000][22][7], transt [NSR_BANDS][22][22][7],
+   sphalbt and normext [NSR_BANDS][22][7] (see ROLUTT_IDX). */
+typedef struct
+{
+    char magic[8];          /* LUT_BIN_MAGIC */
+    int32_t version;        /* LUT_BIN_VERSION */
+    uint32_t byte_order;    /* LUT_BIN_BYTE_ORDER, in the writer byte order */
+    int32_t dims[4];        /* number of bands, pressure levels, AOT values and
+                               intrinsic reflectance values */
+    float xtsstep;          /* solar zenith step value of tts */
+    float xtsmin;           /* minimum solar zenith value of tts */
+    uint64_t offset[LUT_NTABLES];  /* offset (bytes) of the tables */
+    uint64_t size[LUT_NTABLES];    /* size (bytes) of the tables */
+    uint64_t file_size;     /* size (bytes) of the file */
+    uint64_t checksum;      /* Fletcher-64 checksum of the tables */
+} Lut_bin_header_t;
+
+/* Storage of the rolutt, transt, sphalbt and normext tables */
+typedef struct
+{
+    void *map;          /* mapping of the binary LUT file, NULL if the LUTs
+                           were read from the HDF and ASCII files */
+    size_t map_len;     /* size (bytes) of the mapping */
+} Lut_map_t;
+
 /* Prototypes */
 int atmcorlamb2
 (
@@ -25,18 +115,18 @@ int atmcorlamb2
     float pres,                      /* I: surface pressure */
     float tpres[7],                  /* I: surface pressure table */
     float aot550nm[22],              /* I: AOT look-up table */
-    float ****rolutt,                /* I: intrinsic reflectance table
-                                           [NSR_BANDS][7][22][8000] */
-    float ****transt,                /* I: transmission table
-                                           [NSR_BANDS][7][22][22] */
+    float *rolutt,                   /* I: intrinsic reflectance table
+                                           [NSR_BANDS][8000][22][7] */
+    float *transt,                   /* I: transmission table
+                                           [NSR_BANDS][22][22][7] */
     float xtsstep,                   /* I: solar zenith step value */
     float xtsmin,                    /* I: minimum solar zenith value */
     float xtvstep,                   /* I: observation step value */
     float xtvmin,                    /* I: minimum observation value */
-    float ***sphalbt,                /* I: spherical albedo table
-                                           [NSR_BANDS][7][22] */
-    float ***normext,                /* I: ?????
-                                           [NSR_BANDS][7][22] */
+    float *sphalbt,                  /* I: spherical albedo table
+                                           [NSR_BANDS][22][7] */
+    float *normext,                  /* I: ?????
+                                           [NSR_BANDS][22][7] */
     float **tsmax,                   /* I: maximum scattering angle table
                                            [20][22] */
     float **tsmin,                   /* I: minimum scattering angle table
@@ -111,10 +201,10 @@ void compsalb
     float pres,         /* I: surface pressure */
     float tpres[7],     /* I: surface pressure table */
     float aot550nm[22], /* I: AOT look-up table */
-    float ***sphalbt,   /* I: spherical albedo table [NSR_BANDS][7][22] */
-    float ***normext,   /* I: aerosol extinction coefficient at the current
+    float *sphalbt,     /* I: spherical albedo table [NSR_BANDS][22][7] */
+    float *normext,     /* I: aerosol extinction coefficient at the current
                               wavelength (normalized at 550nm)
-                              [NSR_BANDS][7][22] */
+                              [NSR_BANDS][22][7] */
     float *satm,        /* O: spherical albedo */
     float *next         /* O: ????? */
 );
@@ -131,8 +221,8 @@ void comptrans
     float pres,         /* I: surface pressure */
     float tpres[7],     /* I: surface pressure table */
     float aot550nm[22], /* I: AOT look-up table */
-    float ****transt,   /* I: transmission table
-                              [NSR_BANDS][7][22][22] */
+    float *transt,      /* I: transmission table
+                              [NSR_BANDS][22][22][7] */
     float xtsstep,      /* I: zenith angle step value */
     float xtsmin,       /* I: minimum zenith angle value */
     float tts[22],      /* I: sun angle table */
@@ -155,8 +245,8 @@ void comproatm
     float pres,         /* I: surface pressure */
     float tpres[7],     /* I: surface pressure table */
     float aot550nm[22], /* I: AOT look-up table */
-    float ****rolutt,   /* I: intrinsic reflectance table
-                              [NSR_BANDS][7][22][8000] */
+    float *rolutt,      /* I: intrinsic reflectance table
+                              [NSR_BANDS][8000][22][7] */
     float **tsmax,      /* I: maximum scattering angle table [20][22] */
     float **tsmin,      /* I: minimum scattering angle table [20][22] */
     float **nbfic,      /* I: communitive number of azimuth angles [20][22] */
@@ -183,14 +273,14 @@ int readluts
                                       [20][22] */
     float **nbfi,               /* O: number of azimuth angles [20][22] */
     int32 indts[22],            /* O: */
-    float ****rolutt,           /* O: intrinsic reflectance table
-                                      [NSR_BANDS][7][22][8000] */
-    float ****transt,           /* O: transmission table
-                                      [NSR_BANDS][7][22][22] */
-    float ***sphalbt,           /* O: spherical albedo table
-                                      [NSR_BANDS][7][22] */
-    float ***normext,           /* O: ?????
-                                      [NSR_BANDS][7][22] */
+    float **rolutt,             /* O: intrinsic reflectance table
+                                      [NSR_BANDS][8000][22][7] */
+    float **transt,             /* O: transmission table
+                                      [NSR_BANDS][22][22][7] */
+    float **sphalbt,            /* O: spherical albedo table
+                                      [NSR_BANDS][22][7] */
+    float **normext,            /* O: ?????
+                                      [NSR_BANDS][22][7] */
     float xtsstep,              /* I: solar zenith step value */
     float xtsmin,               /* I: minimum solar zenith value */
     char anglehdf[STR_SIZE],    /* I: angle HDF filename */
@@ -199,6 +289,54 @@ int readluts
     char spheranm[STR_SIZE]     /* I: spherical albedo filename */
 );
 
+int write_lut_bin
+(
+    char *lut_bin,              /* I: binary LUT filename */
+    float xtsstep,              /* I: solar zenith step value */
+    float xtsmin,               /* I: minimum solar zenith value */
+    float **tsmax,              /* I: maximum scattering angle table [20][22] */
+    float **tsmin,              /* I: minimum scattering angle table [20][22] */
+    float **ttv,                /* I: view angle table [20][22] */
+    float tts[22],              /* I: sun angle table */
+    float **nbfic,              /* I: communitive number of azimuth angles
+                                      [20][22] */
+    float **nbfi,               /* I: number of azimuth angles [20][22] */
+    int32 indts[22],            /* I: index for the sun angle table */
+    float *rolutt,              /* I: intrinsic reflectance table
+                                      [NSR_BANDS][8000][22][7] */
+    float *transt,              /* I: transmission table
+                                      [NSR_BANDS][22][22][7] */
+    float *sphalbt,             /* I: spherical albedo table
+                                      [NSR_BANDS][22][7] */
+    float *normext              /* I: aerosol extinction coefficient
+                                      [NSR_BANDS][22][7] */
+);
+
+int map_lut_bin
+(
+    char *lut_bin,              /* I: binary LUT filename */
+    float xtsstep,              /* I: solar zenith step value */
+    float xtsmin,               /* I: minimum solar zenith value */
+    float **tsmax,              /* O: maximum scattering angle table [20][22] */
+    float **tsmin,              /* O: minimum scattering angle table [20][22] */
+    float **ttv,                /* O: view angle table [20][22] */
+    float tts[22],              /* O: sun angle table */
+    float **nbfic,              /* O: communitive number of azimuth angles
+                                      [20][22] */
+    float **nbfi,               /* O: number of azimuth angles [20][22] */
+    int32 indts[22],            /* O: index for the sun angle table */
+    float **rolutt,             /* O: intrinsic reflectance table
+                                      [NSR_BANDS][8000][22][7] */
+    float **transt,             /* O: transmission table
+                                      [NSR_BANDS][22][22][7] */
+    float **sphalbt,            /* O: spherical albedo table
+                                      [NSR_BANDS][22][7] */
+    float **normext,            /* O: aerosol extinction coefficient
+                                      [NSR_BANDS][22][7] */
+    bool verify,                /* I: verify the checksum of the tables */
+    Lut_map_t *lut_map          /* O: mapping of the binary LUT file */
+);
+
 int subaeroret
 (
     int iband1,                      /* I: band 1 index (0-based) */
@@ -218,18 +356,18 @@ int subaeroret
     float troatm[NSR_BANDS],         /* I: atmospheric reflectance table */
     float tpres[7],                  /* I: surface pressure table */
     float aot550nm[22],              /* I: AOT look-up table */
-    float ****rolutt,                /* I: intrinsic reflectance table
-                                           [NSR_BANDS][7][22][8000] */
-    float ****transt,                /* I: transmission table
-                                           [NSR_BANDS][7][22][22] */
+    float *rolutt,                   /* I: intrinsic reflectance table
+                                           [NSR_BANDS][8000][22][7] */
+    float *transt,                   /* I: transmission table
+                                           [NSR_BANDS][22][22][7] */
     float xtsstep,                   /* I: solar zenith step value */
     float xtsmin,                    /* I: minimum solar zenith value */
     float xtvstep,                   /* I: observation step value */
     float xtvmin,                    /* I: minimum observation value */
-    float ***sphalbt,                /* I: spherical albedo table
-                                           [NSR_BANDS][7][22] */
-    float ***normext,                /* I: ????
-                                           [NSR_BANDS][7][22] */
+    float *sphalbt,                  /* I: spherical albedo table
+                                           [NSR_BANDS][22][7] */
+    float *normext,                  /* I: ????
+                                           [NSR_BANDS][22][7] */
     float **tsmax,                   /* I: maximum scattering angle table
                                            [20][22] */
     float **tsmin,                   /* I: minimum scattering angle table
@@ -278,18 +416,18 @@ int subaeroret_residual
     float troatm[NSR_BANDS],         /* I: atmospheric reflectance table */
     float tpres[7],                  /* I: surface pressure table */
     float aot550nm[22],              /* I: AOT look-up table */
-    float ****rolutt,                /* I: intrinsic reflectance table
-                                           [NSR_BANDS][7][22][8000] */
-    float ****transt,                /* I: transmission table
-                                           [NSR_BANDS][7][22][22] */
+    float *rolutt,                   /* I: intrinsic reflectance table
+                                           [NSR_BANDS][8000][22][7] */
+    float *transt,                   /* I: transmission table
+                                           [NSR_BANDS][22][22][7] */
     float xtsstep,                   /* I: solar zenith step value */
     float xtsmin,                    /* I: minimum solar zenith value */
     float xtvstep,                   /* I: observation step value */
     float xtvmin,                    /* I: minimum observation value */
-    float ***sphalbt,                /* I: spherical albedo table
-                                           [NSR_BANDS][7][22] */
-    float ***normext,                /* I: ????
-                                           [NSR_BANDS][7][22] */
+    float *sphalbt,                  /* I: spherical albedo table
+                                           [NSR_BANDS][22][7] */
+    float *normext,                  /* I: ????
+                                           [NSR_BANDS][22][7] */
     float **tsmax,                   /* I: maximum scattering angle table
                                            [20][22] */
     float **tsmin,                   /* I: minimum scattering angle table
@@ -357,14 +495,6 @@ int memory_allocation_sr
     int16 ***slpratiob7, /* O: slope band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
     uint16 ***wv,        /* O: water vapor values [CMG_NBLAT][CMG_NBLON] */
     uint8 ***oz,         /* O: ozone values [CMG_NBLAT][CMG_NBLON] */
-    float *****rolutt,   /* O: intrinsic reflectance table
-                               [NSR_BANDS][7][22][8000] */
-    float *****transt,   /* O: transmission table
-                               [NSR_BANDS][7][22][22] */
-    float ****sphalbt,   /* O: spherical albedo table [NSR_BANDS][7][22] */
-    float ****normext,   /* O: aerosol extinction coefficient at the current
-                               wavelength (normalized at 550nm)
-                               [NSR_BANDS][7][22] */
     float ***tsmax,      /* O: maximum scattering angle table [20][22] */
     float ***tsmin,      /* O: minimum scattering angle table [20][22] */
     float ***nbfic,      /* O: communitive number of azimuth angles [20][22] */
@@ -372,6 +502,31 @@ int memory_allocation_sr
     float ***ttv         /* O: view angle table [20][22] */
 );
 
+int memory_allocation_lut
+(
+    float ***tsmax,      /* O: maximum scattering angle table [20][22] */
+    float ***tsmin,      /* O: minimum scattering angle table [20][22] */
+    float ***nbfic,      /* O: communitive number of azimuth angles [20][22] */
+    float ***nbfi,       /* O: number of azimuth angles [20][22] */
+    float ***ttv         /* O: view angle table [20][22] */
+);
+
+void free_lut
+(
+    float *rolutt,       /* I: intrinsic reflectance table
+                               [NSR_BANDS][8000][22][7] */
+    float *transt,       /* I: transmission table [NSR_BANDS][22][22][7] */
+    float *sphalbt,      /* I: spherical albedo table [NSR_BANDS][22][7] */
+    float *normext,      /* I: aerosol extinction coefficient
+                               [NSR_BANDS][22][7] */
+    float **tsmax,       /* I: maximum scattering angle table [20][22] */
+    float **tsmin,       /* I: minimum scattering angle table [20][22] */
+    float **nbfic,       /* I: communitive number of azimuth angles [20][22] */
+    float **nbfi,        /* I: number of azimuth angles [20][22] */
+    float **ttv,         /* I: view angle table [20][22] */
+    Lut_map_t *lut_map   /* I: mapping of the binary LUT file */
+);
+
 int read_auxiliary_files
 (
     char *anglehdf,     /* I: angle HDF filename */
@@ -381,6 +536,11 @@ int read_auxiliary_files
     char *cmgdemnm,     /* I: climate modeling grid DEM filename */
     char *rationm,      /* I: ratio averages filename */
     char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
+    char *aux_cache,    /* I: shared cache file of the static grids, NULL if
+                              not used */
+    Geoloc_t *space,    /* I: geolocation information of the scene */
+    int nlines,         /* I: number of lines in the scene */
+    int nsamps,         /* I: number of samples in the scene */
     int16 **dem,        /* O: CMG DEM data array [DEM_NBLAT][DEM_NBLON] */
     int16 **andwi,      /* O: avg NDWI [RATIO_NBLAT][RATIO_NBLON] */
     int16 **sndwi,      /* O: standard NDWI [RATIO_NBLAT][RATIO_NBLON] */
@@ -394,7 +554,13 @@ int read_auxiliary_files
     int16 **slpratiob2, /* O: slope band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
     int16 **slpratiob7, /* O: slope band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
     uint16 **wv,        /* O: water vapor values [CMG_NBLAT][CMG_NBLON] */
-    uint8 **oz          /* O: ozone values [CMG_NBLAT][CMG_NBLON] */
+    uint8 **oz,         /* O: ozone values [CMG_NBLAT][CMG_NBLON] */
+    Aux_window_t *win   /* O: CMG window read for the scene */
+);
+
+void free_aux_cache
+(
+    Aux_window_t *win   /* I: CMG window read for the scene */
 );
 
 #endif
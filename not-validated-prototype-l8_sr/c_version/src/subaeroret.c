@@ -78,18 +78,18 @@ int subaeroret
     float troatm[NSR_BANDS],         /* I: atmospheric reflectance table */
     float tpres[7],                  /* I: surface pressure table */
     float aot550nm[22],              /* I: AOT look-up table */
-    float ****rolutt,                /* I: intrinsic reflectance table
-                                           [NSR_BANDS][7][22][8000] */
-    float ****transt,                /* I: transmission table
-                                           [NSR_BANDS][7][22][22] */
+    float *rolutt,                   /* I: intrinsic reflectance table
+                                           [NSR_BANDS][8000][22][7] */
+    float *transt,                   /* I: transmission table
+                                           [NSR_BANDS][22][22][7] */
     float xtsstep,                   /* I: solar zenith step value */
     float xtsmin,                    /* I: minimum solar zenith value */
     float xtvstep,                   /* I: observation step value */
     float xtvmin,                    /* I: minimum observation value */
-    float ***sphalbt,                /* I: spherical albedo table
-                                           [NSR_BANDS][7][22] */
-    float ***normext,                /* I: ????
-                                           [NSR_BANDS][7][22] */
+    float *sphalbt,                  /* I: spherical albedo table
+                                           [NSR_BANDS][22][7] */
+    float *normext,                  /* I: ????
+                                           [NSR_BANDS][22][7] */
     float **tsmax,                   /* I: maximum scattering angle table
                                            [20][22] */
     float **tsmin,                   /* I: minimum scattering angle table
@@ -554,18 +554,18 @@ int subaeroret_residual
     float troatm[NSR_BANDS],         /* I: atmospheric reflectance table */
     float tpres[7],                  /* I: surface pressure table */
     float aot550nm[22],              /* I: AOT look-up table */
-    float ****rolutt,                /* I: intrinsic reflectance table
-                                           [NSR_BANDS][7][22][8000] */
-    float ****transt,                /* I: transmission table
-                                           [NSR_BANDS][7][22][22] */
+    float *rolutt,                   /* I: intrinsic reflectance table
+                                           [NSR_BANDS][8000][22][7] */
+    float *transt,                   /* I: transmission table
+                                           [NSR_BANDS][22][22][7] */
     float xtsstep,                   /* I: solar zenith step value */
     float xtsmin,                    /* I: minimum solar zenith value */
     float xtvstep,                   /* I: observation step value */
     float xtvmin,                    /* I: minimum observation value */
-    float ***sphalbt,                /* I: spherical albedo table
-                                           [NSR_BANDS][7][22] */
-    float ***normext,                /* I: ????
-                                           [NSR_BANDS][7][22] */
+    float *sphalbt,                  /* I: spherical albedo table
+                                           [NSR_BANDS][22][7] */
+    float *normext,                  /* I: ????
+                                           [NSR_BANDS][22][7] */
     float **tsmax,                   /* I: maximum scattering angle table
                                            [20][22] */
     float **tsmin,                   /* I: minimum scattering angle table